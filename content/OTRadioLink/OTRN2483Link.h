@@ -19,7 +19,7 @@ Author(s) / Copyright (s): Deniz Erbilgin 2016
 #ifndef ARDUINO_LIB_OTRN2483LINK_H_
 #define ARDUINO_LIB_OTRN2483LINK_H_
 
-#define ARDUINO_LIB_OTRN2483LINK_VERSION_MAJOR 2
+#define ARDUINO_LIB_OTRN2483LINK_VERSION_MAJOR 3
 #define ARDUINO_LIB_OTRN2483LINK_VERSION_MINOR 0
 
 // RN2483 support.
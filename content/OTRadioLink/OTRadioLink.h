@@ -28,12 +28,27 @@ Author(s) / Copyright (s): Damon Hart-Davis 2015--2016
 #include "utility/OTRadioLink_FrameType.h"
 #include "utility/OTRadioLink_SecureableFrameType.h"
 #include "utility/OTRadioLink_SecureableFrameType_V0p2Impl.h"
+#include "utility/OTRadioLink_SecureableFrameType_JournalImpl.h"
+#include "utility/OTRadioLink_SecureableFrameType_AESNIImpl.h"
 #include "utility/OTRadioLink_Messaging.h"
+#include "utility/OTRadioLink_SecureFrameRXPipeline.h"
 
 // Radio Link base class definition.
 #include "utility/OTRadioLink_OTRadioLink.h"
+// Duty-cycle-aware asynchronous TX queue.
+#include "utility/OTRadioLink_TXScheduler.h"
+// Lock-free RX queue for hosted multi-threaded receivers.
+#include "utility/OTRadioLink_ISRRXQueueSPSC.h"
+// Large-capacity RX queue with selectable overflow policy.
+#include "utility/OTRadioLink_ISRRXQueueLarge.h"
+// Optional RX queue instrumentation.
+#include "utility/OTRadioLink_ISRRXQueueInstrumented.h"
 
 // Radio Link Null class definition.
 #include "utility/OTRadioLink_OTNullRadioLink.h"
+// Simulated radio medium for hosted load tests.
+#include "utility/OTRadioLink_SimEther.h"
+// Hub-side in-memory time series of received stats.
+#include "utility/OTRadioLink_StatsIngest.h"
 
 #endif
@@ -368,12 +368,40 @@ namespace OTRFM23BLink
     //         - PCMSK0 interrupts may be enabled during a call to poll().
     // Set the targetISRRXMinQueueCapacity to at least 2, or 3 if RAM space permits, for busy RF channels.
     // With allowRX == false as much as possible of the receive side is disabled.
+    // With instrumentRX == true the RX queue records depth, drops and residency
+    // (in getSubCycleTime() ticks), available via getRXQueue().
+    // The RX path uses only non-virtual calls, into the queue included,
+    // and the RX side of the OTRadioLink interface is built by OTRadioLinkCRTP
+    // from the NonVirtual forms here, which code templated on this type
+    // may call directly.
 #define OTRFM23BLink_DEFINED
     static constexpr uint8_t DEFAULT_RFM23B_RX_QUEUE_CAPACITY = 3;
-    template <uint8_t SPI_nSS_DigitalPin, int8_t RFM_nIRQ_DigitalPin = -1, uint8_t targetISRRXMinQueueCapacity = 3, bool allowRX = true>
-    class OTRFM23BLink final : public OTRFM23BLinkBase
+    template <uint8_t SPI_nSS_DigitalPin, int8_t RFM_nIRQ_DigitalPin = -1, uint8_t targetISRRXMinQueueCapacity = 3, bool allowRX = true, bool instrumentRX = false>
+    class OTRFM23BLink final : public ::OTRadioLink::OTRadioLinkCRTP<
+        OTRFM23BLink<SPI_nSS_DigitalPin, RFM_nIRQ_DigitalPin, targetISRRXMinQueueCapacity, allowRX, instrumentRX>, OTRFM23BLinkBase>
         {
         private:
+            typedef ::OTRadioLink::OTRadioLinkCRTP<OTRFM23BLink, OTRFM23BLinkBase> crtp_t;
+            // Calls _dolistenNonVirtual().
+            friend crtp_t;
+
+            // Base members used here, as the base is now a dependent type.
+            typedef OTRFM23BLinkBase b_t;
+            using b_t::MaxRXMsgLen; using b_t::MaxTXMsgLen; using b_t::WAKE_ON_SYNC_RX;
+            using b_t::RXErr_DroppedFrame; using b_t::RXErr_RXOverrun;
+            typedef b_t::quickFrameFilter_t quickFrameFilter_t; using b_t::filterRXISR;
+            using b_t::droppedRXedMessageCountRecent; using b_t::filteredRXedMessageCountRecent;
+            using b_t::lastRXErr; using b_t::maxTypicalFrameBytes; using b_t::allowRXOps;
+            using b_t::getListenChannel; using b_t::_setChannel;
+            using b_t::_io; using b_t::_rd; using b_t::_wr;
+            using b_t::REG_INT_STATUS1; using b_t::REG_INT_ENABLE1; using b_t::REG_INT_ENABLE2;
+            using b_t::REG_OP_CTRL1; using b_t::REG_OP_CTRL1_SWRES; using b_t::REG_OP_CTRL2;
+            using b_t::REG_RSSI; using b_t::REG_RX_FIFO_CTRL; using b_t::REG_FIFO;
+            using b_t::REG_30_DATA_ACCESS_CONTROL; using b_t::REG_33_HEADER_CONTROL2;
+            using b_t::REG_3E_PACKET_LENGTH; using b_t::REG_4B_RECEIVED_PACKET_LENGTH;
+            using b_t::RFM23B_IPKVALID; using b_t::RFM23B_ENPKVALID;
+            using b_t::RFM23B_ENPACRX; using b_t::RFM23B_FIXPKLEN;
+
             // Use some template meta-programming
             // to replace the RX queue with a dummy if RX is not allowed/required.
             // Eg see https://en.wikibooks.org/wiki/C%2B%2B_Programming/Templates/Template_Meta-Programming#Compile-time_programming
@@ -383,7 +411,12 @@ namespace OTRFM23BLink
               struct typeIf<true, TypeTrue, TypeFalse> { typedef TypeTrue t; };
             template <typename TypeTrue, typename TypeFalse>
               struct typeIf<false, TypeTrue, TypeFalse> { typedef TypeFalse t; };
-            typename typeIf<allowRX, ::OTRadioLink::ISRRXQueueVarLenMsg<MaxRXMsgLen, targetISRRXMinQueueCapacity>, ::OTRadioLink::ISRRXQueueNULL>::t queueRX;
+            typedef typename typeIf<allowRX,
+                typename ::OTRadioLink::ISRRXQueueMaybeInstrumented<instrumentRX,
+                    ::OTRadioLink::ISRRXQueueVarLenMsg<MaxRXMsgLen, targetISRRXMinQueueCapacity>,
+                    ::OTV0P2BASE::getSubCycleTime>::t,
+                ::OTRadioLink::ISRRXQueueNULL>::t queueRX_t;
+            queueRX_t queueRX;
 
             // Internal routines to enable/disable RFM23B on the the SPI bus.
             // These depend only on the (constant) SPI_nSS_DigitalPin template parameter
@@ -715,7 +748,7 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                 // Disable interrupts while enabling them at RFM23B and entering RX mode.
                 ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
                     {
-                    const bool neededEnable = _upSPI_();
+                    const bool neededEnable = _upSPI();
                     // Clear RX and TX FIFOs.
                     _writeReg8Bit(REG_OP_CTRL2, 3); // FFCLRRX | FFCLRTX
                     _writeReg8Bit(REG_OP_CTRL2, 0);
@@ -729,8 +762,6 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                     if(neededEnable) { _downSPI(); }
                     }
                 }
-            // Version accessible to base class.
-            virtual void _dolisten() { _dolistenNonVirtual(); }
 
             // Common handling of polling and ISR code.
             // NOT RENTRANT: interrupts must be blocked when this is called.
@@ -777,7 +808,7 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                         // If there is space in the queue then read in the frame,
                         // else discard it.
                         volatile uint8_t *const bufferRX = (lengthRX > MaxRXMsgLen) ? NULL :
-                            queueRX._getRXBufForInbound();
+                            queueRX._getRXBufForInboundNonVirtual();
                         if(NULL != bufferRX)
                             {
                             // Attempt to read the entire frame.
@@ -789,12 +820,12 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                                 // Drop the frame: filter didn't like it.
                                 ++filteredRXedMessageCountRecent;
                                 // Don't queue frame...
-                                queueRX._loadedBuf(0);
+                                queueRX._loadedBufNonVirtual(0);
                                 }
                             else
                                 {
                                 // Queue message.
-                                queueRX._loadedBuf(lengthRX);
+                                queueRX._loadedBufNonVirtual(lengthRX);
                                 }
                             }
                         else
@@ -845,7 +876,7 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                         {
                         // Received frame.
                         // If there is space in the queue then read in the frame, else discard it.
-                        volatile uint8_t *const bufferRX = queueRX._getRXBufForInbound();
+                        volatile uint8_t *const bufferRX = queueRX._getRXBufForInboundNonVirtual();
                         if(NULL != bufferRX)
                             {
                             // Attempt to read the entire frame.
@@ -856,11 +887,11 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                             if((NULL != f) && !f(bufferRX, lengthRX))
                                 {
                                 ++filteredRXedMessageCountRecent; // Drop the frame: filter didn't like it.
-                                queueRX._loadedBuf(0); // Don't queue this frame...
+                                queueRX._loadedBufNonVirtual(0); // Don't queue this frame...
                                 }
                             else
                                 {
-                                queueRX._loadedBuf(lengthRX); // Queue message.
+                                queueRX._loadedBufNonVirtual(lengthRX); // Queue message.
                                 }
                             }
                         else
@@ -894,7 +925,7 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
             // Should be a compile-time constant.
             static constexpr bool hasInterruptSupport = (RFM_nIRQ_DigitalPin >= 0);
 
-            constexpr OTRFM23BLink() : OTRFM23BLinkBase(allowRX) { }
+            constexpr OTRFM23BLink() : crtp_t(allowRX) { }
 
             // Do very minimal pre-initialisation, eg at power up, to get radio to safe low-power mode.
             // Argument is read-only pre-configuration data;
@@ -913,7 +944,9 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
             // May also be used for output processing,
             // eg to run a transmit state machine.
             // May be called very frequently and should not take more than a few 100ms per call.
-            virtual void poll() override
+            // * pollNonVirtual() avoids the virtual call as for
+            // _handleInterruptNonVirtual() below.
+            void pollNonVirtual()
             {
                 if(!interruptLineIsEnabledAndInactive()) { ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { _poll(); } }
             }
@@ -951,8 +984,6 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
                 _poll();
                 return(true);
             }
-            // Version accessible to bass class.
-            virtual bool handleInterruptSimple() override { return (_handleInterruptNonVirtual()); }
 
             // Get current RSSI.
             // CURRENTLY RFM23B IMPL ONLY.
@@ -999,7 +1030,7 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
 
             // Fetches the current count of queued messages for RX.
             // ISR-/thread- safe.
-            virtual uint8_t getRXMsgsQueued() const override { return(queueRX.getRXMsgsQueued()); }
+            inline uint8_t getRXMsgsQueuedNonVirtual() const { return(queueRX.getRXMsgsQueued()); }
 
             // Peek at first (oldest) queued RX message, returning a pointer or NULL if no message waiting.
             // The pointer returned is NULL if there is no message,
@@ -1012,13 +1043,16 @@ V0P2BASE_DEBUG_SERIAL_PRINTLN_FLASHSTRING("RFM23 reset...");
             // This does not remove the message or alter the queue.
             // The buffer pointed to MUST NOT be altered.
             // Not intended to be called from an ISR.
-            virtual const volatile uint8_t *peekRXMsg() const override { return(queueRX.peekRXMsg()); }
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const { return(queueRX.peekRXMsgNonVirtual()); }
 
             // Remove the first (oldest) queued RX message.
             // Typically used after peekRXMessage().
             // Does nothing if the queue is empty.
             // Not intended to be called from an ISR.
-            virtual void removeRXMsg() override { queueRX.removeRXMsg(); }
+            inline void removeRXMsgNonVirtual() { queueRX.removeRXMsgNonVirtual(); }
+
+            // Read-only access to the RX queue, eg for its stats when instrumentRX is true.
+            const queueRX_t &getRXQueue() const { return(queueRX); }
 
 #if 0 // Defining the virtual destructor uses ~800+ bytes of Flash by forcing use of malloc()/free().
             // Ensure safe instance destruction when derived from.
@@ -14,13 +14,14 @@ specific language governing permissions and limitations
 under the Licence.
 
 Author(s) / Copyright (s): Deniz Erbilgin 2016
-                           Damon Hart-Davis 2016
+                           Damon Hart-Davis 2016--2018
 */
 
 /*
  * OpenTRV RN2483 LoRA Radio Link base class.
  *
- * Currently V0p2/AVR ONLY.
+ * Runs on V0p2/AVR; also builds hosted for unit testing
+ * with a scripted serial in place of the RN2483.
  */
 
 //Collection of useful links:
@@ -33,9 +34,9 @@ Author(s) / Copyright (s): Deniz Erbilgin 2016
 
 
 /**
- * @brief   Set dev addr on line 215 of OTRN2483Link_OTRN2483Link.cpp
- *          Set data rate on line 57 of OTRN2483Link_OTRN2483Link.cpp
- *          Set adaptive data rate by uncommmenting #define RN2483_ENABLE_ADR below and setting limits on line 55 of #define RN2483_ENABLE_ADR
+ * @brief   Set dev addr in setDevAddr() below.
+ *          Set data rate in sendConfigCommand() below.
+ *          Set adaptive data rate by uncommmenting #define RN2483_ENABLE_ADR below and setting limits in sendConfigCommand().
  * @todo    - Add config functionality
  *          - Move commands to progmem
  *          - Add intelligent way of utilising device eeprom (w/ mac save)
@@ -71,7 +72,6 @@ namespace OTRN2483Link
 {
 
 
-#ifdef ARDUINO_ARCH_AVR
 /**
  * @struct  OTRN2483LinkConfig
  * @brief   Structure containing config data for OTRN2483LinkConfig
@@ -97,6 +97,7 @@ typedef struct OTRN2483LinkConfig {
      * @retval    length of data copied to buffer
      */
     char get(const uint8_t *src) const{
+#ifdef ARDUINO_ARCH_AVR
         char c = 0;
         switch (bEEPROM) {
         case true:
@@ -106,109 +107,530 @@ typedef struct OTRN2483LinkConfig {
             c = pgm_read_byte(src);
             break;
         }
+#else
+        const char c = char(*src);
+#endif // ARDUINO_ARCH_AVR
         return c;
     }
 } OTRN2483LinkConfig_t;
 
 
+// Includes string constants.
+class OTRN2483LinkBase : public OTRadioLink::OTRadioLink
+{
+protected:
+    static const char SYS_START[5];   // Beginning of "sys" command set
+    static const char SYS_SLEEP[7];   // Sleep mode
+    static const char SYS_RESET[6]; // todo this can be removed on board with working reset line
+
+    static const char MAC_START[5];   // Beginning of "mac" command set
+#ifndef RN2483_CONFIG_IN_EEPROM
+    static const char MAC_DEVADDR[9]; // device address (required for ABP)
+    static const char MAC_APPSKEY[9]; // Application session key (required for ABP)
+    static const char MAC_NWKSKEY[9]; // Network session key (required for ABP)
+    static const char MAC_ADR[7];     // Set Adaptive Datarate "on"
+    static const char MAC_SET_DR[4];   // Set data rate.
+    static const char MAC_SET_CH[4];  // Channel stuff
+    static const char MAC_SET_DRRANGE[9]; // Set data rate range
+    static const char MAC_POWER[9]; // Set Tx power
+#endif // RN2483_CONFIG_IN_EEPROM
+    static const char MAC_JOINABP[9]; // Join LoRaWAN network by ABP (activation by personalisation)
+    static const char MAC_STATUS[7];
+    static const char MAC_SEND[12];     // Sends an unconfirmed packet on channel 1
+    static const char MAC_SAVE[5];
+
+    static const char RN2483_SET[5];  // Set command
+    static const char RN2483_GET[5];  // Get command
+    static const char RN2483_END[3];  // End of command (CR LF)
+
+    // Replies.
+    static const char RN2483_OK[3];   // Command accepted
+    static const char MAC_TX_OK[10];  // Uplink sent, no downlink
+    static const char MAC_RX[7];      // Uplink sent, downlink received (prefix)
+
+public:
+    // Largest frame sent: JSON frames above 49 bytes have been seen to fail at data rates 0--2.
+    static constexpr uint8_t RN2483_MAX_TX_MSG_LEN = 49;
+};
+
+
 /**
  * @brief   This is a class that extends OTRadioLink to communicate via LoRaWAN
  *          using the RN2483 radio module.
+ * @param   baud    baud rate to run ser_t at; the RN2483 autobauds to it
+ *                  on the break and 'U' sent by begin().
+ * @param   ser_t   serial to the RN2483, eg OTSoftSerial2 or a hardware
+ *                  serial; must also provide begin(baud) and sendBreak().
+ * @note    Nothing here waits for the RN2483: begin() queues the setup
+ *          commands and sendRaw() queues the frame, then poll() sends each
+ *          command in turn once the reply to the one before has arrived,
+ *          reading at most maxReadsPerPoll chars per call.
+ *          A reply is one line; "mac join" and "mac tx" give a second
+ *          line once done, and the next command waits for that.
+ *          Commands not answered in time are given up on.
+ * @note    One frame is held: a frame queued before poll() has started
+ *          sending the last replaces it, ensuring the freshest is sent.
  */
 #define OTRN2483Link_DEFINED
-class OTRN2483Link final : public OTRadioLink::OTRadioLink
+template<uint8_t nRstPin, uint8_t rxPin, uint8_t txPin,
+    uint_fast8_t (*const getCurrentSeconds)(),
+    uint32_t baud,
+    class ser_t
+#ifdef OTSoftSerial2_DEFINED
+        = OTV0P2BASE::OTSoftSerial2<rxPin, txPin, baud>
+#endif // OTSoftSerial2_DEFINED
+    >
+class OTRN2483Link final : public OTRN2483LinkBase
 {
 public:
-	// Public interface
-    OTRN2483Link(uint8_t _nRstPin, uint8_t rxPin, uint8_t txPin);
+    // Maximum number of ser.read() calls in one poll().
+    static constexpr uint8_t maxReadsPerPoll = 64;
 
-    void preinit(const void */*preconfig*/) {};
-    bool begin();
-    bool end();
+    OTRN2483Link() { }
 
-    bool sendRaw(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower power = TXnormal, bool listenAfter = false);
-//    bool queueToSend(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower power = TXnormal);
-    inline bool isAvailable(){ return bAvailable; };     // checks radio is there independant of power state
-    bool handleInterruptSimple() { return true;};
+    void preinit(const void */*preconfig*/) override {};
 
     /**
-     * @brief   Unused. For compatibility with OTRadioLink.
+     * @brief   Starts the serial, autobauds the RN2483 and queues its setup.
+     * @note    The setup is sent by poll().
+     */
+    bool begin() override
+    {
+#ifdef ARDUINO_ARCH_AVR
+        // Wait for RN2483 to boot properly to avoid autobauding issues
+        OTV0P2BASE::nap(WDTO_30MS);
+        // init resetPin
+        pinMode(nRstPin, INPUT);    // TODO This is shorting on my board
+#endif // ARDUINO_ARCH_AVR
+        ser.begin(baud);
+        setBaud();
+        // todo check RN2483 is present and communicative here
+        configStep = 0;
+        repliesExpected = 0;
+        sendingTX = false;
+#ifdef RN2483_ALLOW_SLEEP
+        asleep = false;
+#endif // RN2483_ALLOW_SLEEP
+        return true;
+    }
+
+    /**
+     * @brief   End LoRaWAN connection
      */
-    void poll();
-    void getCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen, uint8_t &maxTXMsgLen) const;
-    uint8_t getRXMsgsQueued() const;
-    const volatile uint8_t *peekRXMsg() const;
-    void removeRXMsg() {};
+    bool end() override { return true; }
 
+    /**
+     * @brief   Queues a raw frame to send.
+     * @param   buf Send buffer.
+     * @retval  True if the frame was queued, to be sent by poll().
+     */
+    bool sendRaw(const uint8_t *buf, uint8_t buflen, int8_t /*channel*/ = 0,
+            TXpower /*power*/ = TXnormal, bool /*listenAfter*/ = false) override
+    {
+        if((NULL == buf) || (0 == buflen) || (buflen > sizeof(txQueue))) return false;
+        memcpy(txQueue, buf, buflen);
+        txMsgLen = buflen;
+        return true;
+    }
 
-private:
-// Private methods
-    // Serial
-    uint8_t read();
-    uint8_t timedBlockingRead(char *data, uint8_t length);
-    void write(const char *data, uint8_t length);
-    void print(const char data);
-    void print(const uint8_t value);	// todo change this so it prints in hex?
-    void print(const char *string);
-    void print(const void *src);
+    // checks radio is there independant of power state
+    bool isAvailable() const override { return bAvailable; }
+    bool handleInterruptSimple() override { return true; }
 
-    // Commands
-    void factoryReset();
-    void reset();
-    void setBaud();
-    void setDevAddr(const uint8_t *address);
-    void setKeys(const uint8_t *appKey, const uint8_t *networkKey);
-    void joinABP();
-    bool getStatus();
-    void save();
-    void setDataRate(uint8_t dataRate);
-    void setAdaptiveDataRate(uint8_t minRate, uint8_t maxRate);
-    void setTxPower(uint8_t power);
+    // Number of frames queued and not yet handed to the RN2483.
+    uint8_t getTXMsgsQueued() const { return (0 != txMsgLen) ? 1 : 0; }
+    // Frames refused, failed or not answered by the RN2483 (wraps).
+    uint8_t getTXFailed() const { return txFailed; }
 
-    // Setup
-    bool _doconfig() { return true; };
+    /**
+     * @brief   Collects any reply and sends the next command when the last is done.
+     */
+    void poll() override
+    {
+        if(0 != repliesExpected) {
+            if(collectReply()) {
+                handleReply();
+            } else if(waitedLongEnough(commandTime, timeOut)) {
+                // Silent module: give up on this command.
+                repliesExpected = 0;
+                if(sendingTX) { sendingTX = false; ++txFailed; }
+            }
+            return;
+        }
+        const uint8_t replies = sendConfigCommand(configStep);
+        if(0 != replies) {
+            ++configStep;
+            startReply(replies);
+            return;
+        }
+        if(0 == txMsgLen) return;
+#ifdef RN2483_ALLOW_SLEEP
+        if(asleep) {
+            // Wake it; it answers "ok" once awake.
+            asleep = false;
+            setBaud();
+            startReply(1);
+            return;
+        }
+#endif // RN2483_ALLOW_SLEEP
+        print(MAC_START);
+        print(MAC_SEND);
+        printHex(txQueue, txMsgLen);
+        print(RN2483_END);
+        txMsgLen = 0; // Free for the next frame.
+        sendingTX = true;
+        startReply(2);
+    }
 
-    // misc
-    bool getHex(const uint8_t *string, uint8_t *output, uint8_t outputLen);
+    void getCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen, uint8_t &maxTXMsgLen) const override
+    {
+        queueRXMsgsMin = 0;
+        maxRXMsgLen = 0;
+        maxTXMsgLen = sizeof(txQueue);
+    }
+    uint8_t getRXMsgsQueued() const override { return 0; }
+    const volatile uint8_t *peekRXMsg() const override { return NULL; }
+    void removeRXMsg() override {};
 
-// Private consts and variables
-    const OTRN2483LinkConfig *config;  // Pointer to radio config
-    OTV0P2BASE::OTSoftSerial ser;
-    static const uint16_t baud = 2400;	 // OTSoftSer baud rate. todo switch to template to allow higher speed
-    bool bAvailable;
-    const uint8_t nRstPin;
 
+private:
+    // Time in seconds to wait for a reply before giving up.
+    static constexpr uint8_t replyTimeOut = 1;
+    // Time in seconds to wait for the result of a join or send,
+    // allowing for airtime at SF12 and both receive windows.
+    static constexpr uint8_t resultTimeOut = 15;
 
-    static const char SYS_START[5];	  // Beginning of "sys" command set
-    static const char SYS_SLEEP[7];   // Sleep mode
-    static const char SYS_RESET[6]; // todo this can be removed on board with working reset line
+    /**
+     * @brief   Check if waited long enough using RTC.
+     * @param   duration: number of seconds we need to wait. Strictly positive.
+     * @reval   True if waited enough, else false.
+     */
+    bool waitedLongEnough(uint_fast8_t oldTime, uint_fast8_t duration) const
+        { return OTV0P2BASE::getElapsedSecondsLT(oldTime, getCurrentSeconds()) > duration; }
 
-    static const char MAC_START[5];   // Beginning of "mac" command set
+    // Serial
+    /**
+     * @brief   Starts collecting the replies to the command just sent.
+     * @param   replies number of reply lines expected.
+     */
+    void startReply(const uint8_t replies)
+    {
+        memset(reply, 0, sizeof(reply));
+        replyLen = 0;
+        repliesExpected = replies;
+        timeOut = replyTimeOut;
+        commandTime = uint8_t(getCurrentSeconds());
+    }
+    /**
+     * @brief   Adds chars from ser.read() to reply[], without waiting for more.
+     * @note    Makes at most maxReadsPerPoll reads. Chars beyond the size
+     *          of reply[] are read and discarded, as are blank lines.
+     *          Anything received restarts the timeout.
+     * @retval  True if a whole reply line is in reply[].
+     */
+    bool collectReply()
+    {
+        for(uint8_t i = maxReadsPerPoll; i > 0; --i) {
+            const int ic = ser.read();
+            if(-1 == ic) return false;
+            commandTime = uint8_t(getCurrentSeconds());
+            if('\n' == ic) {
+                if(0 != replyLen) return true;
+            } else if(('\r' != ic) && (replyLen < sizeof(reply) - 1)) {
+                reply[replyLen++] = char(ic);
+            }
+        }
+        return false; // More to come: carry on next poll.
+    }
+    /**
+     * @brief   Acts on the reply line in reply[].
+     * @note    A refused join or send gives no second reply.
+     */
+    void handleReply()
+    {
+        bAvailable = true;
+        if(repliesExpected > 1) {
+            if(0 != strcmp(reply, RN2483_OK)) repliesExpected = 1;
+            else timeOut = resultTimeOut;
+        }
+        if(0 == --repliesExpected) {
+            if(sendingTX) {
+                sendingTX = false;
+                if((0 != strcmp(reply, MAC_TX_OK)) && (0 != strncmp(reply, MAC_RX, sizeof(MAC_RX) - 1))) ++txFailed;
+#ifdef RN2483_ALLOW_SLEEP
+                print(SYS_START);
+                print(SYS_SLEEP);
+                print("300000"); // FIXME sleeps for 4 mins
+                print(RN2483_END);
+                asleep = true;
+#endif // RN2483_ALLOW_SLEEP
+            }
+        }
+        memset(reply, 0, sizeof(reply));
+        replyLen = 0;
+    }
+    /**
+     * @brief   Prints a single character to RN2483
+     * @param   data character to print
+     */
+    void print(const char data) { ser.print(data); }
+    /**
+     * @brief   Prints a string to the RN2483
+     * @param   pointer to a \0 terminated char string
+     */
+    void print(const char *string) { ser.print(string); }
+    /**
+     * @brief   Prints a buffer to the RN2483 as upper case hex.
+     * @param   buf Buffer to print.
+     * @param   len Length of buf.
+     */
+    void printHex(const uint8_t *buf, uint8_t len)
+    {
+        while(len--) {
+            const uint8_t b = *buf++;
+            print(hexDigit(b >> 4));
+            print(hexDigit(b & 0xf));
+        }
+    }
+    static char hexDigit(const uint8_t n) { return char((n <= 9) ? ('0' + n) : ('A' - 10 + n)); }
+
+    // Commands
+    /**
+     * @brief   Sends the setup command for a step, in order.
+     * @param   step    0 for the first, one more for each after.
+     * @retval  Number of replies to expect, or 0 once past the last step.
+     */
+    uint8_t sendConfigCommand(uint8_t step)
+    {
+        // Each test is of the step left after those before it.
 #ifndef RN2483_CONFIG_IN_EEPROM
-    static const char MAC_DEVADDR[9]; // device address (required for ABP)
-    static const char MAC_APPSKEY[9]; // Application session key (required for ABP)
-    static const char MAC_NWKSKEY[9]; // Network session key (required for ABP)
-    static const char MAC_ADR[7];     // Set Adaptive Datarate "on"
-    static const char MAC_SET_DR[4];   // Set data rate.
-    static const char MAC_SET_CH[4];  // Channel stuff
-    static const char MAC_SET_DRRANGE[9]; // Set data rate range
-    static const char MAC_POWER[9]; // Set Tx power
+        if(0 == step--) { setDevAddr(NULL); return 1; } // TODO not needed if saved to EEPROM
+        if(0 == step--) { setAppSessionKey(NULL); return 1; } // TODO not needed if saved to EEPROM
+        if(0 == step--) { setNetworkSessionKey(NULL); return 1; }
+#ifdef RN2483_ENABLE_ADR
+        // send between SF11 and SF7 on the 3 default channels.
+        if(step < 3) { setChannelDataRateRange(step, 1, 5); return 1; }
+        step -= 3;
+        if(0 == step--) { setAdaptiveDataRateOn(); return 1; }
+#else
+        if(0 == step--) { setDataRate(1); return 1; } // Send at slowest rate possible without breaking etsi (SF12)
+#endif // RN2483_ENABLE_ADR
+        // set power level
+//        setTxPower(1);
 #endif // RN2483_CONFIG_IN_EEPROM
-    static const char MAC_JOINABP[9]; // Join LoRaWAN network by ABP (activation by personalisation)
-    static const char MAC_STATUS[7];
-    static const char MAC_SEND[12];		// Sends an unconfirmed packet on channel 1
-    static const char MAC_SAVE[5];
+        if(0 == step--) { joinABP(); return 2; } // "ok" then "accepted"
+        // get status (returns 0001 when connected and not Txing)
+        if(0 == step--) { getStatus(); return 1; }
+        return 0;
+    }
 
-    static const char RN2483_SET[5];  // Set command
-    static const char RN2483_GET[5];  // Get command
-    static const char RN2483_END[3];  // End of command (CR LF)
+    /**
+     * @brief   Sends a 5 ms break
+     */
+    void setBaud()
+    {
+        ser.sendBreak();
+        print('U'); // send syncro character
+    }
 
+    /**
+     * @brief   reset device
+     * @note    Currently using software reset as there is a short on my REV14
+     */
+    void reset()
+    {
+        print(SYS_START);
+        print(SYS_RESET);
+        print(RN2483_END);
+    }
+
+#ifndef RN2483_CONFIG_IN_EEPROM
+    /**
+     * @brief   sets device address
+     * @param   pointer to 4 byte buffer containing address
+     * @note    OpenTRV has temporarily reserved the block 02:01:11:xx
+     *          and is using addresses 00-04 (as of 2016-01-29)
+     * @todo    Confirm this is in hex
+     */
+    void setDevAddr(const uint8_t */*address*/)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_DEVADDR);
+        print("02011123"); // TODO this will be stored as number in config
+        print(RN2483_END);
+    }
+    /**
+     * @brief   sets LoRa application session key
+     * @param   appKey  pointer to a 16 byte buffer containing application key.
+     *                  This is specific to the OpenTRV server and should be kept secret.
+     * @note    The RN2483 takes numbers as HEX values.
+     */
+    void setAppSessionKey(const uint8_t */*appKey*/)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_APPSKEY);
+        print("2B7E151628AED2A6ABF7158809CF4F3C"); // TODO this will be stored as number in config
+        print(RN2483_END);
+    }
+    /**
+     * @brief   sets LoRa network session key
+     * @param   networkKey  pointer to a 16 byte buffer containing the network key.
+     *                      This should be the Thing Network key and can be made public.
+     *                      The key is: 2B7E151628AED2A6ABF7158809CF4F3C
+     * @note    The RN2483 takes numbers as HEX values.
+     */
+    void setNetworkSessionKey(const uint8_t */*networkKey*/)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_NWKSKEY);
+        print("2B7E151628AED2A6ABF7158809CF4F3C"); // TODO this will be stored as number in config
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Sets data rate
+     * @param   dataRate: desired data rate.
+     *            - 0 is SF12
+     *            - 1 is SF11
+     *            - 2 is SF10
+     *            - 3 is SF9
+     *            - 4 is SF8
+     *            - 5 is SF7
+     * @note    Faster data rates save power and airtime, slower rates give
+     *          better range.
+     * @note    Minimum data rate that allows us to send our packets at 240s
+     *          intervals is  SF11 (see implementation notes for details).
+     * @note    Command reference says it sets the data rate of the next send but
+     *          I think it sets data rate for ALL subsequent sends on ALL channels.
+     */
+    void setDataRate(uint8_t dataRate)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_SET_DR);
+        print((char)('0' + dataRate)); // convert to ascii
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Sets the data rate range of one channel, for adaptive data rate.
+     * @param   channel: channel to set, 0--2 for the default channels.
+     * @param   minRate: Minimum data rate
+     * @param   maxRate: Maximum data rate (as for setDataRate())
+     * @note    Command reference does not mention this, but adr must be set to on
+     *          AND channel data rate ranges must be set.
+     * @todo    Test if this works on 2016/3/8
+     */
+    void setChannelDataRateRange(uint8_t channel, uint8_t minRate, uint8_t maxRate)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_SET_CH);
+        print(MAC_SET_DRRANGE);
+        print((char)('0' + channel));
+        print(' ');
+        print((char)('0' + minRate));
+        print(' ');
+        print((char)('0' + maxRate));
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Turns on adaptive data rate, once channel ranges are set.
+     */
+    void setAdaptiveDataRateOn()
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_ADR); // Adaptive data rate
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Sets Tx power
+     * @param   power:   output power. From LoRaWAN spec:
+     *          - 1: 14 dBm
+     *          - 2: 11 dBm
+     *          - 3:  8 dBm
+     *          - 4:  5 dBm
+     *          - 5:  2 dBm
+     * @note    RN2483 defaults to setting 1 (14 dBm)
+     * @note    The output levels on page 7 of the datasheet are for point to point levels.
+     */
+    void setTxPower(uint8_t power)
+    {
+        print(MAC_START);
+        print(RN2483_SET);
+        print(MAC_POWER);
+        print((char)('0' + power));
+        print(RN2483_END);
+    }
+#endif // RN2483_CONFIG_IN_EEPROM
+    /**
+     * @brief   Activates connection by personalisation
+     */
+    void joinABP()
+    {
+        print(MAC_START);
+        print(MAC_JOINABP); // Join by ABP (activation by personalisation)
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Request status
+     * @todo    Find out what status messages mean and document.
+     *          Implement check
+     */
+    void getStatus()
+    {
+        print(MAC_START);
+        print(RN2483_GET);
+        print(MAC_STATUS);
+        print(RN2483_END);
+    }
+    /**
+     * @brief   Saves current mac state
+     */
+    void save()
+    {
+        print(MAC_START);
+        print(MAC_SAVE);
+        print(RN2483_END);
+    }
+
+    // Setup
+    bool _doconfig() override { return true; };
     /**
      * @brief   Unused. For compatibility with OTRadioLink.
      */
-    void _dolisten() {};
+    void _dolisten() override {};
+
+// Private consts and variables
+    const OTRN2483LinkConfig *config = NULL;  // Pointer to radio config
+    // Serial to the RN2483: for V0p2 boards expected to be of type:
+    //     OTV0P2BASE::OTSoftSerial2<rxPin, txPin, baud>
+    ser_t ser;
+    bool bAvailable = false;
+    // Next setup command to send.
+    uint8_t configStep = 0;
+    // Reply lines still to come for the command last sent; 0 when none.
+    uint8_t repliesExpected = 0;
+    // True from sending a frame until its result.
+    bool sendingTX = false;
+#ifdef RN2483_ALLOW_SLEEP
+    // True once told to sleep after a send.
+    bool asleep = false;
+#endif // RN2483_ALLOW_SLEEP
+    uint8_t txFailed = 0;
+    // Seconds to wait for the next reply line.
+    uint8_t timeOut = replyTimeOut;
+    // Time (from getCurrentSeconds()) of the command last sent or char last received.
+    uint8_t commandTime = 0;
+    // Reply line being collected, \0 terminated; excess chars are discarded.
+    char reply[16];
+    uint8_t replyLen = 0;
+    // Frame to send, if txMsgLen is non-zero.
+    uint8_t txQueue[RN2483_MAX_TX_MSG_LEN];
+    uint8_t txMsgLen = 0;
 };
-#endif // ARDUINO_ARCH_AVR
 
 
 } // namespace OTRN2483Link
@@ -116,7 +116,7 @@ static uint8_t *_FHT8VCreate200usAppendByteEP(uint8_t *bptr, const uint8_t b)
 // The maximum and minimum possible encoded message sizes are 35 (all zero bytes) and 45 (all 0xff bytes) bytes long.
 // Note that a buffer space of at least 46 bytes is needed to accommodate the longest-possible encoded message and terminator.
 // Returns pointer to the terminating 0xff on exit.
-uint8_t *FHT8VRadValveUtil::FHT8VCreate200usBitStreamBptr(uint8_t *bptr, const FHT8VRadValveUtil::fht8v_msg_t *command)
+uint8_t *FHT8VRadValveUtil::FHT8VCreate200usBitStreamBptrCompact(uint8_t *bptr, const FHT8VRadValveUtil::fht8v_msg_t *command)
   {
   // Generate FHT8V preamble.
   // First 12 x 0 bits of preamble, pre-encoded as 6 x 0xcc bytes.
@@ -282,7 +282,7 @@ static uint8_t readOneByteWithParity(decode_state_t *const state)
 // Will return non-null if OK, else NULL if anything obviously invalid is detected such as failing parity or checksum.
 // Finds and discards leading encoded 1 and trailing 0.
 // Returns NULL on failure, else pointer to next full byte after last decoded.
-uint8_t const * FHT8VRadValveUtil::FHT8VDecodeBitStream(uint8_t const *bitStream, uint8_t const *lastByte, FHT8VRadValveUtil::fht8v_msg_t *command)
+uint8_t const * FHT8VRadValveUtil::FHT8VDecodeBitStreamCompact(uint8_t const *bitStream, uint8_t const *lastByte, FHT8VRadValveUtil::fht8v_msg_t *command)
   {
   decode_state_t state;
   state.bitStream = bitStream;
@@ -362,6 +362,192 @@ uint8_t const * FHT8VRadValveUtil::FHT8VDecodeBitStream(uint8_t const *bitStream
   return(state.bitStream + 1);
   }
 
+#ifndef OTRADVALVE_FHT8V_COMPACT_CODEC
+// Table-driven encoder and decoder.
+//
+// Each logical bit is a whole number of bit pairs (11 00 for 0, 11 10 00 for 1),
+// so the encoder appends whole table entries to a bit accumulator,
+// and the decoder steps a three-state bit-pair machine a byte (four pairs) at a time.
+// The tables are in PROGMEM, and only 32-bit arithmetic is used, to suit AVR.
+
+// 200us encoding of the n lsbits of v, msbit first, right-aligned.
+static constexpr uint32_t enc200us(const uint8_t v, const uint8_t n)
+  { return((0 == n) ? 0 : ((enc200us(uint8_t(v >> 1), uint8_t(n - 1)) << ((v & 1) ? 6 : 4)) | ((v & 1) ? 0x38 : 0xc))); }
+static constexpr uint8_t parity4(const uint8_t n) { return((n ^ (n >> 1) ^ (n >> 2) ^ (n >> 3)) & 1); }
+// Low nibble with its byte's even parity bit appended; bit 4 of i is the parity of the high nibble.
+static constexpr uint32_t encLowWithParity(const uint8_t i)
+  { return(enc200us(uint8_t(((i & 0xf) << 1) | ((i >> 4) ^ parity4(i & 0xf))), 5)); }
+
+#define FHT8V_ENC4(f, i) f(i), f(i+1), f(i+2), f(i+3)
+#define FHT8V_ENC16(f, i) FHT8V_ENC4(f, i), FHT8V_ENC4(f, i+4), FHT8V_ENC4(f, i+8), FHT8V_ENC4(f, i+12)
+static constexpr uint32_t encHigh(const uint8_t i) { return(enc200us(i, 4)); }
+// Encoded high nibble, by nibble.
+static const uint32_t FHT8VEncHigh[16] PROGMEM = { FHT8V_ENC16(encHigh, 0) };
+// Encoded low nibble and parity, by (parity of high nibble << 4) | nibble.
+static const uint32_t FHT8VEncLowParity[32] PROGMEM = { FHT8V_ENC16(encLowWithParity, 0), FHT8V_ENC16(encLowWithParity, 16) };
+// Number of 1 bits in each nibble; each 1 encodes 2 bits longer than a 0.
+static const uint8_t FHT8VNibbleOnes[16] PROGMEM = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Accumulates encoded bits, msbit first, writing each byte as it fills.
+class FHT8VBitWriter final
+  {
+  public:
+    uint8_t *bptr;
+    uint32_t acc = 0; // Bits already written may be left above the n lsbits.
+    uint8_t n = 0; // Bits in acc not yet written, 0--7 between calls.
+    explicit FHT8VBitWriter(uint8_t *const b) : bptr(b) { }
+    // Appends the len lsbits of bits; len at most 24 so as to fit in acc.
+    void push(const uint32_t bits, const uint8_t len)
+      {
+      acc = (acc << len) | bits;
+      n += len;
+      while(n >= 8) { n -= 8; *bptr++ = uint8_t(acc >> n); }
+      }
+    // Appends the len lsbits of bits; len at most 32.
+    void append(const uint32_t bits, const uint8_t len)
+      {
+      if(len > 24) { push(bits >> 16, uint8_t(len - 16)); push(bits & 0xffff, 16); }
+      else { push(bits, len); }
+      }
+    // Appends b msbit first then its even parity bit.
+    void appendByteEP(const uint8_t b)
+      {
+      const uint8_t hi = b >> 4, lo = b & 0xf;
+      const uint8_t onesHi = pgm_read_byte(&FHT8VNibbleOnes[hi]);
+      const uint8_t onesLo = pgm_read_byte(&FHT8VNibbleOnes[lo]);
+      const uint8_t parity = (onesHi ^ onesLo) & 1;
+      append(pgm_read_dword(&FHT8VEncHigh[hi]), uint8_t(16 + 2*onesHi));
+      append(pgm_read_dword(&FHT8VEncLowParity[((onesHi & 1) << 4) | lo]), uint8_t(20 + 2*(onesLo + parity)));
+      }
+  };
+
+// As FHT8VCreate200usBitStreamBptrCompact().
+uint8_t *FHT8VRadValveUtil::FHT8VCreate200usBitStreamBptrTable(uint8_t *bptr, const FHT8VRadValveUtil::fht8v_msg_t *command)
+  {
+  FHT8VBitWriter w(bptr);
+  // Preamble of 12 x 0 and a 1.
+  w.append(0xcccccc, 24);
+  w.append(0xcccccc, 24);
+  w.append(0x38, 6);
+  w.appendByteEP(command->hc1);
+  w.appendByteEP(command->hc2);
+#ifdef OTV0P2BASE_FHT8V_ADR_USED
+  w.appendByteEP(command->address);
+  const uint8_t checksum = 0xc + command->hc1 + command->hc2 + command->address + command->command + command->extension;
+#else
+  w.appendByteEP(0); // Default/broadcast.
+  const uint8_t checksum = 0xc + command->hc1 + command->hc2 + command->command + command->extension;
+#endif
+  w.appendByteEP(command->command);
+  w.appendByteEP(command->extension);
+  w.appendByteEP(checksum);
+  // Trailing 0, and two more to flush out the final required bits.
+  w.append(0xccc, 12);
+  // Any partial byte is dropped, as by the compact version.
+  *w.bptr = (uint8_t)0xff; // Terminate TX bytes.
+  return(w.bptr);
+  }
+
+// Bit pair decoder: state 0 expecting 11, 1 after 11, 2 after 11 10.
+static constexpr uint8_t DEC_BIT = 4; // A logical bit was completed...
+static constexpr uint8_t DEC_ONE = 8; // ...and it was a 1.
+static constexpr uint8_t DEC_ERR = 0x10; // Invalid pair.
+// Result of bit pair p in state s: the next state in the low 2 bits.
+static constexpr uint8_t decPair(const uint8_t s, const uint8_t p)
+  {
+  return((0 == s) ? ((3 == p) ? 1 : DEC_ERR) :
+         (1 == s) ? ((0 == p) ? DEC_BIT : ((2 == p) ? 2 : DEC_ERR)) :
+                    ((0 == p) ? (DEC_BIT | DEC_ONE) : DEC_ERR));
+  }
+// Byte decoder table entry:
+//   bits 0--1: state after the byte,
+//   bits 2--3: number of logical bits completed (at most 2) before any invalid pair,
+//   bits 4--5: their values, msbit first (right-aligned),
+//   bits 6--7, 8--9: index (0--3, msbits first) of the pair completing each,
+//   bit 10: an invalid pair follows those bits.
+static constexpr uint16_t DECB_COUNT1 = 4;
+static constexpr uint16_t DECB_ERR = 0x400;
+// Entry e updated with the pair p at index i.
+static constexpr uint16_t decByteStep(const uint16_t e, const uint8_t i, const uint8_t r)
+  {
+  return((0 != (e & DECB_ERR)) ? e :
+         (0 != (r & DEC_ERR)) ? (e | DECB_ERR) :
+         (0 == (r & DEC_BIT)) ? uint16_t((e & ~3U) | r) :
+         uint16_t(((e & ~0x33U) | (((((e >> 4) & 1U) << 1) | ((0 != (r & DEC_ONE)) ? 1U : 0U)) << 4)) +
+           DECB_COUNT1 + (uint16_t(i) << (6 + 2*((e >> 2) & 3)))));
+  }
+static constexpr uint16_t decByteStepPair(const uint16_t e, const uint8_t i, const uint8_t b)
+  { return(decByteStep(e, i, decPair(uint8_t(e & 3), uint8_t((b >> (6 - 2*i)) & 3)))); }
+// Entry for index (state << 8) | byte.
+static constexpr uint16_t decByte(const uint16_t i)
+  {
+  return(decByteStepPair(decByteStepPair(decByteStepPair(decByteStepPair(
+    uint16_t(i >> 8), 0, uint8_t(i)), 1, uint8_t(i)), 2, uint8_t(i)), 3, uint8_t(i)));
+  }
+#define FHT8V_DEC64(i) FHT8V_ENC16(decByte, i), FHT8V_ENC16(decByte, i+16), FHT8V_ENC16(decByte, i+32), FHT8V_ENC16(decByte, i+48)
+#define FHT8V_DEC256(i) FHT8V_DEC64(i), FHT8V_DEC64(i+64), FHT8V_DEC64(i+128), FHT8V_DEC64(i+192)
+static const uint16_t FHT8VDecByte[3*256] PROGMEM = { FHT8V_DEC256(0), FHT8V_DEC256(256), FHT8V_DEC256(512) };
+#undef FHT8V_DEC256
+#undef FHT8V_DEC64
+#undef FHT8V_ENC16
+#undef FHT8V_ENC4
+
+// As FHT8VDecodeBitStreamCompact().
+uint8_t const *FHT8VRadValveUtil::FHT8VDecodeBitStreamTable(uint8_t const *bitStream, uint8_t const *lastByte, FHT8VRadValveUtil::fht8v_msg_t *command)
+  {
+  // After the leading 1: six bytes each with parity, then the trailing 0.
+  uint8_t b[6];
+  uint8_t nBytes = 0;
+  uint16_t acc = 0; // Bits of the current byte and its parity.
+  uint8_t nBits = 0;
+  bool started = false;
+  uint8_t state = 0;
+  for(uint8_t const *p = bitStream; p <= lastByte; ++p)
+    {
+    const uint16_t e = pgm_read_word(&FHT8VDecByte[(uint16_t(state) << 8) | *p]);
+    const uint8_t count = (e >> 2) & 3;
+    const uint8_t bits = (e >> 4) & 3;
+    if(started && (nBytes < 6) && (nBits + count < 9))
+      {
+      // Fast path: all bits from this byte go into the current byte.
+      acc = uint16_t((acc << count) | bits);
+      nBits += count;
+      }
+    else for(uint8_t k = 0; k < count; ++k)
+      {
+      const bool one = (0 != ((bits >> (count - 1 - k)) & 1));
+      if(!started) { started = one; continue; } // Skip preamble 0s up to the leading 1.
+      if(6 == nBytes)
+        {
+        // Check the trailing 0 and the checksum.
+        if(one) { return(NULL); }
+        command->hc1 = b[0];
+        command->hc2 = b[1];
+#ifdef OTV0P2BASE_FHT8V_ADR_USED
+        command->address = b[2];
+#endif
+        command->command = b[3];
+        command->extension = b[4];
+        if(uint8_t(0xc + b[0] + b[1] + b[2] + b[3] + b[4]) != b[5]) { return(NULL); }
+        // Next full byte after the last pair read.
+        return((3 == ((e >> (6 + 2*k)) & 3)) ? (p + 2) : (p + 1));
+        }
+      acc = uint16_t((acc << 1) | (one ? 1 : 0));
+      if(9 != ++nBits) { continue; }
+      // Check each byte's parity as it completes.
+      b[nBytes] = uint8_t(acc >> 1);
+      if((acc & 1) != xor_parity_even_bit(b[nBytes])) { return(NULL); }
+      ++nBytes;
+      acc = 0;
+      nBits = 0;
+      }
+    if(0 != (e & DECB_ERR)) { return(NULL); }
+    state = e & 3;
+    }
+  return(NULL); // Ran off the end.
+  }
+#endif // OTRADVALVE_FHT8V_COMPACT_CODEC
+
 #endif // FHT8VRadValveUtil_DEFINED
 
 
@@ -35,6 +35,15 @@ Author(s) / Copyright (s): Damon Hart-Davis 2013--2016
 #include "OTRadValve_AbstractRadValve.h"
 
 
+// If defined, FHT8VCreate200usBitStreamBptr() and FHT8VDecodeBitStream()
+// use the compact bit-at-a-time FS20 encoder and decoder,
+// else the faster table-driven ones which need ~1.8kB more for tables,
+// held in Flash (PROGMEM) on AVR rather than taking scarce RAM.
+// Compact by default on AVR; define OTRADVALVE_FHT8V_TABLE_CODEC to override.
+#if defined(ARDUINO_ARCH_AVR) && !defined(OTRADVALVE_FHT8V_TABLE_CODEC)
+#define OTRADVALVE_FHT8V_COMPACT_CODEC
+#endif
+
 // Use namespaces to help avoid collisions.
 namespace OTRadValve
     {
@@ -108,13 +117,33 @@ class FHT8VRadValveUtil
     // Note that a buffer space of at least 46 bytes is needed to accommodate the longest-possible encoded message plus terminator.
     // This FHT8V messages is encoded with the FS20 protocol.
     // Returns pointer to the terminating 0xff on exit.
-    static uint8_t *FHT8VCreate200usBitStreamBptr(uint8_t *bptr, const fht8v_msg_t *command);
+    static inline uint8_t *FHT8VCreate200usBitStreamBptr(uint8_t *bptr, const fht8v_msg_t *command)
+#ifdef OTRADVALVE_FHT8V_COMPACT_CODEC
+        { return(FHT8VCreate200usBitStreamBptrCompact(bptr, command)); }
+#else
+        { return(FHT8VCreate200usBitStreamBptrTable(bptr, command)); }
+#endif
 
     // Decode raw bitstream into non-null command structure passed in; returns true if successful.
     // Will return non-null if OK, else NULL if anything obviously invalid is detected such as failing parity or checksum.
     // Finds and discards leading encoded 1 and trailing 0.
     // Returns NULL on failure, else pointer to next full byte after last decoded.
-    static uint8_t const *FHT8VDecodeBitStream(uint8_t const *bitStream, uint8_t const *lastByte, fht8v_msg_t *command);
+    static inline uint8_t const *FHT8VDecodeBitStream(uint8_t const *bitStream, uint8_t const *lastByte, fht8v_msg_t *command)
+#ifdef OTRADVALVE_FHT8V_COMPACT_CODEC
+        { return(FHT8VDecodeBitStreamCompact(bitStream, lastByte, command)); }
+#else
+        { return(FHT8VDecodeBitStreamTable(bitStream, lastByte, command)); }
+#endif
+
+    // Compact implementations of the above, one encoded bit at a time.
+    static uint8_t *FHT8VCreate200usBitStreamBptrCompact(uint8_t *bptr, const fht8v_msg_t *command);
+    static uint8_t const *FHT8VDecodeBitStreamCompact(uint8_t const *bitStream, uint8_t const *lastByte, fht8v_msg_t *command);
+#ifndef OTRADVALVE_FHT8V_COMPACT_CODEC
+    // Table-driven implementations of the above, encoding a nibble and decoding a byte at a time,
+    // with identical output (and identical results when decoding).
+    static uint8_t *FHT8VCreate200usBitStreamBptrTable(uint8_t *bptr, const fht8v_msg_t *command);
+    static uint8_t const *FHT8VDecodeBitStreamTable(uint8_t const *bitStream, uint8_t const *lastByte, fht8v_msg_t *command);
+#endif // OTRADVALVE_FHT8V_COMPACT_CODEC
 
     // Approximate maximum transmission (TX) time for bare FHT8V command frame in ms; strictly positive.
     // This ignores any prefix needed for particular radios such as the RFM23B.
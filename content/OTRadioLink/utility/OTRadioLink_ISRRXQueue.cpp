@@ -30,15 +30,26 @@ namespace OTRadioLink
 // True if the queue is full.
 // True iff _getRXBufForInbound() would return NULL.
 // ISR-/thread- safe on ARDUINO_ARCH_AVR.
-uint8_t ISRRXQueueVarLenMsgBase::isFull() const
+uint8_t ISRRXQueueVarLenMsgBase::isFullNonVirtual() const
     { OTV0P2BASE::RAII_AtomicBlock lock; return(_isFull()); }
 
+// Buffer bytes in use, including any skipped at the end before wrapping.
+// ISR-/thread- safe on ARDUINO_ARCH_AVR.
+uint16_t ISRRXQueueVarLenMsgBase::getRXBytesQueuedNonVirtual() const
+    {
+    OTV0P2BASE::RAII_AtomicBlock lock;
+    const uint8_t n = next, o = oldest; // Cache volatile values.
+    if(n > o) { return(n - o); }
+    if(n == o) { return(isEmpty() ? 0 : (1U + bsm1)); }
+    return((1U + bsm1 - o) + n);
+    }
+
 #ifdef ARDUINO_ARCH_AVR
 // Remove the first (oldest) queued RX message.
 // Typically used after peekRXMessage().
 // Does nothing if the queue is empty.
 // Not intended to be called from an ISR.
-void ISRRXQueueVarLenMsgBase::removeRXMsg()
+void ISRRXQueueVarLenMsgBase::removeRXMsgNonVirtual()
     {
     // Nothing to do if empty.
     if(isEmpty()) { return; }
@@ -59,7 +70,7 @@ void ISRRXQueueVarLenMsgBase::removeRXMsg()
 // Does nothing if the queue is empty.
 // Not intended to be called from an ISR.
 // Not threadsafe in this implementation
-void ISRRXQueueVarLenMsgBase::removeRXMsg()
+void ISRRXQueueVarLenMsgBase::removeRXMsgNonVirtual()
 {
     // Nothing to do if empty.
     if(isEmpty()) { return; }
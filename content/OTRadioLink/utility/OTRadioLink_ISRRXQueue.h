@@ -126,18 +126,52 @@ namespace OTRadioLink
 #endif
         };
 
+    // Static-dispatch (CRTP) form of the ISRRXQueue interface.
+    // The concrete queue derived_t derives from ISRRXQueueCRTP<derived_t>
+    // (or ISRRXQueueCRTP<derived_t, base_t> where base_t derives from ISRRXQueue)
+    // and provides public non-virtual versions of the queue operations:
+    //     isFullNonVirtual(), _getRXBufForInboundNonVirtual(), _loadedBufNonVirtual(),
+    //     peekRXMsgNonVirtual(), removeRXMsgNonVirtual()
+    // from which this builds the (final) virtual interface,
+    // and also getRXBytesQueuedNonVirtual(), the buffer bytes in use
+    // (including any made unusable by wrapping), eg for instrumentation.
+    // Code that knows the concrete queue type, eg the ISR of a radio driver
+    // with the queue as a member, calls the NonVirtual forms directly
+    // so that the whole RX path can be inlined,
+    // while code holding an ISRRXQueue & works as before.
+    template<class derived_t, class base_t = ISRRXQueue>
+    class ISRRXQueueCRTP : public base_t
+        {
+        private:
+            inline const derived_t &d() const { return(static_cast<const derived_t &>(*this)); }
+            inline derived_t &d() { return(static_cast<derived_t &>(*this)); }
+
+        protected:
+            // Pass any arguments on to base_t.
+            template<typename... Args>
+            constexpr ISRRXQueueCRTP(Args... args) : base_t(args...) { }
+
+        public:
+            virtual uint8_t isFull() const override final { return(d().isFullNonVirtual()); }
+            virtual volatile uint8_t *_getRXBufForInbound() const override final { return(d()._getRXBufForInboundNonVirtual()); }
+            virtual void _loadedBuf(const uint8_t frameLen) override final { d()._loadedBufNonVirtual(frameLen); }
+            virtual const volatile uint8_t *peekRXMsg() const override final { return(d().peekRXMsgNonVirtual()); }
+            virtual void removeRXMsg() override final { d().removeRXMsgNonVirtual(); }
+        };
+
     // Dummy/null always-empty queue that can never hold a frame.
     // Use as a space-saving stub/placeholder
-    class ISRRXQueueNULL final : public ISRRXQueue
+    class ISRRXQueueNULL final : public ISRRXQueueCRTP<ISRRXQueueNULL>
         {
         public:
             virtual void getRXCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen) const override
                 { queueRXMsgsMin = 0; maxRXMsgLen = 0; }
-            virtual uint8_t isFull() const override { return(true); }
-            virtual volatile uint8_t *_getRXBufForInbound() const override { return(NULL); }
-            virtual void _loadedBuf(uint8_t /*frameLen*/) override { }
-            virtual const volatile uint8_t *peekRXMsg() const override { return(NULL); }
-            virtual void removeRXMsg() override { }
+            inline uint8_t isFullNonVirtual() const { return(true); }
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const { return(NULL); }
+            inline void _loadedBufNonVirtual(uint8_t /*frameLen*/) { }
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const { return(NULL); }
+            inline void removeRXMsgNonVirtual() { }
+            inline uint16_t getRXBytesQueuedNonVirtual() const { return(0); }
         };
 
     // Minimal, fast, 1-deep queue.
@@ -145,13 +179,13 @@ namespace OTRadioLink
     //   * maxRXBytes  a frame to be queued can be up to maxRXBytes bytes long; in the range [0,255]
     // Does minimal checking; all arguments must be sane.
     template<uint8_t maxRXBytes>
-    class ISRRXQueue1Deep final : public ISRRXQueue
+    class ISRRXQueue1Deep final : public ISRRXQueueCRTP<ISRRXQueue1Deep<maxRXBytes> >
         {
         private:
             // 1-deep RX queue and buffer used to accept data during RX.
             // Frame is preceded in memory by its length.
             // Marked as volatile for ISR-/thread- safe (sometimes lock-free) access.
-            volatile uint8_t fullBuf[1 + maxRXBytes];
+            mutable volatile uint8_t fullBuf[1 + maxRXBytes];
 //            volatile uint8_t *const bufferRX = fullBuf + 1; // Alias for frame itself.
 
         public:
@@ -162,7 +196,7 @@ namespace OTRadioLink
             // True if the queue is full.
             // True iff _getRXBufForInbound() would return NULL.
             // ISR-/thread- safe.
-            virtual uint8_t isFull() const override { return(0 != queuedRXedMessageCount); }
+            inline uint8_t isFullNonVirtual() const { return(0 != this->queuedRXedMessageCount); }
 
             // Get pointer for inbound/RX frame able to accommodate max frame size; NULL if no space.
             // Call this to get a pointer to load an inbound frame (<=maxRXBytes bytes) into;
@@ -172,10 +206,10 @@ namespace OTRadioLink
             // typically there can be no other activity on the queue until _loadedBuf()
             // or use of the pointer is abandoned.
             // _loadedBuf() should not be called if this returns NULL.
-            virtual volatile uint8_t *_getRXBufForInbound() const override
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const
                 {
                 // If something already queued, so no space for a new message, return NULL.
-                if(0 != queuedRXedMessageCount) { return(NULL); }
+                if(0 != this->queuedRXedMessageCount) { return(NULL); }
                 return(fullBuf + 1);
                 }
 
@@ -184,13 +218,13 @@ namespace OTRadioLink
             // The frame can be no larger than maxRXBytes bytes.
             // It is possible to formally abandon an upload attempt by calling this with 0.
             // Must still be in the scope of the same (ISR) call as _getRXBufForInbound().
-            virtual void _loadedBuf(uint8_t frameLen) override
+            inline void _loadedBufNonVirtual(uint8_t frameLen)
                 {
                 if(0 == frameLen) { return; } // New frame not being uploaded.
-                if(0 != queuedRXedMessageCount) { return; } // Prevent messing with existing queued message.
+                if(0 != this->queuedRXedMessageCount) { return; } // Prevent messing with existing queued message.
                 if(frameLen > maxRXBytes) { frameLen = maxRXBytes; } // Be safe...
                 fullBuf[0] = frameLen;
-                queuedRXedMessageCount = 1; // Mark message as queued.
+                this->queuedRXedMessageCount = 1; // Mark message as queued.
                 }
 
             // Peek at first (oldest) queued RX message, returning a pointer or NULL if no message waiting.
@@ -204,10 +238,10 @@ namespace OTRadioLink
             // This does not remove the message or alter the queue.
             // The buffer pointed to MUST NOT be altered.
             // Not intended to be called from an ISR.
-            virtual const volatile uint8_t *peekRXMsg() const override
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const
                 {
                 // Return NULL if no message waiting.
-                if(0 == queuedRXedMessageCount) { return(NULL); }
+                if(0 == this->queuedRXedMessageCount) { return(NULL); }
                 return(fullBuf + 1);
                 }
 
@@ -215,11 +249,15 @@ namespace OTRadioLink
             // Typically used after peekRXMessage().
             // Does nothing if the queue is empty.
             // Not intended to be called from an ISR.
-            virtual void removeRXMsg() override
+            inline void removeRXMsgNonVirtual()
                 {
                 // Clear any extant message in the queue.
-                queuedRXedMessageCount = 0;
+                this->queuedRXedMessageCount = 0;
                 }
+
+            // Buffer bytes in use, ie the frame and its length if queued.
+            inline uint16_t getRXBytesQueuedNonVirtual() const
+                { return((0 == this->queuedRXedMessageCount) ? 0 : (1U + fullBuf[0])); }
         };
 
     // N-deep queue that can efficiently store variable-length messages.
@@ -279,7 +317,7 @@ namespace OTRadioLink
             // True if the queue is full.
             // True iff _getRXBufForInbound() would return NULL.
             // ISR-/thread- safe.
-            virtual uint8_t isFull() const override;
+            uint8_t isFullNonVirtual() const;
 
             // Get pointer for inbound/RX frame able to accommodate max frame size; NULL if no space.
             // Call this to get a pointer to load an inbound frame (<=maxRXBytes bytes) into;
@@ -289,7 +327,7 @@ namespace OTRadioLink
             // typically there can be no other activity on the queue until _loadedBuf()
             // or use of the pointer is abandoned.
             // _loadedBuf() should not be called if this returns NULL.
-            virtual volatile uint8_t *_getRXBufForInbound() const override
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const
                 {
                 // This ISR is kept as short/fast as possible.
                 if(_isFull()) { return(NULL); }
@@ -302,7 +340,7 @@ namespace OTRadioLink
             // The frame can be no larger than maxRXBytes bytes.
             // It is possible to formally abandon an upload attempt by calling this with 0.
             // Must still be in the scope of the same (ISR) call as _getRXBufForInbound().
-            virtual void _loadedBuf(uint8_t frameLen) override
+            inline void _loadedBufNonVirtual(uint8_t frameLen)
                 {
                 // This ISR is kept as short/fast as possible.
                 if(0 == frameLen) { return; } // New frame not being uploaded.
@@ -325,7 +363,7 @@ namespace OTRadioLink
             // This does not remove the message or alter the queue.
             // The buffer pointed to MUST NOT be altered.
             // Not intended to be called from an ISR.
-            virtual const volatile uint8_t *peekRXMsg() const override
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const
                 {
                 if(isEmpty()) { return(NULL); }
                 // Cannot now become empty nor can the 'oldest' index change even if an ISR is invoked,
@@ -337,7 +375,11 @@ namespace OTRadioLink
             // Typically used after peekRXMessage().
             // Does nothing if the queue is empty.
             // Not intended to be called from an ISR.
-            virtual void removeRXMsg() override;
+            void removeRXMsgNonVirtual();
+
+            // Buffer bytes in use, including any skipped at the end before wrapping.
+            // ISR-/thread- safe.
+            uint16_t getRXBytesQueuedNonVirtual() const;
 #undef ISRRXQueueVarLenMsg_VALIDATE
 #ifdef ISRRXQueueVarLenMsg_VALIDATE
             // Validate state, dumping diagnostics to Print stream and returning false if problems found.
@@ -348,7 +390,7 @@ namespace OTRadioLink
     //   * maxRXBytes  a frame to be queued can be up to maxRXBytes bytes long; in the range [1,255]
     //   * targetISRRXMinQueueCapacity  target number of max-sized frames queueable [1,255], usually [2,4]
     template<uint8_t maxRXBytes, uint8_t targetISRRXMinQueueCapacity = 2>
-    class ISRRXQueueVarLenMsg final : public ISRRXQueueVarLenMsgBase
+    class ISRRXQueueVarLenMsg final : public ISRRXQueueCRTP<ISRRXQueueVarLenMsg<maxRXBytes, targetISRRXMinQueueCapacity>, ISRRXQueueVarLenMsgBase>
         {
         private:
             /*Actual buffer size (bytes). */
@@ -359,7 +401,8 @@ namespace OTRadioLink
              */
             volatile uint8_t buf[ISRRX_BUFSIZ];
         public:
-            constexpr ISRRXQueueVarLenMsg() : ISRRXQueueVarLenMsgBase(maxRXBytes, buf, (uint8_t)(ISRRX_BUFSIZ-1)) { }
+            constexpr ISRRXQueueVarLenMsg()
+              : ISRRXQueueCRTP<ISRRXQueueVarLenMsg, ISRRXQueueVarLenMsgBase>(maxRXBytes, buf, (uint8_t)(ISRRX_BUFSIZ-1)) { }
             /*Guaranteed minimum number of (full-length) messages that can be queued. */
             static constexpr uint8_t MinQueueCapacityMsgs = ISRRX_BUFSIZ / (maxRXBytes + 1);
             // Fetches the current inbound RX minimum queue capacity and maximum RX raw message size.
@@ -0,0 +1,261 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Optional instrumentation for any ISRRXQueue implementation:
+ * depth high-water marks, dropped frames, and queue residency time.
+ *
+ * Keywords: C++ radio RX receive queue instrumentation stats latency histogram
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUEINSTRUMENTED_H
+#define ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUEINSTRUMENTED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <OTV0p2Base.h>
+#include "OTV0P2BASE_Concurrency.h"
+#include "OTRadioLink_ISRRXQueue.h"
+#include "OTRadioLink_ISRRXQueueLarge.h"
+
+
+namespace OTRadioLink
+    {
+    // Wraps an RX queue of type queue_t (any ISRRXQueueCRTP-based queue)
+    // and records, with no change to the queue's behaviour:
+    //   * the high-water marks of frames queued and of buffer bytes in use;
+    //   * frames dropped, ie not queued when no buffer was available
+    //     or when the queue rejected them at load, or evicted after queueing;
+    //   * a histogram of the time from _loadedBuf() to removeRXMsg() for each frame,
+    //     in ticks from getTicks(), eg OTV0P2BASE::getSubCycleTime().
+    //
+    // Residency is an 8-bit tick difference, so aliases beyond 255 ticks
+    // (one basic cycle for getSubCycleTime()).
+    // The histogram is summarised for stats reporting as the 50th and 90th
+    // percentiles, each as the top of the bucket it falls in.
+    // Load times are kept for the oldest tsDepth frames only;
+    // later frames are counted but not timed until the backlog clears.
+    //
+    // Costs some RAM and time on every queue operation,
+    // so is best selected with ISRRXQueueMaybeInstrumented
+    // to cost nothing at all when not wanted.
+    //
+    // ISR-safe on ARDUINO_ARCH_AVR as the underlying queue,
+    // with the ISR loading frames and the main thread removing them.
+    // NOT safe with a concurrent producer and consumer
+    // on different threads (eg for ISRRXQueueSPSC).
+    template<class queue_t, uint8_t (*getTicks)(), uint8_t tsDepth = 8>
+    class ISRRXQueueInstrumented final : public ISRRXQueueCRTP<ISRRXQueueInstrumented<queue_t, getTicks, tsDepth>>
+        {
+        static_assert(tsDepth > 0, "must time at least one frame");
+        public:
+            // Number of residency histogram buckets:
+            // 0 ticks, 1, 2--3, 4--7, ... 128--255.
+            static constexpr uint8_t ResidencyBuckets = 9;
+
+        private:
+            // The instrumented queue.
+            queue_t q;
+
+            // High-water marks of frames queued and of buffer bytes in use.
+            uint8_t maxQueued;
+            uint16_t maxBytes;
+            // Frames dropped; saturates.
+            // Mutable as _getRXBufForInbound() is const.
+            mutable uint16_t dropped;
+            // Longest residency seen, in ticks.
+            uint8_t maxResidency;
+            // Residency histogram; each bucket saturates.
+            uint16_t hist[ResidencyBuckets];
+
+            // Load times of the oldest queued frames, as a FIFO of tracked entries
+            // starting at tsHead; the untracked frames queued after those follow.
+            uint8_t ts[tsDepth];
+            uint8_t tsHead, tracked, untracked;
+
+            // Count of queued frames evicted by the queue itself so far.
+            uint16_t evictedSoFar;
+
+            static inline void inc(uint16_t &c) { if(c != 0xffff) { ++c; } }
+
+            // Forget the load time (if any) of the oldest queued frame.
+            // Returns true and sets t if it was tracked.
+            bool popOldest(uint8_t &t)
+                {
+                if(0 != tracked)
+                    {
+                    t = ts[tsHead];
+                    if(++tsHead >= tsDepth) { tsHead = 0; }
+                    --tracked;
+                    return(true);
+                    }
+                if(0 != untracked) { --untracked; }
+                return(false);
+                }
+
+            // Record a residency sample of r ticks.
+            void recordResidency(const uint8_t r)
+                {
+                if(r > maxResidency) { maxResidency = r; }
+                uint8_t b = 0;
+                for(uint8_t v = r; 0 != v; v >>= 1) { ++b; }
+                inc(hist[b]);
+                }
+
+        public:
+            ISRRXQueueInstrumented()
+              : maxQueued(0), maxBytes(0), dropped(0), maxResidency(0),
+                hist(), ts(), tsHead(0), tracked(0), untracked(0), evictedSoFar(0),
+                maxQueuedSubSensor(maxQueued, V0p2_SENSOR_TAG_F("RXqM")),
+                maxBytesSubSensor(maxBytes, V0p2_SENSOR_TAG_F("RXqB")),
+                droppedSubSensor(dropped, V0p2_SENSOR_TAG_F("RXqD")),
+                maxResidencySubSensor(maxResidency, V0p2_SENSOR_TAG_F("RXqL")),
+                residencyP50SubSensor(*this, 50, V0p2_SENSOR_TAG_F("RXq50")),
+                residencyP90SubSensor(*this, 90, V0p2_SENSOR_TAG_F("RXq90"))
+                { }
+
+            // Fetches the current inbound RX minimum queue capacity and maximum RX raw message size.
+            virtual void getRXCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen) const override
+                { q.getRXCapacity(queueRXMsgsMin, maxRXMsgLen); }
+
+            // Queue operations, forwarded to the wrapped queue.
+            inline bool isFullNonVirtual() const { return(q.isFullNonVirtual()); }
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const
+                {
+                volatile uint8_t *const b = q._getRXBufForInboundNonVirtual();
+                if(NULL == b) { inc(dropped); }
+                return(b);
+                }
+            void _loadedBufNonVirtual(const uint8_t frameLen)
+                {
+                const uint8_t before = q.getRXMsgsQueued();
+                q._loadedBufNonVirtual(frameLen);
+                const uint8_t after = q.getRXMsgsQueued();
+                const uint16_t evictedNow = getRXQueueDroppedOldestCount(q);
+                const uint8_t evicted = uint8_t(evictedNow - evictedSoFar);
+                evictedSoFar = evictedNow;
+                // Evicted frames are always the oldest.
+                uint8_t t;
+                for(uint8_t i = evicted; i-- > 0; ) { popOldest(t); inc(dropped); }
+                const bool added = (uint8_t(after + evicted) != before);
+                if(added)
+                    {
+                    if((0 == untracked) && (tracked < tsDepth))
+                        {
+                        uint8_t i = tsHead + tracked;
+                        if(i >= tsDepth) { i -= tsDepth; }
+                        ts[i] = getTicks();
+                        ++tracked;
+                        }
+                    else { ++untracked; }
+                    }
+                else if(0 != frameLen) { inc(dropped); }
+                if(after > maxQueued) { maxQueued = after; }
+                const uint16_t bytes = q.getRXBytesQueuedNonVirtual();
+                if(bytes > maxBytes) { maxBytes = bytes; }
+                this->queuedRXedMessageCount = after;
+                }
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const { return(q.peekRXMsgNonVirtual()); }
+            void removeRXMsgNonVirtual()
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                if(q.isEmpty()) { return; }
+                q.removeRXMsgNonVirtual();
+                uint8_t t;
+                if(popOldest(t)) { recordResidency(uint8_t(getTicks() - t)); }
+                this->queuedRXedMessageCount = q.getRXMsgsQueued();
+                }
+            inline uint16_t getRXBytesQueuedNonVirtual() const { return(q.getRXBytesQueuedNonVirtual()); }
+
+            // Access to the wrapped queue, eg for its own stats.
+            const queue_t &getQueue() const { return(q); }
+
+            // Stats; ISR-/thread- safe.
+            uint8_t getMaxQueued() const { return(maxQueued); }
+            uint16_t getMaxBytesQueued() const { OTV0P2BASE::RAII_AtomicBlock lock; return(maxBytes); }
+            uint16_t getDroppedCount() const { OTV0P2BASE::RAII_AtomicBlock lock; return(dropped); }
+            uint8_t getMaxResidency() const { return(maxResidency); }
+            // Count of frames with residency in histogram bucket i; 0 if i is out of range.
+            uint16_t getResidencyCount(const uint8_t i) const
+                { if(i >= ResidencyBuckets) { return(0); } OTV0P2BASE::RAII_AtomicBlock lock; return(hist[i]); }
+            // Residency in ticks at or below which at least pc percent of
+            // the frames timed fell, as the top of that histogram bucket,
+            // eg 3 for the 2--3 bucket; 0 if none have been timed.
+            uint8_t getResidencyPercentile(const uint8_t pc) const
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                uint32_t total = 0;
+                for(uint8_t i = 0; i < ResidencyBuckets; ++i) { total += hist[i]; }
+                // Rank from 1 of the sample at the percentile, rounded up.
+                const uint32_t rank = (total * pc + 99) / 100;
+                uint32_t seen = 0;
+                for(uint8_t i = 0; i < ResidencyBuckets; ++i)
+                    {
+                    seen += hist[i];
+                    if((0 != seen) && (seen >= rank)) { return(uint8_t((1U << i) - 1)); }
+                    }
+                return(0);
+                }
+
+            // Clear the stats, with the high-water marks reset to the current occupancy.
+            // Frames queued are still timed.
+            void resetStats()
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                maxQueued = q.getRXMsgsQueued();
+                maxBytes = q.getRXBytesQueuedNonVirtual();
+                dropped = 0;
+                maxResidency = 0;
+                for(uint8_t i = 0; i < ResidencyBuckets; ++i) { hist[i] = 0; }
+                }
+
+            // Facades/sub-sensors for stats reporting, at low priority.
+            // Not ISR-safe for multi-byte values on ARDUINO_ARCH_AVR.
+            const OTV0P2BASE::SubSensorSimpleRef<uint8_t> maxQueuedSubSensor;
+            const OTV0P2BASE::SubSensorSimpleRef<uint16_t> maxBytesSubSensor;
+            const OTV0P2BASE::SubSensorSimpleRef<uint16_t> droppedSubSensor;
+            const OTV0P2BASE::SubSensorSimpleRef<uint8_t> maxResidencySubSensor;
+
+            // Facade for one residency percentile, computed when read.
+            class ResidencyPercentileSubSensor final : public OTV0P2BASE::SubSensor<uint8_t>
+                {
+                private:
+                    const ISRRXQueueInstrumented &p;
+                    const uint8_t pc;
+                    const OTV0P2BASE::Sensor_tag_t t;
+                public:
+                    constexpr ResidencyPercentileSubSensor(const ISRRXQueueInstrumented &parent, const uint8_t percentile,
+                                                           const OTV0P2BASE::Sensor_tag_t tag)
+                      : p(parent), pc(percentile), t(tag) { }
+                    virtual uint8_t get() const override { return(p.getResidencyPercentile(pc)); }
+                    virtual OTV0P2BASE::Sensor_tag_t tag() const override { return(t); }
+                };
+            const ResidencyPercentileSubSensor residencyP50SubSensor;
+            const ResidencyPercentileSubSensor residencyP90SubSensor;
+        };
+
+    // Selects queue_t, or queue_t wrapped with ISRRXQueueInstrumented if instrument is true,
+    // so that instrumentation can be a template flag at no cost when off.
+    template<bool instrument, class queue_t, uint8_t (*getTicks)()>
+    struct ISRRXQueueMaybeInstrumented { typedef queue_t t; };
+    template<class queue_t, uint8_t (*getTicks)()>
+    struct ISRRXQueueMaybeInstrumented<true, queue_t, getTicks> { typedef ISRRXQueueInstrumented<queue_t, getTicks> t; };
+    }
+
+#endif
@@ -0,0 +1,271 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Large-capacity RX queue with 16-bit indexing
+ * and a selectable policy for what to lose when full,
+ * for always-listening receivers (eg hubs) with RAM to spare.
+ *
+ * Keywords: C++ radio RX receive queue ring buffer low-copy overflow policy
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUELARGE_H
+#define ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUELARGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "OTV0P2BASE_Concurrency.h"
+#include "OTRadioLink_ISRRXQueue.h"
+
+
+namespace OTRadioLink
+    {
+    // What ISRRXQueueVarLenMsgLarge loses when a frame arrives and it is full.
+    enum ISRRXQueueOverflow : uint8_t
+        {
+        RXQOverflow_DropNewest = 0, // Drop the incoming frame, as ISRRXQueueVarLenMsg does.
+        RXQOverflow_DropOldest,     // Drop the oldest queued frame(s) to make room.
+        RXQOverflow_PreferSecure,   // Drop the oldest queued non-secure frame(s) to make room for a secure one.
+        };
+
+    // N-deep queue that can efficiently store variable-length messages,
+    // as ISRRXQueueVarLenMsg but with 16-bit offsets so that the buffer
+    // can be up to 64kB, eg to ride out bursts on a busy channel.
+    // Frames are kept as (len,data+) segments in a circular buffer,
+    // so a frame can be loaded and decoded in place.
+    //
+    // With RXQOverflow_DropNewest _getRXBufForInbound() returns NULL when full.
+    // With the other policies it then returns a separate staging buffer instead,
+    // and _loadedBuf() decides what to drop once the frame is there to look at,
+    // copying the new frame into the queue if it is kept.
+    // A frame is taken to be secure if its second byte
+    // (the frame type, after the length, as for SecurableFrameHeader)
+    // has the top bit set;
+    // RXQOverflow_PreferSecure never drops a secure frame for a non-secure one
+    // (nor one secure frame for another),
+    // and only drops from the oldest end of the queue.
+    // The oldest frame is never dropped while the consumer may be using it,
+    // ie between peekRXMsg() and removeRXMsg();
+    // the incoming frame is dropped instead.
+    //
+    // Frames lost are counted separately for incoming (newest) and queued (oldest) frames.
+    //
+    // At most 255 frames are queued at once so that getRXMsgsQueued() is exact.
+    //
+    // Queue operations lock out interrupts briefly where the ISR may change
+    // the same state, so this is safe with an RX ISR on an MCU,
+    // but not (like ISRRXQueueVarLenMsg) for concurrent use from hosted threads.
+    //
+    //   * maxRXBytes  a frame to be queued can be up to maxRXBytes bytes long; in the range [1,255]
+    //   * bufSize  buffer size in bytes, in [2 * (maxRXBytes + 1), 65535]
+    //   * policy  what to lose when full
+    template<uint8_t maxRXBytes, uint16_t bufSize = 1024, ISRRXQueueOverflow policy = RXQOverflow_DropNewest>
+    class ISRRXQueueVarLenMsgLarge final : public ISRRXQueueCRTP<ISRRXQueueVarLenMsgLarge<maxRXBytes, bufSize, policy> >
+        {
+        static_assert(maxRXBytes >= 1, "maxRXBytes must be at least 1");
+        static_assert(bufSize >= 2U * (1U + maxRXBytes), "bufSize too small for two maximum-size frames");
+
+        private:
+            static constexpr bool staging = (RXQOverflow_DropNewest != policy);
+            // Last usable index beyond which there is not enough space for len+maxSizeFrame.
+            static constexpr uint16_t lui = bufSize - 1U - maxRXBytes;
+
+            // Offsets to the start of the oldest and next entries in buf.
+            // When oldest == next then either empty or full, depending on the count.
+            volatile uint16_t oldest, next;
+            // True while the consumer may be using the oldest frame,
+            // from peekRXMsg() to removeRXMsg().
+            mutable volatile bool pinned;
+            // True while the ISR is loading into stagingBuf rather than buf.
+            mutable volatile bool staged;
+            // Counts of incoming frames dropped, and of queued frames dropped to make room.
+            mutable volatile uint16_t droppedNewest, droppedOldest;
+            // Circular sequence of (len,data+) segments.
+            // Wrapping around the end is done by hitting lui.
+            // Mutable as _getRXBufForInbound() is const but hands out space to load.
+            mutable volatile uint8_t buf[bufSize];
+            // Where a frame is loaded when the queue is full, if not dropping newest.
+            mutable volatile uint8_t stagingBuf[staging ? (1 + maxRXBytes) : 1];
+
+            // Index following a frame of frameLen at prevIndex, wrapping if too close to the end.
+            static inline uint16_t newIndex(const uint16_t prevIndex, const uint8_t frameLen)
+                {
+                const uint16_t n = uint16_t(1U + prevIndex + frameLen);
+                return((n > lui) ? 0 : n);
+                }
+            // True if a maximum-size frame cannot be added at n with the oldest frame at o and c queued.
+            static inline bool _isFull(const uint16_t n, const uint16_t o, const uint8_t c)
+                {
+                if(c >= 255) { return(true); }
+                if(n > o) { return(false); }
+                if(n == o) { return(0 != c); }
+                // Else 'next' is before 'oldest' so check for enough space between them (including len).
+                return((o - n) <= maxRXBytes);
+                }
+            // True if the frame at index i is secure.
+            inline bool isSecureAt(const uint16_t i) const
+                { return((buf[i] >= 2) && (0 != (0x80 & buf[i + 2]))); }
+
+            // Queue a frame of frameLen already loaded at 'next'.
+            inline void _commit(const uint8_t frameLen)
+                {
+                const uint16_t n = next; // Cache volatile value.
+                buf[n] = frameLen;
+                next = newIndex(n, frameLen);
+                ++this->queuedRXedMessageCount;
+                }
+
+            // Decide the fate of the frameLen frame in stagingBuf.
+            // Interrupts are assumed locked out, eg as in an ISR.
+            void _admitStaged(const uint8_t frameLen)
+                {
+                const bool incomingSecure = (frameLen >= 2) && (0 != (0x80 & stagingBuf[2]));
+                if((RXQOverflow_PreferSecure == policy) && !incomingSecure) { ++droppedNewest; return; }
+                // Find how many of the oldest frames must go, before dropping any.
+                const uint16_t n = next;
+                uint16_t o = oldest;
+                uint8_t c = this->queuedRXedMessageCount;
+                uint8_t toDrop = 0;
+                while(_isFull(n, o, c))
+                    {
+                    if((0 == c) || ((0 == toDrop) && pinned) ||
+                       ((RXQOverflow_PreferSecure == policy) && isSecureAt(o)))
+                        { ++droppedNewest; return; }
+                    o = newIndex(o, buf[o]);
+                    --c;
+                    ++toDrop;
+                    }
+                oldest = o;
+                this->queuedRXedMessageCount = c;
+                droppedOldest += toDrop;
+                for(uint8_t i = 0; i < frameLen; ++i) { buf[n + 1 + i] = stagingBuf[1 + i]; }
+                _commit(frameLen);
+                }
+
+        public:
+            ISRRXQueueVarLenMsgLarge()
+              : oldest(0), next(0), pinned(false), staged(false), droppedNewest(0), droppedOldest(0) { }
+
+            // Guaranteed minimum number of (full-length) messages that can be queued.
+            static constexpr uint8_t MinQueueCapacityMsgs =
+                ((bufSize / (maxRXBytes + 1U)) > 255U) ? 255 : uint8_t(bufSize / (maxRXBytes + 1U));
+
+            // Fetches the current inbound RX minimum queue capacity and maximum RX raw message size.
+            virtual void getRXCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen) const override
+                { queueRXMsgsMin = MinQueueCapacityMsgs; maxRXMsgLen = maxRXBytes; }
+
+            // Count of incoming frames dropped because the queue was full; wraps.
+            uint16_t getDroppedNewestCount() const { OTV0P2BASE::RAII_AtomicBlock lock; return(droppedNewest); }
+            // Count of queued frames dropped to make room for incoming ones; wraps.
+            uint16_t getDroppedOldestCount() const { OTV0P2BASE::RAII_AtomicBlock lock; return(droppedOldest); }
+            // Reset both drop counts.
+            void resetDropCounts() { OTV0P2BASE::RAII_AtomicBlock lock; droppedNewest = 0; droppedOldest = 0; }
+
+            // True if the queue is full (though a frame may yet be accepted by dropping others).
+            // ISR-/thread- safe.
+            inline uint8_t isFullNonVirtual() const
+                { OTV0P2BASE::RAII_AtomicBlock lock; return(_isFull(next, oldest, this->queuedRXedMessageCount)); }
+
+            // Get pointer for inbound/RX frame able to accommodate max frame size; NULL if no space.
+            // Call this to get a pointer to load an inbound frame (<=maxRXBytes bytes) into;
+            // after uploading the frame call _loadedBuf() to queue the new frame
+            // or abandon an upload on this occasion.
+            // Must only be called from within an ISR and/or with interfering threads excluded;
+            // typically there can be no other activity on the queue until _loadedBuf()
+            // or use of the pointer is abandoned.
+            // _loadedBuf() should not be called if this returns NULL.
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const
+                {
+                if(!_isFull(next, oldest, this->queuedRXedMessageCount)) { return(buf + next + 1); }
+                if(!staging) { ++droppedNewest; return(NULL); }
+                staged = true;
+                return(stagingBuf + 1);
+                }
+
+            // Call after loading an RXed frame into the buffer indicated by _getRXBufForInbound().
+            // The argument is the size of the frame loaded into the buffer to be queued.
+            // The frame can be no larger than maxRXBytes bytes.
+            // It is possible to formally abandon an upload attempt by calling this with 0.
+            // Must still be in the scope of the same (ISR) call as _getRXBufForInbound().
+            inline void _loadedBufNonVirtual(uint8_t frameLen)
+                {
+                if(frameLen > maxRXBytes) { frameLen = maxRXBytes; } // Be safe...
+                if(staging && staged)
+                    {
+                    staged = false;
+                    if(0 != frameLen) { _admitStaged(frameLen); }
+                    return;
+                    }
+                if(0 == frameLen) { return; } // New frame not being uploaded.
+                _commit(frameLen);
+                }
+
+            // Peek at first (oldest) queued RX message, returning a pointer or NULL if no message waiting.
+            // The pointer returned is NULL if there is no message,
+            // else the pointer is to the start of the message/frame
+            // and the length is in the byte before the start of the frame.
+            // The returned pointer and length are valid until the next
+            //     peekRXMessage() or removeRXMessage()
+            // This does not remove the message or alter the queue.
+            // The buffer pointed to MUST NOT be altered.
+            // Not intended to be called from an ISR.
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                if(this->isEmpty()) { return(NULL); }
+                pinned = true;
+                return(buf + oldest + 1);
+                }
+
+            // Remove the first (oldest) queued RX message.
+            // Typically used after peekRXMessage().
+            // Does nothing if the queue is empty.
+            // Not intended to be called from an ISR.
+            inline void removeRXMsgNonVirtual()
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                pinned = false;
+                if(this->isEmpty()) { return; }
+                const uint16_t o = oldest; // Cache volatile value.
+                oldest = newIndex(o, buf[o]);
+                --this->queuedRXedMessageCount;
+                }
+
+            // Buffer bytes in use, including any skipped at the end before wrapping.
+            // ISR-/thread- safe.
+            inline uint16_t getRXBytesQueuedNonVirtual() const
+                {
+                OTV0P2BASE::RAII_AtomicBlock lock;
+                const uint16_t n = next, o = oldest; // Cache volatile values.
+                if(n > o) { return(n - o); }
+                if(n == o) { return(this->isEmpty() ? 0 : bufSize); }
+                return((bufSize - o) + n);
+                }
+        };
+
+    // Count of queued frames dropped by q to make room for new ones, for instrumentation;
+    // always 0 for queues (all but ISRRXQueueVarLenMsgLarge) that never do so.
+    template<class queue_t>
+    inline uint16_t getRXQueueDroppedOldestCount(const queue_t &) { return(0); }
+    template<uint8_t maxRXBytes, uint16_t bufSize, ISRRXQueueOverflow policy>
+    inline uint16_t getRXQueueDroppedOldestCount(const ISRRXQueueVarLenMsgLarge<maxRXBytes, bufSize, policy> &q)
+        { return(q.getDroppedOldestCount()); }
+    }
+
+#endif
@@ -0,0 +1,214 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Lock-free single-producer single-consumer RX queue
+ * for hosted (eg Linux hub) multi-threaded receivers.
+ *
+ * Hosted only; not for V0p2/AVR, which should use ISRRXQueueVarLenMsg.
+ *
+ * Keywords: C++ lock-free SPSC radio RX receive queue ring buffer low-copy atomic
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUESPSC_H
+#define ARDUINO_LIB_OTRADIOLINK_ISRRXQUEUESPSC_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "OTV0P2BASE_Concurrency.h"
+#include "OTRadioLink_ISRRXQueue.h"
+
+
+namespace OTRadioLink
+    {
+    // Variable-length message queue with the same zero-copy contract as
+    // ISRRXQueueVarLenMsg, but safe without any lock when the producer
+    // (eg a radio reader thread) and the consumer (eg the frame decoder)
+    // run concurrently in different threads.
+    //
+    // Exactly one thread at a time may call _getRXBufForInbound()/_loadedBuf()
+    // (the producer) and exactly one peekRXMsg()/removeRXMsg() (the consumer);
+    // neither side ever blocks.
+    // isFull(), getRXMsgsQueued() and isEmpty() may be called from any thread,
+    // though the answer may be stale by the time it is used.
+    //
+    // Each (length, frame) record is contiguous in a power-of-two ring,
+    // so that it can be loaded and decoded in place;
+    // a record that would not have room for a maximum-size frame
+    // before the end of the ring starts at the beginning instead.
+    // The write and read positions are free-running byte counts,
+    // each stored only by its own side with release semantics
+    // and loaded by the other side with acquire semantics,
+    // so a frame is fully visible before it is queued
+    // and its space is not reused until it has been removed.
+    //
+    // At most 255 frames are queued at once so that getRXMsgsQueued() is exact.
+    //
+    //   * maxRXBytes  a frame to be queued can be up to maxRXBytes bytes long; in the range [1,255]
+    //   * bufSize  ring size in bytes, a power of two in [2 * (maxRXBytes + 1), 32768]
+    template<uint8_t maxRXBytes, uint16_t bufSize = 1024>
+    class ISRRXQueueSPSC final : public ISRRXQueueCRTP<ISRRXQueueSPSC<maxRXBytes, bufSize> >
+        {
+        static_assert(maxRXBytes >= 1, "maxRXBytes must be at least 1");
+        static_assert((bufSize <= 32768U) && (0 == (bufSize & (bufSize - 1U))), "bufSize must be a power of two up to 32768");
+        static_assert(bufSize >= 2U * (1U + maxRXBytes), "bufSize too small for two maximum-size frames");
+
+        private:
+            static constexpr uint32_t mask = bufSize - 1U;
+            // Longest record: length byte and maximum-size frame.
+            static constexpr uint32_t maxRecord = 1U + maxRXBytes;
+
+            // Free-running write/read positions in bytes,
+            // each with the last value seen of the other side's position,
+            // only reloaded when that may make the difference between full
+            // (or empty) or not, to avoid touching the other side's cache line.
+            // The two sides are kept apart (and from the buffer) so that
+            // they are not slowed by sharing a cache line.
+            alignas(64) OTV0P2BASE::OTAtomic_t<uint32_t> writePos;
+            mutable uint32_t readPosSeen;
+            alignas(64) OTV0P2BASE::OTAtomic_t<uint32_t> readPos;
+            mutable uint32_t writePosSeen;
+            // Mutable as _getRXBufForInbound() is const but hands out space to load.
+            alignas(64) mutable volatile uint8_t buf[bufSize];
+
+            // Bytes skipped at the end of the ring before a record at position p,
+            // ie all that is left if there is not room for a maximum-size record.
+            // The same for producer and consumer, so nothing need mark a skip.
+            static inline uint32_t skipAt(const uint32_t p)
+                {
+                const uint32_t toEnd = bufSize - (p & mask);
+                return((toEnd < maxRecord) ? toEnd : 0);
+                }
+
+            // True if a maximum-size record cannot be added at w with the consumer at r.
+            inline bool _isFull(const uint32_t w, const uint32_t r) const
+                {
+                if(this->queuedRXedMessageCount >= 255) { return(true); }
+                return((w - r) + skipAt(w) + maxRecord > bufSize);
+                }
+
+        public:
+            ISRRXQueueSPSC() : writePos(0), readPosSeen(0), readPos(0), writePosSeen(0) { }
+
+            // Guaranteed minimum number of (full-length) messages that can be queued,
+            // allowing for the most that can be skipped at the end of the ring.
+            static constexpr uint8_t MinQueueCapacityMsgs =
+                ((bufSize - maxRecord + 1U) / maxRecord > 255U) ? 255 : uint8_t((bufSize - maxRecord + 1U) / maxRecord);
+
+            // Fetches the current inbound RX minimum queue capacity and maximum RX raw message size.
+            virtual void getRXCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen) const override
+                { queueRXMsgsMin = MinQueueCapacityMsgs; maxRXMsgLen = maxRXBytes; }
+
+            // True if the queue is full.
+            // True iff _getRXBufForInbound() would return NULL.
+            // Thread-safe.
+            inline uint8_t isFullNonVirtual() const
+                { return(_isFull(writePos.load(std::memory_order_acquire), readPos.load(std::memory_order_acquire))); }
+
+            // Get pointer for inbound/RX frame able to accommodate max frame size; NULL if no space.
+            // Call this to get a pointer to load an inbound frame (<=maxRXBytes bytes) into;
+            // after uploading the frame call _loadedBuf() to queue the new frame
+            // or abandon an upload on this occasion.
+            // Producer thread only.
+            // _loadedBuf() should not be called if this returns NULL.
+            inline volatile uint8_t *_getRXBufForInboundNonVirtual() const
+                {
+                // Only this side stores writePos.
+                const uint32_t w = writePos.load(std::memory_order_relaxed);
+                // Acquire, so that the consumer is done with any space about to be reused.
+                if(_isFull(w, readPosSeen))
+                    {
+                    readPosSeen = readPos.load(std::memory_order_acquire);
+                    if(_isFull(w, readPosSeen)) { return(NULL); }
+                    }
+                return(buf + ((w + skipAt(w)) & mask) + 1);
+                }
+
+            // Call after loading an RXed frame into the buffer indicated by _getRXBufForInbound().
+            // The argument is the size of the frame loaded into the buffer to be queued.
+            // The frame can be no larger than maxRXBytes bytes.
+            // It is possible to formally abandon an upload attempt by calling this with 0.
+            // Producer thread only.
+            inline void _loadedBufNonVirtual(uint8_t frameLen)
+                {
+                if(0 == frameLen) { return; } // New frame not being uploaded.
+                if(frameLen > maxRXBytes) { frameLen = maxRXBytes; } // Be safe...
+                const uint32_t w = writePos.load(std::memory_order_relaxed);
+                const uint32_t start = w + skipAt(w);
+                buf[start & mask] = frameLen;
+                // Count before publishing, so the consumer can never decrement first.
+                __atomic_fetch_add(&this->queuedRXedMessageCount, uint8_t(1), __ATOMIC_RELAXED);
+                // Release: the length and frame are visible before the new position.
+                writePos.store(start + 1 + frameLen, std::memory_order_release);
+                }
+
+            // Peek at first (oldest) queued RX message, returning a pointer or NULL if no message waiting.
+            // The pointer returned is NULL if there is no message,
+            // else the pointer is to the start of the message/frame
+            // and the length is in the byte before the start of the frame.
+            // The returned pointer and length are valid until the next
+            //     peekRXMessage() or removeRXMessage()
+            // This does not remove the message or alter the queue.
+            // The buffer pointed to MUST NOT be altered.
+            // Consumer thread only.
+            inline const volatile uint8_t *peekRXMsgNonVirtual() const
+                {
+                // Only this side stores readPos.
+                const uint32_t r = readPos.load(std::memory_order_relaxed);
+                // Acquire, so that the whole frame is visible.
+                if(r == writePosSeen)
+                    {
+                    writePosSeen = writePos.load(std::memory_order_acquire);
+                    if(r == writePosSeen) { return(NULL); }
+                    }
+                return(buf + ((r + skipAt(r)) & mask) + 1);
+                }
+
+            // Remove the first (oldest) queued RX message.
+            // Typically used after peekRXMessage().
+            // Does nothing if the queue is empty.
+            // Consumer thread only.
+            inline void removeRXMsgNonVirtual()
+                {
+                const uint32_t r = readPos.load(std::memory_order_relaxed);
+                if(r == writePosSeen)
+                    {
+                    writePosSeen = writePos.load(std::memory_order_acquire);
+                    if(r == writePosSeen) { return; }
+                    }
+                const uint32_t start = r + skipAt(r);
+                const uint8_t frameLen = buf[start & mask];
+                __atomic_fetch_sub(&this->queuedRXedMessageCount, uint8_t(1), __ATOMIC_RELAXED);
+                // Release: finished with the space before handing it back.
+                readPos.store(start + 1 + frameLen, std::memory_order_release);
+                }
+
+            // Ring bytes in use, including any skipped at the end before wrapping.
+            // Thread-safe.
+            inline uint16_t getRXBytesQueuedNonVirtual() const
+                { return(uint16_t(writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire))); }
+        };
+    }
+
+#endif // ARDUINO
+
+#endif
@@ -26,8 +26,8 @@ Author(s) / Copyright (s): Deniz Erbilgin 2017
 #include "OTRadioLink_SecureableFrameType_V0p2Impl.h"
 
 #include "OTRadValve_BoilerDriver.h"
+#include "OTRadioLink_ISRRXQueue.h"
 #include "OTRadioLink_OTRadioLink.h"
-#include "OTRadioLink_MessagingFS20.h"
 
 namespace OTRadioLink
 {
@@ -52,6 +52,66 @@ typedef bool (frameOperator_fn_t) (const OTDecodeData_T &fd);
  */
 typedef bool (frameDecodeHandler_fn_t) (volatile const uint8_t *msg);
 
+/**
+ * @brief   Decoded-frame context for one RXed message, created once per
+ *          message and passed by reference along the whole handler chain
+ *          and on to the operators.
+ *
+ * The header is decoded (by SecurableFrameHeader::decodeHeader()) at most
+ * once, when first asked for, and a secure body is authenticated and
+ * decrypted at most once into the single body buffer held here.
+ * So later handlers in the chain neither re-parse the header nor need
+ * their own decrypted body buffer on the stack, and any number of operators
+ * can share the one decoded frame (see frameOperatorChain()).
+ *
+ * @note    The message buffer must not be altered while this is in use.
+ */
+struct OTRXFrameContext_T
+{
+    explicit OTRXFrameContext_T(volatile const uint8_t * const _msg)
+        : msg(_msg), fd((const uint8_t *)_msg - 1, body) {}
+
+    // Raw RXed message as passed to frameDecodeHandler_fn_t handlers;
+    // msgLen is in the byte before and can be accessed with msg[-1].
+    volatile const uint8_t * const msg;
+    // Buffer for the decrypted body, ie fd.ptext.
+    uint8_t body[OTDecodeData_T::ptextLenMax];
+    // Frame data passed to the operators.
+    OTDecodeData_T fd;
+
+    /**
+     * @brief   Decode the frame header into fd.sfh, only on the first call.
+     * @retval  As SecurableFrameHeader::decodeHeader(), ie the header length
+     *          or 0 if the message is not a valid secureable frame.
+     */
+    uint8_t decodeHeader()
+    {
+        if(!headerDone) {
+            headerDone = true;
+            headerLen = fd.sfh.decodeHeader(fd.ctext, fd.ctextLen + 1);
+        }
+        return(headerLen);
+    }
+
+    // True once the body has been authenticated and decrypted into fd.
+    bool isBodyDecoded() const { return(bodyDecoded); }
+    // Mark the body as authenticated and decrypted into fd.
+    void setBodyDecoded() { bodyDecoded = true; }
+
+private:
+    uint8_t headerLen = 0;
+    bool headerDone = false;
+    bool bodyDecoded = false;
+};
+
+/**
+ * @brief   As frameDecodeHandler_fn_t, but given the shared decoded-frame
+ *          context for the message rather than the raw message.
+ * @retval  True if frame is successfully handled, as for
+ *          frameDecodeHandler_fn_t.
+ */
+typedef bool (frameContextHandler_fn_t) (OTRXFrameContext_T &fc);
+
 
 
 //////////////////  FUNCTION DECLARATIONS.
@@ -71,6 +131,9 @@ frameOperator_fn_t boilerFrameOperation;
 // Dummy frame decoder and handler.
 frameDecodeHandler_fn_t decodeAndHandleDummyFrame;
 
+// Dummy frame decoder and handler, given the decoded-frame context.
+frameContextHandler_fn_t decodeAndHandleDummyFrameContext;
+
 // Handle an OT style secure frame. Will return false for *secureable* small
 // frames that aren't secure.
 frameDecodeHandler_fn_t decodeAndHandleOTSecureFrame;
@@ -84,6 +147,22 @@ frameDecodeHandler_fn_t decodeAndHandleOTSecureFrame;
  */
 bool nullFrameOperation (const OTDecodeData_T & /*fd*/) { return (false); }
 
+/**
+ * @brief   Call each of a list of operators in order on the same decoded
+ *          frame, so that more than two can be passed where one is expected,
+ *          eg as o1 of decodeAndHandleOTSecureOFrame():
+ *              frameOperatorChain<serialOp, relayOp, boilerOp>
+ * @retval  True if all the operators returned true. All are always called.
+ */
+template<frameOperator_fn_t &o>
+bool frameOperatorChain(const OTDecodeData_T &fd) { return(o(fd)); }
+template<frameOperator_fn_t &o1, frameOperator_fn_t &o2, frameOperator_fn_t &... os>
+bool frameOperatorChain(const OTDecodeData_T &fd)
+{
+    const bool r = o1(fd);
+    return(frameOperatorChain<o2, os...>(fd) && r);
+}
+
 
 /**
  * @brief   Operation for printing to serial
@@ -178,6 +257,95 @@ bool boilerFrameOperation(const OTDecodeData_T &fd)
 }
 
 
+/**
+ * @brief   Print brief network diagnostics for a secure frame that failed
+ *          association lookup or auth.
+ *
+ * A couple of bytes of the claimed ID of rejected frames.
+ * Warnings rather than errors
+ * because there may legitimately be multiple disjoint networks.
+ */
+inline void printRXAuthFailure(const OTDecodeData_T &fd)
+{
+    // Missing association or failed auth.
+    OTV0P2BASE::serialPrintAndFlush(F("?RX auth"));
+    if(fd.sfh.getIl() > 0) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[0], 16); }
+    if(fd.sfh.getIl() > 1) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[1], 16); }
+    // More detailed ID of rejected frames
+#if 0
+    if(fd.sfh.getIl() > 2) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[2], 16); }
+    if(fd.sfh.getIl() > 3) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[3], 16); }
+    if(fd.sfh.getIl() > 4) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[4], 16); }
+    if(fd.sfh.getIl() > 5) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[5], 16); }
+    if(fd.sfh.getIl() > 6) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[6], 16); }
+    if(fd.sfh.getIl() > 7) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[7], 16); }
+#endif
+    OTV0P2BASE::serialPrintlnAndFlush();
+}
+
+/**
+ * @brief   Authenticate and decrypt one secure frame whose header has already
+ *          been decoded into fd.
+ *
+ * This is the per-frame core shared by authAndDecodeOTSecurableFrame(),
+ * decodeAndHandleOTSecureOFrame() and decodeAndHandleOTSecureOFrameBatch().
+ * Frames from (eg neighbouring networks') nodes that cannot be associated,
+ * and exact repeats of a frame just authenticated (eg heard via a second
+ * radio), are silently dropped before the key is fetched or any crypto done.
+ *
+ * @param   fd: Frame data with the header decoded; the body is decoded into it.
+ * @param   subScratch: Scratch space for the receiver and decrypt routine.
+ * @param   fetchKey: Called with no arguments only once a frame is worth
+ *          decrypting; returns a pointer to the 16-byte key, or nullptr if
+ *          the key is not available. Allows callers to fetch the key lazily.
+ * @retval  True if frame successfully authenticated and decoded, else false.
+ */
+template <typename sfrx_t,
+          SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &decrypt,
+          typename fetchKey_t>
+inline bool authAndDecodeOTSecureFrameBody(OTDecodeData_T &fd, OTV0P2BASE::ScratchSpaceL &subScratch, fetchKey_t &&fetchKey)
+{
+    // Probe the stack here, in case we don't get deeper.
+    OTV0P2BASE::MemoryChecks::recordIfMinSP();
+
+    sfrx_t &sfrx = sfrx_t::getInstance();
+    if(!sfrx.mayBeFromAssociatedNode(fd.sfh) || sfrx.isRecentDuplicateFrame(fd)) { return(false); }
+
+    const uint8_t *const key = fetchKey();
+    if(nullptr == key) { return(false); }
+
+    // Now attempt to decrypt.
+    // Assumed no need to 'adjust' node ID for this form of RX.
+
+    // Look up full ID in associations table,
+    // validate the RX message counter,
+    // authenticate and decrypt,
+    // then update the RX message counter.
+    const bool isOK = (0 != sfrx.decode(fd, decrypt, subScratch, key, true));
+#if 1 // && defined(DEBUG)
+    if(!isOK) { printRXAuthFailure(fd); }
+#endif
+    if(isOK) { sfrx.noteAuthenticatedFrame(fd); }
+
+    return(isOK); // Return if successfully decoded, authenticated, etc.
+}
+
+/**
+ * @brief   Pass an authenticated and decoded secure "O" frame to up to two
+ *          operators, as decodeAndHandleOTSecureOFrame() and
+ *          decodeAndHandleOTSecureOFrameBatch() do.
+ */
+template<frameOperator_fn_t &o1, frameOperator_fn_t &o2>
+inline void operateOnOTSecureOFrame(const OTDecodeData_T &fd)
+{
+    // Make sure frame is long enough to have useful information in it
+    // and then call operations.
+    if(2 < fd.ptextLenMax) {
+        o1(fd);
+        o2(fd);
+    }
+}
+
 /**
  * @brief   Authenticate and decrypt secure frames. Expects syntax checking and
  *          validation to already have been done.
@@ -201,59 +369,20 @@ inline bool authAndDecodeOTSecurableFrame(OTDecodeData_T &fd, OTV0P2BASE::Scratc
     constexpr size_t scratchSpaceNeededHere = authAndDecodeOTSecurableFrameWithWorkspace_scratch_usage;
     if(sW.bufsize < scratchSpaceNeededHere) { return(false); } // ERROR
 
-#if 0
-    // Probe the stack here, in case we don't get deeper.
-    OTV0P2BASE::MemoryChecks::recordIfMinSP();
-#endif
-
     // Use scratch space for 16-byte key.
-    uint8_t *key = sW.buf;
-    // Get the building primary key.
-    if(!getKey(key)) { // CI throws "address will never be null" error.
-        OTV0P2BASE::serialPrintlnAndFlush(F("!RX key"));
-        return(false);
-    }
-
+    uint8_t *const key = sW.buf;
     // Create sub-space for callee.
     OTV0P2BASE::ScratchSpaceL subScratch(sW, scratchSpaceNeededHere);
 
-    // Now attempt to decrypt.
-    // Assumed no need to 'adjust' node ID for this form of RX.
-
-    // Look up full ID in associations table,
-    // validate the RX message counter,
-    // authenticate and decrypt,
-    // then update the RX message counter.
-    const bool isOK = (0 != sfrx_t::getInstance().decode(
-                                                      fd,
-                                                      decrypt,
-                                                      subScratch, key,
-                                                      true));
-#if 1 // && defined(DEBUG)
-if(!isOK) {
-// Useful brief network diagnostics.
-// A couple of bytes of the claimed ID of rejected frames.
-// Warnings rather than errors
-// because there may legitimately be multiple disjoint networks.
-//
-// Missing association or failed auth.
-OTV0P2BASE::serialPrintAndFlush(F("?RX auth"));
-if(fd.sfh.getIl() > 0) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[0], 16); }
-if(fd.sfh.getIl() > 1) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[1], 16); }
-// More detailed ID of rejected frames
-#if 0
-if(fd.sfh.getIl() > 2) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[2], 16); }
-if(fd.sfh.getIl() > 3) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[3], 16); }
-if(fd.sfh.getIl() > 4) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[4], 16); }
-if(fd.sfh.getIl() > 5) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[5], 16); }
-if(fd.sfh.getIl() > 6) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[6], 16); }
-if(fd.sfh.getIl() > 7) { OTV0P2BASE::serialPrintAndFlush(' '); OTV0P2BASE::serialPrintAndFlush(fd.sfh.id[7], 16); }
-#endif
-OTV0P2BASE::serialPrintlnAndFlush();
-}
-#endif
-
-    return(isOK); // Return if successfully decoded, authenticated, etc.
+    return(authAndDecodeOTSecureFrameBody<sfrx_t, decrypt>(fd, subScratch,
+        [key]() -> const uint8_t * {
+            // Get the building primary key.
+            if(!getKey(key)) { // CI throws "address will never be null" error.
+                OTV0P2BASE::serialPrintlnAndFlush(F("!RX key"));
+                return(nullptr);
+            }
+            return(key);
+        }));
 }
 
 
@@ -267,6 +396,16 @@ inline bool decodeAndHandleDummyFrame(volatile const uint8_t * const /*msg*/)
     return false;
 }
 
+/**
+ * @brief   Stub version of a frameContextHandler_fn_t type function.
+ * @retval  Always false.
+ * @note    Used as a dummy handler and should be optimised out by the compiler.
+ */
+inline bool decodeAndHandleDummyFrameContext(OTRXFrameContext_T & /*fc*/)
+{
+    return false;
+}
+
 /**
  * @brief   Attempt to decode a message as if it is a standard OT secure "O"
  *          type frame. May perform up to two "operations" if the decode
@@ -293,9 +432,10 @@ inline bool decodeAndHandleDummyFrame(volatile const uint8_t * const /*msg*/)
  *          Should return true on success.
  * @param   o1: First operator to be called.
  * @param   o2: Second operator to be called. Defaults to a dummy impl.
- * @param   _msg: Raw RXed message. msgLen should be stored in the byte before
- *          and can be accessed with msg[-1]. This routine is NOT allowed to
- *          alter content of the buffer passed.
+ * @param   fc: Decoded-frame context for the raw RXed message, shared with
+ *          any other handlers in the chain. The header and body are decoded
+ *          into it only if not already done by an earlier handler.
+ *          This routine is NOT allowed to alter content of the message.
  * @param   sW: Scratch space to perform decode routine in. Should be large
  *          enough for both the frame RX type and the underlying decryption
  *          routine.
@@ -310,52 +450,56 @@ template<typename sfrx_t,
          OTV0P2BASE::GetPrimary16ByteSecretKey_t &getKey,
          frameOperator_fn_t &o1,
          frameOperator_fn_t &o2 = nullFrameOperation>
-bool decodeAndHandleOTSecureOFrame(volatile const uint8_t * const _msg, OTV0P2BASE::ScratchSpaceL &sW)
+bool decodeAndHandleOTSecureOFrame(OTRXFrameContext_T &fc, OTV0P2BASE::ScratchSpaceL &sW)
 {
-    const uint8_t * const msg = (const uint8_t * const)_msg - 1;
-    const uint8_t firstByte = msg[1];
-    const uint8_t msglen = msg[0];
-
-    // Buffer for receiving secure frame body.
-    // (Non-secure frame bodies should be read directly from the frame buffer.)
-    // FIXME: Should this be passed in by scratch space?
-    // TODO: Consider moving this out by one layer and passing it in, to avoid
-    // needing to re-decode header in second handler.
-    uint8_t decryptedBodyOut[OTDecodeData_T::ptextLenMax];
-    OTDecodeData_T fd(msg, decryptedBodyOut);
-
     // Validate structure of header/frame first.
     // This is quick and checks for insane/dangerous values throughout.
-    const uint8_t l = fd.sfh.decodeHeader(msg, msglen + 1);
+    // Decoded at most once per message, whichever handler asks first.
+    const uint8_t l = fc.decodeHeader();
     // If failed this early and this badly,
     // then let another protocol handler try parsing the message buffer...
     if(0 == l) { return(false); }
     // Make sure frame thinks it is a secure OFrame.
     constexpr uint8_t expectedOFrameFirstByte = 'O' | 0x80;
-    if(expectedOFrameFirstByte != firstByte) { return (false); }
+    if(expectedOFrameFirstByte != fc.fd.ctext[1]) { return (false); }
 
     // Validate integrity of frame (CRC for non-secure, auth for secure).
-    if(!fd.sfh.isSecure()) { return(false); }
+    if(!fc.fd.sfh.isSecure()) { return(false); }
 
     // After this point, once the frame is established as the correct protocol,
     // this routine must return true to avoid another handler
     // attempting to process it.
 
     // Even if auth fails, we have now handled this frame by protocol.
-    if(!authAndDecodeOTSecurableFrame<sfrx_t, decrypt, getKey>(fd, sW))
-        { return(true); }
-
-    // Make sure frame is long enough to have useful information in it
-    // and then call operations.
-    if(2 < fd.ptextLenMax) {
-        o1(fd);
-        o2(fd);
+    // The body is only authenticated and decrypted once per message,
+    // not least since a second attempt would fail the RX counter check.
+    if(!fc.isBodyDecoded()) {
+        if(!authAndDecodeOTSecurableFrame<sfrx_t, decrypt, getKey>(fc.fd, sW))
+            { return(true); }
+        fc.setBodyDecoded();
     }
+
+    operateOnOTSecureOFrame<o1, o2>(fc.fd);
     // This frame has now been dealt with (by protocol)
     // even if we happened not to be able to process it successfully.
     return(true);
 }
 
+/**
+ * @brief   As decodeAndHandleOTSecureOFrame() above, for a raw message
+ *          handled on its own rather than as part of a handler chain.
+ */
+template<typename sfrx_t,
+         SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &decrypt,
+         OTV0P2BASE::GetPrimary16ByteSecretKey_t &getKey,
+         frameOperator_fn_t &o1,
+         frameOperator_fn_t &o2 = nullFrameOperation>
+bool decodeAndHandleOTSecureOFrame(volatile const uint8_t * const _msg, OTV0P2BASE::ScratchSpaceL &sW)
+{
+    OTRXFrameContext_T fc(_msg);
+    return(decodeAndHandleOTSecureOFrame<sfrx_t, decrypt, getKey, o1, o2>(fc, sW));
+}
+
 
 /*
  * @brief   Attempt to decode an inbound message using all available decoders.
@@ -393,6 +537,227 @@ void decodeAndHandleRawRXedMessage(volatile const uint8_t * const msg)
     return;
 }
 
+/**
+ * @brief   Attempt to decode an inbound message using up to two handlers
+ *          that share one decoded-frame context.
+ *
+ * As decodeAndHandleRawRXedMessage() above, except that the header is
+ * decoded at most once and a secure body decrypted at most once for the
+ * whole chain, into the context created here, rather than once per handler.
+ *
+ * This is itself a frameDecodeHandler_fn_t, so it can be passed wherever
+ * such a handler is expected, eg as h1 of OTMessageQueueHandler.
+ *
+ * @param   msg: Raw RXed message. msgLen should be stored in the byte before
+ *          and can be accessed with msg[-1]. This routine is NOT allowed to
+ *          alter content of the buffer passed.
+ * @param   h1: First frame handler to attempt.
+ * @param   h2: Second frame handler to attempt. Defaults to a dummy handler.
+ * @retval  True if either handler handled the frame.
+ */
+template<frameContextHandler_fn_t &h1, frameContextHandler_fn_t &h2 = decodeAndHandleDummyFrameContext>
+bool decodeAndHandleRXedFrame(volatile const uint8_t * const msg)
+{
+    const uint8_t msglen = msg[-1];
+    if(msglen < 2) { return(false); } // Too short to be useful, so ignore.
+    OTRXFrameContext_T fc(msg);
+    if(h1(fc)) { return(true); }
+    return(h2(fc));
+}
+
+/**
+ * @brief   As decodeAndHandleRawRXedMessage() above, with handlers
+ *          sharing one decoded-frame context (see decodeAndHandleRXedFrame()).
+ */
+template<frameContextHandler_fn_t &h1, frameContextHandler_fn_t &h2 = decodeAndHandleDummyFrameContext>
+void decodeAndHandleRawRXedMessage(volatile const uint8_t * const msg)
+{
+    decodeAndHandleRXedFrame<h1, h2>(msg);
+}
+
+/**
+ * @brief   One route for decodeAndRouteRXedMessage(): messages whose first
+ *          byte, masked with mask, equals frameType are passed to handler h.
+ * @param   frameType: Frame type byte, eg FTp2_FS20_native or 'O' | 0x80.
+ * @param   mask: Bits of the first byte to compare; 0xff by default,
+ *          or eg 0x7f to take both the secure and insecure variant of a type.
+ * @param   h: Frame handler for matching messages.
+ */
+template<uint8_t frameType, uint8_t mask, frameDecodeHandler_fn_t &h>
+struct frameTypeRoute
+{
+    static constexpr bool matches(const uint8_t firstByte) { return((firstByte & mask) == (frameType & mask)); }
+    static bool handle(volatile const uint8_t * const msg) { return(h(msg)); }
+};
+
+// Support for building the decodeAndRouteRXedMessage() dispatch table
+// at compile time.
+namespace FrameRouting
+{
+    // Sequence of all the possible first-byte values, 0 to 255.
+    template<uint8_t... bs> struct byteSeq { };
+    template<unsigned n, uint8_t... bs> struct makeByteSeq : makeByteSeq<n - 1, uint8_t(n - 1), bs...> { };
+    template<uint8_t... bs> struct makeByteSeq<0, bs...> { typedef byteSeq<bs...> type; };
+
+    // Index (from 1) of the first route matching the first byte, or 0 if none.
+    template<typename... routes> struct routeIndex
+        { static constexpr uint8_t of(const uint8_t, const uint8_t = 1) { return(0); } };
+    template<typename r, typename... routes> struct routeIndex<r, routes...>
+        {
+        static constexpr uint8_t of(const uint8_t firstByte, const uint8_t i = 1)
+            { return(r::matches(firstByte) ? i : routeIndex<routes...>::of(firstByte, uint8_t(i + 1))); }
+        };
+
+    // Route index for each first byte (in flash on AVR),
+    // and the handler for each route index.
+    template<typename seq, typename... routes> struct routeTable;
+    template<uint8_t... bs, typename... routes> struct routeTable<byteSeq<bs...>, routes...>
+        {
+        static const uint8_t indexByFirstByte[256];
+        static frameDecodeHandler_fn_t * const handlers[1 + sizeof...(routes)];
+        };
+    template<uint8_t... bs, typename... routes>
+    const uint8_t routeTable<byteSeq<bs...>, routes...>::indexByFirstByte[256] PROGMEM =
+        { routeIndex<routes...>::of(bs)... };
+    template<uint8_t... bs, typename... routes>
+    frameDecodeHandler_fn_t * const routeTable<byteSeq<bs...>, routes...>::handlers[1 + sizeof...(routes)] =
+        { decodeAndHandleDummyFrame, routes::handle... };
+}
+
+/**
+ * @brief   Attempt to decode an inbound message by passing it straight to
+ *          the handler for its frame type, for any number of frame types.
+ *
+ * Unlike decodeAndHandleRawRXedMessage(), which offers the message to each
+ * handler in turn, each of which must recheck the first byte, here the
+ * first byte selects the handler via a 256-entry table built at compile
+ * time, so dispatch costs the same however many protocols are enabled.
+ * Where routes overlap the first listed wins, and messages of types with
+ * no route are dropped.
+ * Only the handlers listed are instantiated.
+ *
+ * This is itself a frameDecodeHandler_fn_t, so it can be passed wherever
+ * such a handler is expected, eg as h1 of OTMessageQueueHandler:
+ *     decodeAndRouteRXedMessage<
+ *         frameTypeRoute<'O' | 0x80, 0xff, secureOHandler>,
+ *         frameTypeRoute<FTp2_FS20_native, 0xff, fs20Handler> >
+ *
+ * @param   routes: frameTypeRoute<frameType, mask, handler> for each
+ *          frame type to be handled.
+ * @param   msg: Raw RXed message. msgLen should be stored in the byte before
+ *          and can be accessed with msg[-1]. This routine is NOT allowed to
+ *          alter content of the buffer passed.
+ * @retval  True if the handler for the frame type handled the message.
+ */
+template<typename... routes>
+bool decodeAndRouteRXedMessage(volatile const uint8_t * const msg)
+{
+    const uint8_t msglen = msg[-1];
+    if(msglen < 2) { return(false); } // Too short to be useful, so ignore.
+    typedef FrameRouting::routeTable<typename FrameRouting::makeByteSeq<256>::type, routes...> table_t;
+    const uint8_t i = pgm_read_byte(&table_t::indexByFirstByte[msg[0]]);
+    return(table_t::handlers[i](msg));
+}
+
+/**
+ * @brief   Drain all frames currently queued in an RX queue in one call,
+ *          handling secure "O" frames as decodeAndHandleOTSecureOFrame() does.
+ *
+ * On a busy hub several frames may pile up in the RX queue (eg after a long
+ * TX or flash write), and handling them one call at a time repeats the
+ * per-call setup for each frame. Here, for the whole batch:
+ * - the secret key is fetched once, lazily on the first secure frame,
+ *   and wiped from the scratch space before returning;
+ * - the scratch space is carved up once, including the decrypted body buffer
+ *   (so there is no per-frame stack buffer);
+ * Each frame still has its header decoded and its sender looked up
+ * since each may be from a different node, and is then authenticated,
+ * decrypted and passed to the operators exactly as a single frame is,
+ * by authAndDecodeOTSecureFrameBody() and operateOnOTSecureOFrame().
+ *
+ * Frames that are not secure "O" frames are passed to `other` (if supplied).
+ * Every frame examined is removed from the queue, whether or not it could be
+ * handled, as for OTMessageQueueHandler::handle().
+ *
+ * @param   sfrx_t: Secure frame receiver, as for decodeAndHandleOTSecureOFrame().
+ * @param   decrypt: A function to decrypt secure frame with.
+ * @param   getKey: A function that fills a buffer with the 16 byte secret key.
+ *          Should return true on success.
+ * @param   o1: First operator to be called on each decoded frame.
+ * @param   o2: Second operator to be called. Defaults to a dummy impl.
+ * @param   other: Handler for frames that are not secure "O" frames.
+ *          Defaults to a dummy handler, ie such frames are dropped.
+ * @param   q: Queue to drain, eg an ISRRXQueue or an OTRadioLink;
+ *          needs peekRXMsg() and removeRXMsg().
+ * @param   sW: Scratch space to perform the decodes in; must be at least
+ *          decodeAndHandleOTSecureOFrameBatch_scratch_usage bytes plus
+ *          enough for the frame RX type and the underlying decryption routine.
+ * @param   maxFrames: Maximum number of frames to handle in this call.
+ * @retval  The number of frames removed from the queue.
+ *          0 if the queue was empty or the scratch space too small.
+ */
+// Local scratch: 16-byte key and decrypted body buffer.
+static constexpr uint8_t decodeAndHandleOTSecureOFrameBatch_scratch_usage =
+    16 + OTDecodeData_T::ptextLenMax;
+template<typename sfrx_t,
+         SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &decrypt,
+         OTV0P2BASE::GetPrimary16ByteSecretKey_t &getKey,
+         frameOperator_fn_t &o1,
+         frameOperator_fn_t &o2 = nullFrameOperation,
+         frameDecodeHandler_fn_t &other = decodeAndHandleDummyFrame,
+         typename rxq_t>
+uint8_t decodeAndHandleOTSecureOFrameBatch(rxq_t &q, OTV0P2BASE::ScratchSpaceL &sW, const uint8_t maxFrames = 255)
+{
+    constexpr size_t scratchSpaceNeededHere = decodeAndHandleOTSecureOFrameBatch_scratch_usage;
+    if(sW.bufsize < scratchSpaceNeededHere) { return(0); } // ERROR
+
+    // Use scratch space for 16-byte key, then decrypted body.
+    uint8_t *const key = sW.buf;
+    uint8_t *const decryptedBodyOut = sW.buf + 16;
+    bool keyFetched = false;
+    bool haveKey = false;
+
+    // Create sub-space for callees, shared by all frames in the batch.
+    OTV0P2BASE::ScratchSpaceL subScratch(sW, scratchSpaceNeededHere);
+
+    uint8_t handled = 0;
+    while(handled < maxFrames) {
+        const volatile uint8_t *const pb = q.peekRXMsg();
+        if(nullptr == pb) { break; }
+        const uint8_t *const msg = (const uint8_t *)pb - 1;
+        const uint8_t msglen = msg[0];
+        // Too short to be useful, so ignore.
+        if(msglen >= 2) {
+            OTDecodeData_T fd(msg, decryptedBodyOut);
+            // Validate structure of header/frame first,
+            // and make sure frame thinks it is a secure OFrame.
+            constexpr uint8_t expectedOFrameFirstByte = 'O' | 0x80;
+            const bool isSecureOFrame = (0 != fd.sfh.decodeHeader(msg, msglen + 1)) &&
+                                        (expectedOFrameFirstByte == msg[1]) &&
+                                        fd.sfh.isSecure();
+            if(!isSecureOFrame) { other(pb); }
+            else if(authAndDecodeOTSecureFrameBody<sfrx_t, decrypt>(fd, subScratch,
+                [key, &keyFetched, &haveKey]() -> const uint8_t * {
+                    // Get the building primary key once per batch.
+                    if(!keyFetched) {
+                        keyFetched = true;
+                        haveKey = getKey(key);
+                        if(!haveKey) { OTV0P2BASE::serialPrintlnAndFlush(F("!RX key")); }
+                    }
+                    return(haveKey ? key : nullptr);
+                })) {
+                operateOnOTSecureOFrame<o1, o2>(fd);
+            }
+        }
+        q.removeRXMsg();
+        ++handled;
+    }
+
+    // Don't leave the key lying around in the scratch space.
+    if(keyFetched) { memset(key, 0, 16); }
+    return(handled);
+}
+
 /**
  * @brief   Abstract interface for handling message queues.
  *          Provided as V0p2 is still spaghetti (20170608).
@@ -521,6 +886,65 @@ public:
         }
         return(workDone);
     }
+
+    /**
+     * @brief   Poll radio and process queued messages until the queue is
+     *          empty or the sub-cycle deadline is reached.
+     *
+     * As handle(), but rather than at most one frame per call, frames are
+     * handled back to back while any remain queued, so that a burst does not
+     * wait one major cycle per frame.
+     * No frame is started once getSCT() has reached deadline
+     * (or has wrapped around into the next cycle),
+     * so the caller should allow for the time to handle one frame after it,
+     * eg ~0.5s worst case for a secure 'O' frame on AVR (see handle()).
+     *
+     * @param   deadline: Sub-cycle time after which no frame is started.
+     * @param   getSCT: Sub-cycle time source, eg OTV0P2BASE::getSubCycleTime.
+     * @param   wakeSerialIfNeeded: As for handle().
+     * @param   rl: Radio to check for new RXed frames.
+     * @param   framesLeft: Set to the number of frames left queued on return.
+     * @retval  The number of frames handled.
+     */
+    template<typename sct_fn_t>
+    uint8_t handleUntil(const uint8_t deadline, sct_fn_t &getSCT,
+            bool
+#ifdef ARDUINO_ARCH_AVR
+            wakeSerialIfNeeded
+#endif // ARDUINO_ARCH_AVR
+            , OTRadioLink &rl, uint8_t &framesLeft)
+    {
+        uint8_t handled = 0;
+        const uint8_t sctStart = getSCT();
+        if(sctStart < deadline) {
+            // Deal with any I/O that is queued.
+            pollIO(true);
+#ifdef ARDUINO_ARCH_AVR
+            bool neededWaking = false; // Set true once this routine wakes Serial.
+#endif // ARDUINO_ARCH_AVR
+            for( ; ; ) {
+                // Check for activity on the radio link.
+                rl.poll();
+                const volatile uint8_t *pb = rl.peekRXMsg();
+                if(nullptr == pb) { break; }
+#ifdef ARDUINO_ARCH_AVR
+                if(!neededWaking && wakeSerialIfNeeded && OTV0P2BASE::powerUpSerialIfDisabled<baud>()) { neededWaking = true; } // FIXME
+#endif // ARDUINO_ARCH_AVR
+                decodeAndHandleRawRXedMessage<h1, h2> (pb);
+                rl.removeRXMsg();
+                if(handled < 255) { ++handled; }
+                // Stop at the deadline or if the cycle has ended.
+                const uint8_t sct = getSCT();
+                if((sct >= deadline) || (sct < sctStart)) { break; }
+            }
+            // Turn off serial at end, if this routine woke it.
+#ifdef ARDUINO_ARCH_AVR
+            if(neededWaking) { OTV0P2BASE::flushSerialProductive(); OTV0P2BASE::powerDownSerial(); }
+#endif // ARDUINO_ARCH_AVR
+        }
+        framesLeft = rl.getRXMsgsQueued();
+        return(handled);
+    }
 };
 
 }
@@ -557,4 +981,8 @@ public:
 //      return(true);
 //      }
 //#endif // defined(ENABLE_SECURE_RADIO_BEACON)
+
+// FS20 frame handlers, built on the types above.
+#include "OTRadioLink_MessagingFS20.h"
+
 #endif /* UTILITY_OTRADIOLINK_MESSAGING_H_ */
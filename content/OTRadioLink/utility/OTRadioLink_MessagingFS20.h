@@ -20,114 +20,137 @@ Author(s) / Copyright (s): Deniz Erbilgin 2017
 #ifndef UTILITY_OTRADIOLINK_MESSAGINGFS20_H_
 #define UTILITY_OTRADIOLINK_MESSAGINGFS20_H_
 
+#include <stdint.h>
+#include "OTRadioLink_FrameType.h"
+#include "OTRadioLink_Messaging.h"
 
 namespace OTRadioLink
 {
 
 
-// FS20 stub protocol handler.
-// Template commented as stub.
-// template<typename h1_t, h1_t &h1, uint8_t frameType1>
-inline bool decodeAndHandleFS20Frame(volatile const uint8_t * const /*msg*/)
+/**
+ * @brief   Decoded FS20/FHT8V frame, as passed to FS20 frame operators.
+ *
+ * The trailer points into the raw RXed message, which is decoded in place,
+ * so it is only valid for the duration of the operator call.
+ */
+struct OTFS20DecodeData_T
 {
-    return(false);
+    // FS20 command to set an FHT8V valve position, with the extension
+    // byte holding the position on a [0,255] scale.
+    static constexpr uint8_t cmdValvePosition = 0x26;
+
+    // House code.
+    uint8_t hc1;
+    uint8_t hc2;
+    // FS20 command and extension byte.
+    uint8_t command;
+    uint8_t extension;
+    // First byte after the FS20 frame, eg the start of a stats trailer,
+    // and the last byte of the raw RXed message.
+    // No bytes follow the FS20 frame if trailer > lastByte.
+    const uint8_t *trailer;
+    const uint8_t *lastByte;
+
+    // House code as a single value, hc1 in the high byte.
+    uint16_t getHouseCode() const { return(uint16_t((uint16_t(hc1) << 8) | hc2)); }
+};
+
+/**
+ * @brief   Function containing the desired operation for the FS20 frame
+ *          handler to perform on receipt of a valid FS20 frame,
+ *          as frameOperator_fn_t is for secure frames.
+ * @retval  True if operation is performed successfully.
+ */
+typedef bool (fs20FrameOperator_fn_t) (const OTFS20DecodeData_T &fd);
+
+/**
+ * @brief   Stub version of a fs20FrameOperator_fn_t type function.
+ * @retval  Always false.
+ * @note    Used as a dummy operation. Should be optimised out by the compiler.
+ */
+inline bool nullFS20FrameOperation(const OTFS20DecodeData_T & /*fd*/) { return(false); }
+
+/**
+ * @brief   Operator for triggering a boiler call for heat from an FHT8V
+ *          valve-position command, with the house code as the valve ID.
+ * @param   fs20util_t: FHT8V/FS20 utilities, ie OTRadValve::FHT8VRadValveUtil.
+ * @param   bh_t: Type of bh
+ * @param   bh: Boiler Hub driver, as for boilerFrameOperation().
+ * @param   minuteCount: As for boilerFrameOperation().
+ * @param   fd: Decoded FS20 frame data.
+ * @retval  True if call for heat handled. False if not a valve-position command.
+ */
+template <typename fs20util_t, typename bh_t, bh_t &bh, const uint8_t &minuteCount>
+bool boilerFS20FrameOperation(const OTFS20DecodeData_T &fd)
+{
+    if(OTFS20DecodeData_T::cmdValvePosition != fd.command) { return(false); }
+    const uint8_t percentOpen = fs20util_t::convert255ScaleToPercent(fd.extension);
+    bh.remoteCallForHeatRX(fd.getHouseCode(), percentOpen, minuteCount);
+    return(true);
 }
 
+/**
+ * @brief   Attempt to decode a message as an FS20/FHT8V frame, such as
+ *          a valve-position command from an FHT8V-driving V0p2 valve,
+ *          possibly followed by a stats trailer.
+ *          May perform up to two "operations" if the decode succeeds,
+ *          as for decodeAndHandleOTSecureOFrame().
+ *
+ * Anything not starting with the FS20 preamble byte (FTp2_FS20_native)
+ * is rejected without further work, so this can go in a handler chain
+ * ahead of or behind the secure frame handlers on a mixed hub.
+ * The 200us-per-bit stream is decoded in place in the RX buffer.
+ *
+ * @param   fs20util_t: FHT8V/FS20 utilities providing fht8v_msg_t and the
+ *          FHT8VDecodeBitStream() decoder, ie OTRadValve::FHT8VRadValveUtil.
+ * @param   o1: First operator to be called.
+ * @param   o2: Second operator to be called. Defaults to a dummy impl.
+ * @param   msg: Raw RXed message. msgLen should be stored in the byte before
+ *          and can be accessed with msg[-1]. This routine is NOT allowed to
+ *          alter content of the buffer passed.
+ * @retval  True if the message is a valid FS20 frame and the operators were
+ *          called, else false so that another handler may try the message.
+ */
+template<typename fs20util_t,
+         fs20FrameOperator_fn_t &o1,
+         fs20FrameOperator_fn_t &o2 = nullFS20FrameOperation>
+bool decodeAndHandleFS20Frame(volatile const uint8_t * const msg)
+{
+    // Quick reject of other frame types.
+    if(FTp2_FS20_native != msg[0]) { return(false); }
+    const uint8_t msglen = msg[-1];
+    if(msglen < V0P2_MESSAGING_FS20_MIN_BYTES) { return(false); }
 
+    // Decode the FS20/FHT8V command straight from the RX buffer.
+    const uint8_t * const bitStream = (const uint8_t *)msg;
+    const uint8_t * const lastByte = bitStream + msglen - 1;
+    typename fs20util_t::fht8v_msg_t command;
+    const uint8_t * const trailer = fs20util_t::FHT8VDecodeBitStream(bitStream, lastByte, &command);
+    if(nullptr == trailer) { return(false); }
 
+    const OTFS20DecodeData_T fd = { command.hc1, command.hc2, command.command, command.extension, trailer, lastByte };
+    o1(fd);
+    o2(fd);
+    return(true);
+}
 
-// Copied from Messaging.cpp to preserve FS20 messaging code.
+/**
+ * @brief   As decodeAndHandleFS20Frame() above, as a frameContextHandler_fn_t
+ *          for a chain of handlers sharing one decoded-frame context
+ *          (see decodeAndHandleRXedFrame()).
+ *          The context is not used beyond the raw message.
+ */
+template<typename fs20util_t,
+         fs20FrameOperator_fn_t &o1,
+         fs20FrameOperator_fn_t &o2 = nullFS20FrameOperation>
+bool decodeAndHandleFS20Frame(OTRXFrameContext_T &fc)
+{
+    return(decodeAndHandleFS20Frame<fs20util_t, o1, o2>(fc.msg));
+}
 
-//#if defined(ENABLE_RADIO_RX) && defined(ENABLE_FHT8VSIMPLE_RX) // (defined(ENABLE_BOILER_HUB) || defined(ENABLE_STATS_RX)) && defined(ENABLE_FS20_NATIVE_AND_BINARY_STATS_RX) // Listen for calls for heat from remote valves...
-//// Handle FS20/FHT8V traffic including binary stats.
-//// Returns true on success, false otherwise.
-//static bool decodeAndHandleFTp2_FS20_native(Print *p, const bool secure, const uint8_t * const msg, const uint8_t msglen)
-//{
-//  // Decode the FS20/FHT8V command into the buffer/struct.
-//  OTRadValve::FHT8VRadValveBase::fht8v_msg_t command;
-//  uint8_t const *lastByte = msg+msglen-1;
-//  uint8_t const *trailer = OTRadValve::FHT8VRadValveBase::FHT8VDecodeBitStream(msg, lastByte, &command);
-//
-//#if defined(ENABLE_BOILER_HUB)
-//  // Potentially accept as call for heat only if command is 0x26 (38).
-//  // Later filter on the valve being open enough for some water flow to be likely
-//  // (for individual valves, and in aggregate)
-//  // and for the housecode being accepted.
-//  if(0x26 == command.command)
-//    {
-//    const uint16_t compoundHC = (((uint16_t)command.hc1) << 8) | command.hc2;
-//#if 0 && defined(DEBUG)
-//    p->print("FS20 RX 0x26 "); // Just notes that a 'valve %' FS20 command has been overheard.
-//    p->print(command.hc1); p->print(' ');
-//    p->println(command.hc2);
-//#endif
-//    const uint8_t percentOpen = OTRadValve::FHT8VRadValveUtil::convert255ScaleToPercent(command.extension);
-//    BoilerHub.remoteCallForHeatRX(compoundHC, percentOpen, minuteCount);
-//    }
-//#endif
-//
-//  if(NULL != trailer)
-//    {
-//#if 0 && defined(DEBUG)
-//p->print("FS20 msg HC "); p->print(command.hc1); p->print(' '); p->println(command.hc2);
-//#endif
-//#if defined(ENABLE_STATS_RX) // Only look for the trailer if supported.
-//    // If whole FHT8V frame was OK then check if there is a valid stats trailer.
-//
-//    // Check for 'core' stats trailer.
-//    if(OTV0P2BASE::MESSAGING_FULL_STATS_FLAGS_HEADER_MSBS == (trailer[0] & OTV0P2BASE::MESSAGING_FULL_STATS_FLAGS_HEADER_MASK))
-//      {
-//      OTV0P2BASE::FullStatsMessageCore_t content;
-//      const uint8_t *tail = decodeFullStatsMessageCore(trailer, lastByte-trailer+1, OTV0P2BASE::stTXalwaysAll, false, &content);
-//      if(NULL != tail)
-//        {
-//        // Received trailing stats frame!
-//
-//        // If ID is present then make sure it matches that implied by the FHT8V frame (else reject this trailer)
-//        // else file it in from the FHT8C frame.
-//        bool allGood = true;
-//        if(content.containsID)
-//          {
-//          if((content.id0 != command.hc1) || (content.id1 != command.hc2))
-//            { allGood = false; }
-//          }
-//        else
-//          {
-//          content.id0 = command.hc1;
-//          content.id1 = command.hc2;
-//          content.containsID = true;
-//          }
-//
-//#if 0 && defined(DEBUG)
-///*if(allGood)*/ { p->println("FS20 ts"); }
-//#endif
-//        // If frame looks good then capture it.
-//        if(allGood) { outputCoreStats(p, false, &content); }
-////            else { setLastRXErr(FHT8VRXErr_BAD_RX_SUBFRAME); }
-//        // TODO: record error with mismatched ID.
-//        }
-//      }
-//#if defined(ENABLE_MINIMAL_STATS_TXRX)
-//    // Check for minimal stats trailer.
-//    else if((trailer + MESSAGING_TRAILING_MINIMAL_STATS_PAYLOAD_BYTES <= lastByte) && // Enough space for minimum-stats trailer.
-//       (MESSAGING_TRAILING_MINIMAL_STATS_HEADER_MSBS == (trailer[0] & MESSAGING_TRAILING_MINIMAL_STATS_HEADER_MASK)))
-//      {
-//      if(verifyHeaderAndCRCForTrailingMinimalStatsPayload(trailer)) // Valid header and CRC.
-//        {
-//#if 0 && defined(DEBUG)
-//        p->println("FS20 tsm"); // Just notes that a 'valve %' FS20 command has been overheard.
-//#endif
-//        trailingMinimalStatsPayload_t payload;
-//        extractTrailingMinimalStatsPayload(trailer, &payload);
-//        }
-//      }
-//#endif
-//#endif // defined(ENABLE_STATS_RX)
-//    }
-//  return(true);
-//  }
-//#endif
 
+// Copied from Messaging.cpp to preserve the rest of the old RX router.
 
 //#ifdef ENABLE_RADIO_RX
 //// Decode and handle inbound raw message (msg[-1] contains the count of bytes received).
@@ -405,6 +405,42 @@ namespace OTRadioLink
 #endif
         };
 
+    // Static-dispatch (CRTP) form of the OTRadioLink RX interface.
+    // The concrete driver derived_t derives from OTRadioLinkCRTP<derived_t>
+    // (or OTRadioLinkCRTP<derived_t, base_t> where base_t derives from OTRadioLink)
+    // and provides non-virtual versions of the RX-side operations:
+    //     getRXMsgsQueuedNonVirtual(), peekRXMsgNonVirtual(), removeRXMsgNonVirtual(),
+    //     pollNonVirtual(), _handleInterruptNonVirtual(), _dolistenNonVirtual()
+    // from which this builds the (final) virtual interface.
+    // All but _dolistenNonVirtual() should be public;
+    // derived_t should declare this class a friend if any are not.
+    // Code templated on the driver type, eg an ISR or message pump
+    // for a template-configured radio, calls the NonVirtual forms directly
+    // so that the whole RX path (with an ISRRXQueueCRTP queue) can be inlined,
+    // while code holding an OTRadioLink & works as before.
+    // OTRFM23BLink is built this way on OTRFM23BLinkBase.
+    template<class derived_t, class base_t = OTRadioLink>
+    class OTRadioLinkCRTP : public base_t
+        {
+        private:
+            inline const derived_t &d() const { return(static_cast<const derived_t &>(*this)); }
+            inline derived_t &d() { return(static_cast<derived_t &>(*this)); }
+
+        protected:
+            // Pass any arguments on to base_t.
+            template<typename... Args>
+            constexpr OTRadioLinkCRTP(Args... args) : base_t(args...) { }
+
+            virtual void _dolisten() override final { d()._dolistenNonVirtual(); }
+
+        public:
+            virtual uint8_t getRXMsgsQueued() const override final { return(d().getRXMsgsQueuedNonVirtual()); }
+            virtual const volatile uint8_t *peekRXMsg() const override final { return(d().peekRXMsgNonVirtual()); }
+            virtual void removeRXMsg() override final { d().removeRXMsgNonVirtual(); }
+            virtual void poll() override final { d().pollNonVirtual(); }
+            virtual bool handleInterruptSimple() override final { return(d()._handleInterruptNonVirtual()); }
+        };
+
 
     // Forward some CRC definitions that were in OTRadioLink for compatibility (DHD20160117).
     inline uint8_t crc7_5B_update(uint8_t crc, uint8_t datum) { return(OTV0P2BASE::crc7_5B_update(crc, datum)); }
@@ -0,0 +1,400 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Hosted (eg multi-core gateway) multi-threaded pipeline
+ * for decoding and handling secure 'O' frames.
+ *
+ * Hosted only; not for V0p2/AVR.
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_SECUREFRAMERXPIPELINE_H
+#define ARDUINO_LIB_OTRADIOLINK_SECUREFRAMERXPIPELINE_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <OTV0p2Base.h>
+
+#include "OTRadioLink_SecureableFrameType.h"
+#include "OTRadioLink_Messaging.h"
+
+
+namespace OTRadioLink
+    {
+
+// Multi-threaded equivalent of decodeAndHandleOTSecureOFrame()
+// for a hub handling several radios on a multi-core host,
+// where AES-GCM authentication is the bottleneck.
+//
+// RX producers (eg one thread per radio) copy raw frames in with submit()
+// or submitAll() and return at once.
+// A pool of worker threads then decodes them, in three stages:
+//   * serialised, in RX order: header validation, key fetch
+//     (once per batch of frames arriving together),
+//     sender lookup and message counter check (decodeLookupSender());
+//   * in parallel: authentication and decryption (decodeAuthFromSender());
+//   * serialised, in RX order per sender: the RX message counter update
+//     (authAndUpdateRXMsgCtr()) and then the operators.
+// So anti-replay is exactly as for decodeAndHandleOTSecureOFrame()
+// called on each frame in turn: a repeated or older counter
+// that passes the early check while an earlier frame from the same sender
+// is still in flight is rejected by the (ordered) counter update.
+//
+// The operators and the `other` handler (for frames that are not
+// secure 'O' frames) are never called concurrently,
+// and are called in RX order for any one sender,
+// but frames from different senders may be handled out of RX order.
+// As for decodeAndHandleOTSecureOFrame(), frames rejected by
+// lookup or authentication get the "?RX auth" diagnostic.
+//
+// The sfrx_t receiver instance, getKey and the association table behind sfrx_t
+// are only used from one thread at a time (while holding the pipeline lock),
+// so need not be thread-safe, but must not be used elsewhere while running.
+// The parallel stage uses only the static sfrx_t::decodeAuthFromSender(),
+// which cannot touch the receiver's state,
+// and decrypt, which must be thread-safe (eg stateless with its own workspace,
+// or SimpleSecureFrame32or0BodyRXKeyCache::decrypt with its per-thread cache).
+//
+// The key is fetched with getKey for the first frame after the pipeline
+// has been idle (no frames waiting), then reused for frames queued behind it,
+// and wiped once none are waiting; so a key change is picked up
+// the next time the pipeline catches up with its input.
+//
+// Frames are copied into a fixed pool of slots, so producers never block:
+// if all slots are in use then submit() drops the frame and counts it.
+template<typename sfrx_t,
+         SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &decrypt,
+         OTV0P2BASE::GetPrimary16ByteSecretKey_t &getKey,
+         frameOperator_fn_t &o1,
+         frameOperator_fn_t &o2 = nullFrameOperation,
+         frameDecodeHandler_fn_t &other = decodeAndHandleDummyFrame>
+class SecureOFrameRXPipeline final
+    {
+    public:
+        // Default number of worker threads.
+        static constexpr uint8_t defaultWorkers = 4;
+        // Default number of frames that can be queued or in flight.
+        static constexpr uint16_t defaultCapacity = 256;
+        // Default per-worker scratch space (including the key);
+        // must cover decode_total_scratch_usage_OTAESGCM_3p0
+        // and the workspace of the decrypt function.
+        static constexpr uint16_t defaultScratchBytes = 1024;
+
+        SecureOFrameRXPipeline() { }
+        ~SecureOFrameRXPipeline() { stop(); }
+        SecureOFrameRXPipeline(const SecureOFrameRXPipeline &) = delete;
+        SecureOFrameRXPipeline &operator=(const SecureOFrameRXPipeline &) = delete;
+
+        // Allocate the slots and start the workers.
+        // Returns false if already running or the arguments are not sane.
+        bool start(const uint8_t workers = defaultWorkers,
+                   const uint16_t capacity = defaultCapacity,
+                   const uint16_t scratchBytes = defaultScratchBytes)
+            {
+            std::unique_lock<std::mutex> lk(lock);
+            if(!threads.empty()) { return(false); } // Already running.
+            if((0 == workers) || (0 == capacity) ||
+               (scratchBytes < keyBytes + SimpleSecureFrame32or0BodyRXBase::decode_total_scratch_usage_OTAESGCM_3p0))
+                { return(false); }
+            slots.reset(new Slot[capacity]);
+            freeSlots.clear();
+            for(uint16_t i = capacity; i-- > 0; ) { freeSlots.push_back(&slots[i]); }
+            inbound.clear();
+            lastForSender.clear();
+            inFlight = 0;
+            stopping = false;
+            haveKey = false;
+            for(uint8_t i = 0; i < workers; ++i)
+                { threads.push_back(std::thread(&SecureOFrameRXPipeline::worker, this, scratchBytes)); }
+            return(true);
+            }
+
+        // Finish handling all submitted frames then stop the workers.
+        // Does nothing if not running.
+        void stop()
+            {
+            {
+            std::unique_lock<std::mutex> lk(lock);
+            if(threads.empty()) { return; }
+            stopping = true;
+            }
+            work.notify_all();
+            for(auto &t : threads) { t.join(); }
+            std::unique_lock<std::mutex> lk(lock);
+            threads.clear();
+            }
+
+        // True if the workers are running.
+        bool isRunning() const { std::unique_lock<std::mutex> lk(lock); return(!threads.empty()); }
+
+        // Copy a raw RXed frame in for handling.
+        // msg is as for the frameDecodeHandler_fn_t handlers,
+        // ie the length is in the byte before the frame (msg[-1]).
+        // Never blocks on decoding; safe to call from several producer threads.
+        // Returns false if the frame was dropped, eg because all slots are in use
+        // or the pipeline is not running.
+        bool submit(volatile const uint8_t *const msg)
+            {
+            if(nullptr == msg) { return(false); }
+            const uint8_t msglen = msg[-1];
+            {
+            std::unique_lock<std::mutex> lk(lock);
+            if(threads.empty() || stopping || freeSlots.empty()) { ++dropped; return(false); }
+            Slot *const s = freeSlots.back();
+            freeSlots.pop_back();
+            s->msg[0] = msglen;
+            for(uint16_t i = 0; i < msglen; ++i) { s->msg[1 + i] = msg[i]; }
+            inbound.push_back(s);
+            ++inFlight;
+            ++submitted;
+            }
+            work.notify_one();
+            return(true);
+            }
+
+        // Move all frames currently queued in an RX queue, eg an ISRRXQueue
+        // or an OTRadioLink, into the pipeline, in order.
+        // Every frame examined is removed from q, even if dropped.
+        // Returns the number of frames accepted.
+        template<typename rxq_t>
+        uint8_t submitAll(rxq_t &q)
+            {
+            uint8_t n = 0;
+            for(const volatile uint8_t *pb; nullptr != (pb = q.peekRXMsg()); q.removeRXMsg())
+                { if(submit(pb)) { ++n; } }
+            return(n);
+            }
+
+        // Wait until all frames submitted so far have been handled.
+        void flush()
+            {
+            std::unique_lock<std::mutex> lk(lock);
+            idle.wait(lk, [this]{ return(0 == inFlight); });
+            }
+
+        // Statistics.
+        // Frames accepted by submit().
+        uint32_t getSubmittedCount() const { std::unique_lock<std::mutex> lk(lock); return(submitted); }
+        // Frames dropped by submit().
+        uint32_t getDroppedCount() const { std::unique_lock<std::mutex> lk(lock); return(dropped); }
+        // Secure 'O' frames authenticated and passed to the operators.
+        uint32_t getDecodedCount() const { std::unique_lock<std::mutex> lk(lock); return(decoded); }
+        // Secure 'O' frames rejected by sender lookup, counter check or authentication.
+        uint32_t getRejectedCount() const { std::unique_lock<std::mutex> lk(lock); return(rejected); }
+        // Other frames, passed to the `other` handler (or dropped if too short).
+        uint32_t getOtherCount() const { std::unique_lock<std::mutex> lk(lock); return(others); }
+        // Secure 'O' frames dropped by sfrx_t::mayBeFromAssociatedNode() before any crypto.
+        uint32_t getFilteredCount() const { std::unique_lock<std::mutex> lk(lock); return(filtered); }
+        // Secure 'O' frames dropped by sfrx_t::isRecentDuplicateFrame() before any crypto.
+        uint32_t getDuplicateCount() const { std::unique_lock<std::mutex> lk(lock); return(duplicates); }
+
+    private:
+        static constexpr uint8_t keyBytes = 16;
+
+        // One frame being handled.
+        struct Slot
+            {
+            // Length byte then frame, as in an RX queue.
+            uint8_t msg[1 + 255];
+            uint8_t body[OTDecodeData_T::ptextLenMax];
+            OTDecodeData_T fd;
+            // Full sender ID and message counter from decodeLookupSender().
+            uint8_t senderID[OTV0P2BASE::OpenTRV_Node_ID_Bytes];
+            uint8_t counter[SimpleSecureFrame32or0BodyBase::fullMsgCtrBytes];
+            uint64_t senderKey;
+            // Next frame in flight from the same sender, in RX order.
+            Slot *nextFromSender;
+            // True once authentication has been attempted.
+            bool authDone;
+            bool authOK;
+            // True while an earlier frame from the same sender is in flight.
+            bool blocked;
+            Slot() : fd(msg, body) { }
+            };
+
+        mutable std::mutex lock;
+        // Signalled when there is inbound work or when stopping.
+        std::condition_variable work;
+        // Signalled when inFlight drops to zero.
+        std::condition_variable idle;
+        std::vector<std::thread> threads;
+        std::unique_ptr<Slot[]> slots;
+        std::vector<Slot *> freeSlots;
+        // Frames waiting for a worker, in RX order.
+        std::deque<Slot *> inbound;
+        // Last (most recently RXed) frame in flight per sender.
+        std::unordered_map<uint64_t, Slot *> lastForSender;
+        uint32_t inFlight = 0;
+        bool stopping = false;
+        // Key for the current batch of frames, valid if haveKey.
+        uint8_t batchKey[16];
+        bool haveKey = false;
+
+        uint32_t submitted = 0;
+        uint32_t dropped = 0;
+        uint32_t decoded = 0;
+        uint32_t rejected = 0;
+        uint32_t others = 0;
+        uint32_t filtered = 0;
+        uint32_t duplicates = 0;
+
+        // Return a slot to the free pool; lock must be held.
+        void release(Slot *const s)
+            {
+            freeSlots.push_back(s);
+            if(0 == --inFlight) { idle.notify_all(); }
+            }
+
+        // Update the counter and call the operators for s and any following
+        // frames from the same sender that have already been authenticated.
+        // s must be authenticated and not blocked; lock must be held.
+        void complete(Slot *s)
+            {
+            sfrx_t &sfrx = sfrx_t::getInstance();
+            while((nullptr != s) && s->authDone)
+                {
+                Slot *const next = s->nextFromSender;
+                if(s->authOK && sfrx.authAndUpdateRXMsgCtr(s->senderID, s->counter))
+                    {
+                    // As the final step of decode().
+                    memcpy(s->fd.id, s->senderID, sizeof(s->senderID));
+                    sfrx.noteAuthenticatedFrame(s->fd);
+                    ++decoded;
+                    // Make sure frame is long enough to have useful information in it
+                    // and then call operations.
+                    if(2 < s->fd.ptextLenMax) { o1(s->fd); o2(s->fd); }
+                    }
+                else { ++rejected; printRXAuthFailure(s->fd); }
+                if(nullptr == next) { lastForSender.erase(s->senderKey); }
+                else { next->blocked = false; }
+                release(s);
+                s = next;
+                }
+            }
+
+        void worker(const uint16_t scratchBytes)
+            {
+            std::vector<uint8_t> workspace(scratchBytes);
+            uint8_t *const key = workspace.data();
+            OTV0P2BASE::ScratchSpaceL sW(workspace.data() + keyBytes, scratchBytes - keyBytes);
+            sfrx_t &sfrx = sfrx_t::getInstance();
+            std::unique_lock<std::mutex> lk(lock);
+            for( ; ; )
+                {
+                // Wipe the batch key once nothing is waiting.
+                if(inbound.empty() && haveKey) { memset(batchKey, 0, keyBytes); haveKey = false; }
+                work.wait(lk, [this]{ return(stopping || !inbound.empty()); });
+                if(inbound.empty()) { return; } // Stopping and drained.
+                Slot *const s = inbound.front();
+                inbound.pop_front();
+
+                // Stage 1, serialised in RX order: validate, fetch key, look up sender.
+                const uint8_t msglen = s->msg[0];
+                s->fd.ptextLen = 0;
+                memset(s->fd.id, 0, sizeof(s->fd.id));
+                // Validate structure of header/frame first,
+                // and make sure frame thinks it is a secure OFrame.
+                constexpr uint8_t expectedOFrameFirstByte = 'O' | 0x80;
+                const bool isSecureOFrame = (msglen >= 2) &&
+                                            (0 != s->fd.sfh.decodeHeader(s->msg, msglen + 1)) &&
+                                            (expectedOFrameFirstByte == s->msg[1]) &&
+                                            s->fd.sfh.isSecure();
+                if(!isSecureOFrame)
+                    {
+                    ++others;
+                    // Too short to be useful, so ignore.
+                    if(msglen >= 2) { other(s->msg + 1); }
+                    release(s);
+                    continue;
+                    }
+                // Silently drop frames from nodes that cannot be associated,
+                // before any key fetch or crypto.
+                if(!sfrx.mayBeFromAssociatedNode(s->fd.sfh))
+                    {
+                    ++filtered;
+                    release(s);
+                    continue;
+                    }
+                // Silently drop exact repeats of frames already authenticated.
+                // (A repeat arriving while the original is still in flight
+                // is instead rejected by the ordered counter update.)
+                if(sfrx.isRecentDuplicateFrame(s->fd))
+                    {
+                    ++duplicates;
+                    release(s);
+                    continue;
+                    }
+                if(!haveKey)
+                    {
+                    if(!getKey(batchKey))
+                        {
+                        memset(batchKey, 0, keyBytes);
+                        OTV0P2BASE::serialPrintlnAndFlush(F("!RX key"));
+                        ++rejected;
+                        release(s);
+                        continue;
+                        }
+                    haveKey = true;
+                    }
+                if(!sfrx.decodeLookupSender(s->fd, s->senderID, s->counter))
+                    {
+                    ++rejected;
+                    printRXAuthFailure(s->fd);
+                    release(s);
+                    continue;
+                    }
+                // Queue behind any earlier frame in flight from the same sender.
+                memcpy(&s->senderKey, s->senderID, sizeof(s->senderKey));
+                s->nextFromSender = nullptr;
+                s->authDone = false;
+                s->authOK = false;
+                auto const last = lastForSender.find(s->senderKey);
+                s->blocked = (lastForSender.end() != last);
+                if(s->blocked) { last->second->nextFromSender = s; last->second = s; }
+                else { lastForSender[s->senderKey] = s; }
+
+                // Stage 2, in parallel: authenticate and decrypt.
+                memcpy(key, batchKey, keyBytes);
+                lk.unlock();
+                const bool authOK = (0 != sfrx_t::decodeAuthFromSender(s->fd, decrypt, s->senderID, sW, key));
+                memset(key, 0, keyBytes);
+                lk.lock();
+
+                // Stage 3, serialised in RX order per sender: update counter, call operators.
+                s->authDone = true;
+                s->authOK = authOK;
+                if(!s->blocked) { complete(s); }
+                }
+            }
+    };
+
+    }
+
+#endif // ARDUINO
+
+#endif
@@ -752,6 +752,37 @@ bool fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL(
     return(true);
     }
 
+// Keyed decryption context setup for any stateless decrypt: copies the key into the context.
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(
+        uint8_t *const ctx, const size_t ctxSize,
+        const uint8_t *const key)
+    {
+    if((nullptr == ctx) || (nullptr == key)) { return(false); } // ERROR
+    if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize) { return(false); } // ERROR
+    memcpy(ctx, key, 16);
+    return(true);
+    }
+
+// NULL keyed 'decryption' context setup: copies the key into the context.
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_NULL_IMPL(
+        uint8_t *const ctx, const size_t ctxSize,
+        const uint8_t *const key)
+    { return(fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(ctx, ctxSize, key)); }
+
+// NULL keyed 'decryption': as fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL() using the key in the context.
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL(
+        const uint8_t *const ctx, const size_t ctxSize,
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    return(fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY<fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL>(
+            ctx, ctxSize, workspace, workspaceSize,
+            iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+
 
 // CONVENIENCE/BOILERPLATE METHODS
 
@@ -1048,43 +1079,78 @@ uint8_t SimpleSecureFrame32or0BodyRXBase::decode(
     // Create a new sub scratch space for callee.
     OTV0P2BASE::ScratchSpaceL subScratch(scratch, scratchSpaceNeededHere);
 
+    // Look up the full node ID of the sender in the associations table
+    // and validate the message counter.
+    // Use start of scratch space. This buffer should not be visible
+    // outside the decode stack (e.g. should not be part of fd).
+    uint8_t *const nodeID = scratch.buf;
+    // Append to scratch space, after node id.
+    uint8_t * const messageCounter = scratch.buf + OTV0P2BASE::OpenTRV_Node_ID_Bytes;
+    if(!decodeLookupSender(fd, nodeID, messageCounter)) { return(0); } // ERROR
+
+    // Now attempt to decrypt.
+    const uint8_t decodeResult = decodeAuthFromSender(fd, d, nodeID, subScratch, key);
+    if(0 == decodeResult) { return(0); } // ERROR
+    // Successfully decoded: update the RX message counter to avoid duplicates/replays.
+    if(!authAndUpdateRXMsgCtr(nodeID, messageCounter)) { return(0); } // ERROR
+    // Success: copy sender ID to output buffer (if non-NULL) as last action.
+    memcpy(fd.id, nodeID, OTV0P2BASE::OpenTRV_Node_ID_Bytes);
+    return(decodeResult);
+    }
+
+/**
+ * @brief   First stage of decode(): look up the sender and check the message
+ *          counter, without authenticating or altering any state.
+ *
+ * See the declaration for how the stages fit together.
+ */
+bool SimpleSecureFrame32or0BodyRXBase::decodeLookupSender(
+            const OTDecodeData_T &fd,
+            uint8_t *const senderNodeID,
+            uint8_t *const messageCounter) const
+    {
+    if((nullptr == senderNodeID) || (nullptr == messageCounter)) { return(false); } // ERROR
     // Rely on _decodeSecureSmallFrameFromID() for validation of items
     // not directly needed here.
-    if(nullptr == fd.ctext) { return(0); } // ERROR
+    if(nullptr == fd.ctext) { return(false); } // ERROR
     // Abort if header was not decoded properly.
-    if(fd.sfh.isInvalid()) { return(0); } // ERROR
+    if(fd.sfh.isInvalid()) { return(false); } // ERROR
     // Abort if trailer not large enough to extract message counter from
     // safely (and not expected size/flavour).
-    if(23 != fd.sfh.getTl()) { return(0); } // ERROR
+    if(23 != fd.sfh.getTl()) { return(false); } // ERROR
     // Look up the full node ID of the sender in the associations table.
-    // NOTE: this only tries the first match, ignoring firstIDMatchOnly.
-    // Use start of scratch space. This buffer should not be visible
-    // outside the decode stack (e.g. should not be part of fd).
-    uint8_t *const nodeID = scratch.buf;
-    const OTBuf_t senderNodeID(nodeID, OTV0P2BASE::OpenTRV_Node_ID_Bytes);
-    const int8_t index = _getNextMatchingNodeID(0, &fd.sfh, nodeID);
-    if(index < 0) { return(0); } // ERROR
+    // NOTE: this only tries the first match.
+    const int16_t index = _getNextMatchingNodeID(0, &fd.sfh, senderNodeID);
+    if(index < 0) { return(false); } // ERROR
     // Extract the message counter and validate it
     // (that it is higher than previously seen)...
-    // Append to scratch space, after node id.
-    uint8_t * const messageCounter = scratch.buf + OTV0P2BASE::OpenTRV_Node_ID_Bytes;
     // Assume counter positioning as for 0x80 type trailer,
     // ie 6 bytes at start of trailer.
     // Destination and source known large enough for copy to be safe.
     memcpy(messageCounter,
            fd.ctext + fd.sfh.getTrailerOffset(),
            SimpleSecureFrame32or0BodyBase::fullMsgCtrBytes);
-    if(!validateRXMsgCtr(senderNodeID.getBuf(), messageCounter)) { return(0); } // ERROR
+    return(validateRXMsgCtr(senderNodeID, messageCounter));
+    }
 
-    // Now attempt to decrypt.
+/**
+ * @brief   Second stage of decode(): authenticate and decrypt the frame
+ *          given the sender from decodeLookupSender().
+ *
+ * Does not use or alter the receiver state, so may be called concurrently
+ * for different frames (with separate fd and scratch).
+ */
+uint8_t SimpleSecureFrame32or0BodyRXBase::decodeAuthFromSender(
+            OTDecodeData_T &fd,
+            fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d,
+            const uint8_t *const senderNodeID,
+            OTV0P2BASE::ScratchSpaceL &scratch,
+            const uint8_t *const key)
+    {
+    if(nullptr == senderNodeID) { return(0); } // ERROR
     // Assumed no need to 'adjust' ID for this form of RX.
-    const uint8_t decodeResult = _decodeFromID( fd, d, senderNodeID, subScratch, key);
-    if(0 == decodeResult) { return(0); } // ERROR
-    // Successfully decoded: update the RX message counter to avoid duplicates/replays.
-    if(!authAndUpdateRXMsgCtr(senderNodeID.getBuf(), messageCounter)) { return(0); } // ERROR
-    // Success: copy sender ID to output buffer (if non-NULL) as last action.
-    memcpy(fd.id, senderNodeID.getBuf(), OTV0P2BASE::OpenTRV_Node_ID_Bytes);
-    return(decodeResult);
+    const OTBuf_t adjID(const_cast<uint8_t *>(senderNodeID), OTV0P2BASE::OpenTRV_Node_ID_Bytes);
+    return(_decodeFromID(fd, d, adjID, scratch, key));
     }
 
 }
@@ -803,7 +803,11 @@ namespace OTRadioLink
     class SimpleSecureFrame32or0BodyRXBase : public SimpleSecureFrame32or0BodyBase
         {
         private:
-            virtual int8_t _getNextMatchingNodeID(const uint8_t index, const SecurableFrameHeader *const sfh, uint8_t *nodeID) const = 0;
+            // Get the first associated node ID matching the frame header's ID prefix
+            // at or after the given association table index, copied to nodeID if not NULL.
+            // Returns the index of the match, or -1 if none.
+            // 16-bit so that hosted tables of more than 127 entries can be searched.
+            virtual int16_t _getNextMatchingNodeID(uint16_t index, const SecurableFrameHeader *sfh, uint8_t *nodeID) const = 0;
 
         public:
             // Check one (6-byte) message counter against another for magnitude.
@@ -860,6 +864,30 @@ namespace OTRadioLink
                     const uint8_t *ciphertext, const uint8_t *tag,
                     uint8_t *plaintextOut);
 
+            // Keyed variant of fixed32BTextSize12BNonce16BTagSimpleDec_fn_t,
+            // split so that the per-key work (eg AES key expansion and GHASH table setup)
+            // can be done once and reused across many frames with the same key.
+            // The context (ctx) is opaque to this library
+            // and its size depends on the implementation used.
+            // The setup function fills ctx from the 16-byte key;
+            // it will fail (safely, returning false) if ctx is NULL or too small.
+            // Returns true on success, false on failure.
+            typedef bool (fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t)(
+                    uint8_t *ctx, size_t ctxSize,
+                    const uint8_t *key);
+            // The keyed decrypt function behaves exactly as the matching stateless
+            // fixed32BTextSize12BNonce16BTagSimpleDec_fn_t would with the key
+            // that the context was set up from.
+            // The context is not altered; the workspace is cleared on exit.
+            // Returns true on success, false on failure.
+            typedef bool (fixed32BTextSize12BNonce16BTagSimpleDecKeyed_fn_t)(
+                    const uint8_t *ctx, size_t ctxSize,
+                    uint8_t *workspace, size_t workspaceSize,
+                    const uint8_t *iv,
+                    const uint8_t *authtext, uint8_t authtextSize,
+                    const uint8_t *ciphertext, const uint8_t *tag,
+                    uint8_t *plaintextOut);
+
             /**
              * @brief   Decode entire secure small frame from raw frame bytes and crypto support.
              *
@@ -955,6 +983,24 @@ namespace OTRadioLink
             // Must only be called once the RXed message has passed authentication.
             virtual bool authAndUpdateRXMsgCtr(const uint8_t *ID, const uint8_t *newCounterValue) = 0;
 
+            // Quick check that a frame with this (decoded) header may be from
+            // an associated node, for use straight after decodeHeader()
+            // to drop foreign traffic before any key fetch, lookup or crypto.
+            // Never false for a frame whose header ID prefix matches an association.
+            // By default there is no filter and this is always true.
+            virtual bool mayBeFromAssociatedNode(const SecurableFrameHeader &/*sfh*/) { return(true); }
+
+            // Quick check, before decode(), that this is not an exact repeat
+            // (same header ID prefix and message counter) of a frame
+            // recently authenticated, eg the same frame heard via a second radio or a relay,
+            // so that it can be dropped without authenticating it again.
+            // Such a repeat would be rejected by the RX message counter check anyway.
+            // By default no frames are remembered and this is always false.
+            virtual bool isRecentDuplicateFrame(const OTDecodeData_T &/*fd*/) { return(false); }
+            // Remember a frame for isRecentDuplicateFrame(),
+            // ONLY once it has been authenticated and its RX message counter updated.
+            virtual void noteAuthenticatedFrame(const OTDecodeData_T &/*fd*/) { }
+
         protected:
             /**
              * @brief   Decode a frame from a given ID. NOT A PUBLIC ENTRY POINT!
@@ -1004,7 +1050,7 @@ namespace OTRadioLink
             static constexpr size_t _decodeFromID_total_scratch_usage_OTAESGCM_3p0 =
                 decodeRaw_total_scratch_usage_OTAESGCM_3p0 +
                 _decodeFromID_scratch_usage;
-            uint8_t _decodeFromID(
+            static uint8_t _decodeFromID(
                         OTDecodeData_T &fd,
                         fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d,
                         const OTBuf_t &adjID,
@@ -1062,6 +1108,52 @@ namespace OTRadioLink
                         const uint8_t *key,
                         bool firstIDMatchOnly = true);
 
+            /**
+             * @brief   The stages of decode(), for receivers that authenticate
+             *          several frames concurrently (eg a hosted hub).
+             *
+             * decode() is exactly:
+             * - decodeLookupSender(), which looks up the sender and checks the
+             *   message counter against this receiver's state;
+             * - then decodeAuthFromSender(), which does the (slow) authentication
+             *   and decryption and is static, so cannot touch this receiver's state;
+             * - then authAndUpdateRXMsgCtr() with the sender ID and counter
+             *   from decodeLookupSender(), and copying the sender ID to fd.id.
+             *
+             * Only decodeAuthFromSender() may be run concurrently (with
+             * separate fd and scratch). The lookup and counter update must be
+             * serialised, and for anti-replay the counter updates for any one
+             * sender must be made in the order that its frames were received.
+             *
+             * @param   fd: As for decode(); the header must be decoded.
+             * @param   senderNodeID, OUTPUT: full (8-byte) sender node ID.
+             * @param   messageCounter, OUTPUT: full (6-byte) message counter
+             *              from the frame trailer.
+             * @retval  True if the sender is associated and the message counter
+             *          is higher than the last authenticated one, else false.
+             */
+            bool decodeLookupSender(
+                        const OTDecodeData_T &fd,
+                        uint8_t *senderNodeID,
+                        uint8_t *messageCounter) const;
+            /**
+             * @param   fd: As for decode(); passed to decodeLookupSender() first.
+             * @param   d: Decryption function.
+             * @param   senderNodeID, INPUT: full sender node ID as set by
+             *              decodeLookupSender().
+             * @param   scratch: Scratch space. Size must be large enough to contain
+             *              _decodeFromID_total_scratch_usage_OTAESGCM_3p0 bytes AND
+             *              the scratch space required by the decryption function `d`.
+             * @param   key, INPUT: 16-byte secret key. Never NULL.
+             * @retval  As for decode(); zero if authentication failed.
+             */
+            static uint8_t decodeAuthFromSender(
+                        OTDecodeData_T &fd,
+                        fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d,
+                        const uint8_t *senderNodeID,
+                        OTV0P2BASE::ScratchSpaceL &scratch,
+                        const uint8_t *key);
+
         };
 
 
@@ -1105,6 +1197,277 @@ namespace OTRadioLink
      */
     SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL;
 
+    /**
+     * @brief   NULL keyed 'decryption' context setup and decrypt functions,
+     *          matching fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL().
+     *          DO NOT USE IN PRODUCTION SYSTEMS.
+     *
+     * - The setup copies the key into the context,
+     *   which must be at least fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL_ctxSize bytes.
+     * - The decrypt applies fixed32BTextSize12BNonce16BTagSimpleDec_NULL_IMPL()
+     *   with the key held in the context.
+     */
+    static constexpr size_t fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL_ctxSize = 16;
+    SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_NULL_IMPL;
+    SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL;
+
+    /**
+     * @brief   Keyed decryption context setup and decrypt functions
+     *          wrapping any stateless decrypt function, eg the portable OTAESGCM one,
+     *          where there is no faster keyed implementation (eg on AVR).
+     *
+     * - The setup copies the key into the context,
+     *   which must be at least fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize bytes.
+     * - The decrypt applies dec() with the key held in the context,
+     *   so saves no work per frame but behaves exactly as dec() does.
+     */
+    static constexpr size_t fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize = 16;
+    SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY;
+    template<SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &dec>
+    bool fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY(
+            const uint8_t *const ctx, const size_t ctxSize,
+            uint8_t *const workspace, const size_t workspaceSize,
+            const uint8_t *const iv,
+            const uint8_t *const authtext, const uint8_t authtextSize,
+            const uint8_t *const ciphertext, const uint8_t *const tag,
+            uint8_t *const plaintextOut)
+        {
+        if(nullptr == ctx) { return(false); } // ERROR
+        if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize) { return(false); } // ERROR
+        return(dec(workspace, workspaceSize,
+                ctx, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+        }
+
+    /**
+     * @brief   Caches the expanded key context for one secret key across RX decodes.
+     *
+     * With a stateless decrypt function the AES key schedule (and GHASH setup)
+     * is recomputed for every frame, though the building key almost never changes.
+     * This holds the context for the last key seen and only redoes the setup
+     * when a frame is decrypted with a different key or after invalidate().
+     *
+     * decrypt() has the fixed32BTextSize12BNonce16BTagSimpleDec_fn_t signature,
+     * so it can be supplied anywhere the stateless function can, eg:
+     *     typedef SimpleSecureFrame32or0BodyRXKeyCache<ctxSize, setup, dec> kc_t;
+     *     authAndDecodeOTSecurableFrame<sfrx_t, kc_t::decrypt, getKey>(...);
+     * and the stateless type remains selectable in the same place,
+     * ie as the decrypt function passed to the SimpleSecureFrame32or0BodyRXBase
+     * decode routines, which hold no per-instance crypto state
+     * (and so cost no RAM on V0p2 builds not using a cache).
+     * For a hub that may run on any CPU use the keyed _AESNI_OR forms,
+     * and elsewhere fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY().
+     *
+     * Since the supplied key is compared (in constant time) with the cached one
+     * on each decrypt, a key change via eg the CLI SetSecretKey command is
+     * picked up on the next frame. So that old key material is not left in RAM,
+     * pass keyChanged to SetSecretKey, eg:
+     *     OTV0P2BASE::SetSecretKey setSecretKey(keysCleared, kc_t::keyChanged);
+     * or otherwise call it when the key is set or cleared.
+     *
+     * @param   ctxSize: size of the context needed by the keyed functions.
+     * @param   setup: fills the context from a key.
+     * @param   dec: keyed decrypt using the context.
+     *
+     * @note    Not ISR safe.
+     *          Hosted, each thread has its own instance, so decodes in parallel
+     *          (eg from SecureFrameRXPipeline workers) need no lock;
+     *          keyChanged() from any thread invalidates them all,
+     *          each being wiped at its next use.
+     *          On V0p2 there is one instance; use from the main loop only.
+     */
+    template<size_t ctxSize,
+             SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t &setup,
+             SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_fn_t &dec>
+    class SimpleSecureFrame32or0BodyRXKeyCache final
+        {
+        private:
+            // Key that ctx was set up from; only meaningful when valid.
+            uint8_t cachedKey[16];
+            // Opaque expanded key context.
+            uint8_t ctx[ctxSize];
+            // True iff ctx holds a good setup for cachedKey.
+            bool valid;
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+            // Value of keyGeneration() when ctx was set up.
+            uint32_t generation;
+            // Bumped by keyChanged() to invalidate the instances in all threads.
+            static std::atomic<uint32_t> &keyGeneration()
+                {
+                static std::atomic<uint32_t> g(0);
+                return(g);
+                }
+#endif
+
+            SimpleSecureFrame32or0BodyRXKeyCache() : valid(false)
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+                , generation(0)
+#endif
+                { }
+
+            // Constant-time compare of key against the cached key; true if same.
+            bool sameKey(const uint8_t *key) const
+                {
+                uint8_t diff = 0;
+                for(uint8_t i = 0; i < sizeof(cachedKey); ++i) { diff |= uint8_t(key[i] ^ cachedKey[i]); }
+                return(0 == diff);
+                }
+
+        public:
+            static SimpleSecureFrame32or0BodyRXKeyCache &getInstance()
+                {
+                // Lazily create/initialise singleton on first use, NOT statically.
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+                // One per thread.
+                static thread_local SimpleSecureFrame32or0BodyRXKeyCache instance;
+#else
+                static SimpleSecureFrame32or0BodyRXKeyCache instance;
+#endif
+                return(instance);
+                }
+
+            // Discard and wipe any cached key material.
+            // Call when the secret key is changed or cleared.
+            void invalidate()
+                {
+                valid = false;
+                memset(cachedKey, 0, sizeof(cachedKey));
+                memset(ctx, 0, sizeof(ctx));
+                }
+
+            // True if a key context is currently cached (and usable).
+            bool isValid() const
+                {
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+                if(generation != keyGeneration()) { return(false); }
+#endif
+                return(valid);
+                }
+
+            // Invalidates the singleton, eg as the SetSecretKey keyChanged callback.
+            static void keyChanged()
+                {
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+                ++keyGeneration();
+#endif
+                getInstance().invalidate();
+                }
+
+            // Drop-in replacement for a stateless fixed32BTextSize12BNonce16BTagSimpleDec_fn_t.
+            // Sets up the context if the key is not the one cached, then decrypts.
+            // Returns true on success, false on failure.
+            static bool decrypt(uint8_t *workspace, size_t workspaceSize,
+                                const uint8_t *key, const uint8_t *iv,
+                                const uint8_t *authtext, uint8_t authtextSize,
+                                const uint8_t *ciphertext, const uint8_t *tag,
+                                uint8_t *plaintextOut)
+                {
+                if(NULL == key) { return(false); } // ERROR
+                SimpleSecureFrame32or0BodyRXKeyCache &c = getInstance();
+#ifdef OTV0P2BASE_PLATFORM_HAS_atomic
+                const uint32_t g = keyGeneration();
+                if(g != c.generation) { c.invalidate(); c.generation = g; }
+#endif
+                if(!c.valid || !c.sameKey(key))
+                    {
+                    c.invalidate();
+                    if(!setup(c.ctx, sizeof(c.ctx), key)) { c.invalidate(); return(false); } // ERROR
+                    memcpy(c.cachedKey, key, sizeof(c.cachedKey));
+                    c.valid = true;
+                    }
+                return(dec(c.ctx, sizeof(c.ctx), workspace, workspaceSize,
+                           iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+                }
+        };
+
+
+    /**
+     * @brief   Small fixed-size cache of recently authenticated secure frames,
+     *          keyed on header ID prefix and full message counter.
+     *
+     * Lets exact repeats (eg the same frame heard via two radios or a relay)
+     * be dropped in O(1) before decode(), saving their authentication.
+     *
+     * Direct-mapped: each frame has one slot, picked by a hash of its key,
+     * and displaces whatever was there.
+     * Only add() frames that have been authenticated and have had
+     * their RX message counter updated, so that a forged frame cannot
+     * suppress the genuine one; any repeat not caught here (eg evicted)
+     * is still rejected by the RX message counter check after authentication.
+     *
+     * Only frames with the usual 23-byte (0x80) trailer are cached.
+     *
+     * @param   slots_: Number of frames remembered; a power of two in [1,128].
+     *
+     * @note    Not ISR- or thread- safe.
+     */
+    template<uint8_t slots_ = 16>
+    class RecentSecureFrameCache final
+        {
+        public:
+            static constexpr uint8_t slots = slots_;
+            static_assert((slots_ >= 1) && (slots_ <= 128) && (0 == (slots_ & (slots_ - 1))), "slots_ must be a power of two in [1,128]");
+
+            RecentSecureFrameCache() { clear(); }
+
+            // Forget all frames, eg when associations change; counts are kept.
+            void clear() { memset(entries, 0, sizeof(entries)); }
+
+            // True (a hit) if fd's header ID prefix and message counter match a frame add()ed;
+            // else false (a miss), including for frames that cannot be cached.
+            // The header must have been decoded successfully.
+            bool isDuplicate(const OTDecodeData_T &fd)
+                {
+                Entry e;
+                const bool hit = makeEntry(fd, e) && (0 == memcmp(&e, entries + slotFor(e), sizeof(e)));
+                if(hit) { ++hits; } else { ++misses; }
+                return(hit);
+                }
+
+            // Remember an authenticated frame; ignored if it cannot be cached.
+            void add(const OTDecodeData_T &fd)
+                {
+                Entry e;
+                if(makeEntry(fd, e)) { entries[slotFor(e)] = e; }
+                }
+
+            // Frames found by isDuplicate(), each saving an authentication.
+            uint32_t getHitCount() const { return(hits); }
+            // Frames not found by isDuplicate().
+            uint32_t getMissCount() const { return(misses); }
+            void resetCounts() { hits = 0; misses = 0; }
+
+        private:
+            struct Entry
+                {
+                // ID length from the header; 0 marks an empty slot.
+                uint8_t il;
+                uint8_t id[SecurableFrameHeader::maxIDLength];
+                uint8_t counter[SimpleSecureFrame32or0BodyBase::fullMsgCtrBytes];
+                };
+            Entry entries[slots];
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+
+            // Fill e (including unused ID bytes) from fd; false if not cacheable.
+            static bool makeEntry(const OTDecodeData_T &fd, Entry &e)
+                {
+                if((nullptr == fd.ctext) || fd.sfh.isInvalid() || !fd.sfh.isSecure()) { return(false); }
+                const uint8_t il = fd.sfh.getIl();
+                if((0 == il) || (23 != fd.sfh.getTl())) { return(false); }
+                memset(&e, 0, sizeof(e));
+                e.il = il;
+                memcpy(e.id, fd.sfh.id, il);
+                memcpy(e.counter, fd.ctext + fd.sfh.getTrailerOffset(), sizeof(e.counter));
+                return(true);
+                }
+            // FNV-1a over the entry, reduced to a slot index.
+            static uint8_t slotFor(const Entry &e)
+                {
+                const uint32_t h = OTV0P2BASE::fnv1a32(reinterpret_cast<const uint8_t *>(&e), sizeof(e));
+                return(uint8_t((h ^ (h >> 16)) & (slots - 1)));
+                }
+        };
+
 
     // CONVENIENCE/BOILERPLATE METHODS
 
@@ -1157,10 +1520,10 @@ namespace OTRadioLink
          * @param   nodeID: Buffer to copy mockID too. Must be at least 6 bytes.
          * @retval  always true.
          */
-        virtual int8_t _getNextMatchingNodeID(const uint8_t index, const SecurableFrameHeader *const /* sfh */, uint8_t *nodeID) const override
+        virtual int16_t _getNextMatchingNodeID(const uint16_t index, const SecurableFrameHeader *const /* sfh */, uint8_t *nodeID) const override
         {
             memcpy(nodeID, mockID, 6);
-            return (index);
+            return (int16_t(index));
         }
     public:
         static SimpleSecureFrame32or0BodyRXFixedCounter &getInstance()
@@ -0,0 +1,416 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Hosted (eg gateway) hardware-accelerated AES-128-GCM
+ * for the secure frame fixed-size enc/dec function types,
+ * using the x86-64 AES-NI and PCLMULQDQ instructions where present.
+ *
+ * Hosted only; not for V0p2/AVR.
+ */
+
+#ifndef ARDUINO
+
+#include <string.h>
+
+#include "OTRadioLink_SecureableFrameType_AESNIImpl.h"
+
+// Only x86-64 with GCC-compatible compilers has the instructions
+// (enabled per function below, so the rest of the library
+// still runs on CPUs without them).
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define OTRADIOLINK_AESNI_X86_64
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+
+namespace OTRadioLink
+    {
+
+bool isAvailableAESNI()
+    {
+#ifdef OTRADIOLINK_AESNI_X86_64
+    static const bool available = []()
+        {
+        unsigned int a, b, c, d;
+        if(!__get_cpuid(1, &a, &b, &c, &d)) { return(false); }
+        return((0 != (c & bit_AES)) && (0 != (c & bit_PCLMUL)) && (0 != (c & bit_SSSE3)));
+        }();
+    return(available);
+#else
+    return(false);
+#endif
+    }
+
+#ifdef OTRADIOLINK_AESNI_X86_64
+namespace
+    {
+
+#define OTAESNI_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+OTAESNI_TARGET inline __m128i loadBlock(const uint8_t *const p)
+    { return(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))); }
+OTAESNI_TARGET inline void storeBlock(uint8_t *const p, const __m128i b)
+    { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), b); }
+
+// Reverses the byte order of a block,
+// to/from the bit-reflected form used by gfmul().
+OTAESNI_TARGET inline __m128i byteSwap(const __m128i b)
+    { return(_mm_shuffle_epi8(b, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15))); }
+
+// One step of the AES-128 key schedule, given the previous round key
+// and the aeskeygenassist of it with the round constant.
+OTAESNI_TARGET inline __m128i expandStep(__m128i k, __m128i gen)
+    {
+    gen = _mm_shuffle_epi32(gen, 0xff);
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    return(_mm_xor_si128(k, gen));
+    }
+
+// Expands the 16-byte key into the 11 round keys (176 bytes) at rk.
+OTAESNI_TARGET void expandKey(const uint8_t *const key, uint8_t *const rk)
+    {
+    __m128i k = loadBlock(key);
+    storeBlock(rk, k);
+    // The round constant must be an immediate.
+#define OTAESNI_EXPAND(i, rcon) \
+    k = expandStep(k, _mm_aeskeygenassist_si128(k, rcon)); storeBlock(rk + 16*(i), k)
+    OTAESNI_EXPAND(1, 0x01);
+    OTAESNI_EXPAND(2, 0x02);
+    OTAESNI_EXPAND(3, 0x04);
+    OTAESNI_EXPAND(4, 0x08);
+    OTAESNI_EXPAND(5, 0x10);
+    OTAESNI_EXPAND(6, 0x20);
+    OTAESNI_EXPAND(7, 0x40);
+    OTAESNI_EXPAND(8, 0x80);
+    OTAESNI_EXPAND(9, 0x1b);
+    OTAESNI_EXPAND(10, 0x36);
+#undef OTAESNI_EXPAND
+    }
+
+// Encrypts n independent blocks in place, interleaved to hide AESENC latency.
+// The stateless operations need four: the GHASH key, the tag mask and two keystream blocks;
+// with a keyed context the GHASH key is already to hand.
+template<int n>
+OTAESNI_TARGET inline void encryptBlocks(const uint8_t *const rk, __m128i (&b)[n])
+    {
+    __m128i k = loadBlock(rk);
+    for(int i = 0; i < n; ++i) { b[i] = _mm_xor_si128(b[i], k); }
+    for(int r = 1; r < 10; ++r)
+        {
+        k = loadBlock(rk + 16*r);
+        for(int i = 0; i < n; ++i) { b[i] = _mm_aesenc_si128(b[i], k); }
+        }
+    k = loadBlock(rk + 160);
+    for(int i = 0; i < n; ++i) { b[i] = _mm_aesenclast_si128(b[i], k); }
+    }
+
+// Counter block n: the 12-byte IV then a 32-bit big-endian count.
+OTAESNI_TARGET inline __m128i counterBlock(const uint8_t *const iv, const uint8_t n)
+    {
+    uint8_t j[16];
+    memcpy(j, iv, 12);
+    j[12] = 0; j[13] = 0; j[14] = 0;
+    j[15] = n;
+    return(loadBlock(j));
+    }
+
+// Accumulates the unreduced carry-less product of a and b into lo, mid and hi,
+// so that several products can share one reduce().
+OTAESNI_TARGET inline void clmulAcc(const __m128i a, const __m128i b,
+        __m128i &lo, __m128i &mid, __m128i &hi)
+    {
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    mid = _mm_xor_si128(mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    }
+
+// Completes a (sum of) clmulAcc() product(s) as an element of GF(2^128)
+// in byte-swapped form, by shift and reduction modulo x^128+x^7+x^2+x+1
+// (after Gueron and Kounavis, Intel white paper 323640).
+// Both steps are linear, so a sum of products needs only one reduction.
+OTAESNI_TARGET __m128i reduce(__m128i lo, const __m128i mid, __m128i hi)
+    {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    // Shift the 256-bit product left one bit for the reflected bit order.
+    const __m128i loCarry = _mm_srli_epi32(lo, 31);
+    const __m128i hiCarry = _mm_srli_epi32(hi, 31);
+    lo = _mm_or_si128(_mm_slli_epi32(lo, 1), _mm_slli_si128(loCarry, 4));
+    hi = _mm_or_si128(_mm_slli_epi32(hi, 1), _mm_slli_si128(hiCarry, 4));
+    hi = _mm_or_si128(hi, _mm_srli_si128(loCarry, 12));
+    // Reduce.
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    const __m128i tHi = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    t = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    t = _mm_xor_si128(t, tHi);
+    lo = _mm_xor_si128(lo, t);
+    return(_mm_xor_si128(hi, lo));
+    }
+
+// Multiplication in GF(2^128) of byte-swapped blocks, as GHASH needs.
+OTAESNI_TARGET __m128i gfmul(const __m128i a, const __m128i b)
+    {
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    clmulAcc(a, b, lo, mid, hi);
+    return(reduce(lo, mid, hi));
+    }
+
+// Most blocks GHASHed: up to 255 bytes of authtext, the text and the lengths.
+constexpr uint8_t maxGHASHBlocks = 16 + 2 + 1;
+// Powers of the GHASH key held in a keyed context.
+constexpr uint8_t nHPowers = 4;
+// Keyed context: the 11 round keys then H^1..H^nHPowers, byte-swapped.
+constexpr size_t ctxHPowersOffset = 176;
+static_assert(ctxHPowersOffset + 16*nHPowers == fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize, "context size");
+
+// Computes the GCM tag over the authtext and the 32-byte ciphertext
+// (or no text if ciphertext is NULL), given the encrypted initial counter block
+// and hPow[i], the byte-swapped GHASH key H to the power i+1, for i < nPow.
+// Folds in up to nPow blocks per reduction, as
+//     X = (X + B[j]).H^k + B[j+1].H^(k-1) + ... + B[j+k-1].H
+// so that the multiplies are independent.
+OTAESNI_TARGET __m128i computeTag(const __m128i *const hPow, const uint8_t nPow, const __m128i ej0,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext)
+    {
+    __m128i b[maxGHASHBlocks];
+    uint8_t n = 0;
+    size_t i = 0;
+    for( ; i + 16 <= authtextSize; i += 16) { b[n++] = byteSwap(loadBlock(authtext + i)); }
+    if(i < authtextSize)
+        {
+        // Final partial block is zero-padded.
+        uint8_t last[16] = { };
+        memcpy(last, authtext + i, authtextSize - i);
+        b[n++] = byteSwap(loadBlock(last));
+        }
+    if(nullptr != ciphertext)
+        {
+        b[n++] = byteSwap(loadBlock(ciphertext));
+        b[n++] = byteSwap(loadBlock(ciphertext + 16));
+        }
+    // Bit lengths of authtext and text, already in byte-swapped form.
+    b[n++] = _mm_set_epi64x(int64_t(authtextSize) * 8, (nullptr != ciphertext) ? 256 : 0);
+    __m128i x = _mm_setzero_si128();
+    for(uint8_t j = 0; j < n; )
+        {
+        const uint8_t k = ((n - j) < nPow) ? uint8_t(n - j) : nPow;
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        clmulAcc(_mm_xor_si128(x, b[j]), hPow[k - 1], lo, mid, hi);
+        for(uint8_t m = 1; m < k; ++m) { clmulAcc(b[j + m], hPow[k - 1 - m], lo, mid, hi); }
+        x = reduce(lo, mid, hi);
+        j = uint8_t(j + k);
+        }
+    return(_mm_xor_si128(byteSwap(x), ej0));
+    }
+
+// Expands the key into the workspace and computes
+// the byte-swapped GHASH key, the encrypted initial counter block
+// and the keystream for the two text blocks.
+OTAESNI_TARGET void setUp(uint8_t *const workspace,
+        const uint8_t *const key, const uint8_t *const iv,
+        __m128i &hr, __m128i &ej0, __m128i &ks0, __m128i &ks1)
+    {
+    expandKey(key, workspace);
+    // Counter blocks count from 1.
+    __m128i b[4] = { _mm_setzero_si128(), counterBlock(iv, 1), counterBlock(iv, 2), counterBlock(iv, 3) };
+    encryptBlocks(workspace, b);
+    hr = byteSwap(b[0]);
+    ej0 = b[1];
+    ks0 = b[2];
+    ks1 = b[3];
+    }
+
+// Checks the tag t against tag, then if good decrypts any ciphertext with the keystream.
+OTAESNI_TARGET bool checkTagAndDecrypt(const __m128i t, const uint8_t *const tag,
+        const uint8_t *const ciphertext, const __m128i ks0, const __m128i ks1,
+        uint8_t *const plaintextOut)
+    {
+    // Compare all of the tag before deciding, to avoid a timing side-channel.
+    if(0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(t, loadBlock(tag)))) { return(false); } // FAIL
+    if(nullptr != ciphertext)
+        {
+        storeBlock(plaintextOut, _mm_xor_si128(loadBlock(ciphertext), ks0));
+        storeBlock(plaintextOut + 16, _mm_xor_si128(loadBlock(ciphertext + 16), ks1));
+        }
+    return(true);
+    }
+
+OTAESNI_TARGET bool encAESNI(uint8_t *const workspace,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    __m128i hr, ej0, ks0, ks1;
+    setUp(workspace, key, iv, hr, ej0, ks0, ks1);
+    if(nullptr != plaintext)
+        {
+        storeBlock(ciphertextOut, _mm_xor_si128(loadBlock(plaintext), ks0));
+        storeBlock(ciphertextOut + 16, _mm_xor_si128(loadBlock(plaintext + 16), ks1));
+        }
+    storeBlock(tagOut, computeTag(&hr, 1, ej0, authtext, authtextSize,
+                                  (nullptr != plaintext) ? ciphertextOut : nullptr));
+    memset(workspace, 0, workspaceRequired_GCM32B16B_AESNI);
+    return(true);
+    }
+
+OTAESNI_TARGET bool decAESNI(uint8_t *const workspace,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    __m128i hr, ej0, ks0, ks1;
+    setUp(workspace, key, iv, hr, ej0, ks0, ks1);
+    memset(workspace, 0, workspaceRequired_GCM32B16B_AESNI);
+    const __m128i t = computeTag(&hr, 1, ej0, authtext, authtextSize, ciphertext);
+    return(checkTagAndDecrypt(t, tag, ciphertext, ks0, ks1, plaintextOut));
+    }
+
+// Expands the key and computes the powers of the GHASH key into ctx.
+OTAESNI_TARGET void keySetupAESNI(uint8_t *const ctx, const uint8_t *const key)
+    {
+    expandKey(key, ctx);
+    __m128i h[1] = { _mm_setzero_si128() };
+    encryptBlocks(ctx, h);
+    const __m128i hr = byteSwap(h[0]);
+    __m128i p = hr;
+    storeBlock(ctx + ctxHPowersOffset, p);
+    for(uint8_t i = 1; i < nHPowers; ++i)
+        {
+        p = gfmul(p, hr);
+        storeBlock(ctx + ctxHPowersOffset + 16*i, p);
+        }
+    }
+
+OTAESNI_TARGET bool decKeyedAESNI(const uint8_t *const ctx,
+        const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    __m128i b[3] = { counterBlock(iv, 1), counterBlock(iv, 2), counterBlock(iv, 3) };
+    encryptBlocks(ctx, b);
+    __m128i hPow[nHPowers];
+    for(uint8_t i = 0; i < nHPowers; ++i) { hPow[i] = loadBlock(ctx + ctxHPowersOffset + 16*i); }
+    const __m128i t = computeTag(hPow, nHPowers, b[0], authtext, authtextSize, ciphertext);
+    return(checkTagAndDecrypt(t, tag, ciphertext, b[1], b[2], plaintextOut));
+    }
+
+#undef OTAESNI_TARGET
+
+    }
+#endif // OTRADIOLINK_AESNI_X86_64
+
+bool fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((nullptr == workspace) || (nullptr == key) || (nullptr == iv) || (nullptr == tagOut)) { return(false); } // ERROR
+    if(workspaceSize < workspaceRequired_GCM32B16B_AESNI) { return(false); } // ERROR
+    if((nullptr == authtext) && (0 != authtextSize)) { return(false); } // ERROR
+    if((nullptr != plaintext) && (nullptr == ciphertextOut)) { return(false); } // ERROR
+    if(!isAvailableAESNI()) { return(false); } // ERROR
+#ifdef OTRADIOLINK_AESNI_X86_64
+    return(encAESNI(workspace, key, iv, authtext, authtextSize, plaintext, ciphertextOut, tagOut));
+#else
+    return(false);
+#endif
+    }
+
+bool fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((nullptr == workspace) || (nullptr == key) || (nullptr == iv) || (nullptr == tag)) { return(false); } // ERROR
+    if(workspaceSize < workspaceRequired_GCM32B16B_AESNI) { return(false); } // ERROR
+    if((nullptr == authtext) && (0 != authtextSize)) { return(false); } // ERROR
+    if((nullptr != ciphertext) && (nullptr == plaintextOut)) { return(false); } // ERROR
+    if(!isAvailableAESNI()) { return(false); } // ERROR
+#ifdef OTRADIOLINK_AESNI_X86_64
+    return(decAESNI(workspace, key, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+#else
+    return(false);
+#endif
+    }
+
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(
+        uint8_t *const ctx, const size_t ctxSize,
+        const uint8_t *const key)
+    {
+    if((nullptr == ctx) || (nullptr == key)) { return(false); } // ERROR
+    if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize) { return(false); } // ERROR
+    if(!isAvailableAESNI()) { return(false); } // ERROR
+#ifdef OTRADIOLINK_AESNI_X86_64
+    keySetupAESNI(ctx, key);
+    return(true);
+#else
+    return(false);
+#endif
+    }
+
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(
+        const uint8_t *const ctx, const size_t ctxSize,
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if(nullptr == ctx) { return(false); } // ERROR
+    if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize) { return(false); } // ERROR
+    // Checked as for the stateless form so that the two are interchangeable.
+    if((nullptr == workspace) || (nullptr == iv) || (nullptr == tag)) { return(false); } // ERROR
+    if(workspaceSize < workspaceRequired_GCM32B16B_AESNI) { return(false); } // ERROR
+    if((nullptr == authtext) && (0 != authtextSize)) { return(false); } // ERROR
+    if((nullptr != ciphertext) && (nullptr == plaintextOut)) { return(false); } // ERROR
+    if(!isAvailableAESNI()) { return(false); } // ERROR
+#ifdef OTRADIOLINK_AESNI_X86_64
+    return(decKeyedAESNI(ctx, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+#else
+    return(false);
+#endif
+    }
+
+
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR(
+        uint8_t *const ctx, const size_t ctxSize,
+        const uint8_t *const key)
+    {
+    if(isAvailableAESNI())
+        { return(fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(ctx, ctxSize, key)); }
+    // Same size check whichever is used.
+    if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize) { return(false); } // ERROR
+    return(fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(ctx, ctxSize, key));
+    }
+
+    }
+
+#endif // ARDUINO
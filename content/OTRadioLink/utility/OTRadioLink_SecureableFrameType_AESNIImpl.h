@@ -0,0 +1,169 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Hosted (eg gateway) hardware-accelerated AES-128-GCM
+ * for the secure frame fixed-size enc/dec function types,
+ * using the x86-64 AES-NI and PCLMULQDQ instructions where present.
+ *
+ * Hosted only; not for V0p2/AVR.
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_SECUREABLEFRAMETYPE_AESNIIMPL_H
+#define ARDUINO_LIB_OTRADIOLINK_SECUREABLEFRAMETYPE_AESNIIMPL_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "OTRadioLink_SecureableFrameType.h"
+
+
+namespace OTRadioLink
+    {
+
+// True if this CPU can run the AES-NI implementations below,
+// ie is x86-64 with AES-NI, PCLMULQDQ and SSSE3.
+// Checked once with CPUID, then cached.
+// Always false where this library is built for any other architecture.
+bool isAvailableAESNI();
+
+// Workspace needed by the AES-NI implementations below,
+// which holds the expanded key schedule.
+// Less than OTAESGCM needs, so a workspace sized for OTAESGCM
+// (eg via encodeRaw_total_scratch_usage_OTAESGCM_2p0) is always enough.
+static constexpr size_t workspaceRequired_GCM32B16B_AESNI = 176;
+
+// AES-128-GCM fixed-size encryption and decryption
+// using AES-NI and PCLMULQDQ,
+// with the same behaviour as the portable OTAESGCM
+// fixed32BTextSize12BNonce16BTagSimpleEnc/Dec implementations.
+//   * workspace must be non-NULL and at least
+//     workspaceRequired_GCM32B16B_AESNI bytes,
+//     and is zeroed again before return.
+//   * A NULL plaintext (or ciphertext) means a zero-length text,
+//     ie only the authtext is authenticated.
+//   * On decryption the plaintext is only written if the tag is good.
+// Fail (return false) if !isAvailableAESNI(),
+// so normally use the fallback forms below.
+SimpleSecureFrame32or0BodyTXBase::fixed32BTextSize12BNonce16BTagSimpleEnc_fn_t fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI;
+SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t fixed32BTextSize12BNonce16BTagSimpleDec_AESNI;
+
+// Keyed AES-128-GCM fixed-size decryption using AES-NI and PCLMULQDQ,
+// eg for SimpleSecureFrame32or0BodyRXKeyCache, eg:
+//     typedef SimpleSecureFrame32or0BodyRXKeyCache<
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize,
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI,
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI> kc_t;
+//   * The setup expands the round keys and computes the GHASH key H
+//     and its powers H^2..H^4 into ctx,
+//     which must be at least fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize bytes,
+//     so that each frame needs only its three counter blocks encrypted
+//     and its GHASH multiplies done four blocks per reduction.
+//   * The decrypt gives the same results as fixed32BTextSize12BNonce16BTagSimpleDec_AESNI()
+//     with the key that ctx was set up from,
+//     and checks its workspace the same way, though does not use it.
+// Both fail (return false) if !isAvailableAESNI(),
+// so normally use the fallback forms below.
+static constexpr size_t fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize = 176 + 4*16;
+SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI;
+SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI;
+
+// As fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI() where the CPU supports it,
+// else the supplied (portable) implementation, chosen at run time, eg:
+//     encodeRaw(fd, id, il, iv,
+//         fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE>,
+//         scratch, key);
+// Size the workspace for the fallback,
+// so that behaviour does not depend on the CPU.
+template<SimpleSecureFrame32or0BodyTXBase::fixed32BTextSize12BNonce16BTagSimpleEnc_fn_t &fallback>
+bool fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI_OR(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if(isAvailableAESNI())
+        {
+        return(fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(workspace, workspaceSize,
+            key, iv, authtext, authtextSize, plaintext, ciphertextOut, tagOut));
+        }
+    return(fallback(workspace, workspaceSize,
+        key, iv, authtext, authtextSize, plaintext, ciphertextOut, tagOut));
+    }
+
+// As fixed32BTextSize12BNonce16BTagSimpleDec_AESNI() where the CPU supports it,
+// else the supplied (portable) implementation, chosen at run time.
+// Size the workspace for the fallback,
+// so that behaviour does not depend on the CPU.
+template<SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &fallback>
+bool fixed32BTextSize12BNonce16BTagSimpleDec_AESNI_OR(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if(isAvailableAESNI())
+        {
+        return(fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(workspace, workspaceSize,
+            key, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+        }
+    return(fallback(workspace, workspaceSize,
+        key, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+
+// Keyed forms of fixed32BTextSize12BNonce16BTagSimpleDec_AESNI_OR(),
+// using the keyed AES-NI implementation where the CPU supports it,
+// else the supplied (portable) stateless implementation
+// with the raw key held in ctx (see fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY()), eg:
+//     typedef SimpleSecureFrame32or0BodyRXKeyCache<
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize,
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR,
+//         fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE> > kc_t;
+// so that a hub works (if more slowly) on any CPU.
+// Size ctx for AES-NI (fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize)
+// and the workspace for the fallback,
+// so that behaviour does not depend on the CPU.
+SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_fn_t fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR;
+template<SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &fallback>
+bool fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_OR(
+        const uint8_t *const ctx, const size_t ctxSize,
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if(isAvailableAESNI())
+        {
+        return(fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(ctx, ctxSize, workspace, workspaceSize,
+            iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+        }
+    if(ctxSize < fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize) { return(false); } // ERROR
+    return(fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY<fallback>(ctx, ctxSize, workspace, workspaceSize,
+        iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+
+    }
+
+#endif // ARDUINO
+
+#endif
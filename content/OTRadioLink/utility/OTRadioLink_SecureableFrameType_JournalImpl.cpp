@@ -0,0 +1,419 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2015--2018
+*/
+
+/*
+ * Hosted (eg gateway) implementation of secure frame RX code,
+ * using a write-behind journal file for non-volatile storage of
+ * RX message counters.
+ *
+ * Hosted (POSIX) only; not for V0p2/AVR.
+ */
+
+#ifndef ARDUINO
+
+#include <fcntl.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "OTRadioLink_SecureableFrameType_JournalImpl.h"
+
+#include "OTV0P2BASE_CRC.h"
+
+namespace OTRadioLink
+    {
+
+constexpr RXMsgCtrJournal::Config RXMsgCtrJournal::defaultConfig;
+
+// Journal file magic, followed in the header by the clean-shutdown flag.
+static const uint8_t journalMagic[8] = { 'O', 'T', 'R', 'X', 'C', 'J', '0', '1' };
+static constexpr size_t journalCleanFlagOffset = sizeof(journalMagic);
+// Record types.
+static constexpr uint8_t recordTypeCounter = 'C';
+static constexpr uint8_t recordTypeReservation = 'R';
+
+// Monotonic time in milliseconds (wraps).
+static uint32_t nowMs()
+    {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(uint32_t(ts.tv_sec * 1000U + ts.tv_nsec / 1000000U));
+    }
+
+// Compute the (never zero) CRC over the first 15 bytes of a record.
+static uint8_t recordCRC(const uint8_t *const r)
+    {
+    uint8_t crc = 0;
+    for(uint8_t i = 0; i < RXMsgCtrJournal::recordBytes - 2; ++i) { crc = OTV0P2BASE::crc7_5B_update(crc, r[i]); }
+    return(OTV0P2BASE::crc7_5B_update_nz_final(crc, r[RXMsgCtrJournal::recordBytes - 2]));
+    }
+
+// Fill a record.
+static void encodeRecord(uint8_t *const r, const uint8_t type, const uint8_t *const id, const uint8_t *const ctr)
+    {
+    r[0] = type;
+    memcpy(r + 1, id, RXMsgCtrJournal::idBytes);
+    memcpy(r + 1 + RXMsgCtrJournal::idBytes, ctr, RXMsgCtrJournal::ctrBytes);
+    r[RXMsgCtrJournal::recordBytes - 1] = recordCRC(r);
+    }
+
+// True if the record looks complete and uncorrupted.
+static bool validRecord(const uint8_t *const r)
+    {
+    if((recordTypeCounter != r[0]) && (recordTypeReservation != r[0])) { return(false); }
+    return(r[RXMsgCtrJournal::recordBytes - 1] == recordCRC(r));
+    }
+
+// Fsync the directory containing path, so that a rename within it is durable.
+static bool syncDirOf(const char *const path)
+    {
+    const char *const slash = strrchr(path, '/');
+    int dfd;
+    if(NULL == slash) { dfd = ::open(".", O_RDONLY); }
+    else
+        {
+        const size_t len = (slash == path) ? 1 : size_t(slash - path);
+        char *const dir = new (std::nothrow) char[len + 1];
+        if(NULL == dir) { return(false); } // FAIL
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        dfd = ::open(dir, O_RDONLY);
+        delete[] dir;
+        }
+    if(dfd < 0) { return(false); } // FAIL
+    const bool ok = (0 == fsync(dfd));
+    ::close(dfd);
+    return(ok);
+    }
+
+// Journal file size for the given configuration.
+static size_t journalFileBytes(const RXMsgCtrJournal::Config &c)
+    { return(RXMsgCtrJournal::headerBytes + size_t(c.journalRecords) * RXMsgCtrJournal::recordBytes); }
+
+bool RXMsgCtrJournal::open(const char *const _path, const Config &config)
+    {
+    if(isOpen()) { return(false); } // FAIL: already open.
+    if(NULL == _path) { return(false); } // FAIL
+    if((0 == config.maxNodes) || (config.maxNodes > 0x40000000U) ||
+       (config.journalRecords < 2 * config.maxNodes + 2) ||
+       (0 == config.batchSize)) { return(false); } // FAIL: bad config.
+    cfg = config;
+
+    // Allocate the node table: a power of two at least twice maxNodes.
+    tableSize = 1;
+    while(tableSize < 2 * cfg.maxNodes) { tableSize <<= 1; }
+    table = new (std::nothrow) Entry[tableSize]();
+    const size_t pathLen = strlen(_path);
+    path = new (std::nothrow) char[pathLen + 1];
+    if((NULL == table) || (NULL == path)) { freeAll(); return(false); } // FAIL
+    memcpy(path, _path, pathLen + 1);
+    nodeCount = 0;
+    unsynced = 0;
+    syncs = 0;
+    compactions = 0;
+
+    fd = ::open(path, O_RDWR | O_CREAT, 0600);
+    if(fd < 0) { freeAll(); return(false); } // FAIL
+    struct stat st;
+    if(0 != fstat(fd, &st)) { _abandon(); return(false); } // FAIL
+    size_t bytes = size_t(st.st_size);
+    if(0 == bytes)
+        {
+        // New journal: preallocate (to avoid faults on a full disc later) and write the header.
+        bytes = journalFileBytes(cfg);
+        if(0 != posix_fallocate(fd, 0, off_t(bytes))) { _abandon(); return(false); } // FAIL
+        if(!mapFile(bytes)) { _abandon(); return(false); } // FAIL
+        memcpy(map, journalMagic, sizeof(journalMagic));
+        map[journalCleanFlagOffset] = 1;
+        if(0 != msync(map, headerBytes, MS_SYNC)) { _abandon(); return(false); } // FAIL
+        }
+    else
+        {
+        // Don't clobber something that is not a journal.
+        if(bytes < headerBytes) { _abandon(); return(false); } // FAIL
+        if(!mapFile(bytes)) { _abandon(); return(false); } // FAIL
+        if(0 != memcmp(map, journalMagic, sizeof(journalMagic))) { _abandon(); return(false); } // FAIL
+        }
+
+    // Recover counters.
+    cleanOnOpen = (0 != map[journalCleanFlagOffset]);
+    if(!replay()) { _abandon(); return(false); } // FAIL
+    // Mark as in use (not cleanly closed) before accepting any updates.
+    if(!setClean(false)) { _abandon(); return(false); } // FAIL
+    syncedOffset = writeOffset;
+    // Resize (and tidy) the journal if the configuration has changed.
+    if((bytes != journalFileBytes(cfg)) && !compact()) { _abandon(); return(false); } // FAIL
+    return(true);
+    }
+
+bool RXMsgCtrJournal::close()
+    {
+    if(!isOpen()) { return(true); }
+    const bool ok = sync() && setClean(true);
+    unmapFile();
+    ::close(fd);
+    fd = -1;
+    freeAll();
+    return(ok);
+    }
+
+void RXMsgCtrJournal::_abandon()
+    {
+    unmapFile();
+    if(fd >= 0) { ::close(fd); }
+    fd = -1;
+    freeAll();
+    }
+
+void RXMsgCtrJournal::freeAll()
+    {
+    delete[] table;
+    table = nullptr;
+    tableSize = 0;
+    nodeCount = 0;
+    delete[] path;
+    path = nullptr;
+    }
+
+bool RXMsgCtrJournal::mapFile(const size_t bytes)
+    {
+    if(failNextMap) { failNextMap = false; return(false); } // FAIL: for testing.
+    void *const m = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(MAP_FAILED == m) { return(false); } // FAIL
+    map = static_cast<uint8_t *>(m);
+    mapBytes = bytes;
+    return(true);
+    }
+
+void RXMsgCtrJournal::unmapFile()
+    {
+    if(nullptr != map) { munmap(map, mapBytes); }
+    map = nullptr;
+    mapBytes = 0;
+    }
+
+RXMsgCtrJournal::Entry *RXMsgCtrJournal::find(const uint8_t *const id) const
+    {
+    // FNV-1a over the ID, then linear probing.
+    const uint32_t h = OTV0P2BASE::fnv1a32(id, idBytes);
+    const uint32_t mask = tableSize - 1;
+    for(uint32_t i = h & mask; ; i = (i + 1) & mask)
+        {
+        Entry *const e = table + i;
+        if(!e->used || (0 == memcmp(e->id, id, idBytes))) { return(e); }
+        }
+    }
+
+RXMsgCtrJournal::Entry *RXMsgCtrJournal::findOrAdd(const uint8_t *const id)
+    {
+    Entry *const e = find(id);
+    if(e->used) { return(e); }
+    if(nodeCount >= cfg.maxNodes) { return(nullptr); } // FAIL: full.
+    // New entry has zero counter and reservation.
+    memcpy(e->id, id, idBytes);
+    e->used = true;
+    ++nodeCount;
+    return(e);
+    }
+
+bool RXMsgCtrJournal::replay()
+    {
+    for(writeOffset = headerBytes; writeOffset + recordBytes <= mapBytes; writeOffset += recordBytes)
+        {
+        const uint8_t *const r = map + writeOffset;
+        // Stop at the end of the journal or at a torn/corrupt record.
+        if(!validRecord(r)) { break; }
+        Entry *const e = findOrAdd(r + 1);
+        if(nullptr == e) { return(false); } // FAIL: more nodes than configured for.
+        const uint8_t *const ctr = r + 1 + idBytes;
+        uint8_t *const dest = (recordTypeCounter == r[0]) ? e->ctr : e->reserved;
+        if(SimpleSecureFrame32or0BodyRXBase::msgcountercmp(ctr, dest) > 0) { memcpy(dest, ctr, ctrBytes); }
+        }
+    // Clear (durably) anything after the end of the valid records,
+    // eg left by a torn write, so that it cannot be picked up after later appends.
+    bool dirtyTail = false;
+    for(size_t i = writeOffset; i < mapBytes; ++i) { if(0 != map[i]) { dirtyTail = true; break; } }
+    if(dirtyTail)
+        {
+        memset(map + writeOffset, 0, mapBytes - writeOffset);
+        const size_t page = size_t(sysconf(_SC_PAGESIZE));
+        const size_t start = (writeOffset / page) * page;
+        if(0 != msync(map + start, mapBytes - start, MS_SYNC)) { return(false); } // FAIL
+        }
+    // After a crash, any update since the last sync may have been lost,
+    // but none can have exceeded the (synced) reservation.
+    if(!cleanOnOpen)
+        {
+        for(uint32_t i = 0; i < tableSize; ++i)
+            {
+            Entry *const e = table + i;
+            if(e->used && (SimpleSecureFrame32or0BodyRXBase::msgcountercmp(e->reserved, e->ctr) > 0))
+                { memcpy(e->ctr, e->reserved, ctrBytes); }
+            }
+        }
+    return(true);
+    }
+
+bool RXMsgCtrJournal::setClean(const bool clean)
+    {
+    map[journalCleanFlagOffset] = clean ? 1 : 0;
+    return(0 == msync(map, headerBytes, MS_SYNC));
+    }
+
+bool RXMsgCtrJournal::syncTo(const size_t offset)
+    {
+    if(offset > syncedOffset)
+        {
+        // msync() needs a page-aligned start.
+        const size_t page = size_t(sysconf(_SC_PAGESIZE));
+        const size_t start = (syncedOffset / page) * page;
+        if(0 != msync(map + start, offset - start, MS_SYNC)) { return(false); } // FAIL
+        ++syncs;
+        }
+    syncedOffset = offset;
+    unsynced = 0;
+    return(true);
+    }
+
+bool RXMsgCtrJournal::sync()
+    {
+    if(!isOpen()) { return(false); } // FAIL
+    return(syncTo(writeOffset));
+    }
+
+bool RXMsgCtrJournal::poll()
+    {
+    if(!isOpen()) { return(false); } // FAIL
+    if((0 != unsynced) && (uint32_t(nowMs() - firstUnsyncedMs) >= cfg.maxLatencyMs)) { return(sync()); }
+    return(true);
+    }
+
+bool RXMsgCtrJournal::append(const uint8_t type, const uint8_t *const id, const uint8_t *const ctr)
+    {
+    if(writeOffset + recordBytes > mapBytes) { return(false); } // FAIL: full.
+    encodeRecord(map + writeOffset, type, id, ctr);
+    writeOffset += recordBytes;
+    return(true);
+    }
+
+bool RXMsgCtrJournal::compact()
+    {
+    const size_t bytes = journalFileBytes(cfg);
+    const size_t pathLen = strlen(path);
+    char *const tmpPath = new (std::nothrow) char[pathLen + 5];
+    if(NULL == tmpPath) { return(false); } // FAIL
+    memcpy(tmpPath, path, pathLen);
+    memcpy(tmpPath + pathLen, ".tmp", 5);
+
+    // Write the current values to a new journal file, and sync it.
+    bool ok = false;
+    size_t off = headerBytes;
+    const int tfd = ::open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(tfd >= 0)
+        {
+        void *const m = (0 == posix_fallocate(tfd, 0, off_t(bytes))) ?
+            mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, tfd, 0) : MAP_FAILED;
+        if(MAP_FAILED != m)
+            {
+            uint8_t *const tmap = static_cast<uint8_t *>(m);
+            memcpy(tmap, journalMagic, sizeof(journalMagic));
+            tmap[journalCleanFlagOffset] = 0;
+            for(uint32_t i = 0; i < tableSize; ++i)
+                {
+                const Entry *const e = table + i;
+                if(!e->used) { continue; }
+                encodeRecord(tmap + off, recordTypeCounter, e->id, e->ctr);
+                off += recordBytes;
+                encodeRecord(tmap + off, recordTypeReservation, e->id, e->reserved);
+                off += recordBytes;
+                }
+            ok = (0 == msync(tmap, bytes, MS_SYNC));
+            munmap(m, bytes);
+            }
+        ok = ok && (0 == fsync(tfd));
+        ::close(tfd);
+        }
+    // Atomically replace the old journal.
+    ok = ok && (0 == rename(tmpPath, path)) && syncDirOf(path);
+    if(!ok) { unlink(tmpPath); }
+    delete[] tmpPath;
+    if(!ok) { return(false); } // FAIL: old journal still in use.
+
+    // Switch to the new journal.
+    // The old one has been replaced so cannot be carried on with:
+    // if the new one cannot be opened then give up and close,
+    // rather than be left apparently open with no mapping.
+    unmapFile();
+    ::close(fd);
+    fd = ::open(path, O_RDWR);
+    if((fd < 0) || !mapFile(bytes)) { _abandon(); return(false); } // FAIL
+    writeOffset = off;
+    syncedOffset = off;
+    unsynced = 0;
+    ++compactions;
+    return(true);
+    }
+
+bool RXMsgCtrJournal::get(const uint8_t *const id, uint8_t *const counter) const
+    {
+    if(!isOpen() || (NULL == id) || (NULL == counter)) { return(false); } // FAIL
+    const Entry *const e = find(id);
+    if(e->used) { memcpy(counter, e->ctr, ctrBytes); }
+    else { memset(counter, 0, ctrBytes); }
+    return(true);
+    }
+
+bool RXMsgCtrJournal::update(const uint8_t *const id, const uint8_t *const counter)
+    {
+    if(!isOpen() || (NULL == id) || (NULL == counter)) { return(false); } // FAIL
+    Entry *const e = findOrAdd(id);
+    if(nullptr == e) { return(false); } // FAIL: too many nodes.
+    // Must be strictly higher than the last accepted value.
+    if(SimpleSecureFrame32or0BodyRXBase::msgcountercmp(counter, e->ctr) <= 0) { return(false); } // FAIL
+    // Make sure that there is room for a reservation and counter record.
+    if((writeOffset + 2 * recordBytes > mapBytes) &&
+       (!compact() || (writeOffset + 2 * recordBytes > mapBytes))) { return(false); } // FAIL
+    // If above the durable reservation then move the reservation up first,
+    // and sync it before accepting the new value.
+    if(SimpleSecureFrame32or0BodyRXBase::msgcountercmp(counter, e->reserved) > 0)
+        {
+        uint8_t reservation[ctrBytes];
+        memcpy(reservation, counter, ctrBytes);
+        // Near the top of the counter range just reserve the counter value itself.
+        if(!SimpleSecureFrame32or0BodyRXBase::msgcounteradd(reservation, cfg.reserveAhead))
+            { memcpy(reservation, counter, ctrBytes); }
+        if(!append(recordTypeReservation, id, reservation)) { return(false); } // FAIL
+        if(!sync()) { return(false); } // FAIL
+        memcpy(e->reserved, reservation, ctrBytes);
+        }
+    // Write-behind the exact value.
+    if(!append(recordTypeCounter, id, counter)) { return(false); } // FAIL
+    memcpy(e->ctr, counter, ctrBytes);
+    const uint32_t now = nowMs();
+    if(0 == unsynced++) { firstUnsyncedMs = now; }
+    if((unsynced >= cfg.batchSize) || (uint32_t(now - firstUnsyncedMs) >= cfg.maxLatencyMs)) { return(sync()); }
+    return(true);
+    }
+
+    }
+
+#endif // ARDUINO
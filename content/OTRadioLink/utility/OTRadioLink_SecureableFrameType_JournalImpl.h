@@ -0,0 +1,294 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2015--2018
+*/
+
+/*
+ * Hosted (eg gateway) implementation of secure frame RX code,
+ * using a write-behind journal file for non-volatile storage of
+ * RX message counters.
+ *
+ * Hosted (POSIX) only; not for V0p2/AVR.
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_SECUREABLEFRAMETYPE_JOURNALIMPL_H
+#define ARDUINO_LIB_OTRADIOLINK_SECUREABLEFRAMETYPE_JOURNALIMPL_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <OTV0p2Base.h>
+
+#include "OTRadioLink_SecureableFrameType.h"
+
+
+namespace OTRadioLink
+    {
+
+// RAM table of RX message counters per node,
+// backed by an append-only memory-mapped journal file.
+//
+// On a V0p2 each authenticated RX frame causes a (careful) EEPROM write.
+// On a busy gateway the equivalent (a synchronous write to disc per frame)
+// is slow, so here the latest counters are kept in RAM
+// and each update is appended to the journal,
+// with the journal synced to disc in batches
+// (after batchSize updates or maxLatencyMs, whichever is first).
+//
+// Anti-replay across a crash (ie losing any unsynced updates) is kept
+// by reserving ahead, in the same spirit as the V0p2 unary counter:
+// before accepting a counter above a node's durable reservation,
+// a new reservation (counter + reserveAhead) is journalled and synced
+// before the update is accepted.
+// After an unclean shutdown each node's counter is recovered
+// as at least its reservation, so no accepted counter value can be accepted again,
+// at the cost of possibly ignoring up to reserveAhead messages from each node.
+// After a clean close() the exact counters are recovered.
+//
+// The journal is compacted (rewritten to a new file
+// holding just the current values, then renamed into place) when full.
+// If the new journal cannot then be reopened this is closed (without syncing)
+// and all further calls fail until it is reopened.
+//
+// Journal format: a 16-byte header ("OTRXCJ01" then a clean-shutdown flag),
+// then 16-byte records until the first invalid one:
+//     type ('C' counter or 'R' reservation), 8-byte node ID,
+//     6-byte counter, 7-bit CRC (never zero) over the preceding 15 bytes.
+//
+// Not ISR-/thread- safe.
+class RXMsgCtrJournal final
+    {
+    public:
+        static constexpr uint8_t idBytes = OTV0P2BASE::OpenTRV_Node_ID_Bytes;
+        static constexpr uint8_t ctrBytes = SimpleSecureFrame32or0BodyBase::fullMsgCtrBytes;
+        static constexpr size_t headerBytes = 16;
+        static constexpr size_t recordBytes = 16;
+
+        struct Config
+            {
+            // Maximum number of distinct nodes held.
+            uint32_t maxNodes;
+            // Number of records that the journal file can hold before compaction;
+            // must be at least 2 * maxNodes + 2.
+            uint32_t journalRecords;
+            // Sync after this many unsynced updates; 1 syncs on every update.
+            uint16_t batchSize;
+            // Sync unsynced updates at least this often (checked on update and poll()).
+            uint16_t maxLatencyMs;
+            // Counter headroom reserved (durably) ahead of each accepted counter.
+            uint8_t reserveAhead;
+            };
+        static constexpr Config defaultConfig = { 1024, 16384, 64, 100, 16 };
+
+        RXMsgCtrJournal() { }
+        ~RXMsgCtrJournal() { close(); }
+
+        // Open (creating if necessary) the journal at path and recover counters from it.
+        // Returns false on failure, eg bad config or I/O error, leaving this closed.
+        bool open(const char *path, const Config &config = defaultConfig);
+        // Sync everything and mark the journal cleanly closed.
+        // Returns false if the final sync failed (the journal is closed anyway).
+        bool close();
+        // True if open.
+        bool isOpen() const { return(fd >= 0); }
+        // True if the journal was cleanly closed when last opened.
+        bool wasCleanOnOpen() const { return(cleanOnOpen); }
+
+        // Get the last accepted counter for the node with the full 8-byte ID.
+        // Gives all zeros if no counter is held for this node.
+        // Returns false if not open or an argument is NULL.
+        bool get(const uint8_t *id, uint8_t *counter) const;
+        // Accept a new (strictly higher) counter for the node with the full 8-byte ID.
+        // The counter is safe against replay (see above) when this returns true.
+        // Returns false if not accepted, eg not higher or I/O error.
+        bool update(const uint8_t *id, const uint8_t *counter);
+
+        // Sync any updates whose maximum latency has expired; call regularly.
+        // Returns false on I/O error.
+        bool poll();
+        // Sync all updates now; returns false on I/O error.
+        bool sync();
+
+        // Statistics.
+        // Number of updates not yet synced.
+        uint32_t getUnsyncedCount() const { return(unsynced); }
+        // Number of syncs done since open.
+        uint32_t getSyncCount() const { return(syncs); }
+        // Number of compactions done since open.
+        uint32_t getCompactionCount() const { return(compactions); }
+        // Number of nodes held.
+        uint32_t getNodeCount() const { return(nodeCount); }
+
+        // Exposed for unit testing.
+        // Close without syncing or marking clean, as after a crash.
+        // Does not lose data already written to the mapping, so only useful
+        // to exercise the recovery of reservations.
+        void _abandon();
+        // Make the next (re)mapping of the journal fail, as if mmap() had,
+        // to exercise the error paths of compaction.
+        void _failNextMapFile() { failNextMap = true; }
+
+    private:
+        // One node's counters.
+        struct Entry
+            {
+            uint8_t id[idBytes];
+            uint8_t ctr[ctrBytes];
+            uint8_t reserved[ctrBytes];
+            bool used;
+            };
+
+        Config cfg = defaultConfig;
+        char *path = nullptr;
+        int fd = -1;
+        uint8_t *map = nullptr;
+        size_t mapBytes = 0;
+        // Offset of next record to write.
+        size_t writeOffset = 0;
+        // Offset up to which the journal has been synced.
+        size_t syncedOffset = 0;
+        Entry *table = nullptr;
+        // Table size (a power of two).
+        uint32_t tableSize = 0;
+        uint32_t nodeCount = 0;
+        uint32_t unsynced = 0;
+        // Time (ms) of first unsynced update.
+        uint32_t firstUnsyncedMs = 0;
+        uint32_t syncs = 0;
+        uint32_t compactions = 0;
+        bool cleanOnOpen = false;
+        // If true, the next mapFile() fails.
+        bool failNextMap = false;
+
+        Entry *find(const uint8_t *id) const;
+        Entry *findOrAdd(const uint8_t *id);
+        bool append(uint8_t type, const uint8_t *id, const uint8_t *ctr);
+        bool syncTo(size_t offset);
+        bool setClean(bool clean);
+        bool mapFile(size_t bytes);
+        void unmapFile();
+        bool compact();
+        bool replay();
+        void freeAll();
+    };
+
+// Hosted RX implementation keeping message counters in an RXMsgCtrJournal
+// and looking up node associations in a table such as OTV0P2BASE::NodeAssociationTableIndexed,
+// ie anything with getNextMatchingNodeID(index, prefix, prefixLen, nodeID) returning an index or -1
+// and getGeneration() that changes whenever the associations do.
+//
+// mayBeFromAssociatedNode() checks a NodeIDPrefixFilter over the associations,
+// rebuilt on first use after they change,
+// so that frames from neighbouring networks are dropped before any crypto.
+// isRecentDuplicateFrame() checks a small RecentSecureFrameCache,
+// so that a frame heard via several radios or a relay is only authenticated once.
+//
+// Open the journal with getJournal().open(...) before use;
+// until then all counter lookups and updates fail (safely).
+// Call getJournal().poll() regularly to bound the write-behind latency.
+//
+// The associations table may have up to 32767 slots;
+// _getNextMatchingNodeID() takes and returns the full (16-bit) slot index.
+template<typename nodes_t, nodes_t &nodes>
+class SimpleSecureFrame32or0BodyRXJournalled final : public SimpleSecureFrame32or0BodyRXBase
+    {
+    public:
+        // Roughly 16 bits per association slot, as a power of two.
+        static constexpr uint32_t filterBits(const uint32_t n, const uint32_t b = 64)
+            { return(((b >= 16 * n) || (b >= (uint32_t(1) << 20))) ? b : filterBits(n, 2 * b)); }
+        typedef OTV0P2BASE::NodeIDPrefixFilter<filterBits(nodes_t::maxSets)> filter_t;
+        typedef RecentSecureFrameCache<32> recent_t;
+
+    private:
+        RXMsgCtrJournal journal;
+
+        // Pre-crypto filter over the associations,
+        // and the table generation that it was built from.
+        filter_t filter;
+        uint32_t filterGeneration = 0;
+
+        // Recently authenticated frames, to drop exact repeats before any crypto.
+        recent_t recent;
+
+        // Constructor is private to force use of factory method to return singleton.
+        SimpleSecureFrame32or0BodyRXJournalled() { }
+
+    public:
+        // Public here for unit testing.
+        virtual int16_t _getNextMatchingNodeID(const uint16_t index, const SecurableFrameHeader *const sfh, uint8_t *nodeID) const override
+            {
+            const auto r = nodes.getNextMatchingNodeID(index, sfh->id, sfh->getIl(), nodeID);
+            if(r < 0) { return(-1); }
+            return(int16_t(r));
+            }
+
+        // Factory method to get singleton instance.
+        // Create/initialise on first use, NOT statically.
+        static SimpleSecureFrame32or0BodyRXJournalled &getInstance()
+            { static SimpleSecureFrame32or0BodyRXJournalled instance; return(instance); }
+
+        // Access the underlying counter store, eg to open/close/poll it.
+        RXMsgCtrJournal &getJournal() { return(journal); }
+
+        // Access the pre-crypto filter, eg for its passed/filtered counts.
+        const filter_t &getFilter() const { return(filter); }
+        void resetFilterCounts() { filter.resetCounts(); }
+
+        // Access the recent frame cache, eg for its hit/miss counts.
+        const recent_t &getRecentFrameCache() const { return(recent); }
+        void resetRecentFrameCounts() { recent.resetCounts(); }
+
+        // Check the header ID prefix against the filter,
+        // first rebuilding the filter (and forgetting recent frames)
+        // if the associations have changed.
+        virtual bool mayBeFromAssociatedNode(const SecurableFrameHeader &sfh) override
+            {
+            const uint32_t g = nodes.getGeneration();
+            if(g != filterGeneration) { filter.rebuild(nodes); recent.clear(); filterGeneration = g; }
+            return(filter.check(sfh.id, sfh.getIl()));
+            }
+
+        virtual bool isRecentDuplicateFrame(const OTDecodeData_T &fd) override { return(recent.isDuplicate(fd)); }
+        virtual void noteAuthenticatedFrame(const OTDecodeData_T &fd) override { recent.add(fd); }
+
+        // Read current (last-authenticated) RX message count for specified node, or return false if failed.
+        // Will fail for invalid (unassociated) node ID and if the journal is not open.
+        // Both args must be non-NULL, with counter pointing to enough space to copy the message counter value to.
+        virtual bool getLastRXMsgCtr(const uint8_t * const ID, uint8_t *counter) const override
+            {
+            if((NULL == ID) || (NULL == counter)) { return(false); } // FAIL
+            if(nodes.getNextMatchingNodeID(0, ID, OTV0P2BASE::OpenTRV_Node_ID_Bytes, NULL) < 0) { return(false); } // FAIL
+            return(journal.get(ID, counter));
+            }
+
+        // Update message counter for received frame AFTER successful authentication.
+        // ID is full (8-byte) node ID; counter is full (6-byte) counter.
+        // Returns false on failure, eg if message counter is not higher than the previous value for this node.
+        // Must only be called once the RXed message has passed authentication.
+        virtual bool authAndUpdateRXMsgCtr(const uint8_t *ID, const uint8_t *newCounterValue) override
+            {
+            // Validate node ID and new count.
+            if(!validateRXMsgCtr(ID, newCounterValue)) { return(false); } // Putative new counter value not valid; reject.
+            return(journal.update(ID, newCounterValue));
+            }
+    };
+
+    }
+
+#endif // ARDUINO
+
+#endif
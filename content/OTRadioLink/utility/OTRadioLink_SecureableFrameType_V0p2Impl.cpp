@@ -528,7 +528,7 @@ bool SimpleSecureFrame32or0BodyTXV0p2SuppliedID::getTXID(uint8_t *const idOut) c
     return(getID(idOut));
     }
 
-int8_t SimpleSecureFrame32or0BodyRXV0p2::_getNextMatchingNodeID(const uint8_t /*index*/, const SecurableFrameHeader *const sfh, uint8_t *nodeID) const
+int16_t SimpleSecureFrame32or0BodyRXV0p2::_getNextMatchingNodeID(const uint16_t /*index*/, const SecurableFrameHeader *const sfh, uint8_t *nodeID) const
 {
         return (OTV0P2BASE::getNextMatchingNodeID(0, sfh->id, sfh->getIl(), nodeID));
 }
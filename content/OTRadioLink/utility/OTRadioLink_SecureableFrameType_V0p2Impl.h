@@ -402,7 +402,7 @@ class SimpleSecureFrame32or0BodyTXV0p2Null : public SimpleSecureFrame32or0BodyTX
             // Constructor is private to force use of factory method to return singleton.
             constexpr SimpleSecureFrame32or0BodyRXV0p2() { }
 
-            virtual int8_t _getNextMatchingNodeID(const uint8_t index, const SecurableFrameHeader *const sfh, uint8_t *nodeID) const override;
+            virtual int16_t _getNextMatchingNodeID(uint16_t index, const SecurableFrameHeader *sfh, uint8_t *nodeID) const override;
 
         public:
             // Factory method to get singleton instance.
@@ -0,0 +1,310 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * In-process simulated radio medium ("ether") shared by many virtual nodes,
+ * each an OTRadioLink, for load-testing hub code with no radio hardware.
+ *
+ * Hosted only; not for V0p2/AVR.
+ *
+ * Keywords: C++ radio simulation ether airtime collision loss load test
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_SIMETHER_H
+#define ARDUINO_LIB_OTRADIOLINK_SIMETHER_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "OTRadioLink_OTRadioLink.h"
+#include "OTRadioLink_ISRRXQueue.h"
+
+
+namespace OTRadioLink
+    {
+    class OTSimRadioLinkBase;
+
+    // Shared simulated medium connecting any number of OTSimRadioLink nodes.
+    //
+    // Time is simulated, in microseconds, and only moves on in advance().
+    // A frame sent at time t is on the air until t plus its airtime,
+    // computed from its length plus a fixed per-frame overhead
+    // (preamble, sync word, CRC) at the configured bit rate,
+    // and is delivered at the end of that to every other node
+    // listening on the same channel (config index) that was not itself
+    // transmitting meanwhile, unless lost on that link.
+    // Frames on the same channel that overlap in time at all collide
+    // and are lost everywhere (no capture effect).
+    // Each link (sender to receiver) has an independent loss probability,
+    // defaulting to that set with setDefaultLoss(), drawn from a seeded PRNG
+    // so that a run is repeatable.
+    //
+    // The ether must outlive all nodes attached to it.
+    // Not thread-safe: all nodes and the ether must be driven from one thread.
+    class SimEther final
+        {
+        public:
+            // Default bit rate, as for the RFM23B GFSK configuration.
+            static constexpr uint32_t DefaultBitRate = 49260;
+            // Default per-frame overhead in bytes: preamble, sync and CRC.
+            static constexpr uint8_t DefaultOverheadBytes = 10;
+
+        private:
+            // A frame on (or recently on) the air.
+            struct Transmission
+                {
+                uint16_t from;
+                int8_t channel;
+                bool collided;
+                uint64_t start, end;
+                std::vector<uint8_t> frame;
+                };
+
+            const uint32_t bitRate;
+            const uint8_t overheadBytes;
+            uint64_t now;
+            std::vector<OTSimRadioLinkBase *> nodes;
+            // End of each node's latest transmission, to enforce half-duplex.
+            std::vector<uint64_t> txEnd;
+            // Start of each node's latest transmission.
+            std::vector<uint64_t> txStart;
+            // Frames not yet delivered, in start order.
+            std::deque<Transmission> inFlight;
+            // Loss probabilities in [0,1]: default, and per (from,to) link where set.
+            double defaultLoss;
+            std::unordered_map<uint32_t, double> linkLoss;
+            std::mt19937 prng;
+            std::uniform_real_distribution<double> uniform;
+
+            // Counters.
+            uint32_t txCount, collidedCount, deliveredCount, lostCount;
+
+            static uint32_t linkKey(const uint16_t from, const uint16_t to) { return((uint32_t(from) << 16) | to); }
+
+            // Deliver tx to each eligible receiver.
+            void deliver(const Transmission &tx);
+
+            friend class OTSimRadioLinkBase;
+            // Attach a node, returning its ID.
+            uint16_t attach(OTSimRadioLinkBase *n)
+                {
+                nodes.push_back(n);
+                txStart.push_back(0);
+                txEnd.push_back(0);
+                return(uint16_t(nodes.size() - 1));
+                }
+            // Put a frame on the air now from node from;
+            // false if the node is still sending an earlier frame.
+            bool transmit(uint16_t from, int8_t channel, const uint8_t *buf, uint8_t buflen);
+
+        public:
+            explicit SimEther(const uint32_t bitRate_ = DefaultBitRate,
+                              const uint8_t overheadBytes_ = DefaultOverheadBytes,
+                              const uint32_t seed = 1)
+              : bitRate(bitRate_), overheadBytes(overheadBytes_), now(0),
+                defaultLoss(0), prng(seed), uniform(0, 1),
+                txCount(0), collidedCount(0), deliveredCount(0), lostCount(0)
+                { }
+
+            // Current simulated time in microseconds.
+            uint64_t getTime() const { return(now); }
+            // Number of nodes attached.
+            uint16_t getNodeCount() const { return(uint16_t(nodes.size())); }
+
+            // Airtime in microseconds of a frame of buflen bytes, rounded up.
+            uint32_t airtimeUs(const uint8_t buflen) const
+                { return(uint32_t(((uint64_t(overheadBytes) + buflen) * 8U * 1000000U + bitRate - 1) / bitRate)); }
+
+            // Set loss probability in [0,1] for all links not set individually.
+            void setDefaultLoss(const double p) { defaultLoss = p; }
+            // Set loss probability in [0,1] for frames from one node to another.
+            void setLinkLoss(const uint16_t from, const uint16_t to, const double p) { linkLoss[linkKey(from, to)] = p; }
+            // Get loss probability for frames from one node to another.
+            double getLinkLoss(const uint16_t from, const uint16_t to) const
+                {
+                const auto i = linkLoss.find(linkKey(from, to));
+                return((linkLoss.end() == i) ? defaultLoss : i->second);
+                }
+
+            // Move simulated time on by us microseconds,
+            // delivering every frame whose airtime ends by then, in order of ending.
+            void advance(uint64_t us);
+            // True if any frame is still on the air.
+            bool isBusy() const { return(!inFlight.empty()); }
+
+            // Frames sent, frames lost to collisions,
+            // and per-receiver deliveries made and lost on the link.
+            // Deliveries dropped by a receiver (eg with a full queue)
+            // show in its getRXMsgsDroppedRecent().
+            uint32_t getTXCount() const { return(txCount); }
+            uint32_t getCollidedCount() const { return(collidedCount); }
+            uint32_t getDeliveredCount() const { return(deliveredCount); }
+            uint32_t getLostCount() const { return(lostCount); }
+        };
+
+    // Simulated radio attached to a SimEther; see OTSimRadioLink.
+    // Frames are sent with sendRaw() and arrive when the ether is advanced.
+    // Must be configure()d with at least one channel (config contents are ignored)
+    // and listen()ing on the channel of a frame to receive it.
+    class OTSimRadioLinkBase : public OTRadioLink
+        {
+        friend class SimEther;
+        private:
+            SimEther &ether;
+            const uint16_t id;
+
+        protected:
+            OTSimRadioLinkBase(SimEther &e) : ether(e), id(e.attach(this)) { }
+
+            // Nothing to do: the ether checks listenChannel at delivery.
+            virtual void _dolisten() override { }
+
+            // Accept (or drop) a frame from the ether, as an RX ISR would.
+            virtual void _deliver(const uint8_t *buf, uint8_t buflen) = 0;
+
+        public:
+            // ID of this node on its ether, from 0 in order of attachment.
+            uint16_t getNodeID() const { return(id); }
+
+            virtual bool begin() override { return(true); }
+
+            // Start sending buf on the given channel (config index) at the current ether time.
+            // Returns false if the channel is invalid, buflen is 0,
+            // or this node is still sending a previous frame.
+            // Does not wait for the send to complete.
+            virtual bool sendRaw(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower = TXnormal, bool = false) override
+                {
+                if((channel < 0) || (channel >= nChannels) || (0 == buflen)) { return(false); }
+                return(ether.transmit(id, channel, buf, buflen));
+                }
+        };
+
+    // Simulated radio with its own RX queue of type queue_t,
+    // eg ISRRXQueueVarLenMsgLarge to size a hub's queue.
+    // The RX filter, if any, is applied as by a hardware driver.
+    template<class queue_t = ISRRXQueueVarLenMsg<64, 3>>
+    class OTSimRadioLink final : public OTSimRadioLinkBase
+        {
+        private:
+            queue_t queueRX;
+
+            virtual void _deliver(const uint8_t *const buf, const uint8_t buflen) override
+                {
+                uint8_t qMin, maxLen;
+                queueRX.getRXCapacity(qMin, maxLen);
+                volatile uint8_t *const b = (buflen > maxLen) ? NULL : queueRX._getRXBufForInbound();
+                if(NULL == b) { ++droppedRXedMessageCountRecent; return; }
+                for(uint8_t i = 0; i < buflen; ++i) { b[i] = buf[i]; }
+                volatile uint8_t len = buflen;
+                quickFrameFilter_t *const f = filterRXISR;
+                if((NULL != f) && !f(b, len))
+                    {
+                    ++filteredRXedMessageCountRecent;
+                    queueRX._loadedBuf(0);
+                    return;
+                    }
+                queueRX._loadedBuf(len);
+                }
+
+        public:
+            explicit OTSimRadioLink(SimEther &e) : OTSimRadioLinkBase(e) { }
+
+            virtual void getCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen, uint8_t &maxTXMsgLen) const override
+                {
+                queueRX.getRXCapacity(queueRXMsgsMin, maxRXMsgLen);
+                maxTXMsgLen = 255;
+                }
+            virtual uint8_t getRXMsgsQueued() const override { return(queueRX.getRXMsgsQueued()); }
+            virtual const volatile uint8_t *peekRXMsg() const override { return(queueRX.peekRXMsg()); }
+            virtual void removeRXMsg() override { queueRX.removeRXMsg(); }
+
+            // Read-only access to the RX queue, eg for its stats.
+            const queue_t &getRXQueue() const { return(queueRX); }
+        };
+
+    inline bool SimEther::transmit(const uint16_t from, const int8_t channel, const uint8_t *const buf, const uint8_t buflen)
+        {
+        if(txEnd[from] > now) { return(false); }
+        Transmission tx;
+        tx.from = from;
+        tx.channel = channel;
+        tx.collided = false;
+        tx.start = now;
+        tx.end = now + airtimeUs(buflen);
+        tx.frame.assign(buf, buf + buflen);
+        // Anything on the same channel still on the air collides with this.
+        for(Transmission &t : inFlight)
+            {
+            if((t.channel != channel) || (t.end <= now)) { continue; }
+            if(!t.collided) { t.collided = true; ++collidedCount; }
+            if(!tx.collided) { tx.collided = true; ++collidedCount; }
+            }
+        txStart[from] = tx.start;
+        txEnd[from] = tx.end;
+        inFlight.push_back(std::move(tx));
+        ++txCount;
+        return(true);
+        }
+
+    inline void SimEther::deliver(const Transmission &tx)
+        {
+        if(tx.collided) { return; }
+        for(uint16_t to = 0; to < nodes.size(); ++to)
+            {
+            if(to == tx.from) { continue; }
+            OTSimRadioLinkBase *const n = nodes[to];
+            if(n->getListenChannel() != tx.channel) { continue; }
+            // Deaf while sending: half-duplex.
+            if((txEnd[to] > tx.start) && (txStart[to] < tx.end)) { continue; }
+            const double p = getLinkLoss(tx.from, to);
+            if((p > 0) && (uniform(prng) < p)) { ++lostCount; continue; }
+            n->_deliver(tx.frame.data(), uint8_t(tx.frame.size()));
+            ++deliveredCount;
+            }
+        }
+
+    inline void SimEther::advance(const uint64_t us)
+        {
+        const uint64_t until = now + us;
+        // Deliver in order of ending, moving time on to each end in turn
+        // so that receivers see a consistent 'now' (eg if they reply at once).
+        for( ; ; )
+            {
+            auto first = inFlight.end();
+            for(auto i = inFlight.begin(); i != inFlight.end(); ++i)
+                { if((i->end <= until) && ((inFlight.end() == first) || (i->end < first->end))) { first = i; } }
+            if(inFlight.end() == first) { break; }
+            if(first->end > now) { now = first->end; }
+            const Transmission tx = std::move(*first);
+            inFlight.erase(first);
+            deliver(tx);
+            }
+        now = until;
+        }
+    }
+
+#endif // ARDUINO
+
+#endif
@@ -0,0 +1,387 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Hub-side ingest of decoded stats into per-node in-memory time series,
+ * fed directly from decoded frames (or JSON) rather than re-parsing
+ * the lines printed to serial, with latest-value and time-range queries.
+ *
+ * Hosted only; not for V0p2/AVR.
+ *
+ * Keywords: C++ hub stats ingest time series ring buffer query
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_STATSINGEST_H
+#define ARDUINO_LIB_OTRADIOLINK_STATSINGEST_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "OTRadioLink_SecureableFrameType.h"
+
+
+namespace OTRadioLink
+    {
+    // In-memory store of the stats received from many nodes.
+    //
+    // Each node has, for each stats key it sends (eg "T|C16", "H|%", "L"),
+    // a ring buffer of its most recent (time, value) samples, held as
+    // separate time and value columns.
+    // A node keeps at most maxKeysPerNode keys of samplesPerKey samples each,
+    // and samples for further keys are dropped, so memory per node is bounded.
+    // The number of nodes is capped at maxNodes, DefaultMaxNodes by default,
+    // and samples from further nodes are dropped and counted.
+    // Distinct key names (shared by all nodes) are capped at maxKeys,
+    // and limits are checked before anything new is stored,
+    // so that a stream of made-up keys or node IDs,
+    // eg in unauthenticated JSON, cannot grow memory without bound.
+    //
+    // Times are supplied by the caller, eg seconds since some epoch,
+    // and must not go backwards for any one node and key:
+    // a sample older than the latest for its node and key is dropped.
+    // Only integer values are kept; other JSON values are skipped.
+    // JSON is parsed with OTV0P2BASE::JSONStatsRXTokenizer, leniently,
+    // so values are in the int16_t range as for JSON stats frames.
+    //
+    // Node IDs are the node's ID bytes taken big-endian, up to 8 of them,
+    // (see nodeIDFromBytes()), or the "@" hex ID from JSON as a number;
+    // these agree only where the "@" field holds the leading ID bytes
+    // in full, so stick to one form for any one node.
+    //
+    // Not thread-safe.
+    class StatsIngest final
+        {
+        public:
+            typedef uint64_t nodeID_t;
+
+            // One stored sample.
+            struct Sample
+                {
+                uint32_t time;
+                int32_t value;
+                };
+
+            static constexpr uint8_t DefaultMaxKeysPerNode = 16;
+            static constexpr uint16_t DefaultSamplesPerKey = 64;
+            // Distinct key names across all nodes.
+            static constexpr uint16_t DefaultMaxKeys = 1024;
+            // Nodes; well beyond any one hub's radio range.
+            static constexpr uint32_t DefaultMaxNodes = 8192;
+            // Most fields taken from one JSON object.
+            static constexpr uint8_t MaxJSONFields = 16;
+
+            // Key under which the valve percent open from the start of a
+            // secure 'O' frame body is kept; the same as in the JSON stats.
+            static const char *valvePercentKey() { return("v|%"); }
+
+            // Node ID from up to 8 ID bytes, big-endian.
+            static nodeID_t nodeIDFromBytes(const uint8_t *const id, const uint8_t len)
+                {
+                nodeID_t n = 0;
+                for(uint8_t i = 0; (i < len) && (i < 8); ++i) { n = (n << 8) | id[i]; }
+                return(n);
+                }
+
+        private:
+            // Ring buffer of samples for one key of one node.
+            struct Column
+                {
+                uint16_t key;
+                // Index of the next sample to be written, and samples held.
+                uint16_t next;
+                uint16_t count;
+                std::vector<uint32_t> times;
+                std::vector<int32_t> values;
+                };
+            struct Node
+                {
+                std::vector<Column> columns;
+                };
+
+            const uint8_t maxKeysPerNode;
+            const uint16_t samplesPerKey;
+            // 0 for no limit.
+            const uint32_t maxNodes;
+            const uint16_t maxKeys;
+            // Key names, interned.
+            std::unordered_map<std::string, uint16_t> keyIndex;
+            std::vector<std::string> keyNames;
+            std::unordered_map<nodeID_t, Node> nodes;
+
+            // Counters.
+            uint32_t sampleCount, droppedCount, nodeRejectedCount;
+
+            // Index of key, or -1 if never seen.
+            int keyOf(const std::string &key) const
+                {
+                const auto i = keyIndex.find(key);
+                return((keyIndex.end() == i) ? -1 : i->second);
+                }
+
+            static const Column *findColumn(const Node &n, const int key)
+                {
+                for(const Column &c : n.columns) { if(key == c.key) { return(&c); } }
+                return(NULL);
+                }
+            static Column *findColumn(Node &n, const int key)
+                {
+                for(Column &c : n.columns) { if(key == c.key) { return(&c); } }
+                return(NULL);
+                }
+            const Column *findColumn(const nodeID_t node, const char *const key) const
+                {
+                const int k = keyOf(key);
+                if(k < 0) { return(NULL); }
+                const auto i = nodes.find(node);
+                return((nodes.end() == i) ? NULL : findColumn(i->second, k));
+                }
+
+            // Physical index of the i-th oldest sample held in c.
+            uint16_t slot(const Column &c, const uint16_t i) const
+                { return(uint16_t((c.next + samplesPerKey - c.count + i) % samplesPerKey)); }
+
+            // Add one sample, interning the key only once it is known to fit.
+            bool addSample(nodeID_t node, const char *key, size_t keyLen, uint32_t time, int32_t value);
+
+            // Add the integer values in a flat JSON object for node,
+            // or if haveNode is false for the node in its "@" field,
+            // skipping "@" and "+".
+            // Stops at the closing '}' or '}' | 0x80 (of a raw RXed JSON
+            // frame, whose CRC is not checked) or at len, so the closing '}'
+            // may be missing as in 'O' frames.
+            // Values before any malformed pair are kept.
+            uint8_t ingestJSONFields(bool haveNode, nodeID_t node, uint32_t time, const char *json, size_t len);
+
+        public:
+            explicit StatsIngest(const uint8_t maxKeysPerNode_ = DefaultMaxKeysPerNode,
+                                 const uint16_t samplesPerKey_ = DefaultSamplesPerKey,
+                                 const uint32_t maxNodes_ = DefaultMaxNodes,
+                                 const uint16_t maxKeys_ = DefaultMaxKeys)
+              : maxKeysPerNode(maxKeysPerNode_), samplesPerKey((0 == samplesPerKey_) ? 1 : samplesPerKey_),
+                maxNodes(maxNodes_), maxKeys(maxKeys_),
+                sampleCount(0), droppedCount(0), nodeRejectedCount(0)
+                { }
+
+            // Add one sample; false if dropped.
+            bool add(const nodeID_t node, const char *const key, const uint32_t time, const int32_t value)
+                { return(addSample(node, key, strlen(key), time, value)); }
+
+            // Add the integer stats in a JSON object such as
+            // {"@":"cdfb","+":2,"T|C16":299,"H|%":83}
+            // for the node given, or else for that in its "@" field.
+            // Returns the number of samples added.
+            uint8_t ingestJSON(const nodeID_t node, const uint32_t time, const char *const json, const size_t len)
+                { return(ingestJSONFields(true, node, time, json, len)); }
+            uint8_t ingestJSON(const uint32_t time, const char *const json, const size_t len)
+                { return(ingestJSONFields(false, 0, time, json, len)); }
+
+            // Add the stats from a decoded secure 'O' frame, for the node
+            // with the frame's ID: the valve percent open (if any) and the
+            // JSON stats (if any), as printed by serialFrameOperation().
+            // Returns the number of samples added.
+            uint8_t ingest(const OTDecodeData_T &fd, const uint32_t time)
+                {
+                const nodeID_t node = nodeIDFromBytes(fd.id, sizeof(fd.id));
+                const uint8_t *const db = fd.ptext;
+                const uint8_t dbLen = fd.ptextLen;
+                if((NULL == db) || (dbLen < 2)) { return(0); }
+                uint8_t n = 0;
+                if((db[0] <= 100) && add(node, valvePercentKey(), time, db[0])) { ++n; }
+                if((0 != (db[1] & 0x10)) && (dbLen > 3) && ('{' == db[2]))
+                    { n = uint8_t(n + ingestJSON(node, time, (const char *)db + 2, dbLen - 2u)); }
+                return(n);
+                }
+
+            // Latest sample for the node and key; false if none.
+            bool getLatest(const nodeID_t node, const char *const key, Sample &out) const
+                {
+                const Column *const c = findColumn(node, key);
+                if((NULL == c) || (0 == c->count)) { return(false); }
+                const uint16_t s = slot(*c, uint16_t(c->count - 1));
+                out.time = c->times[s];
+                out.value = c->values[s];
+                return(true);
+                }
+
+            // Copy out, oldest first, up to maxOut samples for the node and key
+            // with times in [from, to], and return the number copied.
+            size_t getRange(nodeID_t node, const char *key, uint32_t from, uint32_t to, Sample *out, size_t maxOut) const;
+
+            // Append the latest sample for the key from every node that has one.
+            // Returns the number appended.
+            size_t getLatestAll(const char *key, std::vector<std::pair<nodeID_t, Sample>> &out) const;
+
+            // Number of nodes and of distinct keys seen.
+            size_t getNodeCount() const { return(nodes.size()); }
+            size_t getKeyCount() const { return(keyNames.size()); }
+            // Samples added, and dropped (out of order, too many keys or nodes).
+            uint32_t getSampleCount() const { return(sampleCount); }
+            uint32_t getDroppedCount() const { return(droppedCount); }
+            // Of those dropped, the samples from new nodes beyond maxNodes.
+            uint32_t getNodeRejectedCount() const { return(nodeRejectedCount); }
+        };
+
+    inline bool StatsIngest::addSample(const nodeID_t node, const char *const key, const size_t keyLen,
+                                       const uint32_t time, const int32_t value)
+        {
+        const std::string k(key, keyLen);
+        int ki = keyOf(k);
+        auto i = nodes.find(node);
+        Column *c = ((nodes.end() == i) || (ki < 0)) ? NULL : findColumn(i->second, ki);
+        if(NULL == c)
+            {
+            // Check every limit before storing anything new.
+            if(nodes.end() == i)
+                {
+                if((0 != maxNodes) && (nodes.size() >= maxNodes))
+                    { ++nodeRejectedCount; ++droppedCount; return(false); }
+                }
+            else if(i->second.columns.size() >= maxKeysPerNode)
+                { ++droppedCount; return(false); }
+            if((0 == maxKeysPerNode) || ((ki < 0) && (keyNames.size() >= maxKeys)))
+                { ++droppedCount; return(false); }
+            if(ki < 0)
+                {
+                ki = int(keyNames.size());
+                keyIndex.emplace(k, uint16_t(ki));
+                keyNames.push_back(k);
+                }
+            if(nodes.end() == i) { i = nodes.emplace(node, Node()).first; }
+            Node &n = i->second;
+            n.columns.push_back(Column());
+            c = &n.columns.back();
+            c->key = uint16_t(ki);
+            c->next = 0;
+            c->count = 0;
+            c->times.resize(samplesPerKey);
+            c->values.resize(samplesPerKey);
+            }
+        else if((0 != c->count) && (time < c->times[slot(*c, uint16_t(c->count - 1))]))
+            { ++droppedCount; return(false); }
+        c->times[c->next] = time;
+        c->values[c->next] = value;
+        c->next = uint16_t((c->next + 1) % samplesPerKey);
+        if(c->count < samplesPerKey) { ++c->count; }
+        ++sampleCount;
+        return(true);
+        }
+
+    inline uint8_t StatsIngest::ingestJSONFields(const bool haveNode, nodeID_t node, const uint32_t time,
+                                                 const char *const json, const size_t len)
+        {
+        typedef OTV0P2BASE::JSONStatsRXTokenizer tokenizer_t;
+        tokenizer_t t(reinterpret_cast<const uint8_t *>(json), uint8_t((len > 255) ? 255 : len), true);
+        // Keys and values to add once the node is known.
+        struct Field { const char *key; uint8_t keyLen; int32_t value; };
+        Field fields[MaxJSONFields];
+        uint8_t nFields = 0;
+        bool haveAt = false;
+        nodeID_t at = 0;
+        while((nFields < MaxJSONFields) && t.next())
+            {
+            const bool isAt = (1 == t.keyLen) && ('@' == t.key[0]);
+            const bool isSeq = (1 == t.keyLen) && ('+' == t.key[0]);
+            if(tokenizer_t::JSON_INT == t.type)
+                {
+                if(!isAt && !isSeq) { fields[nFields++] = { t.key, t.keyLen, t.value }; }
+                continue;
+                }
+            // String value: only the "@" ID is used.
+            if(!isAt) { continue; }
+            nodeID_t v = 0;
+            bool hex = true;
+            for(uint8_t i = 0; i < t.strLen; ++i)
+                {
+                const char c = t.str[i];
+                const int d = ((c >= '0') && (c <= '9')) ? (c - '0') :
+                              ((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) :
+                              ((c >= 'A') && (c <= 'F')) ? (c - 'A' + 10) : -1;
+                if(d < 0) { hex = false; } else { v = (v << 4) | nodeID_t(d); }
+                }
+            if(hex) { haveAt = true; at = v; }
+            }
+        if(!haveNode)
+            {
+            if(!haveAt) { return(0); }
+            node = at;
+            }
+        uint8_t n = 0;
+        for(uint8_t f = 0; f < nFields; ++f)
+            { if(addSample(node, fields[f].key, fields[f].keyLen, time, fields[f].value)) { ++n; } }
+        return(n);
+        }
+
+    inline size_t StatsIngest::getRange(const nodeID_t node, const char *const key,
+                                        const uint32_t from, const uint32_t to,
+                                        Sample *const out, const size_t maxOut) const
+        {
+        const Column *const c = findColumn(node, key);
+        if((NULL == c) || (from > to)) { return(0); }
+        // Times are in order, so find the first at or after from.
+        uint16_t lo = 0, hi = c->count;
+        while(lo < hi)
+            {
+            const uint16_t mid = uint16_t((lo + hi) / 2);
+            if(c->times[slot(*c, mid)] < from) { lo = uint16_t(mid + 1); } else { hi = mid; }
+            }
+        size_t n = 0;
+        for(uint16_t i = lo; (i < c->count) && (n < maxOut); ++i)
+            {
+            const uint16_t s = slot(*c, i);
+            if(c->times[s] > to) { break; }
+            out[n].time = c->times[s];
+            out[n].value = c->values[s];
+            ++n;
+            }
+        return(n);
+        }
+
+    inline size_t StatsIngest::getLatestAll(const char *const key, std::vector<std::pair<nodeID_t, Sample>> &out) const
+        {
+        const int k = keyOf(key);
+        if(k < 0) { return(0); }
+        size_t n = 0;
+        for(const auto &i : nodes)
+            {
+            const Column *const c = findColumn(i.second, k);
+            if((NULL == c) || (0 == c->count)) { continue; }
+            const uint16_t s = slot(*c, uint16_t(c->count - 1));
+            out.push_back(std::make_pair(i.first, Sample{ c->times[s], c->values[s] }));
+            ++n;
+            }
+        return(n);
+        }
+
+    // Frame operator adding the stats from each decoded secure 'O' frame
+    // to the StatsIngest si, timestamped with getTime(),
+    // eg as o2 of decodeAndHandleOTSecureOFrame() beside the serial output.
+    // Returns true if any samples were added.
+    template<StatsIngest &si, uint32_t (*getTime)()>
+    bool statsIngestFrameOperation(const OTDecodeData_T &fd) { return(0 != si.ingest(fd, getTime())); }
+    }
+
+#endif // ARDUINO
+
+#endif // ARDUINO_LIB_OTRADIOLINK_STATSINGEST_H
@@ -0,0 +1,302 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Duty-cycle-aware asynchronous TX queue wrapping any OTRadioLink.
+ *
+ * Keywords: C++ radio TX transmit queue duty cycle airtime backoff scheduler
+ */
+
+#ifndef ARDUINO_LIB_OTRADIOLINK_TXSCHEDULER_H
+#define ARDUINO_LIB_OTRADIOLINK_TXSCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <OTV0p2Base.h>
+#include "OTRadioLink_OTRadioLink.h"
+
+
+namespace OTRadioLink
+    {
+    // Wraps a radio so that queueToSend() copies the frame
+    // into a small FIFO and returns at once,
+    // with frames actually sent (with the wrapped radio's sendRaw()) from poll()
+    // once their randomised backoff has passed,
+    // and only while the rolling airtime on their channel is within budget,
+    // eg 1% of each hour in much of the 868MHz band.
+    //
+    // Airtime is estimated from frame length plus a fixed per-frame overhead
+    // (preamble, sync, CRC) at the given bit rate,
+    // and tracked per channel in 16 buckets spanning the rolling window.
+    // Direct calls to sendRaw() are counted too,
+    // and refused if they would exceed the budget.
+    //
+    // Each queued frame waits a random [0,backoffSlotMs) (from randRNG8())
+    // before it is first sent, and after the frame before it,
+    // so that many generated at once are spread out.
+    // Each retry after a failed send doubles the range,
+    // up to maxTXAttempts tries after which the frame is dropped.
+    // A frame with no budget left waits until some expires.
+    // A frame longer than the whole budget for its channel is refused,
+    // or dropped if the budget is cut after it was queued.
+    // Frames are sent in order, so the head frame can hold up later ones.
+    //
+    // All RX calls go straight to the wrapped radio,
+    // though RX filters and RX stats must be set/read on it directly.
+    // The wrapped radio must not be configured or used directly
+    // once wrapped, but is configured via configure() on this.
+    //
+    // Template parameters:
+    //   * getTimeMs  monotonic millisecond clock; may wrap
+    //   * queueDepth  maximum frames queued; strictly positive
+    //   * maxFrameLen  maximum frame length queued
+    //   * maxChannels  maximum number of channels tracked; channels beyond send no frames
+    //
+    // Not ISR-safe: call only from the main loop/thread.
+    template<uint32_t (*getTimeMs)(), uint8_t queueDepth = 4, uint8_t maxFrameLen = 64, uint8_t maxChannels = 1>
+    class OTRadioLinkTXScheduled final : public OTRadioLink
+        {
+        static_assert(queueDepth > 0, "must be able to queue a frame");
+        static_assert(maxChannels > 0, "must track at least one channel");
+        public:
+            // Default bit rate, as for the RFM23B GFSK configuration.
+            static constexpr uint32_t DefaultBitRate = 49260;
+            // Default per-frame overhead in bytes: preamble, sync and CRC.
+            static constexpr uint8_t DefaultOverheadBytes = 10;
+            // Default duty cycle, in parts per 1000.
+            static constexpr uint8_t DefaultDutyCyclePermille = 10;
+            // Default rolling window: 1 hour.
+            static constexpr uint32_t DefaultWindowMs = 3600000UL;
+            // Default backoff slot.
+            static constexpr uint16_t DefaultBackoffSlotMs = 50;
+            // Tries before a queued frame is dropped.
+            static constexpr uint8_t maxTXAttempts = 8;
+            // Number of buckets the window is tracked in.
+            static constexpr uint8_t Buckets = 16;
+
+        private:
+            OTRadioLink &radio;
+
+            const uint32_t bitRate;
+            const uint32_t bucketMs;
+            const uint16_t backoffSlotMs;
+            const uint8_t overheadBytes;
+            // Budget per channel per window.
+            uint32_t budgetMs[maxChannels];
+
+            // Estimated airtime (ms) per channel in each bucket, current first at bucketHead.
+            uint16_t airtime[maxChannels][Buckets];
+            uint8_t bucketHead;
+            // Start time of the current bucket.
+            uint32_t bucketStart;
+
+            // Queued frame.
+            struct TXFrame
+                {
+                uint32_t notBefore;
+                uint8_t len;
+                int8_t channel;
+                TXpower power;
+                uint8_t attempts;
+                uint8_t buf[maxFrameLen];
+                };
+            TXFrame queue[queueDepth];
+            uint8_t qHead, qCount;
+
+            // Frames dropped after too many tries or exceeding the budget; saturates.
+            uint16_t txDropped;
+
+            // Move the window on to now, clearing buckets that have expired.
+            void rotate(const uint32_t now)
+                {
+                uint32_t elapsed = now - bucketStart;
+                if(elapsed < bucketMs) { return; }
+                uint32_t steps = elapsed / bucketMs;
+                bucketStart += steps * bucketMs;
+                if(steps > Buckets) { steps = Buckets; }
+                while(steps-- > 0)
+                    {
+                    if(++bucketHead >= Buckets) { bucketHead = 0; }
+                    for(uint8_t c = 0; c < maxChannels; ++c) { airtime[c][bucketHead] = 0; }
+                    }
+                }
+
+            // Random delay [0,backoffSlotMs << attempts).
+            uint32_t backoff(const uint8_t attempts) const
+                {
+                const uint32_t range = uint32_t(backoffSlotMs) << ((attempts > 7) ? 7 : attempts);
+                return((range * OTV0P2BASE::randRNG8()) >> 8);
+                }
+
+            // True if a frame of len bytes can be sent on channel now within budget.
+            bool withinBudget(const int8_t channel, const uint8_t len) const
+                {
+                if((channel < 0) || (channel >= maxChannels)) { return(false); }
+                return((getAirtimeUsedMs(channel) + airtimeMs(len)) <= budgetMs[channel]);
+                }
+
+            // True if a frame of len bytes could ever be sent on channel within budget.
+            bool fitsBudget(const int8_t channel, const uint8_t len) const
+                {
+                if((channel < 0) || (channel >= maxChannels)) { return(false); }
+                return(airtimeMs(len) <= budgetMs[channel]);
+                }
+
+            // Send now via the wrapped radio if within budget, accounting for airtime.
+            bool sendNow(const uint8_t *const buf, const uint8_t buflen, const int8_t channel, const TXpower power, const bool listenAfter)
+                {
+                rotate(getTimeMs());
+                if(!withinBudget(channel, buflen)) { return(false); }
+                // Count the airtime whether or not the send works, as it may have gone out.
+                uint16_t &a = airtime[channel][bucketHead];
+                const uint32_t t = uint32_t(a) + airtimeMs(buflen);
+                a = (t > 0xffff) ? 0xffff : uint16_t(t);
+                return(radio.sendRaw(buf, buflen, channel, power, listenAfter));
+                }
+
+            // Try to send the head frame if it is due.
+            void pollTX()
+                {
+                if(0 == qCount) { return; }
+                TXFrame &f = queue[qHead];
+                const uint32_t now = getTimeMs();
+                if(int32_t(now - f.notBefore) < 0) { return; }
+                rotate(now);
+                // Drop a frame that the (possibly reduced) budget can never allow,
+                // rather than let it hold up those behind it for ever.
+                const bool fits = fitsBudget(f.channel, f.len);
+                if(fits && !withinBudget(f.channel, f.len))
+                    {
+                    // Wait for the oldest bucket to expire, without using up a try.
+                    f.notBefore = bucketStart + bucketMs + backoff(0);
+                    return;
+                    }
+                if(fits && !sendNow(f.buf, f.len, f.channel, f.power, false) && (++f.attempts < maxTXAttempts))
+                    {
+                    f.notBefore = now + backoff(f.attempts);
+                    return;
+                    }
+                if(!fits || (f.attempts >= maxTXAttempts)) { if(0xffff != txDropped) { ++txDropped; } }
+                if(++qHead >= queueDepth) { qHead = 0; }
+                --qCount;
+                // Spread out the next frame from this one.
+                if(0 != qCount)
+                    {
+                    TXFrame &n = queue[qHead];
+                    const uint32_t earliest = now + backoff(0);
+                    if(int32_t(earliest - n.notBefore) > 0) { n.notBefore = earliest; }
+                    }
+                }
+
+        protected:
+            // Configure the wrapped radio with the same channels.
+            virtual bool _doconfig() override { return(radio.configure(nChannels, channelConfig)); }
+            virtual void _dolisten() override { const int8_t c = getListenChannel(); radio.listen(-1 != c, c); }
+
+        public:
+            OTRadioLinkTXScheduled(OTRadioLink &r,
+                                   const uint32_t bitRate_ = DefaultBitRate,
+                                   const uint8_t overheadBytes_ = DefaultOverheadBytes,
+                                   const uint32_t windowMs = DefaultWindowMs,
+                                   const uint16_t backoffSlotMs_ = DefaultBackoffSlotMs)
+              : radio(r), bitRate(bitRate_), bucketMs(windowMs / Buckets),
+                backoffSlotMs(backoffSlotMs_), overheadBytes(overheadBytes_),
+                airtime(), bucketHead(0), bucketStart(getTimeMs()),
+                qHead(0), qCount(0), txDropped(0)
+                {
+                for(uint8_t c = 0; c < maxChannels; ++c)
+                    { budgetMs[c] = (uint32_t(bucketMs) * Buckets / 1000) * DefaultDutyCyclePermille; }
+                }
+
+            // Set the duty cycle allowed on channel in parts per 1000, eg 10 for 1%.
+            void setDutyCyclePermille(const int8_t channel, const uint16_t permille)
+                {
+                if((channel < 0) || (channel >= maxChannels)) { return; }
+                budgetMs[channel] = (uint32_t(bucketMs) * Buckets / 1000) * permille;
+                }
+
+            // Estimated airtime of a frame of len bytes, rounded up.
+            uint32_t airtimeMs(const uint8_t len) const
+                { return(((uint32_t(overheadBytes) + len) * 8000U + bitRate - 1) / bitRate); }
+            // Estimated airtime used on channel in the current window.
+            uint32_t getAirtimeUsedMs(const int8_t channel) const
+                {
+                if((channel < 0) || (channel >= maxChannels)) { return(0); }
+                uint32_t sum = 0;
+                for(uint8_t b = 0; b < Buckets; ++b) { sum += airtime[channel][b]; }
+                return(sum);
+                }
+            // Frames waiting to be sent.
+            uint8_t getTXMsgsQueued() const { return(qCount); }
+            // Frames dropped after maxTXAttempts tries or for exceeding the budget.
+            uint16_t getTXMsgsDropped() const { return(txDropped); }
+
+            virtual bool begin() override { return(radio.begin()); }
+            virtual bool isAvailable() const override { return(radio.isAvailable()); }
+            virtual void preinit(const void *preconfig) override { radio.preinit(preconfig); }
+            virtual void panicShutdown() override { radio.panicShutdown(); }
+            virtual void getCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen, uint8_t &maxTXMsgLen) const override
+                {
+                radio.getCapacity(queueRXMsgsMin, maxRXMsgLen, maxTXMsgLen);
+                if(maxTXMsgLen > maxFrameLen) { maxTXMsgLen = maxFrameLen; }
+                }
+            virtual uint8_t getRXMsgsQueued() const override { return(radio.getRXMsgsQueued()); }
+            virtual const volatile uint8_t *peekRXMsg() const override { return(radio.peekRXMsg()); }
+            virtual void removeRXMsg() override { radio.removeRXMsg(); }
+            virtual uint8_t getRXErr() override { return(radio.getRXErr()); }
+            virtual bool handleInterruptSimple() override { return(radio.handleInterruptSimple()); }
+            virtual bool end() override { return(radio.end()); }
+
+            // Send at once (blocking as the wrapped radio does) if within the duty-cycle budget.
+            // Returns false without sending if over budget.
+            virtual bool sendRaw(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower power = TXnormal, bool listenAfter = false) override
+                { return(sendNow(buf, buflen, channel, power, listenAfter)); }
+
+            // Queue a copy of the frame to send from poll() and return immediately.
+            // Returns false if the frame is too long, the channel is invalid,
+            // the frame's airtime exceeds the channel's whole budget, or the queue is full.
+            virtual bool queueToSend(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower power = TXnormal) override
+                {
+                if((NULL == buf) || (0 == buflen) || (buflen > maxFrameLen) ||
+                   !fitsBudget(channel, buflen) || (qCount >= queueDepth)) { return(false); }
+                uint8_t i = qHead + qCount;
+                if(i >= queueDepth) { i -= queueDepth; }
+                TXFrame &f = queue[i];
+                memcpy(f.buf, buf, buflen);
+                f.len = buflen;
+                f.channel = channel;
+                f.power = power;
+                f.attempts = 0;
+                f.notBefore = getTimeMs() + backoff(0);
+                ++qCount;
+                return(true);
+                }
+
+            // Poll the wrapped radio, then send the next queued frame if it is due and within budget.
+            // At most one frame is sent per call, to bound the time taken.
+            virtual void poll() override
+                {
+                radio.poll();
+                pollTX();
+                }
+        };
+    }
+
+#endif
@@ -44,17 +44,6 @@
 // If DEFINED: Prints debug information to serial.
 //             !!! WARNING! THIS WILL CAUSE BLOCKING OF OVER 300 MS!!!
 #undef OTSIM900LINK_DEBUG
-// IF DEFINED:  Splits the send routine into two steps, rather than polling for a prompt.
-//              Should be avoided if possible, but may be necessary e.g. with the REV10 as
-//              the blocking poll may overrun a sub-cycle, triggering a WDT reset.
-//              This behaviour depends on the fact that the V0p2 cycle takes long enough
-//              between polls for the SIM900 to be ready to receive a packet, but not
-//              long enough to time out the send routine. // XXX
-#define OTSIM900LINK_SPLIT_SEND_TEST
-// IF DEFINED:  Flush until a fixed point in the sub-cycle. Note that this requires
-//              OTV0P2BASE::getSubCycleTime or equivalent to be passed in as a template param.
-//              May perform poorer/send junk in some circumstances (untested)
-#undef OTSIM900LINK_SUBCYCLE_SEND_TIMEOUT_TEST
 
 // OTSIM900Link macros for printing debug information to serial.
 #ifndef OTSIM900LINK_DEBUG
@@ -218,10 +207,74 @@ typedef const char *AT_t;
         public:
             // Max reliable baud to talk to SIM900 over OTSoftSerial2.
             constexpr static const uint16_t SIM900_MAX_baud = 9600;
+            // Max UDP payload in one AT+CIPSEND.
+            constexpr static const uint16_t SIM900_MAX_UDP_PAYLOAD = 1460;
+        };
+
+    /**
+     * @brief   Splits a UDP datagram from an OTSIM900Link with coalescing on
+     *          back into its frames, eg on the receiving server.
+     * @note    The datagram is one or more frames each as a length byte
+     *          (1--255) then that many bytes, with nothing after the last.
+     *
+     * Usage:
+     *     UDPCoalescedFrameReader r(buf, buflen);
+     *     const uint8_t *frame; uint8_t len;
+     *     while(r.next(frame, len)) { ... }
+     *     if(r.isMalformed()) { ... }
+     */
+    class UDPCoalescedFrameReader final
+        {
+        private:
+            const uint8_t *const buf;
+            const uint16_t buflen;
+            uint16_t pos = 0;
+            bool malformed = false;
+
+        public:
+            UDPCoalescedFrameReader(const uint8_t *const b, const uint16_t l)
+                : buf(b), buflen(l) { }
+
+            /**
+             * @brief   Gets the next frame.
+             * @param   frame:  set to point at the frame within the datagram.
+             * @param   len:    set to the frame length.
+             * @retval  True if a frame was found; false at the end of the
+             *          datagram, or if the rest of it is malformed.
+             */
+            bool next(const uint8_t *&frame, uint8_t &len)
+                {
+                if(malformed || (NULL == buf) || (pos >= buflen)) { return(false); }
+                const uint8_t l = buf[pos];
+                if((0 == l) || (l > buflen - pos - 1)) { malformed = true; return(false); }
+                frame = buf + pos + 1;
+                len = l;
+                pos += 1 + l;
+                return(true);
+                }
+
+            // True if next() stopped at a zero length or one overrunning the datagram.
+            bool isMalformed() const { return(malformed); }
         };
 
     /**
      * @note    To enable serial debug define 'OTSIM900LINK_DEBUG'
+     * @note    poll() never busy-waits for the SIM900: each AT command is sent
+     *          and its reply collected from whatever ser_t has ready, over as
+     *          many polls as needed, with at most maxReadsPerPoll reads per poll.
+     *          Where ser_t.available() is negative (eg OTSoftSerial2) read()
+     *          is taken to block until a char arrives or the line goes idle,
+     *          so the -1 from read() marks the end of a reply as before.
+     *          Otherwise (a buffered serial) a reply ends at a poll with
+     *          nothing new after something has arrived, or on timeout.
+     * @note    With txCoalesceBytes 0 one frame is held, replaced by each
+     *          queueToSend(), and sent as the whole UDP payload;
+     *          while it is being sent one more is held to send after it.
+     *          Otherwise frames are queued in a txCoalesceBytes buffer,
+     *          each with a leading length byte, until full, and all those
+     *          queued are sent together in one datagram as soon as possible,
+     *          saving an AT+CIPSEND exchange and UDP/IP overhead per frame.
+     *          Use UDPCoalescedFrameReader to split them at the far end.
      * @todo    SIM900 has a low power state which stays connected to network
      *             - Not sure how much power reduced
      *             - If not sending often may be more efficient to power up and wait for connect each time
@@ -233,9 +286,14 @@ typedef const char *AT_t;
 #ifdef OTSoftSerial2_DEFINED
         = OTV0P2BASE::OTSoftSerial2<rxPin, txPin, OTSIM900LinkBase::SIM900_MAX_baud>
 #endif // OTSoftSerial2_DEFINED
+    , uint16_t txCoalesceBytes = 0
     >
     class OTSIM900Link final : public OTSIM900LinkBase
         {
+            static_assert(txCoalesceBytes <= SIM900_MAX_UDP_PAYLOAD, "coalesced datagram too big for SIM900");
+            static_assert((0 == txCoalesceBytes) || (txCoalesceBytes >= 2), "no room for a frame");
+            static constexpr bool coalesce = (0 != txCoalesceBytes);
+
             // Maximum number of significant chars in the SIM900 response.
             // Minimising this reduces stack and/or global space pressures.
             static constexpr int MAX_SIM900_RESPONSE_CHARS = 64;
@@ -267,6 +325,11 @@ typedef const char *AT_t;
                 { return OTV0P2BASE::getElapsedSecondsLT(oldTime, getCurrentSeconds()) > duration; }
 
         public:
+            // Maximum number of ser.read() calls in one poll().
+            // With a blocking read of one char time plus a fixed idle timeout
+            // this bounds the time spent in poll() whatever the SIM900 sends.
+            static constexpr uint8_t maxReadsPerPoll = 2 * MAX_SIM900_RESPONSE_CHARS;
+
             /**
              * @brief    Constructor. Initializes softSerial and sets PWR_PIN.
              * @param    pwrPin       SIM900 power on/off pin
@@ -311,26 +374,15 @@ typedef const char *AT_t;
              * @param   Txpower ignored
              * @retval  returns true if send process inited.
              * @note    requires calling of poll() to check if message sent successfully
+             * @note    Queues the frame as for queueToSend() rather than blocking
+             *          waiting for the SIM900's prompt.
              */
             virtual bool sendRaw(const uint8_t *buf, uint8_t buflen,
-                    int8_t /*channel*/ = 0, TXpower /*power*/ = TXnormal,
+                    int8_t channel = 0, TXpower power = TXnormal,
                     bool /*listenAfter*/ = false) override
                 {
                 OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("Send Raw")
-                initUDPSend(buflen);
-                // Wait for the module to indicate it is ready to receive the frame.
-                // A response of '>' indicates module is ready.
-                if (flushUntil('>'))
-                    {
-                    UDPSend((const char *) buf, buflen);
-                    OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*success")
-                    return true;
-                    }
-                else
-                    {
-                    OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*fail")
-                    return false;
-                    }
+                return(queueToSend(buf, buflen, channel, power));
                 }
 
             /**
@@ -341,22 +393,44 @@ typedef const char *AT_t;
              * @param   Txpower ignored.
              * @retval  returns true if send process inited.
              * @note    requires calling of poll() to check if message sent successfully.
+             * @note    Without coalescing (txCoalesceBytes == 0) replaces
+             *          any frame queued, so the freshest is sent.
+             *          A frame already being sent is not touched:
+             *          a frame queued meanwhile waits to be sent after it.
+             * @note    When coalescing, appends the frame to those queued,
+             *          failing if it does not fit in the space left.
              */
             virtual bool queueToSend(const uint8_t *buf, uint8_t buflen, int8_t /*channel*/ = 0,
                     TXpower = TXnormal) override
                 {
-                if ((buf == NULL) || (buflen > sizeof(txQueue)))
+                if (buf == NULL)
                     return false;    //
-//        if ((buf == NULL) || (buflen > sizeof(txQueue)) || (txMessageQueue >= maxTxQueueLength)) return false;    //
-//        // Increment message queue
-//        txMessageQueue++; //
-                    // copy into queue here?
-                txMessageQueue = 1;
-                memcpy(txQueue, buf, buflen); // Last message queued is copied to buffer, ensuring freshest message is sent.
-                txMsgLen = buflen;
+                if (!coalesce) {
+                    if (buflen > sizeof(txQueue)) return false;
+                    // Last message queued is copied to buffer, ensuring freshest message is sent.
+                    if (0 != txSendLen) {
+                        // txQueue is being sent, so hold this until that is done.
+                        memcpy(txPending, buf, buflen);
+                        txPendingLen = buflen;
+                        txMessageQueue = 2;
+                        return true;
+                    }
+                    memcpy(txQueue, buf, buflen);
+                    txMsgLen = buflen;
+                    txMessageQueue = 1;
+                    return true;
+                }
+                if ((0 == buflen) || (255 == txMessageQueue) || (1U + buflen > sizeof(txQueue) - txMsgLen)) return false;
+                txQueue[txMsgLen] = buflen;
+                memcpy(txQueue + txMsgLen + 1, buf, buflen);
+                txMsgLen += 1U + buflen;
+                ++txMessageQueue;
                 return true;
                 }
 
+            // Number of frames queued to send, including any being sent.
+            uint8_t getTXMsgsQueued() const { return(txMessageQueue); }
+
             // Returns true if radio is present, independent of its power state.
             virtual bool isAvailable() const override { return(bAvailable); }
 
@@ -384,12 +458,15 @@ typedef const char *AT_t;
                         messageCounter = 0;
                         retryTimer = -1;
                         txMsgLen = 0;
+                        txSendLen = 0;
+                        txPendingLen = 0;
                         txMessageQueue = 0;
                         bAvailable = false;
                         state = GET_STATE;
                         break;
-                    case GET_STATE: // Check SIM900 is present and can be talked to. Takes up to 220 ticks?
+                    case GET_STATE: // Check SIM900 is present and can be talked to.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*GET_STATE")
+                        if (!exchange(&OTSIM900Link::sendAT)) break;  // Still waiting for the reply.
                         if (isSIM900Replying()) {
                             bAvailable = true;
                         }
@@ -408,32 +485,36 @@ typedef const char *AT_t;
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*WAIT_PWR_LOW")
                         if (waitedLongEnough(powerTimer, powerLockOutDuration)) state = START_UP;
                         break;
-                    case START_UP: // takes up to 150 ticks
+                    case START_UP:
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*WAIT_FOR_REPLY")
+                        if (!exchange(&OTSIM900Link::sendAT)) break;
                         if (isSIM900Replying()) {
                             state = CHECK_PIN;
                         } else {
                             state = GET_STATE;
                         }
                         break;
-                    case CHECK_PIN: // Set pin if required. Takes ~100 ticks to exit.
+                    case CHECK_PIN: // Set pin if required.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*CHECK_PIN")
+                        if (!exchange(&OTSIM900Link::sendPINQuery)) break;
                         if (isPINRequired()) {
                             state = WAIT_FOR_REGISTRATION;
                         }
                         setRetryLock();
                         //                if(setPIN()) state = PANIC;// TODO make sure setPin returns true or false
                         break;
-                    case WAIT_FOR_REGISTRATION: // Wait for registration to GSM network. Stuck in this state until success. Takes ~150 ticks to exit.
+                    case WAIT_FOR_REGISTRATION: // Wait for registration to GSM network. Stuck in this state until success.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*WAIT_FOR_REG")
+                        if (!exchange(&OTSIM900Link::sendRegistrationQuery)) break;
                         if (isRegistered()) {
                             state = SET_APN;
                         }
                         setRetryLock();
                         break;
-                    case SET_APN: // Attempt to set the APN. Stuck in this state until success. Takes up to 200 ticks to exit.
+                    case SET_APN: // Attempt to set the APN. Stuck in this state until success.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*SET_APN")
-                        if (setAPN()) {
+                        if (!exchange(&OTSIM900Link::sendSetAPN)) break;
+                        if (isAPNSet()) {
                             messageCounter = 0;
                             state = START_GPRS;
                         }
@@ -441,29 +522,35 @@ typedef const char *AT_t;
                         break;
                     case START_GPRS:  // Start GPRS context.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN("*START_GPRS")
-                        {
-                            uint8_t udpState = checkUDPStatus();
+                        if (!startingGPRS) {
+                            if (!exchange(&OTSIM900Link::sendStatusQuery)) break;
+                            const uint8_t udpState = getUDPStatus();
                             if (3 == udpState) {  // GPRS active, UDP shut.
                                 state = GET_IP;
+                                break;
                             } else if(0 == udpState) {  // GPRS shut.
-                                startGPRS();
+                                startingGPRS = true;
                             }
-                            setRetryLock();
                         }
-//                          if(!startGPRS()) state = GET_IP;  // TODO: Add retries, Option to shut GPRS here (probably needs a new state)
+                        if (startingGPRS) {  // Reply to AT+CIICR is unreliable so is ignored.
+                            if (!exchange(&OTSIM900Link::sendStartGPRS)) break;
+                            startingGPRS = false;
+                        }
+                        setRetryLock();
                         // FIXME 20160505: Need to work out how to handle this. If signal is marginal this will fail.
                         break;
-                    case GET_IP: // Takes up to 200 ticks to exit.
+                    case GET_IP:
                         // For some reason, AT+CIFSR must done to be able to do any networking.
                         // It is the way recommended in SIM900_Appication_Note.pdf section 3: Single Connections.
                         // This was not necessary when opening and shutting GPRS as in OTSIM900Link v1.0
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*GET IP")
-                        getIP();
+                        if (!exchange(&OTSIM900Link::sendGetIP)) break;
                         state = OPEN_UDP;
                         break;
-                    case OPEN_UDP: // Open a udp socket. Takes ~200 ticks to exit.
+                    case OPEN_UDP: // Open a udp socket.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*OPEN UDP")
-                        if (openUDPSocket()) {
+                        if (!exchange(&OTSIM900Link::sendOpenUDP)) break;
+                        if (isUDPOpen()) {
                             state = IDLE;
                         }
                         setRetryLock();
@@ -473,10 +560,11 @@ typedef const char *AT_t;
                             state = WAIT_FOR_UDP;
                         }
                         break;
-                    case WAIT_FOR_UDP: // Make sure UDP context is open. Takes up to 200 ticks to exit.
+                    case WAIT_FOR_UDP: // Make sure UDP context is open.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*WAIT_FOR_UDP")
                         {
-                            uint8_t udpState = checkUDPStatus();
+                            if (!exchange(&OTSIM900Link::sendStatusQuery)) break;
+                            const uint8_t udpState = getUDPStatus();
                             if (udpState == 1) {  // UDP connected
                                 state = INIT_SEND;
                             }
@@ -488,35 +576,32 @@ typedef const char *AT_t;
                             }
                         }
                         break;
-#if !defined(OTSIM900LINK_SPLIT_SEND_TEST)  // FIXME DE20170825: test this branch still works
-                    case INIT_SEND: // Attempt to send a message. Takes ~100 ticks to exit.
-                        OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*SENDING")
-                        if (0 < txMessageQueue) { // Check to make sure it is near the start of the subcycle to avoid overrunning.
-                            // TODO logic to check if send attempt successful
-                            sendRaw(txQueue, txMsgLen); /// @note can't use strlen with encrypted/binary packets
-                            --txMessageQueue;
-                        }
-                        if (0 == txMessageQueue) state = IDLE;
-                        break;
-#else // OTSIM900LINK_SPLIT_SEND_TEST
-                    case INIT_SEND: // Attempt to send a message. Takes ~100 ticks to exit.
+                    case INIT_SEND: // Attempt to send a message.
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*SENDING")
+                        if (!exchange(&OTSIM900Link::sendAT)) break;
                         if(!isSIM900Replying()) state = RESET;
                         if (0 < txMessageQueue) { // Check that we have a message queued
-                            // TODO logic to check if send attempt successful
-                            initUDPSend(txMsgLen); /// @note can't use strlen with encrypted/binary packets
+                            // Send what is queued now; more may be queued meanwhile.
+                            txSendLen = txMsgLen;
+                            txSendMsgs = txMessageQueue;
+                            initUDPSend(txSendLen); /// @note can't use strlen with encrypted/binary packets
                             state = WRITE_PACKET;
                         } else { state = IDLE; }
                         break;
-                    case WRITE_PACKET:
-                        --txMessageQueue;
-                        UDPSend((const char *) txQueue, txMsgLen);
-                        state = INIT_SEND;
+                    case WRITE_PACKET: // Send the frame once the SIM900 prompts for it with '>'.
+                        if (isPromptSeen()) {
+                            UDPSend((const char *) txQueue, txSendLen);
+                            removeSent();
+                            state = INIT_SEND;
+                        } else if (waitedLongEnough(commandTime, replyTimeOut)) {
+                            OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*no prompt")
+                            state = RESET;  // Frame stays queued for after the reset.
+                        }
                         break;
-#endif // OTSIM900LINK_SPLIT_SEND_TEST
 
                     case RESET:
                         OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*RESET")
+                        abandonSend();  // Anything being sent stays queued.
                         state = GET_STATE;
                         break;
                     case PANIC:
@@ -541,9 +626,13 @@ typedef const char *AT_t;
             // Power up/down takes a while, and prints stuff we want to ignore to the serial connection.
             // DE20160703:Increased duration due to startup issues.
             static constexpr uint8_t powerLockOutDuration = 10 + powerPinToggleDuration;
-            // Time in seconds we should block for while polling for a specific character.
-            // DE20170824: Reduced from 10s to avoid watchdog resets. Seems to work acceptably.
+            // Time in seconds to wait for a reply or prompt before giving up.
+            // Checked across polls, so this no longer blocks poll().
             static constexpr uint8_t flushTimeOut = 1;
+            // Time in seconds from sending a command to give up on its reply
+            // or prompt, however much the SIM900 is still sending, and reset.
+            // Allows for a reply collected over several polls from a buffered serial.
+            static constexpr uint8_t replyTimeOut = 30;
             // Standard Responses
 
             // Software serial: for V0p2 boards (eg REV10) expected to be of type:
@@ -560,6 +649,16 @@ typedef const char *AT_t;
             volatile uint8_t txMessageQueue = 0; // Number of frames currently queued for TX.
             const OTSIM900LinkConfig_t *config = NULL;
             OTSIM900LinkState oldState;
+            // Reply to the command last sent, collected over one or more polls.
+            // Zero-filled beyond replyLen; excess chars are discarded.
+            char reply[MAX_SIM900_RESPONSE_CHARS];
+            uint8_t replyLen = 0;
+            // True from sending a command until its reply is complete.
+            bool awaitingReply = false;
+            // True while START_GPRS waits for the reply to AT+CIICR.
+            bool startingGPRS = false;
+            // Time (from getCurrentSeconds()) that the last command was sent.
+            uint8_t commandTime = 0;
             /************************* Private Methods *******************************/
 
         private:
@@ -571,6 +670,9 @@ typedef const char *AT_t;
                 if (newState != oldState) {
                     oldState = newState;
                     retryTimer = -1;
+                    // Abandon any exchange in progress, eg when forced into RESET.
+                    awaitingReply = false;
+                    startingGPRS = false;
                     if (WAIT_FOR_REGISTRATION == newState) retriesRemaining = 30; // More retries to allow for poor signal.
                     else retriesRemaining = maxRetriesDefault;  // default case.
                 }
@@ -603,30 +705,70 @@ typedef const char *AT_t;
 
             // Serial functions
             /**
-             * @brief   Fills a buffer with characters from ser.read(). Exits when array filled, or if ser.read() times out.
-             * @note    Safe for buffer passed in to be no larger than length.
-             * @param   data:   Data buffer to write to.
-             * @param   length: Length of data buffer.
-             * @retval  Number of characters received before time out.
+             * @brief   Sends a command with sendCommand() unless already sent,
+             *          then collects what is available of its reply.
+             * @param   sendCommand: writes the command to ser.
+             * @retval  True once the whole reply is in reply[], ready to parse.
              */
-            uint8_t readMany(char * const data, const uint8_t length)
+            bool exchange(void (OTSIM900Link::*const sendCommand)())
                 {
-                // Pointer to write data to.
-                char *dp = data;
-                // Init array to all zeros.
-                memset(data, 0, length);
-                // Loop through filling array until full,
-                // or until ser.read() returns -1 on timeout.
-                while ((dp-data) < length) {
+                if (!awaitingReply) {
+                    memset(reply, 0, sizeof(reply));
+                    replyLen = 0;
+                    (this->*sendCommand)();
+                    commandTime = uint8_t(getCurrentSeconds());
+                    awaitingReply = true;
+                }
+                if (!collectReply()) {
+                    // Don't wait forever for a SIM900 that never stops talking.
+                    if (waitedLongEnough(commandTime, replyTimeOut)) {
+                        OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING("*reply timeout")
+                        awaitingReply = false;
+                        state = RESET;
+                    }
+                    return(false);
+                }
+                awaitingReply = false;
+                return(true);
+                }
+            /**
+             * @brief   Adds chars from ser.read() to reply[], without waiting for more.
+             * @note    Makes at most maxReadsPerPoll reads. Chars beyond the size
+             *          of reply[] are read and discarded.
+             * @retval  True if the reply is complete.
+             */
+            bool collectReply()
+                {
+                bool gotAny = false;
+                for (uint8_t i = maxReadsPerPoll; i > 0; --i) {
                     const int ic = ser.read();
-                    if (ic == -1) {
-                        return(uint8_t(data-dp)); // Return length of data.
+                    if (-1 == ic) {
+                        // A blocking read only gives up once the line is idle.
+                        if (ser.available() < 0) { return(true); }
+                        // Else done when a poll finds nothing more, or nothing ever came.
+                        if (gotAny) { return(false); }
+                        return((0 != replyLen) || waitedLongEnough(commandTime, flushTimeOut));
                     }
-                    *dp++ = char(ic);
+                    gotAny = true;
+                    if (replyLen < sizeof(reply)) { reply[replyLen++] = char(ic); }
+                }
+                return(false); // More to come: carry on next poll.
+                }
+            /**
+             * @brief   Reads what is available looking for the '>' send prompt.
+             * @note    Makes at most maxReadsPerPoll reads.
+             *          The caller times out from when AT+CIPSEND was sent,
+             *          however much else (eg the command echo) is received.
+             * @retval  True if the prompt has been seen.
+             */
+            bool isPromptSeen()
+                {
+                for (uint8_t i = maxReadsPerPoll; i > 0; --i) {
+                    const int ic = ser.read();
+                    if (-1 == ic) { break; }
+                    if ('>' == ic) { return(true); }
                 }
-                // Should not block forever: read should timeout and return -1.
-                while (-1 != ser.read()) {}
-                return(length); // Data is maximum length.
+                return(false);
                 }
             /**
              * @brief   Utility function for printing from config structure.
@@ -647,136 +789,90 @@ typedef const char *AT_t;
                     }
                 }
 
-            // write AT commands
-            /**
-             * @brief   Checks module ID.
-             * @fixme    DOES NOT CHECK
-             * @param   name:   pointer to array to compare name with.
-             * @param   length: length of array name.
-             * @retval  True if ID recovered successfully.
-             */
-            bool isModulePresent()
+            // Write AT commands.
+            // Each is sent with exchange(), and its reply
+            // is parsed from reply[] by the matching check below.
+            void sendAT() { ser.println(AT_START); }
+            void sendPINQuery()
                 {
-                char data[OTV0P2BASE::fnmin(32, MAX_SIM900_RESPONSE_CHARS)];
                 ser.print(AT_START);
-                ser.println(ATc_GET_MODULE);
-                readMany(data, sizeof(data));
-                OTSIM900LINK_DEBUG_SERIAL_PRINT(data)
-                OTSIM900LINK_DEBUG_SERIAL_PRINTLN()
-                return true;
-                }
-            /**
-             * @brief   Checks connected network.
-             * @fixme   DOES NOT CHECK
-             * @param   buffer: pointer to array to store network name in.
-             * @param   length: length of buffer.
-             * @param   True if connected to network.
-             * @note
-             */
-            bool isNetworkCorrect()
-                {
-                char data[MAX_SIM900_RESPONSE_CHARS];
-                ser.print(AT_START);
-                ser.print(AT_NETWORK);
+                ser.print(AT_PIN);
                 ser.println(ATc_QUERY);
-                readMany(data, sizeof(data));
-                return true;
                 }
-            /**
-             * @brief   Check if module connected and registered (GSM and GPRS).
-             * @retval  True if registered.
-             * @note    reply: b'AT+CREG?\r\n\r\n+CREG: 0,5\r\n\r\n'OK\r\n'
-             */
-            bool isRegistered()
+            void sendRegistrationQuery()
                 {
-                //  Check the GSM registration via AT commands ( "AT+CREG?" returns "+CREG:x,1" or "+CREG:x,5"; where "x" is 0, 1 or 2).
-                //  Check the GPRS registration via AT commands ("AT+CGATT?" returns "+CGATT:1" and "AT+CGREG?" returns "+CGREG:x,1" or "+CGREG:x,5"; where "x" is 0, 1 or 2).
-                char data[MAX_SIM900_RESPONSE_CHARS];
                 ser.print(AT_START);
                 ser.print(AT_REGISTRATION);
                 ser.println(ATc_QUERY);
-                readMany(data, sizeof(data));
-                // response stuff
-                const char *dataCut = getResponse(data, sizeof(data), ' '); // first ' ' appears right before useful part of message
-                if(NULL == dataCut) { return(false); }
-                // Expected response '1' or '5'.
-                return((dataCut[2] == '1') || (dataCut[2] == '5'));
                 }
-
-            /**
-             * @brief   Set Access Point Name and start task.
-             * @retval  True if APN set.
-             * @note    reply: b'AT+CSTT="mobiledata"\r\n\r\nOK\r\n'
-             */
-            bool setAPN()
+            void sendSetAPN()
                 {
-                char data[MAX_SIM900_RESPONSE_CHARS];
                 ser.print(AT_START);
                 ser.print(AT_SET_APN);
                 ser.print(ATc_SET);
                 printConfig(config->APN);
                 ser.println();
-                readMany(data, sizeof(data));
-                // response stuff
-                const char *dataCut = getResponse(data, sizeof(data), 0x0A);
-                if(NULL == dataCut) { return(-1); }
-                return(dataCut[2] == 'O'); // Expected response 'OK'.
                 }
-            /**
-             * @brief   Start GPRS connection.
-             * @retval  True if connected.
-             * @note    check power, check registered, check gprs active.
-             * @note    reply: b'AT+CIICR\r\n\r\nOK\r\nAT+CIICR\r\n\r\nERROR\r\n' (not sure why OK then ERROR happens.)
-             */
-            bool startGPRS()
+            // Reply: b'AT+CIICR\r\n\r\nOK\r\nAT+CIICR\r\n\r\nERROR\r\n' (not sure why OK then ERROR happens.)
+            void sendStartGPRS()
                 {
-                char data[OTV0P2BASE::fnmin(16, MAX_SIM900_RESPONSE_CHARS)];
                 ser.print(AT_START);
                 ser.println(AT_START_GPRS);
-                readMany(data, sizeof(data));
-
-                // response stuff
-                const char *dataCut = getResponse(data, sizeof(data), 0x0A); // unreliable
-                if(NULL == dataCut) { return(-1); }
-                return ((dataCut[0] == 'O') & (dataCut[1] == 'K'));
                 }
-            /**
-             * @brief   Shut GPRS connection.
-             * @retval  True if shut.
-             */
-            bool shutGPRS()
+            // For some reason must be done before any networking.
+            // Reply: b'AT+CIFSR\r\n\r\n172.16.101.199\r\n'
+            void sendGetIP()
+                {
+                ser.print(AT_START);
+                ser.println(AT_GET_IP);
+                }
+            void sendStatusQuery()
+                {
+                ser.print(AT_START);
+                ser.println(AT_STATUS);
+                }
+            void sendOpenUDP()
                 {
-                char data[MAX_SIM900_RESPONSE_CHARS]; // Was 96: that's a LOT of stack!
                 ser.print(AT_START);
-                ser.println(AT_SHUT_GPRS);
-                readMany(data, sizeof(data));
+                ser.print(AT_START_UDP);
+                ser.print("=\"UDP\",");
+                ser.print('\"');
+                printConfig(config->UDP_Address);
+                ser.print("\",\"");
+                printConfig(config->UDP_Port);
+                ser.println('\"');
+                }
 
-                // response stuff
-                const char *dataCut = getResponse(data, sizeof(data), 0x0A);
+            /**
+             * @brief   Checks module for response.
+             * @retval  True if correct response.
+             * @note     reply: b'AT\r\n\r\nOK\r\n'
+             */
+            bool isSIM900Replying() const { return ('A' == *reply); }
+            /**
+             * @brief   Check if module connected and registered (GSM and GPRS).
+             * @retval  True if registered.
+             * @note    reply: b'AT+CREG?\r\n\r\n+CREG: 0,5\r\n\r\n'OK\r\n'
+             */
+            bool isRegistered() const
+                {
+                //  Check the GSM registration via AT commands ( "AT+CREG?" returns "+CREG:x,1" or "+CREG:x,5"; where "x" is 0, 1 or 2).
+                //  Check the GPRS registration via AT commands ("AT+CGATT?" returns "+CGATT:1" and "AT+CGREG?" returns "+CGREG:x,1" or "+CGREG:x,5"; where "x" is 0, 1 or 2).
+                const char *dataCut = getResponse(reply, sizeof(reply), ' '); // first ' ' appears right before useful part of message
                 if(NULL == dataCut) { return(false); }
-                // Expected response 'SHUT OK'.
-                return (*dataCut == 'S');
+                // Expected response '1' or '5'.
+                return((dataCut[2] == '1') || (dataCut[2] == '5'));
                 }
             /**
-             * @brief   Get IP address from SIM900. Note that the function just returns a bool
-             *          as we currently have no need to know our IP address.
-             * @retval  True if no errors.
-             * @note    reply: b'AT+CIFSR\r\n\r\n172.16.101.199\r\n'
+             * @brief   Check Access Point Name set and task started.
+             * @retval  True if APN set.
+             * @note    reply: b'AT+CSTT="mobiledata"\r\n\r\nOK\r\n'
              */
-            bool getIP()
+            bool isAPNSet() const
                 {
-                char data[MAX_SIM900_RESPONSE_CHARS];
-                ser.print(AT_START);
-                ser.println(AT_GET_IP);
-                readMany(data, sizeof(data));
-                // response stuff
-                const char *dataCut = getResponse(data, sizeof(data), 0x0A);
+                const char *dataCut = getResponse(reply, sizeof(reply), 0x0A);
                 if(NULL == dataCut) { return(false); }
-                // All error messages will start with a '+'.
-                if (*dataCut == '+')
-                    { return(false); }
-                else
-                    { return(true); }
+                return(dataCut[2] == 'O'); // Expected response 'OK'.
                 }
             /**
              * @brief   Check if UDP open.
@@ -802,15 +898,10 @@ typedef const char *AT_t;
              *
              *
              */
-            uint8_t checkUDPStatus()
+            uint8_t getUDPStatus() const
                 {
-                char data[MAX_SIM900_RESPONSE_CHARS];
-                ser.print(AT_START);
-                ser.println(AT_STATUS);
-                readMany(data, sizeof(data));
-
                 // First ' ' appears right before useful part of message.
-                const char *dataCut = getResponse(data, sizeof(data), ' ');
+                const char *dataCut = getResponse(reply, sizeof(reply), ' ');
                 if(NULL == dataCut) { return(0); }
                 if (*dataCut == 'C')
                     return 1; // expected string is 'CONNECT OK'. no other possible string begins with C
@@ -821,36 +912,7 @@ typedef const char *AT_t;
                 else
                     return 0;
                 }
-            /**
-             * @brief   Get signal strength.
-             * @todo    Return /print something?
-             */
-            uint8_t getSignalStrength()
-                {
-                char data[OTV0P2BASE::fnmin(32, MAX_SIM900_RESPONSE_CHARS)];
-                ser.print(AT_START);
-                ser.println(AT_SIGNAL);
-                readMany(data, sizeof(data));
-                OTSIM900LINK_DEBUG_SERIAL_PRINTLN(data)
-                // response stuff
-                getResponse(data, sizeof(data), ' '); // first ' ' appears right before useful part of message
-                return 0;
-                }
 
-            /**
-             * @brief   Set verbose errors
-             * @param   level: 0 is no error codes, 1 is with codes, 2 is human readable descriptions.
-             */
-            void verbose(uint8_t level)
-                {
-                char data[MAX_SIM900_RESPONSE_CHARS];
-                ser.print(AT_START);
-                ser.print(AT_VERBOSE_ERRORS);
-                ser.print(ATc_SET);
-                ser.println((char) (level + '0'));
-                readMany(data, sizeof(data));
-            OTSIM900LINK_DEBUG_SERIAL_PRINTLN(data)
-            }
         /**
          * @brief   Enter PIN code
          * @todo    Check return value?
@@ -862,14 +924,11 @@ typedef const char *AT_t;
                 {
                 return 0;
                 } // do not attempt to set PIN if NULL pointer.
-            char data[MAX_SIM900_RESPONSE_CHARS];
             ser.print(AT_START);
             ser.print(AT_PIN);
             ser.print(ATc_SET);
             printConfig(config->PIN);
             ser.println();
-//        readMany(data, sizeof(data));  // todo redundant until function properly implemented.
-//            OTSIM900LINK_DEBUG_SERIAL_PRINTLN(data)
             return true;
             }
         /**
@@ -877,54 +936,14 @@ typedef const char *AT_t;
          * @retval  True if SIM card unlocked.
          * @note    reply: b'AT+CPIN?\r\n\r\n+CPIN: READY\r\n\r\nOK\r\n'
          */
-        bool isPINRequired()
+        bool isPINRequired() const
             {
-            char data[OTV0P2BASE::fnmin(40, MAX_SIM900_RESPONSE_CHARS)];
-            ser.print(AT_START);
-            ser.print(AT_PIN);
-            ser.println(ATc_QUERY);
-            readMany(data, sizeof(data));
-
-            // response stuff
             // First ' ' appears right before useful part of message
-            const char *dataCut = getResponse(data, sizeof(data), ' ');
+            const char *dataCut = getResponse(reply, sizeof(reply), ' ');
             if(NULL == dataCut) { return(false); }
             return('R' == *dataCut);  // Expected string is 'READY'. no other possible string begins with R.
             }
 
-        /**
-         * @brief   Blocks process until terminatingChar received.
-         * @param   terminatingChar:    Character to block until.
-         * @retval  True if character found, or false on 1000ms timeout
-         * @note    Blocks main loop but not interrupts.
-         */
-        bool flushUntil(uint8_t _terminatingChar)
-            {
-            const uint8_t terminatingChar = _terminatingChar;
-#if !defined(OTSIM900LINK_SUBCYCLE_SEND_TIMEOUT_TEST)
-            // Quit once over a second has passed.
-            // Note, 1 second means that it may not listen for long enough.
-            // On the other hand, 2 or more seconds is more likely to trigger a watchdog reset.
-            const uint8_t endTime = getCurrentSeconds() + flushTimeOut;
-            while (getCurrentSeconds() <= endTime)
-#else // OTSIM900LINK_SUBCYCLE_SEND_TIMEOUT_TEST
-            // Quit with a reasonable amount of time left in the cycle.
-            // so that we can exit in time to service the watchdog timer.
-            constexpr uint8_t endTime = 220; // May exit prematurely if late in minor cycle.  FIXME
-            while (OTV0P2BASE::getSubCycleTime() <= endTime)
-#endif // OTSIM900LINK_SUBCYCLE_SEND_TIMEOUT_TEST
-                {
-                const uint8_t c = uint8_t(ser.read());
-                if (c == terminatingChar)
-                    return true;
-                }
-#if 0
-            OTSIM900LINK_DEBUG_SERIAL_PRINTLN_FLASHSTRING(" Timeout")
-            OTSIM900LINK_DEBUG_SERIAL_PRINTLN(getCurrentSeconds())
-#endif
-            return false;
-            }
-
         /**
          * @brief   Finds the first occurrence of a character within a buffer and returns a pointer to the next element.
          * @param   data:       pointer to array containing response from device.
@@ -934,7 +953,7 @@ typedef const char *AT_t;
          *
          * MUST CHECK RESPONSE AGAINST NULL FIRST
          */
-        const char *getResponse(const char * const data, const uint8_t dataLength, const char startChar)
+        static const char *getResponse(const char * const data, const uint8_t dataLength, const char startChar)
         {
             const char *dp = data;  // read only pointer to data buffer.
             // Ignore echo of command
@@ -947,27 +966,13 @@ typedef const char *AT_t;
         }
 
         /**
-         * @brief   Open UDP socket.
-         * @param   array containing server IP
+         * @brief   Check UDP socket opened.
          * @retval  True if UDP opened
          * @note    reply: b'AT+CIPSTART="UDP","0.0.0.0","9999"\r\n\r\nOK\r\n\r\nCONNECT OK\r\n'
          */
-        bool openUDPSocket()
+        bool isUDPOpen() const
             {
-            char data[MAX_SIM900_RESPONSE_CHARS];
-            memset(data, 0, sizeof(data));
-            ser.print(AT_START);
-            ser.print(AT_START_UDP);
-            ser.print("=\"UDP\",");
-            ser.print('\"');
-            printConfig(config->UDP_Address);
-            ser.print("\",\"");
-            printConfig(config->UDP_Port);
-            ser.println('\"');
-            // Implement check here
-            readMany(data, sizeof(data));
-            // response stuff
-            const char *dataCut = getResponse(data, sizeof(data), 0x0A);
+            const char *dataCut = getResponse(reply, sizeof(reply), 0x0A);
             if(NULL == dataCut) { return(false); }
             OTSIM900LINK_DEBUG_SERIAL_PRINTLN(dataCut)
             return !('E' == *dataCut);  // Returns ERROR on fail, else successfully opened UDP.
@@ -985,38 +990,24 @@ typedef const char *AT_t;
             return true;
             }
         /**
-         * @brief   Send a UDP frame.
-         * @param   frame:  Pointer to array containing frame to send.
+         * @brief   Start sending a UDP frame; the SIM900 prompts for it with '>'.
          * @param   length: Length of frame.
-         * @retval  True if send successful.
          * @note    On Success: b'AT+CIPSEND=62\r\n\r\n>' echos back input b'\r\nSEND OK\r\n'
          */
-        void initUDPSend(uint8_t length)
+        void initUDPSend(uint16_t length)
         {
             messageCounter++; // increment counter
             ser.print(AT_START);
             ser.print(AT_SEND_UDP);
             ser.print('=');
             ser.println(length);
+            commandTime = uint8_t(getCurrentSeconds());
         }
-        inline void UDPSend(const char *frame, uint8_t length)
+        inline void UDPSend(const char *frame, uint16_t length)
         {
             (static_cast<Print *>(&ser))->write(frame, length);
         }
 
-        /**
-         * @brief   Checks module for response.
-         * @retval  True if correct response.
-         * @note     reply: b'AT\r\n\r\nOK\r\n'
-         */
-        bool isSIM900Replying()
-            {
-            char data[OTV0P2BASE::fnmin(16, MAX_SIM900_RESPONSE_CHARS)];
-            ser.println(AT_START);
-            readMany(data, sizeof(data));
-            return ('A' == *data);
-            }
-
         /**
          * @brief     Assigns OTSIM900LinkConfig config and does some basic validation. Must be called before begin()
          * @retval    returns true if assigned or false if config is NULL
@@ -1036,12 +1027,54 @@ typedef const char *AT_t;
             }
         }
 
+        /**
+         * @brief   Removes the frames just sent from the front of txQueue.
+         */
+        void removeSent()
+            {
+            if (!coalesce) {
+                // Any frame queued since is now the one to send.
+                txMsgLen = 0;
+                txMessageQueue = 0;
+                abandonSend();
+                return;
+            }
+            memmove(txQueue, txQueue + txSendLen, txMsgLen - txSendLen);
+            txMsgLen -= txSendLen;
+            txMessageQueue -= txSendMsgs;
+            txSendLen = 0;
+            }
+
+        /**
+         * @brief   Ends any send in progress, leaving its frames queued.
+         * @note    Without coalescing, a frame queued during the send
+         *          replaces the one that was being sent.
+         */
+        void abandonSend()
+            {
+            txSendLen = 0;
+            if (!coalesce && (0 != txPendingLen)) {
+                memcpy(txQueue, txPending, txPendingLen);
+                txMsgLen = txPendingLen;
+                txPendingLen = 0;
+                txMessageQueue = 1;
+            }
+            }
+
         volatile OTSIM900LinkState state = INIT;
-        uint8_t txMsgLen = 0; // This stores the length of the tx message. will have to be redone for multiple txQueue
-        static constexpr uint8_t maxTxQueueLength = 1;
+        // Bytes queued in txQueue: the frame, or length-prefixed frames when coalescing.
+        uint16_t txMsgLen = 0;
+        // Bytes and frames from the front of txQueue in the send in progress;
+        // txSendLen is non-zero only from AT+CIPSEND until sent or abandoned.
+        uint16_t txSendLen = 0;
+        uint8_t txSendMsgs = 0;
+        // Without coalescing, bytes in txPending, the frame queued during a send.
+        uint8_t txPendingLen = 0;
 
         // Putting this last in the structure.
-        uint8_t txQueue[64]; // 64 is maxTxMsgLen (from OTRadioLink)
+        uint8_t txQueue[coalesce ? txCoalesceBytes : 64]; // 64 is maxTxMsgLen (from OTRadioLink)
+        // Without coalescing, the frame queued while txQueue is being sent.
+        uint8_t txPending[coalesce ? 1 : sizeof(txQueue)];
 
     public:
         // define abstract methods here
@@ -1054,7 +1087,7 @@ typedef const char *AT_t;
             {
             queueRXMsgsMin = 0;
             maxRXMsgLen = 0;
-            maxTXMsgLen = 64;
+            maxTXMsgLen = !coalesce ? 64 : uint8_t(OTV0P2BASE::fnmin(255U, txCoalesceBytes - 1U));
             }
         ;
         virtual uint8_t getRXMsgsQueued() const override
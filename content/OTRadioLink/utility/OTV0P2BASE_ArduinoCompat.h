@@ -47,10 +47,22 @@ class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(static_cast<const char *>(string_literal)))
 #endif
 
+// PROGMEM attribute on Arduino places a constant in Flash.
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
 // pgm_read_byte() macro for Arduino reads one byte from Flash.
 #ifndef pgm_read_byte
 #define pgm_read_byte(p) (*reinterpret_cast<const char *>(p))
 #endif
+// pgm_read_word() and pgm_read_dword() read 16 and 32 bits from Flash.
+#ifndef pgm_read_word
+#define pgm_read_word(p) (*reinterpret_cast<const uint16_t *>(p))
+#endif
+#ifndef pgm_read_dword
+#define pgm_read_dword(p) (*reinterpret_cast<const uint32_t *>(p))
+#endif
 
 // Minimal skeleton matching Print to permit at least compilation and test on non-Arduino platforms.
 // Implementation is not necessarily efficient as assumed to be for (unit) test.
@@ -479,6 +479,7 @@ bool SetSecretKey::doCommand(char *const buf, const uint8_t buflen)
                 if (*tok2 == '*')
                     {
                     OTV0P2BASE::setPrimaryBuilding16ByteSecretKey (NULL);
+                    if(NULL != keyChangedFn) { keyChangedFn(); }
                     Serial.println(F("B clear"));
 #if 0 && defined(DEBUG)
                     uint8_t keyTest[16];
@@ -509,7 +510,10 @@ bool SetSecretKey::doCommand(char *const buf, const uint8_t buflen)
                         if(-1 == ib) { InvalidIgnored(); return(false); } // ERROR: abrupt exit.
                         newKey[i] = (uint8_t)ib;
                         }
-                    if(OTV0P2BASE::setPrimaryBuilding16ByteSecretKey(newKey))
+                    const bool set = OTV0P2BASE::setPrimaryBuilding16ByteSecretKey(newKey);
+                    // The stored key may have changed even on failure.
+                    if(NULL != keyChangedFn) { keyChangedFn(); }
+                    if(set)
                         { Serial.println(F("B set")); }
                     else
                         { Serial.println(F("!B")); } // ERROR: key not set
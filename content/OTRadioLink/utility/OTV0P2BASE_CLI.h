@@ -150,6 +150,8 @@ namespace CLI {
 
     // Set/clear secret key(s) ("K ...").
     // Will call the keysCleared() routine when keys have been cleared, eg to allow resetting of TX message counters.
+    // Will call the keyChanged() routine (if not NULL) whenever the key is set or cleared,
+    // eg to discard cached key material such as OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<...>::keyChanged.
     // Note that this may take significant time and will mess with the CPU clock.
     /**
      * @note    - keysCleared MUST be passed the appropriate function in order to ensure security.
@@ -164,8 +166,10 @@ namespace CLI {
     class SetSecretKey final : public CLIEntryBase
         {
         bool (*const keysClearedFn)();
+        void (*const keyChangedFn)();
         public:
-            SetSecretKey(bool (*keysCleared)()) : keysClearedFn(keysCleared) { }
+            SetSecretKey(bool (*keysCleared)(), void (*keyChanged)() = NULL)
+              : keysClearedFn(keysCleared), keyChangedFn(keyChanged) { }
             virtual bool doCommand(char *buf, uint8_t buflen);
         };
 
@@ -57,6 +57,20 @@ namespace OTV0P2BASE
     extern uint8_t crc7_5B_update_nz_final(uint8_t crc, uint8_t datum);
 
 
+    // Initial value (offset basis) for fnv1a32().
+    static const uint32_t fnv1a32_init = 2166136261U;
+
+    /**32-bit FNV-1a hash of len bytes, eg to index hash tables and filters.
+     * Quick and well spread, but NOT for error detection or anything security related.
+     * To continue a hash over more bytes pass the result back in as h.
+     */
+    inline uint32_t fnv1a32(const uint8_t *const p, const uint8_t len, uint32_t h = fnv1a32_init)
+        {
+        for(uint8_t i = 0; i < len; ++i) { h = (h ^ p[i]) * 16777619U; }
+        return(h);
+        }
+
+
     }
 
 
@@ -169,6 +169,104 @@ int8_t checkJSONMsgRXCRC(const uint8_t * const bptr, const uint8_t bufLen)
   return(checkJSONMsgRXCRC_ERR); // Bad (unterminated) message.
   }
 
+// Check the terminator just read and the CRC (if any) following it.
+bool JSONStatsRXTokenizer::endAt(const char c)
+  {
+  if(lenient) { state = TS_VALID; return(true); }
+  if(pos >= bufLen) { return(fail()); }
+  const uint8_t next = buf[pos];
+  // Raw message terminated with "}\0".
+  if('}' == c) { if('\0' != next) { return(fail()); } }
+  // TXed message terminated with '}'|0x80 and the CRC.
+  else if((crc != next) && !((0 == crc) && (0x80 == next))) { return(fail()); }
+  state = TS_VALID;
+  return(true);
+  }
+
+// Move to the next pair, returning false at the end or on error.
+bool JSONStatsRXTokenizer::next()
+  {
+  if(TS_START == state)
+    {
+    if((maxLen < 2) || ('{' != buf[0])) { return(fail()); }
+    pos = 1;
+    crc = '{';
+    state = TS_FIRST;
+    }
+  else if(TS_VALID == state) { return(false); } // Pair(s) already yielded.
+  if((TS_ERROR == state) || (pos >= maxLen)) { return(fail()); }
+
+  // Fetch the next char into c, updating the CRC; fail at the scan limit,
+  // unless lenient and at the end of the buffer, when c is '\0'.
+  char c;
+#define JSONStatsRXTokenizer_GET() \
+    { \
+    if(pos >= maxLen) { if(!lenient || (pos < bufLen)) { return(fail()); } c = '\0'; } \
+    else { c = char(buf[pos++]); crc = crc7_5B_update(crc, uint8_t(c)); } \
+    }
+
+  JSONStatsRXTokenizer_GET();
+  // Empty object.
+  if((TS_FIRST == state) && (('}' == c) || (char('}' | 0x80) == c))) { endAt(c); return(false); }
+
+  // "key":
+  if('"' != c) { return(fail()); }
+  key = reinterpret_cast<const char *>(buf + pos);
+  for( ; ; )
+    {
+    JSONStatsRXTokenizer_GET();
+    if('"' == c) { break; }
+    if((c < 32) || (c > 126) || ('\\' == c)) { return(fail()); }
+    }
+  keyLen = uint8_t(reinterpret_cast<const char *>(buf + pos - 1) - key);
+  JSONStatsRXTokenizer_GET();
+  if(':' != c) { return(fail()); }
+
+  // Value, then c is the char after it.
+  JSONStatsRXTokenizer_GET();
+  if('"' == c)
+    {
+    type = JSON_STRING;
+    value = 0;
+    str = reinterpret_cast<const char *>(buf + pos);
+    for( ; ; )
+      {
+      JSONStatsRXTokenizer_GET();
+      if('"' == c) { break; }
+      if((c < 32) || (c > 126) || ('\\' == c)) { return(fail()); }
+      }
+    strLen = uint8_t(reinterpret_cast<const char *>(buf + pos - 1) - str);
+    JSONStatsRXTokenizer_GET();
+    }
+  else
+    {
+    type = JSON_INT;
+    str = NULL;
+    strLen = 0;
+    const bool neg = ('-' == c);
+    if(neg) { JSONStatsRXTokenizer_GET(); }
+    if((c < '0') || (c > '9')) { return(fail()); }
+    int32_t v = 0;
+    do
+      {
+      v = (v * 10) + (c - '0');
+      if(v > 32768) { return(fail()); } // Out of int16_t range.
+      JSONStatsRXTokenizer_GET();
+      } while((c >= '0') && (c <= '9'));
+    if(neg) { v = -v; }
+    if(v > 32767) { return(fail()); }
+    value = int16_t(v);
+    }
+#undef JSONStatsRXTokenizer_GET
+
+  // More pairs, or the end of the message.
+  if(',' == c) { state = TS_NEXT; return(true); }
+  if(('}' == c) || (char('}' | 0x80) == c)) { return(endAt(c)); }
+  // Lenient, and the buffer ended just after the value.
+  if(lenient && ('\0' == c) && (pos >= bufLen)) { state = TS_VALID; return(true); }
+  return(fail());
+  }
+
 // Returns true iff if a valid key for OpenTRV subset of JSON.
 // Rejects keys containing " or \ or any chars outside the range [32,126]
 // to avoid having to escape anything.
@@ -453,6 +453,79 @@ uint8_t adjustJSONMsgForTXAndComputeCRC(char *bptr);
 static const int8_t checkJSONMsgRXCRC_ERR = -1;
 int8_t checkJSONMsgRXCRC(const uint8_t * const bptr, const uint8_t bufLen);
 
+// Single-pass tokenizer for a received raw JSON stats message,
+// in place in the RX buffer and without copying or allocation.
+// Validates the message and checks its CRC as checkJSONMsgRXCRC() does
+// while yielding each "key":value pair in turn with next(),
+// so the application need not make a second pass over the message.
+// Accepts the compact flat form written by SimpleStatsRotation,
+// eg {"@":"cdfb","T|C16":299,"H|%":83}, terminated either with '}'|0x80
+// followed by the CRC, or (raw) with "}\0";
+// values may be integers in the int16_t range or strings without escapes.
+// Anything else, including whitespace, makes the message invalid.
+//
+// Since the CRC can only be checked at the end, a pair yielded by next()
+// should not be acted upon until the message is known to be good:
+// isValid() becomes true as the last pair is yielded
+// (or when next() first returns false for an empty object).
+// Typical use:
+//     JSONStatsRXTokenizer t(buf, bufLen);
+//     while(t.next()) { ...stash t.key/t.keyLen/t.value... }
+//     if(t.isValid()) { ...use stashed pairs... }
+//
+// If lenient, for JSON that needs no CRC, eg already authenticated in the
+// body of a secure frame, the closing '}' or '}'|0x80 need not be followed
+// by anything, and the message may instead end with the buffer after a
+// value, as when the closing '}' is not sent in a full 'O' frame.
+class JSONStatsRXTokenizer final
+  {
+  public:
+    // Type of the value of the current pair.
+    enum valueType_t : uint8_t { JSON_INT, JSON_STRING };
+
+  private:
+    enum state_t : uint8_t { TS_START, TS_FIRST, TS_NEXT, TS_VALID, TS_ERROR };
+    const uint8_t * const buf;
+    // Bytes that may be scanned, and bytes in the buffer.
+    const uint8_t maxLen;
+    const uint8_t bufLen;
+    const bool lenient;
+    uint8_t pos;
+    uint8_t crc;
+    state_t state;
+
+    // Check the terminator just read and the CRC (if any) following it.
+    bool endAt(char c);
+    bool fail() { state = TS_ERROR; return(false); }
+
+  public:
+    // Wrap a received message of up to bufLen bytes, starting with '{'.
+    JSONStatsRXTokenizer(const uint8_t *b, uint8_t bl, bool lenient_ = false)
+      : buf(b), maxLen(fnmin(MSG_JSON_ABS_MAX_LENGTH, bl)), bufLen(bl), lenient(lenient_),
+        pos(0), crc(0), state(TS_START),
+        key(NULL), keyLen(0), type(JSON_INT), value(0), str(NULL), strLen(0)
+      { }
+
+    // Current pair, valid after next() returns true.
+    // The key and any string value point into the message and are not terminated.
+    const char *key;
+    uint8_t keyLen;
+    valueType_t type;
+    // Value if type is JSON_INT, else 0.
+    int16_t value;
+    // Value if type is JSON_STRING, else NULL.
+    const char *str;
+    uint8_t strLen;
+
+    // Move to the next pair, returning false at the end or on error.
+    bool next();
+    // True iff the whole message has been scanned and is good.
+    bool isValid() const { return(TS_VALID == state); }
+    // As checkJSONMsgRXCRC(), the length including the bounding '{' and '}',
+    // once valid, else 0.
+    uint8_t getLength() const { return(isValid() ? pos : 0); }
+  };
+
 
 // Send (valid) JSON to specified print channel, terminated with "}\0" or '}'|0x80, followed by "\r\n".
 // This does NOT attempt to flush output nor wait after writing.
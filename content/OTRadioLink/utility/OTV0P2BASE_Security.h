@@ -25,8 +25,10 @@ Author(s) / Copyright (s): Damon Hart-Davis 2015--2016
 #define OTV0P2BASE_SECURITY_H
 
 #include <stdint.h>
+#include <string.h>
 // #include <iostream>
 
+#include "OTV0P2BASE_CRC.h"
 #include "OTV0P2BASE_EEPROM.h"
 
 
@@ -270,6 +272,314 @@ inline int8_t getNextMatchingNodeID(
 }
 #endif // ARDUINO_ARCH_AVR
 
+/**
+ * @brief   Compact (Bloom) filter over the leading bytes of associated node
+ *          IDs, to drop frames from unassociated nodes (eg those of
+ *          neighbouring networks) cheaply, straight after decoding the frame
+ *          header and before any key fetch, association lookup or crypto.
+ *
+ * There are no false negatives: a prefix of an associated ID always passes.
+ * A small fraction of other prefixes also pass (false positives),
+ * and are then rejected by the full lookup and authentication as before.
+ * With about 16 bits per association around 0.5% of foreign prefixes pass.
+ *
+ * Only the first prefixLen bytes of each ID are used, so a frame header with
+ * a shorter ID (eg an anonymous frame) cannot be filtered and always passes.
+ *
+ * Must be rebuilt (clear() and add() each association, or rebuild())
+ * whenever the associations change.
+ *
+ * Not ISR-/thread- safe.
+ *
+ * @param   bits_: Filter size in bits; a power of two in [64, 2^20].
+ * @param   prefixLen_: Leading ID bytes used; in range [1,8].
+ */
+template<uint32_t bits_, uint8_t prefixLen_ = 4>
+class NodeIDPrefixFilter final {
+public:
+    static constexpr uint32_t bits {bits_};
+    static constexpr uint8_t prefixLen {prefixLen_};
+    // Bits set per ID.
+    static constexpr uint8_t hashes {3};
+    static_assert((bits_ >= 64) && (bits_ <= (uint32_t(1) << 20)) && (0 == (bits_ & (bits_ - 1))), "bits_ must be a power of two in [64, 2^20]");
+    static_assert((prefixLen_ >= 1) && (prefixLen_ <= 8), "prefixLen_ out of range");
+
+    NodeIDPrefixFilter() { clear(); }
+
+    // Empty the filter, so that only prefixes too short to check pass.
+    void clear() { memset(filter, 0, sizeof(filter)); }
+
+    // Add an (at least prefixLen-byte) associated ID; ignored if NULL.
+    void add(const uint8_t* const id)
+    {
+        if (nullptr == id) { return; }
+        const uint32_t h = hash(id);
+        for (uint8_t i = 0; i < hashes; ++i) {
+            const uint32_t b = bitIndex(h, i);
+            filter[b / 8] |= uint8_t(1U << (b % 8));
+        }
+    }
+
+    // Clear and add every association in nodes, ie anything with
+    // getNextMatchingNodeID(index, prefix, prefixLen, nodeID) returning an index or -1,
+    // scanning as lookups do (so stopping at the first empty slot).
+    template<class nodes_t>
+    void rebuild(const nodes_t& nodes)
+    {
+        clear();
+        uint8_t id[V0P2BASE_EE_NODE_ASSOCIATIONS_8B_ID_LENGTH];
+        for (int32_t i = 0; ; ++i) {
+            const int32_t r = nodes.getNextMatchingNodeID(i, nullptr, 0, id);
+            if (r < 0) { break; }
+            add(id);
+            i = r;
+        }
+    }
+
+    /**
+     * @brief   True if an associated ID may start with the given prefix.
+     * @param   prefix  Leading bytes of the ID, eg from the frame header;
+     *          can be NULL if prefixLen == 0.
+     * @param   len  Length of prefix; if less than prefixLen this is always true.
+     */
+    bool mayContain(const uint8_t* const prefix, const uint8_t len) const
+    {
+        if ((len < prefixLen) || (nullptr == prefix)) { return (true); }
+        const uint32_t h = hash(prefix);
+        for (uint8_t i = 0; i < hashes; ++i) {
+            const uint32_t b = bitIndex(h, i);
+            if (0 == (filter[b / 8] & (1U << (b % 8)))) { return (false); }
+        }
+        return (true);
+    }
+
+    // As mayContain(), also counting the frames passed and filtered out.
+    bool check(const uint8_t* const prefix, const uint8_t len)
+    {
+        const bool pass = mayContain(prefix, len);
+        if (pass) { ++passed; } else { ++filtered; }
+        return (pass);
+    }
+
+    // Number of check()s that passed (including any false positives).
+    uint32_t getPassedCount() const { return (passed); }
+    // Number of check()s that filtered a prefix out.
+    uint32_t getFilteredCount() const { return (filtered); }
+    void resetCounts() { passed = 0; filtered = 0; }
+
+private:
+    uint8_t filter[bits / 8];
+    uint32_t passed = 0;
+    uint32_t filtered = 0;
+
+    // FNV-1a over the first prefixLen bytes.
+    static uint32_t hash(const uint8_t* const p) { return (fnv1a32(p, prefixLen)); }
+    // i-th bit for hash h, by double hashing.
+    static uint32_t bitIndex(const uint32_t h, const uint8_t i)
+    {
+        const uint32_t h2 = (h >> 16) | (h << 16) | 1U;
+        return ((h + i * h2) & (bits - 1));
+    }
+};
+
+#ifndef ARDUINO_ARCH_AVR
+/**
+ * @brief   Indexed in-RAM node association table for hosted hubs with many
+ *          (up to tens of thousands of) associated nodes.
+ *
+ * Slots behave as for NodeAssociationTableMock (all 0xff when empty), but
+ * alongside them a list of the occupied slots is kept sorted by ID (then by
+ * slot), so that getNextMatchingNodeID() finds a prefix match with a binary
+ * search, ie O(log n + k) for k entries sharing the prefix, instead of
+ * get()ing and comparing every slot in turn.
+ * Updates (set()) are O(n) but expected to be rare.
+ *
+ * getNextMatchingNodeID() has the same semantics as
+ * getNextMatchingNodeIDGeneric() (including stopping at the first slot
+ * at or after the start index whose ID starts with 0xff),
+ * so can back a SimpleSecureFrame32or0BodyRXBase::_getNextMatchingNodeID()
+ * implementation unchanged; both take and return a 16-bit index,
+ * so every slot (not just the first 128) can be found and searched on from.
+ *
+ * As the inherited set()/get() can only address the first 256 slots,
+ * setEntry()/getEntry() take a 16-bit index.
+ *
+ * Not ISR-/thread- safe.
+ *
+ * @param   maxSets_: Number of slots; in range [1,32767].
+ */
+template<uint16_t maxSets_>
+class NodeAssociationTableIndexed final : public NodeAssociationTableBase {
+public:
+    static constexpr uint16_t maxSets {maxSets_};
+    static constexpr uint8_t idLength {V0P2BASE_EE_NODE_ASSOCIATIONS_8B_ID_LENGTH};
+    static_assert((maxSets_ > 0) && (maxSets_ <= 32767), "maxSets_ out of range");
+
+    NodeAssociationTableIndexed() { _reset(); }
+
+    // Set an ID; false if index out of range or src is NULL.
+    bool set(uint8_t index, const uint8_t* src) override { return (setEntry(index, src)); }
+    // Get an ID; does nothing if index out of range or dest is NULL.
+    void get(uint8_t index, uint8_t* dest) const override { getEntry(index, dest); }
+
+    // Set an ID at a 16-bit index; false if index out of range or src is NULL.
+    bool setEntry(const uint16_t index, const uint8_t* const src)
+    {
+        if ((index >= maxSets) || (src == nullptr)) { return (false); }
+        ++generation;
+        if (!isEmpty(index)) { removeFromOrder(index); }
+        memcpy(ids[index], src, idLength);
+        if (0xff == src[0]) {
+            markEmpty(index, true);
+            if (index < firstEmpty) { firstEmpty = index; }
+        } else {
+            markEmpty(index, false);
+            insertIntoOrder(index);
+            if (index == firstEmpty) { firstEmpty = nextEmpty(index); }
+        }
+        return (true);
+    }
+
+    // Get an ID at a 16-bit index; does nothing if index out of range or dest is NULL.
+    void getEntry(const uint16_t index, uint8_t* const dest) const
+    {
+        if ((index >= maxSets) || (dest == nullptr)) { return; }
+        memcpy(dest, ids[index], idLength);
+    }
+
+    /**
+     * @brief   Returns first matching node ID at or after the index provided,
+     *          as getNextMatchingNodeIDGeneric() does. If no matching ID is
+     *          found, returns -1.
+     * @param   index   Index to start searching from.
+     *          prefix  Prefix to match; can be NULL if prefixLen == 0.
+     *          prefixLen  Length of prefix, [0,8] bytes.
+     *          nodeID  Buffer to write nodeID to; can be NULL if only the index return value is required.
+     * @retval  returns index or -1 if no matching node ID found
+     */
+    int16_t getNextMatchingNodeID(const uint16_t index, const uint8_t* const prefix, const uint8_t prefixLen, uint8_t* const nodeID) const
+    {
+        // Validate inputs.
+        if (index >= maxSets) { return (-1); }
+        if (prefixLen > idLength) { return (-1); }
+        if ((NULL == prefix) && (0 != prefixLen)) { return (-1); }
+
+        // A linear scan from index stops at the first empty slot.
+        const uint16_t end = (index <= firstEmpty) ? firstEmpty : nextEmpty(index);
+
+        int32_t found = -1;
+        if (0 == prefixLen) {
+            // Everything matches, so the first slot is it if not empty.
+            if (index < end) { found = index; }
+        } else {
+            // Scan the (sorted) entries with this prefix for the lowest slot in range.
+            for (uint16_t i = lowerBound(prefix, prefixLen); i < indexed; ++i) {
+                const uint16_t slot = order[i];
+                if (0 != memcmp(ids[slot], prefix, prefixLen)) { break; }
+                if ((slot >= index) && (slot < end) && ((found < 0) || (slot < found))) { found = slot; }
+            }
+        }
+
+        if (found < 0) { return (-1); }
+        if (nullptr != nodeID) { memcpy(nodeID, ids[found], idLength); }
+        return (int16_t(found));
+    }
+
+    // Number of slots with an ID that does not start with 0xff.
+    uint16_t countEntries() const { return (indexed); }
+
+    // Changes on every set()/setEntry() or _reset(),
+    // eg so that a NodeIDPrefixFilter built from this table can tell when to rebuild.
+    uint32_t getGeneration() const { return (generation); }
+
+    // Exposed for unit testing. Clears all values to default.
+    void _reset()
+    {
+        memset(ids, 0xff, sizeof(ids));
+        memset(emptyMap, 0xff, sizeof(emptyMap));
+        indexed = 0;
+        firstEmpty = 0;
+        ++generation;
+    }
+
+private:
+    // ID slots.
+    uint8_t ids[maxSets][idLength];
+    // Occupied slots, sorted by ID then slot.
+    uint16_t order[maxSets];
+    // Number of valid entries in order.
+    uint16_t indexed;
+    // One bit per slot, set if the slot ID starts with 0xff.
+    uint32_t emptyMap[(maxSets + 31) / 32];
+    // First empty slot, or maxSets if none.
+    uint16_t firstEmpty;
+    // Bumped on every change.
+    uint32_t generation = 0;
+
+    bool isEmpty(const uint16_t slot) const { return (0 != (emptyMap[slot / 32] & (uint32_t(1) << (slot % 32)))); }
+    void markEmpty(const uint16_t slot, const bool empty)
+    {
+        if (empty) { emptyMap[slot / 32] |= (uint32_t(1) << (slot % 32)); }
+        else { emptyMap[slot / 32] &= ~(uint32_t(1) << (slot % 32)); }
+    }
+    // First empty slot at or after slot, or maxSets if none.
+    uint16_t nextEmpty(uint16_t slot) const
+    {
+        while (slot < maxSets) {
+            const uint32_t w = emptyMap[slot / 32] >> (slot % 32);
+            if (0 != w) {
+                uint16_t s = slot;
+                for (uint32_t b = w; 0 == (b & 1); b >>= 1) { ++s; }
+                return ((s < maxSets) ? s : maxSets);
+            }
+            slot = uint16_t((slot / 32 + 1) * 32);
+        }
+        return (maxSets);
+    }
+    // Orders a before b by ID then slot.
+    bool before(const uint16_t a, const uint16_t b) const
+    {
+        const int c = memcmp(ids[a], ids[b], idLength);
+        return ((c < 0) || ((0 == c) && (a < b)));
+    }
+    // Position in order of first entry whose first prefixLen bytes are not less than prefix.
+    uint16_t lowerBound(const uint8_t* const prefix, const uint8_t prefixLen) const
+    {
+        uint16_t lo = 0, hi = indexed;
+        while (lo < hi) {
+            const uint16_t mid = uint16_t(lo + (hi - lo) / 2);
+            if (memcmp(ids[order[mid]], prefix, prefixLen) < 0) { lo = uint16_t(mid + 1); } else { hi = mid; }
+        }
+        return (lo);
+    }
+    // Position in order at which slot is or would be held.
+    uint16_t orderPosition(const uint16_t slot) const
+    {
+        uint16_t lo = 0, hi = indexed;
+        while (lo < hi) {
+            const uint16_t mid = uint16_t(lo + (hi - lo) / 2);
+            if (before(order[mid], slot)) { lo = uint16_t(mid + 1); } else { hi = mid; }
+        }
+        return (lo);
+    }
+    void insertIntoOrder(const uint16_t slot)
+    {
+        const uint16_t pos = orderPosition(slot);
+        memmove(order + pos + 1, order + pos, (indexed - pos) * sizeof(order[0]));
+        order[pos] = slot;
+        ++indexed;
+    }
+    // Must be called while ids[slot] still holds the indexed value.
+    void removeFromOrder(const uint16_t slot)
+    {
+        const uint16_t pos = orderPosition(slot);
+        if ((pos >= indexed) || (order[pos] != slot)) { return; } // Not present.
+        memmove(order + pos, order + pos + 1, (indexed - pos - 1) * sizeof(order[0]));
+        --indexed;
+    }
+};
+#endif // ARDUINO_ARCH_AVR
+
 //#if 0 // Pairing API outline.
 //struct pairInfo { bool successfullyPaired; };
 //bool startPairing(bool primary, &pairInfo);
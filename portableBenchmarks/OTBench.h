@@ -0,0 +1,147 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Minimal harness for portable (hosted) benchmarks of this library.
+ *
+ * Each benchmark is a function registered with OTBENCH(name)
+ * which times its own loop and calls report() with the result,
+ * or hands a single operation to measure() to time.
+ * Results are printed one per line as CSV, for easy tracking of regressions.
+ */
+
+#ifndef OTBENCH_H
+#define OTBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace OTBench
+    {
+
+// Monotonic time in nanoseconds.
+inline uint64_t nowNs()
+    {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t(ts.tv_sec) * 1000000000U) + uint64_t(ts.tv_nsec));
+    }
+
+// CPU timestamp counter, for cycle counts; always 0 where not available.
+inline uint64_t nowCycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+    return(__rdtsc());
+#else
+    return(0);
+#endif
+    }
+
+// Number of heap allocations (via operator new) so far, from all threads.
+uint64_t allocCount();
+
+// High-water mark of scratch space (bytes from the start of buf) used by op(),
+// found by filling buf with a pattern and seeing what op() changed.
+// Runs op() twice with different patterns,
+// so that a byte written with one pattern's value is still seen.
+// op() must have no side-effects that make a second call behave differently.
+template<class op_t>
+size_t scratchHighWater(uint8_t *const buf, const size_t bufsize, op_t op)
+    {
+    size_t hw = 0;
+    static const uint8_t patterns[] = { 0x5a, 0xa5 };
+    for(const uint8_t p : patterns)
+        {
+        memset(buf, p, bufsize);
+        op();
+        size_t n = bufsize;
+        while((n > hw) && (p == buf[n - 1])) { --n; }
+        if(n > hw) { hw = n; }
+        }
+    return(hw);
+    }
+
+// One registered benchmark.
+// Instances must be static (see OTBENCH) and are chained into a global list.
+class Benchmark final
+    {
+    public:
+        typedef void run_fn_t(Benchmark &b);
+
+        const char *const name;
+        run_fn_t &run;
+
+        Benchmark(const char *name_, run_fn_t &run_);
+
+        // Report a result: ops operations (eg frames) completed in elapsedNs.
+        // A benchmark may report more than once, eg for different variants,
+        // in which case variant names the row (else may be NULL).
+        void report(const char *variant, uint32_t ops, uint64_t elapsedNs);
+        // As above, also with the heap allocations made during the ops
+        // and the scratch space high-water mark of one op (0 if none).
+        void report(const char *variant, uint32_t ops, uint64_t elapsedNs,
+                    uint64_t allocs, size_t scratchBytes);
+        // As above, also with the CPU timestamp counter ticks (0 if not available).
+        void report(const char *variant, uint32_t ops, uint64_t elapsedNs,
+                    uint64_t allocs, size_t scratchBytes, uint64_t elapsedCycles);
+
+        // Time ops calls of op(), which returns false on failure,
+        // and report the result with the allocations made and cycles taken;
+        // if scratch is non-NULL, also measure how much of it one op() uses.
+        // Stops with a message on stderr (and no report) if op() fails.
+        template<class op_t>
+        void measure(const char *const variant, const uint32_t ops, op_t op,
+                     uint8_t *const scratch = NULL, const size_t scratchSize = 0)
+            {
+            const size_t hw = (NULL == scratch) ? 0 : scratchHighWater(scratch, scratchSize, op);
+            if(!op()) { fprintf(stderr, "%s %s FAILED\n", name, variant); return; }
+            const uint64_t allocsBefore = allocCount();
+            const uint64_t start = nowNs();
+            const uint64_t startCycles = nowCycles();
+            for(uint32_t i = 0; i < ops; ++i)
+                { if(!op()) { fprintf(stderr, "%s %s FAILED\n", name, variant); return; } }
+            const uint64_t elapsedCycles = nowCycles() - startCycles;
+            const uint64_t elapsed = nowNs() - start;
+            report(variant, ops, elapsed, allocCount() - allocsBefore, hw, elapsedCycles);
+            }
+
+        // Head of list of registered benchmarks, or NULL if none.
+        static Benchmark *first();
+        // Next registered benchmark, or NULL if none.
+        Benchmark *getNext() const { return(next); }
+
+    private:
+        Benchmark *next;
+    };
+
+    }
+
+// Define and register a benchmark, eg:
+//     OTBENCH(myBench) { ... b.report(NULL, n, OTBench::nowNs() - start); }
+#define OTBENCH(bname) \
+    static void bname##_OTBench(OTBench::Benchmark &b); \
+    static OTBench::Benchmark bname##_OTBenchReg(#bname, bname##_OTBench); \
+    static void bname##_OTBench(OTBench::Benchmark &b)
+
+#endif
@@ -0,0 +1,99 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of the compact and table-driven FHT8V/FS20
+ * 200us bitstream encoders and decoders.
+ *
+ * Each op is one frame encoded or decoded,
+ * cycling through a set of random commands.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <OTV0p2Base.h>
+#include "OTRadValve_FHT8VRadValve.h"
+
+#include "OTBench.h"
+
+#ifndef OTRADVALVE_FHT8V_COMPACT_CODEC
+namespace FHT8VCB
+{
+    typedef OTRadValve::FHT8VRadValveUtil u;
+    constexpr uint32_t ops = 2000000;
+    constexpr uint16_t frames = 256;
+    constexpr uint8_t bufSize = u::MIN_FHT8V_200US_BIT_STREAM_BUF_SIZE;
+
+    u::fht8v_msg_t commands[frames];
+    uint8_t streams[frames][bufSize];
+
+    void setUp()
+    {
+        srandom(1);
+        for(uint16_t i = 0; i < frames; ++i)
+            {
+            u::fht8v_msg_t &c = commands[i];
+            c.hc1 = uint8_t(random() % 100);
+            c.hc2 = uint8_t(random() % 100);
+#ifdef OTV0P2BASE_FHT8V_ADR_USED
+            c.address = 0;
+#endif
+            c.command = 0x26;
+            c.extension = uint8_t(random());
+            streams[i][0] = 0xff;
+            u::FHT8VCreate200usBitStreamBptrCompact(streams[i], &c);
+            }
+    }
+
+    // Time encoding with encode, which is u::FHT8VCreate200usBitStreamBptr*.
+    void encode(OTBench::Benchmark &b, const char *const variant,
+                uint8_t *(*const encode)(uint8_t *, const u::fht8v_msg_t *))
+    {
+        uint8_t buf[bufSize];
+        uint16_t i = 0;
+        b.measure(variant, ops, [&]() {
+            buf[0] = 0xff;
+            const uint8_t *const end = encode(buf, &commands[i++ % frames]);
+            return(0xff == *end);
+            });
+    }
+
+    // Time decoding with decode, which is u::FHT8VDecodeBitStream*.
+    void decode(OTBench::Benchmark &b, const char *const variant,
+                uint8_t const *(*const decode)(uint8_t const *, uint8_t const *, u::fht8v_msg_t *))
+    {
+        uint16_t i = 0;
+        b.measure(variant, ops, [&]() {
+            const uint16_t n = i++ % frames;
+            u::fht8v_msg_t c;
+            if(NULL == decode(streams[n], streams[n] + bufSize - 1, &c)) { return(false); }
+            return(c.extension == commands[n].extension);
+            });
+    }
+}
+
+OTBENCH(FHT8VCodec)
+{
+    typedef FHT8VCB::u u;
+    FHT8VCB::setUp();
+    FHT8VCB::encode(b, "encodeCompact", u::FHT8VCreate200usBitStreamBptrCompact);
+    FHT8VCB::encode(b, "encodeTable", u::FHT8VCreate200usBitStreamBptrTable);
+    FHT8VCB::decode(b, "decodeCompact", u::FHT8VDecodeBitStreamCompact);
+    FHT8VCB::decode(b, "decodeTable", u::FHT8VDecodeBitStreamTable);
+}
+#endif // OTRADVALVE_FHT8V_COMPACT_CODEC
@@ -0,0 +1,102 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of the fixed-size secure frame AES-GCM enc/dec:
+ * hardware-accelerated (AES-NI) against the portable OTAESGCM implementations.
+ *
+ * Each op is one 32-byte body with the 8-byte header as authtext,
+ * as for a secure 'O' frame.
+ */
+
+#include <stdio.h>
+#include <OTAESGCM.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace AESNIB
+{
+    constexpr uint32_t ops = 100000;
+
+    const uint8_t key[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    const uint8_t iv[12] = { 0xaa, 0xaa, 0xaa, 0xaa, 0x55, 0x55, 0x00, 0x00, 0x2a, 0x00, 0x03, 0x19 };
+    const uint8_t authtext[8] = { 0x3e, 0xcf, 0x94, 0xaa, 0xaa, 0xaa, 0xaa, 0x20 };
+    const uint8_t plaintext[32] = { 0x7f, 0x11, 0x7b, 0x22, 0x62, 0x22, 0x3a, 0x31 };
+
+    uint8_t workspace[OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec];
+    uint8_t ciphertext[32];
+    uint8_t tag[16];
+
+    // Times ops encryptions with e; returns elapsed ns, or 0 on failure.
+    uint64_t runEnc(OTRadioLink::SimpleSecureFrame32or0BodyTXBase::fixed32BTextSize12BNonce16BTagSimpleEnc_fn_t &e)
+    {
+        const uint64_t start = OTBench::nowNs();
+        for(uint32_t i = 0; i < ops; ++i)
+        {
+            if(!e(workspace, sizeof(workspace), key, iv, authtext, sizeof(authtext), plaintext, ciphertext, tag)) { return(0); } // FAIL
+        }
+        return(OTBench::nowNs() - start);
+    }
+
+    // Times ops decryptions with d; returns elapsed ns, or 0 on failure.
+    uint64_t runDec(OTRadioLink::SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d)
+    {
+        uint8_t out[32];
+        const uint64_t start = OTBench::nowNs();
+        for(uint32_t i = 0; i < ops; ++i)
+        {
+            if(!d(workspace, sizeof(workspace), key, iv, authtext, sizeof(authtext), ciphertext, tag, out)) { return(0); } // FAIL
+        }
+        return(OTBench::nowNs() - start);
+    }
+
+    // Times ops decryptions with the portable stateless decrypt; returns elapsed ns, or 0 on failure.
+    uint64_t runDecStateless()
+    {
+        uint8_t out[32];
+        const uint64_t start = OTBench::nowNs();
+        for(uint32_t i = 0; i < ops; ++i)
+        {
+            if(!OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(NULL, key, iv, authtext, sizeof(authtext), ciphertext, tag, out)) { return(0); } // FAIL
+        }
+        return(OTBench::nowNs() - start);
+    }
+
+    void report(OTBench::Benchmark &b, const char *const variant, const uint64_t t)
+    {
+        if(0 == t) { fprintf(stderr, "AESGCM %s FAILED\n", variant); }
+        else { b.report(variant, ops, t); }
+    }
+}
+
+OTBENCH(AESGCM)
+{
+    AESNIB::report(b, "encPortable", AESNIB::runEnc(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE));
+    AESNIB::report(b, "decPortableStateless", AESNIB::runDecStateless());
+    AESNIB::report(b, "decPortable", AESNIB::runDec(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE));
+    if(!OTRadioLink::isAvailableAESNI()) { fputs("AESGCM: no AES-NI on this CPU\n", stderr); return; }
+    AESNIB::report(b, "encAESNI", AESNIB::runEnc(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI));
+    AESNIB::report(b, "decAESNI", AESNIB::runDec(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI));
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI> kc_t;
+    AESNIB::report(b, "decAESNIKeyCache", AESNIB::runDec(kc_t::decrypt));
+}
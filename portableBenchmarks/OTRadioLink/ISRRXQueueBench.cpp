@@ -0,0 +1,110 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of RX queue throughput:
+ * the lock-free ISRRXQueueSPSC against ISRRXQueueVarLenMsg,
+ * single-threaded and with separate producer and consumer threads
+ * (ISRRXQueueVarLenMsg then needing a mutex around every operation).
+ *
+ * Each op is one 63-byte frame (as for a secure 'O' frame)
+ * loaded into and then removed from the queue.
+ * The two-thread results depend heavily on the number of cores available.
+ */
+
+#include <stdio.h>
+#include <mutex>
+#include <thread>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace ISRRXQB
+{
+    constexpr uint32_t ops = 2000000;
+    constexpr uint8_t frameLen = 63;
+
+    OTRadioLink::ISRRXQueueVarLenMsg<64, 3> varLen;
+    // Same capacity as varLen, and the default (larger) ring.
+    OTRadioLink::ISRRXQueueSPSC<64, 256> spsc;
+    OTRadioLink::ISRRXQueueSPSC<64> spscDefault;
+
+    // Load one frame; false if full.
+    inline bool push(OTRadioLink::ISRRXQueue &q, const uint32_t n)
+    {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        if(NULL == b) { return(false); }
+        b[0] = uint8_t(n);
+        b[frameLen - 1] = uint8_t(n);
+        q._loadedBuf(frameLen);
+        return(true);
+    }
+    // Check and remove one frame; false if empty.
+    inline bool pop(OTRadioLink::ISRRXQueue &q, uint32_t &sum)
+    {
+        const volatile uint8_t *const b = q.peekRXMsg();
+        if(NULL == b) { return(false); }
+        sum += b[0] + b[frameLen - 1];
+        q.removeRXMsg();
+        return(true);
+    }
+
+    // Times ops frames through q from a producer thread to this (consumer) thread,
+    // with every queue operation made under lock if non-NULL.
+    // Returns elapsed ns.
+    template<class q_t>
+    uint64_t runTwoThreads(q_t &q, std::mutex *const lock)
+    {
+        uint32_t sum = 0;
+        const uint64_t start = OTBench::nowNs();
+        std::thread producer([&]{
+            for(uint32_t n = 0; n < ops; ) {
+                bool ok;
+                if(NULL == lock) { ok = push(q, n); }
+                else { std::lock_guard<std::mutex> lk(*lock); ok = push(q, n); }
+                if(ok) { ++n; } else { std::this_thread::yield(); }
+            }
+        });
+        for(uint32_t n = 0; n < ops; ) {
+            bool ok;
+            if(NULL == lock) { ok = pop(q, sum); }
+            else { std::lock_guard<std::mutex> lk(*lock); ok = pop(q, sum); }
+            if(ok) { ++n; } else { std::this_thread::yield(); }
+        }
+        producer.join();
+        const uint64_t elapsed = OTBench::nowNs() - start;
+        if(0 == sum) { fputs("ISRRXQueue: no data\n", stderr); }
+        return(elapsed);
+    }
+}
+
+OTBENCH(ISRRXQueue)
+{
+    uint32_t n = 0, sum = 0;
+    b.measure("varLenSingleThread", ISRRXQB::ops, [&]{
+        return(ISRRXQB::push(ISRRXQB::varLen, ++n) && ISRRXQB::pop(ISRRXQB::varLen, sum));
+        });
+    b.measure("spscSingleThread", ISRRXQB::ops, [&]{
+        return(ISRRXQB::push(ISRRXQB::spsc, ++n) && ISRRXQB::pop(ISRRXQB::spsc, sum));
+        });
+    std::mutex lock;
+    b.report("varLenMutexTwoThreads", ISRRXQB::ops, ISRRXQB::runTwoThreads(ISRRXQB::varLen, &lock));
+    b.report("spscTwoThreads", ISRRXQB::ops, ISRRXQB::runTwoThreads(ISRRXQB::spsc, (std::mutex *)NULL));
+    b.report("spsc1KTwoThreads", ISRRXQB::ops, ISRRXQB::runTwoThreads(ISRRXQB::spscDefault, (std::mutex *)NULL));
+}
@@ -0,0 +1,127 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of the cost of virtual against static (CRTP) dispatch
+ * on the RX path: the ISRRXQueue interface on its own,
+ * and a whole (loopback) radio from interrupt to dequeue.
+ *
+ * Each op is one frame queued by the 'ISR' then peeked and removed.
+ * The virtual variants call through a base pointer
+ * that the compiler cannot see through;
+ * the static variants call the NonVirtual forms on the concrete type.
+ */
+
+#include <stdio.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace RXDB
+{
+    constexpr uint32_t ops = 10000000;
+    constexpr uint8_t frameLen = 63;
+
+    typedef OTRadioLink::ISRRXQueueVarLenMsg<64, 3> queue_t;
+
+    // Radio that 'receives' a frame on every interrupt,
+    // just marking its first and last bytes as a real driver's
+    // FIFO read would fill it.
+    class LoopbackRadio final : public OTRadioLink::OTRadioLinkCRTP<LoopbackRadio>
+    {
+        friend class ::OTRadioLink::OTRadioLinkCRTP<LoopbackRadio>;
+    private:
+        queue_t queueRX;
+        uint8_t n;
+        void _dolistenNonVirtual() { }
+    public:
+        LoopbackRadio() : n(0) { }
+        virtual void getCapacity(uint8_t &queueRXMsgsMin, uint8_t &maxRXMsgLen, uint8_t &maxTXMsgLen) const override
+            { queueRX.getRXCapacity(queueRXMsgsMin, maxRXMsgLen); maxTXMsgLen = 64; }
+        virtual bool sendRaw(const uint8_t *, uint8_t, int8_t = 0, TXpower = TXnormal, bool = false) override { return(false); }
+        bool _handleInterruptNonVirtual()
+            {
+            volatile uint8_t *const b = queueRX._getRXBufForInboundNonVirtual();
+            if(NULL == b) { ++droppedRXedMessageCountRecent; return(true); }
+            b[0] = ++n;
+            b[frameLen - 1] = n;
+            queueRX._loadedBufNonVirtual(frameLen);
+            return(true);
+            }
+        void pollNonVirtual() { _handleInterruptNonVirtual(); }
+        uint8_t getRXMsgsQueuedNonVirtual() const { return(queueRX.getRXMsgsQueued()); }
+        const volatile uint8_t *peekRXMsgNonVirtual() const { return(queueRX.peekRXMsgNonVirtual()); }
+        void removeRXMsgNonVirtual() { queueRX.removeRXMsgNonVirtual(); }
+    };
+
+    queue_t q;
+    LoopbackRadio radio;
+    // Hide the concrete types from the virtual variants.
+    OTRadioLink::ISRRXQueue *volatile qv = &q;
+    OTRadioLink::OTRadioLink *volatile rv = &radio;
+}
+
+OTBENCH(RXDispatch)
+{
+    uint32_t sum = 0;
+    uint8_t n = 0;
+    b.measure("queueVirtual", RXDB::ops, [&]{
+        OTRadioLink::ISRRXQueue &q = *RXDB::qv;
+        volatile uint8_t *const w = q._getRXBufForInbound();
+        if(NULL == w) { return(false); }
+        w[0] = ++n;
+        q._loadedBuf(RXDB::frameLen);
+        const volatile uint8_t *const r = q.peekRXMsg();
+        if(NULL == r) { return(false); }
+        sum += r[0];
+        q.removeRXMsg();
+        return(true);
+        });
+    b.measure("queueStatic", RXDB::ops, [&]{
+        RXDB::queue_t &q = RXDB::q;
+        volatile uint8_t *const w = q._getRXBufForInboundNonVirtual();
+        if(NULL == w) { return(false); }
+        w[0] = ++n;
+        q._loadedBufNonVirtual(RXDB::frameLen);
+        const volatile uint8_t *const r = q.peekRXMsgNonVirtual();
+        if(NULL == r) { return(false); }
+        sum += r[0];
+        q.removeRXMsgNonVirtual();
+        return(true);
+        });
+    b.measure("radioVirtual", RXDB::ops, [&]{
+        OTRadioLink::OTRadioLink &r = *RXDB::rv;
+        r.handleInterruptSimple();
+        const volatile uint8_t *const m = r.peekRXMsg();
+        if(NULL == m) { return(false); }
+        sum += m[0] + m[RXDB::frameLen - 1];
+        r.removeRXMsg();
+        return(true);
+        });
+    b.measure("radioStatic", RXDB::ops, [&]{
+        RXDB::LoopbackRadio &r = RXDB::radio;
+        r._handleInterruptNonVirtual();
+        const volatile uint8_t *const m = r.peekRXMsgNonVirtual();
+        if(NULL == m) { return(false); }
+        sum += m[0] + m[RXDB::frameLen - 1];
+        r.removeRXMsgNonVirtual();
+        return(true);
+        });
+    if(0 == sum) { fputs("RXDispatch: no data\n", stderr); }
+}
@@ -0,0 +1,96 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of RX message counter persistence on a hosted receiver.
+ *
+ * Compares the write-behind journal (batched syncs)
+ * with the same store syncing on every frame (batchSize 1),
+ * the hosted equivalent of the V0p2 per-frame EEPROM update.
+ *
+ * Set TMPDIR to measure a particular filesystem.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace RXMCJB
+{
+    constexpr uint16_t nodeCount = 64;
+    OTV0P2BASE::NodeAssociationTableIndexed<nodeCount> nodes;
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXJournalled<decltype(nodes), nodes> sfrx_t;
+
+    void makeID(const uint16_t n, uint8_t *const id)
+    {
+        for(uint8_t i = 0; i < 8; ++i) { id[i] = uint8_t(0x80 | (n * 7 + i)); }
+        id[6] = uint8_t(n >> 8);
+        id[7] = uint8_t(n);
+    }
+
+    // Authenticate and persist frames counters round-robin across all nodes.
+    // Returns elapsed ns, or 0 on failure.
+    uint64_t run(const OTRadioLink::RXMsgCtrJournal::Config &config, const uint32_t frames)
+    {
+        const char *tmp = getenv("TMPDIR");
+        char path[256];
+        snprintf(path, sizeof(path), "%s/OTRXMsgCtrJournalBench.%d", (NULL == tmp) ? "/tmp" : tmp, int(getpid()));
+        unlink(path);
+        nodes._reset();
+        uint8_t id[8];
+        for(uint16_t n = 0; n < nodeCount; ++n) { makeID(n, id); nodes.set(n, id); }
+        sfrx_t &rx = sfrx_t::getInstance();
+        if(!rx.getJournal().open(path, config)) { return(0); } // FAIL
+        uint8_t ctr[6] = { };
+        const uint64_t start = OTBench::nowNs();
+        for(uint32_t f = 0; f < frames; ++f)
+        {
+            const uint16_t n = uint16_t(f % nodeCount);
+            const uint32_t c = (f / nodeCount) + 1;
+            ctr[3] = uint8_t(c >> 16);
+            ctr[4] = uint8_t(c >> 8);
+            ctr[5] = uint8_t(c);
+            makeID(n, id);
+            if(!rx.authAndUpdateRXMsgCtr(id, ctr)) { rx.getJournal().close(); unlink(path); return(0); } // FAIL
+            rx.getJournal().poll();
+        }
+        const bool closed = rx.getJournal().close();
+        const uint64_t elapsed = OTBench::nowNs() - start;
+        unlink(path);
+        return(closed ? elapsed : 0);
+    }
+}
+
+OTBENCH(RXMsgCtrJournal)
+{
+    OTRadioLink::RXMsgCtrJournal::Config perFrame = OTRadioLink::RXMsgCtrJournal::defaultConfig;
+    perFrame.batchSize = 1;
+    const uint32_t perFrameFrames = 2000;
+    const uint64_t tp = RXMCJB::run(perFrame, perFrameFrames);
+    if(0 == tp) { fputs("RXMsgCtrJournal perFrameSync FAILED\n", stderr); }
+    else { b.report("perFrameSync", perFrameFrames, tp); }
+
+    const uint32_t batchedFrames = 200000;
+    const uint64_t tb = RXMCJB::run(OTRadioLink::RXMsgCtrJournal::defaultConfig, batchedFrames);
+    if(0 == tb) { fputs("RXMsgCtrJournal batched FAILED\n", stderr); }
+    else { b.report("batched", batchedFrames, tb); }
+}
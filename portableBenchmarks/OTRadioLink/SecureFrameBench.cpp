@@ -0,0 +1,151 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmarks of the secure frame encode/decode hot paths,
+ * using the test vectors from SecureFrameTest.cpp,
+ * with the portable OTAESGCM enc/dec where crypto is involved.
+ *
+ * Each op is one frame; the scratch column is the high-water mark
+ * of the workspace passed in (0 for routines that take none).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <OTAESGCM.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace SFB
+{
+    constexpr uint32_t opsPlain = 1000000;
+    constexpr uint32_t opsCrypto = 20000;
+
+    // All-zeros 16-byte key.
+    const uint8_t key[16] = { };
+    // Preshared ID; only a 4-byte prefix goes on the wire.
+    const uint8_t id[8] = { 0xaa, 0xaa, 0xaa, 0xaa, 0x55, 0x55, 0x00, 0x00 };
+    // IV/nonce: first 6 bytes of ID, then 6 bytes of counter.
+    const uint8_t iv[12] = { 0xaa, 0xaa, 0xaa, 0xaa, 0x55, 0x55, 0x00, 0x00, 0x2a, 0x00, 0x03, 0x19 };
+    // 'O' frame body with some JSON stats.
+    const uint8_t body[8] = { 0x7f, 0x11, 0x7b, 0x22, 0x62, 0x22, 0x3a, 0x31 };
+    // Non-secure 'O' frame of the same body, with leading length byte.
+    const uint8_t nonsecureFrame[] = { 0x0e, 0x4f, 0x02, 0x80, 0x81, 0x08, 0x7f, 0x11, 0x7b, 0x22, 0x62, 0x22, 0x3a, 0x31, 0x61 };
+
+    // Workspace big enough for any of the routines here.
+    uint8_t workspace[
+        OTRadioLink::SimpleSecureFrame32or0BodyRXBase::decode_total_scratch_usage_OTAESGCM_3p0
+        + OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec
+        + OTRadioLink::authAndDecodeOTSecurableFrameWithWorkspace_scratch_usage
+        + OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeValveFrame_total_scratch_usage_OTAESGCM_2p0];
+
+    // Secure frame (with leading length byte), built once.
+    uint8_t secureFrame[OTRadioLink::SecurableFrameHeader::maxSmallFrameSize + 1];
+
+    bool getKey(uint8_t *const k) { memset(k, 0, 16); return(true); }
+
+    // Set when a frame gets through to the operators.
+    bool handled;
+    bool noteHandled(const OTRadioLink::OTDecodeData_T &) { handled = true; return(true); }
+
+    // Fixed TX ID and counter, as for TXBaseMock in SecureFrameTest.cpp.
+    class TXFixed final : public OTRadioLink::SimpleSecureFrame32or0BodyTXBase
+    {
+    public:
+        virtual bool getTXID(uint8_t *i) const override { memcpy(i, id, sizeof(id)); return(true); }
+        virtual bool getTXNVCtrPrefix(uint8_t *buf) const override { memset(buf, 0, 3); return(true); }
+        virtual bool resetTXNVCtrPrefix(bool /*allZeros*/ = false) override { return(false); }
+        virtual bool incrementTXNVCtrPrefix() override { return(false); }
+        virtual bool getNextTXMsgCtr(uint8_t *buf) override { memcpy(buf, iv + 6, 6); return(true); }
+    };
+}
+
+OTBENCH(SecureFrame)
+{
+    uint8_t out[OTRadioLink::SecurableFrameHeader::maxSmallFrameSize];
+    uint8_t bodyBuf[32];
+    uint8_t decrypted[OTRadioLink::OTDecodeData_T::ptextLenMax];
+
+    b.measure("encodeNonsecure", SFB::opsPlain, [&]{
+        memcpy(bodyBuf, SFB::body, sizeof(SFB::body));
+        OTRadioLink::OTEncodeData_T fd(bodyBuf, sizeof(SFB::body), out, sizeof(out));
+        fd.fType = OTRadioLink::FTS_BasicSensorOrValve;
+        return(0 != OTRadioLink::encodeNonsecure(fd, 0, SFB::nonsecureFrame + 3, 2));
+        });
+
+    b.measure("decodeNonsecure", SFB::opsPlain, [&]{
+        OTRadioLink::OTDecodeData_T fd(SFB::nonsecureFrame, nullptr);
+        return((0 != fd.sfh.decodeHeader(SFB::nonsecureFrame, sizeof(SFB::nonsecureFrame))) &&
+               (0 != OTRadioLink::decodeNonsecure(fd)));
+        });
+
+    // Build the secure frame used by the decode benchmarks.
+    memcpy(bodyBuf, SFB::body, sizeof(SFB::body));
+    memset(bodyBuf + sizeof(SFB::body), 0, sizeof(bodyBuf) - sizeof(SFB::body));
+    auto encodeRaw = [&]{
+        OTRadioLink::OTEncodeData_T fd(bodyBuf, sizeof(bodyBuf), SFB::secureFrame, sizeof(SFB::secureFrame));
+        fd.ptextLen = sizeof(SFB::body);
+        fd.fType = OTRadioLink::FTS_BasicSensorOrValve;
+        OTV0P2BASE::ScratchSpaceL sW(SFB::workspace, sizeof(SFB::workspace));
+        return(63 == OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeRaw(fd, SFB::id, 4, SFB::iv,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE, sW, SFB::key));
+        };
+    if(!encodeRaw()) { fputs("SecureFrame: cannot build test frame\n", stderr); return; }
+    const uint8_t frameLen = SFB::secureFrame[0] + 1;
+
+    b.measure("decodeHeader", SFB::opsPlain, [&]{
+        OTRadioLink::SecurableFrameHeader sfh;
+        return(0 != sfh.decodeHeader(SFB::secureFrame, frameLen));
+        });
+
+    b.measure("encodeRaw", SFB::opsCrypto, encodeRaw, SFB::workspace, sizeof(SFB::workspace));
+
+    b.measure("decodeRaw", SFB::opsCrypto, [&]{
+        OTRadioLink::OTDecodeData_T fd(SFB::secureFrame, decrypted);
+        OTV0P2BASE::ScratchSpaceL sW(SFB::workspace, sizeof(SFB::workspace));
+        return((0 != fd.sfh.decodeHeader(SFB::secureFrame, frameLen)) &&
+               (0 != OTRadioLink::SimpleSecureFrame32or0BodyRXBase::decodeRaw(fd,
+                   OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+                   sW, SFB::key, SFB::iv)));
+        }, SFB::workspace, sizeof(SFB::workspace));
+
+    SFB::TXFixed tx;
+    b.measure("encodeValveFrame", SFB::opsCrypto, [&]{
+        // Body is padded in place, so rebuild it each time: no valve, stats {"b":1}.
+        uint8_t valveBody[34] = { 0, 0, '{', '"', 'b', '"', ':', '1', '}' };
+        OTRadioLink::OTEncodeData_T fd(valveBody, sizeof(valveBody), out, sizeof(out));
+        OTV0P2BASE::ScratchSpaceL sW(SFB::workspace, sizeof(SFB::workspace));
+        return(0 != tx.encodeValveFrame(fd, 4, 0x7f,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE, sW, SFB::key));
+        }, SFB::workspace, sizeof(SFB::workspace));
+
+    // Full RX path, with a receiver that accepts any counter above zero.
+    OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter &sfrx = OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter::getInstance();
+    const uint8_t zeroCounter[6] = { };
+    sfrx.setMockIDValue(SFB::id);
+    sfrx.setMockCounterValue(zeroCounter);
+    b.measure("decodeAndHandleOTSecureOFrame", SFB::opsCrypto, [&]{
+        OTV0P2BASE::ScratchSpaceL sW(SFB::workspace, sizeof(SFB::workspace));
+        SFB::handled = false;
+        return(OTRadioLink::decodeAndHandleOTSecureOFrame<OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+            SFB::getKey, SFB::noteHandled>(SFB::secureFrame + 1, sW) && SFB::handled);
+        }, SFB::workspace, sizeof(SFB::workspace));
+}
@@ -0,0 +1,152 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Hub ingest load test on the simulated radio medium:
+ * many valves each sending a secure valve frame (from encodeValveFrame())
+ * once per cycle at a random time, to a hub that drains its RX queue
+ * at a fixed poll interval, for a few RX queue sizes.
+ *
+ * Each op is one frame sent; the time is that of the simulation and draining.
+ * Frames lost to collisions and to a full hub queue
+ * are printed to stderr for queue sizing.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include <OTAESGCM.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+#include "OTBench.h"
+
+namespace SEB
+{
+    constexpr uint16_t valves = 500;
+    constexpr uint8_t cycles = 20;
+    // Compressed cycle, to load the hub far harder than the usual 4 minutes.
+    constexpr uint64_t cycleUs = 30 * 1000000ULL;
+    // Hub drains its whole queue this often.
+    constexpr uint64_t pollUs = 1000000ULL;
+
+    const OTRadioLink::OTRadioChannelConfig config(NULL, true);
+
+    // All-zeros key.
+    const uint8_t key[16] = { };
+
+    // Fixed counter, with a per-valve ID.
+    class TXValve final : public OTRadioLink::SimpleSecureFrame32or0BodyTXBase
+    {
+    public:
+        uint8_t id[8];
+        virtual bool getTXID(uint8_t *i) const override { memcpy(i, id, sizeof(id)); return(true); }
+        virtual bool getTXNVCtrPrefix(uint8_t *buf) const override { memset(buf, 0, 3); return(true); }
+        virtual bool resetTXNVCtrPrefix(bool /*allZeros*/ = false) override { return(false); }
+        virtual bool incrementTXNVCtrPrefix() override { return(false); }
+        virtual bool getNextTXMsgCtr(uint8_t *buf) override { memset(buf, 0, 5); buf[5] = 1; return(true); }
+    };
+
+    // Encoded frame for each valve, without the leading length byte.
+    std::vector<std::vector<uint8_t>> frames;
+
+    bool buildFrames()
+    {
+        uint8_t workspace[OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeValveFrame_total_scratch_usage_OTAESGCM_2p0];
+        uint8_t out[OTRadioLink::SecurableFrameHeader::maxSmallFrameSize];
+        TXValve tx;
+        for(uint16_t v = 0; v < valves; ++v)
+            {
+            memset(tx.id, 0x55, sizeof(tx.id));
+            tx.id[0] = uint8_t(v >> 8);
+            tx.id[1] = uint8_t(v);
+            // Valve at some %, stats {"b":1}.
+            uint8_t body[34] = { uint8_t(v % 101), 0, '{', '"', 'b', '"', ':', '1', '}' };
+            OTRadioLink::OTEncodeData_T fd(body, sizeof(body), out, sizeof(out));
+            OTV0P2BASE::ScratchSpaceL sW(workspace, sizeof(workspace));
+            const uint8_t len = tx.encodeValveFrame(fd, 4, 0x7f,
+                OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE, sW, key);
+            if(0 == len) { return(false); }
+            frames.emplace_back(out + 1, out + len);
+            }
+        return(true);
+    }
+
+    // Run the load test with a hub RX queue of type queue_t.
+    template<class queue_t>
+    void run(OTBench::Benchmark &b, const char *const variant)
+    {
+        OTRadioLink::SimEther ether;
+        std::unique_ptr<OTRadioLink::OTSimRadioLink<queue_t>> hub(new OTRadioLink::OTSimRadioLink<queue_t>(ether));
+        hub->configure(1, &config);
+        hub->listen(true);
+        std::vector<std::unique_ptr<OTRadioLink::OTSimRadioLink<>>> nodes;
+        for(uint16_t v = 0; v < valves; ++v)
+            {
+            nodes.emplace_back(new OTRadioLink::OTSimRadioLink<>(ether));
+            nodes.back()->configure(1, &config);
+            }
+        std::mt19937 prng(1);
+        std::uniform_int_distribution<uint64_t> offset(0, cycleUs - 1);
+        std::vector<std::pair<uint64_t, uint16_t>> sends;
+        uint32_t sent = 0, ingested = 0, dropped = 0;
+        uint8_t droppedRecent = 0;
+        uint64_t nextPoll = pollUs;
+        const uint64_t start = OTBench::nowNs();
+        for(uint8_t c = 0; c < cycles; ++c)
+            {
+            const uint64_t base = uint64_t(c) * cycleUs;
+            sends.clear();
+            for(uint16_t v = 0; v < valves; ++v) { sends.emplace_back(base + offset(prng), v); }
+            std::sort(sends.begin(), sends.end());
+            sends.emplace_back(base + cycleUs, valves); // End of cycle.
+            for(const auto &s : sends)
+                {
+                // Poll the hub at each interval up to this send.
+                while(nextPoll <= s.first)
+                    {
+                    ether.advance(nextPoll - ether.getTime());
+                    while(0 != hub->getRXMsgsQueued()) { ++ingested; hub->removeRXMsg(); }
+                    // The hub's count wraps at 255, so accumulate it at each poll.
+                    dropped += uint8_t(hub->getRXMsgsDroppedRecent() - droppedRecent);
+                    droppedRecent = hub->getRXMsgsDroppedRecent();
+                    nextPoll += pollUs;
+                    }
+                ether.advance(s.first - ether.getTime());
+                if(s.second >= valves) { continue; }
+                const std::vector<uint8_t> &f = frames[s.second];
+                if(nodes[s.second]->sendRaw(f.data(), uint8_t(f.size()))) { ++sent; }
+                }
+            }
+        const uint64_t elapsed = OTBench::nowNs() - start;
+        b.report(variant, sent, elapsed);
+        fprintf(stderr, "SimEther %s: sent %u, collided %u, ingested %u, queue drops %u\n",
+            variant, unsigned(sent), unsigned(ether.getCollidedCount()), unsigned(ingested), unsigned(dropped));
+    }
+}
+
+OTBENCH(SimEther)
+{
+    if(!SEB::buildFrames()) { fputs("SimEther: cannot build valve frames\n", stderr); return; }
+    SEB::run<OTRadioLink::ISRRXQueueVarLenMsg<64, 3>>(b, "hubQueue3x64");
+    SEB::run<OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 1024>>(b, "hubQueue1k");
+    SEB::run<OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 4096>>(b, "hubQueue4k");
+}
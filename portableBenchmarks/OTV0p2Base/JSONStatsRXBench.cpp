@@ -0,0 +1,121 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Benchmark of parsing received (TX form, with CRC) JSON stats messages:
+ * checkJSONMsgRXCRC() then sscanf() over a copy,
+ * against the single-pass JSONStatsRXTokenizer.
+ *
+ * Each op is one message validated and all its pairs extracted,
+ * cycling through the samples from JSONStatsTest.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <OTV0p2Base.h>
+
+#include "OTBench.h"
+
+namespace JSONRXB
+{
+    constexpr uint32_t ops = 1000000;
+    constexpr uint8_t bufSize = OTV0P2BASE::MSG_JSON_ABS_MAX_LENGTH + 2;
+
+    const char *const samples[] = {
+        "{\"@\":\"1234\"}",
+        "{\"@\":\"1234\",\"+\":2}",
+        "{\"@\":\"1234\",\"f1\":-111}",
+        "{\"@\":\"1234\",\"L\":0}",
+        "{\"@\":\"cdfb\",\"T|C16\":299,\"H|%\":83,\"L\":255,\"B|cV\":256}",
+        "{\"H|%\":0,\"L\":42}",
+        };
+    constexpr uint8_t nSamples = sizeof(samples) / sizeof(samples[0]);
+
+    uint8_t msgs[nSamples][bufSize];
+    uint8_t lens[nSamples];
+    // Sum of the int values in each sample, to check the parse.
+    int sums[nSamples];
+
+    void setUp()
+    {
+        for(uint8_t i = 0; i < nSamples; ++i)
+            {
+            char *const buf = reinterpret_cast<char *>(msgs[i]);
+            strcpy(buf, samples[i]);
+            const uint8_t crc = OTV0P2BASE::adjustJSONMsgForTXAndComputeCRC(buf);
+            const uint8_t l = uint8_t(strlen(buf));
+            buf[l] = char((0 == crc) ? 0x80 : crc);
+            lens[i] = uint8_t(l + 1);
+            }
+        sums[0] = 0; sums[1] = 2; sums[2] = -111; sums[3] = 0; sums[4] = 299 + 83 + 255 + 256; sums[5] = 42;
+    }
+
+    // Validate, restore the raw form in a copy, then sscanf() each pair.
+    int validateSscanf(const uint8_t *const msg, const uint8_t len)
+    {
+        const int8_t l = OTV0P2BASE::checkJSONMsgRXCRC(msg, len);
+        if(l <= 0) { return(-1); }
+        char buf[bufSize];
+        memcpy(buf, msg, size_t(l));
+        buf[l - 1] = '}';
+        buf[l] = '\0';
+        int sum = 0;
+        const char *p = buf + 1;
+        for( ; ; )
+            {
+            char key[16];
+            char str[16];
+            int value;
+            int n = 0;
+            if(2 == sscanf(p, "\"%15[^\"]\":%d%n", key, &value, &n)) { sum += value; }
+            else if(2 != sscanf(p, "\"%15[^\"]\":\"%15[^\"]\"%n", key, str, &n)) { break; }
+            p += n;
+            if(',' != *p) { break; }
+            ++p;
+            }
+        return(sum);
+    }
+
+    int tokenizer(const uint8_t *const msg, const uint8_t len)
+    {
+        OTV0P2BASE::JSONStatsRXTokenizer t(msg, len);
+        int sum = 0;
+        while(t.next())
+            { if(OTV0P2BASE::JSONStatsRXTokenizer::JSON_INT == t.type) { sum += t.value; } }
+        return(t.isValid() ? sum : -1);
+    }
+
+    void parse(OTBench::Benchmark &b, const char *const variant,
+               int (*const parse)(const uint8_t *, uint8_t))
+    {
+        uint8_t i = 0;
+        b.measure(variant, ops, [&]() {
+            const uint8_t n = i;
+            if(++i >= nSamples) { i = 0; }
+            return(sums[n] == parse(msgs[n], lens[n]));
+            });
+    }
+}
+
+OTBENCH(JSONStatsRX)
+{
+    JSONRXB::setUp();
+    JSONRXB::parse(b, "validateSscanf", JSONRXB::validateSscanf);
+    JSONRXB::parse(b, "tokenizer", JSONRXB::tokenizer);
+}
@@ -0,0 +1,104 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Driver for portable benchmarks for this library.
+ *
+ * Run with no arguments to run all benchmarks,
+ * else only those whose names contain any of the arguments.
+ *
+ * Output is CSV on stdout:
+ *     benchmark,variant,ops,ns_per_op,ops_per_sec,allocs_per_op,scratch_bytes,cycles_per_op
+ * with the last three fields empty where not measured.
+ * cycles_per_op is from the CPU timestamp counter (x86 only),
+ * which may tick at a fixed rate rather than with the core clock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#include "OTBench.h"
+
+// Count all heap allocations;
+// the other forms of new and delete forward to these.
+static std::atomic<uint64_t> allocs(0);
+void *operator new(const size_t size)
+    {
+    ++allocs;
+    void *const p = malloc((0 == size) ? 1 : size);
+    if(NULL == p) { throw std::bad_alloc(); }
+    return(p);
+    }
+void operator delete(void *const p) noexcept { free(p); }
+
+namespace OTBench
+    {
+
+uint64_t allocCount() { return(allocs); }
+
+static Benchmark *head;
+
+Benchmark::Benchmark(const char *const name_, run_fn_t &run_)
+  : name(name_), run(run_), next(head)
+    { head = this; }
+
+Benchmark *Benchmark::first() { return(head); }
+
+void Benchmark::report(const char *const variant, const uint32_t ops, const uint64_t elapsedNs)
+    {
+    const double nsPerOp = (0 == ops) ? 0.0 : (double(elapsedNs) / ops);
+    const double opsPerSec = (0 == elapsedNs) ? 0.0 : (ops * 1e9 / double(elapsedNs));
+    printf("%s,%s,%lu,%.1f,%.0f,,,\n", name, (NULL == variant) ? "" : variant,
+        (unsigned long)ops, nsPerOp, opsPerSec);
+    fflush(stdout);
+    }
+
+void Benchmark::report(const char *const variant, const uint32_t ops, const uint64_t elapsedNs,
+                       const uint64_t allocs_, const size_t scratchBytes)
+    { report(variant, ops, elapsedNs, allocs_, scratchBytes, 0); }
+
+void Benchmark::report(const char *const variant, const uint32_t ops, const uint64_t elapsedNs,
+                       const uint64_t allocs_, const size_t scratchBytes, const uint64_t elapsedCycles)
+    {
+    const double nsPerOp = (0 == ops) ? 0.0 : (double(elapsedNs) / ops);
+    const double opsPerSec = (0 == elapsedNs) ? 0.0 : (ops * 1e9 / double(elapsedNs));
+    const double allocsPerOp = (0 == ops) ? 0.0 : (double(allocs_) / ops);
+    printf("%s,%s,%lu,%.1f,%.0f,%.2f,%lu,", name, (NULL == variant) ? "" : variant,
+        (unsigned long)ops, nsPerOp, opsPerSec, allocsPerOp, (unsigned long)scratchBytes);
+    if((0 != elapsedCycles) && (0 != ops)) { printf("%.1f", double(elapsedCycles) / ops); }
+    putchar('\n');
+    fflush(stdout);
+    }
+
+    }
+
+int main(const int argc, const char *const argv[])
+    {
+    printf("benchmark,variant,ops,ns_per_op,ops_per_sec,allocs_per_op,scratch_bytes,cycles_per_op\n");
+    for(OTBench::Benchmark *b = OTBench::Benchmark::first(); NULL != b; b = b->getNext())
+        {
+        bool selected = (argc < 2);
+        for(int i = 1; !selected && (i < argc); ++i)
+            { selected = (NULL != strstr(b->name, argv[i])); }
+        if(selected) { b->run(*b); }
+        }
+    return(0);
+    }
@@ -25,6 +25,7 @@ Author(s) / Copyright (s): Damon Hart-Davis 2016
 #include <gtest/gtest.h>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 #include "OTRadValve_FHT8VRadValve.h"
 
@@ -422,3 +423,45 @@ TEST(FHT8VRadValve,FHTEncodingHeadAndTail)
 //    #endif
 //    #endif
 }
+
+#ifndef OTRADVALVE_FHT8V_COMPACT_CODEC
+// Test that the table-driven FHT8V encoder and decoder give exactly the results of the compact ones,
+// for random commands and for corrupted and truncated bitstreams.
+TEST(FHT8VRadValve,FHTTableCodecMatchesCompact)
+{
+    typedef OTRadValve::FHT8VRadValveUtil u;
+    srandom((unsigned)::testing::UnitTest::GetInstance()->random_seed()); // Seed random(); --gtest_shuffle will force it to change.
+    constexpr size_t bufSize = u::MIN_FHT8V_200US_BIT_STREAM_BUF_SIZE;
+    for(int i = 0; i < 10000; ++i)
+        {
+        u::fht8v_msg_t command;
+        command.hc1 = uint8_t(random());
+        command.hc2 = uint8_t(random());
+#ifdef OTV0P2BASE_FHT8V_ADR_USED
+        command.address = uint8_t(random());
+#endif
+        command.command = uint8_t(random());
+        command.extension = uint8_t(random());
+        uint8_t bufC[bufSize], bufT[bufSize];
+        memset(bufC, 0, sizeof(bufC));
+        memset(bufT, 0x55, sizeof(bufT));
+        *bufC = 0xff;
+        const uint8_t *const endC = u::FHT8VCreate200usBitStreamBptrCompact(bufC, &command);
+        const uint8_t *const endT = u::FHT8VCreate200usBitStreamBptrTable(bufT, &command);
+        ASSERT_EQ(endC - bufC, endT - bufT);
+        ASSERT_EQ(0, memcmp(bufC, bufT, size_t(endC - bufC) + 1));
+        // Corrupt a bit some of the time, and sometimes cut the stream short.
+        if(0 != (i & 1)) { bufC[random() % (endC - bufC)] ^= uint8_t(1 << (random() & 7)); }
+        const uint8_t *const last = (0 != (i & 2)) ? (bufC + random() % (endC - bufC)) : (bufC + sizeof(bufC) - 1);
+        u::fht8v_msg_t decodedC, decodedT;
+        const uint8_t *const rC = u::FHT8VDecodeBitStreamCompact(bufC, last, &decodedC);
+        const uint8_t *const rT = u::FHT8VDecodeBitStreamTable(bufC, last, &decodedT);
+        ASSERT_EQ(rC, rT);
+        if(NULL == rC) { continue; }
+        EXPECT_EQ(decodedC.hc1, decodedT.hc1);
+        EXPECT_EQ(decodedC.hc2, decodedT.hc2);
+        EXPECT_EQ(decodedC.command, decodedT.command);
+        EXPECT_EQ(decodedC.extension, decodedT.extension);
+        }
+}
+#endif // OTRADVALVE_FHT8V_COMPACT_CODEC
@@ -22,6 +22,7 @@ Author(s) / Copyright (s): Deniz Erbilgin 2017
  */
 
 #include <stdint.h>
+#include <vector>
 #include <gtest/gtest.h>
 #include <OTV0p2Base.h>
 #include "OTV0P2BASE_Util.h"
@@ -30,6 +31,7 @@ Author(s) / Copyright (s): Deniz Erbilgin 2017
 #include <OTAESGCM.h>
 #endif  // defined(EXT_AVAILABLE_ARDUINO_LIB_OTAESGCM)
 #include <OTRadioLink.h>
+#include "OTRadValve_FHT8VRadValve.h"
 
 
 #ifndef __APPLE__
@@ -382,6 +384,151 @@ TEST(FrameHandler, BoilerFrameOperationSuccess)
     EXPECT_TRUE(boilerOperationSuccess);
 }
 
+namespace OTFHTF {
+    typedef OTRadValve::FHT8VRadValveUtil fs20util_t;
+    // Count FS20 operator calls and keep the frame data last seen.
+    int frameOperationCount;
+    OTRadioLink::OTFS20DecodeData_T lastFd;
+    bool recordingFS20FrameOperation(const OTRadioLink::OTFS20DecodeData_T &fd) { ++frameOperationCount; lastFd = fd; return(true); }
+
+    constexpr bool inHubMode = true;
+    uint8_t minuteCount = 1;
+    OTRadValve::OTHubManager<false, false> hm;  // no EEPROM so parameters don't matter
+    OTRadValve::BoilerLogic::OnOffBoilerDriverLogic<decltype(hm), hm, OTFHT::heatCallPin> b2;
+
+    // Encode a valve-position command as RXed into buf,
+    // ie with the length in the first byte, followed by any trailing bytes.
+    // Returns a pointer to the message, after the length byte.
+    const uint8_t *encode(uint8_t *const buf, const uint8_t hc1, const uint8_t hc2, const uint8_t valvePC,
+                          const uint8_t *const trailing = NULL, const uint8_t trailingLen = 0)
+    {
+        fs20util_t::fht8v_msg_t command;
+        command.hc1 = hc1;
+        command.hc2 = hc2;
+#ifdef OTV0P2BASE_FHT8V_ADR_USED
+        command.address = 0;
+#endif
+        command.command = 0x26;
+        command.extension = fs20util_t::convertPercentTo255Scale(valvePC);
+        buf[1] = 0xff;
+        uint8_t *const end = fs20util_t::FHT8VCreate200usBitStreamBptr(buf + 1, &command);
+        if(0 != trailingLen) { memcpy(end, trailing, trailingLen); }
+        buf[0] = uint8_t(end - (buf + 1) + trailingLen);
+        return(buf + 1);
+    }
+}
+// FS20 frames are decoded in place and passed to the operators; anything else is left for other handlers.
+TEST(FrameHandler, decodeAndHandleFS20Frame)
+{
+    OTFHTF::frameOperationCount = 0;
+    uint8_t buf[64];
+    const uint8_t *const msg = OTFHTF::encode(buf, 13, 73, 100);
+    EXPECT_EQ(OTRadioLink::FTp2_FS20_native, msg[0]);
+    EXPECT_TRUE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation, OTFHTF::recordingFS20FrameOperation>(msg)));
+    EXPECT_EQ(2, OTFHTF::frameOperationCount);
+    EXPECT_EQ(13, OTFHTF::lastFd.hc1);
+    EXPECT_EQ(73, OTFHTF::lastFd.hc2);
+    EXPECT_EQ((13 << 8) | 73, OTFHTF::lastFd.getHouseCode());
+    EXPECT_EQ(0x26, OTFHTF::lastFd.command);
+    EXPECT_EQ(255, OTFHTF::lastFd.extension);
+    // Nothing after the FS20 frame.
+    EXPECT_EQ(msg + msg[-1] - 1, OTFHTF::lastFd.lastByte);
+    EXPECT_LT(OTFHTF::lastFd.lastByte, OTFHTF::lastFd.trailer);
+
+    // A trailer is left in place for the operators.
+    const uint8_t trailing[] = { 0x40, 0x11, 0x22 };
+    const uint8_t *const msgT = OTFHTF::encode(buf, 1, 2, 0, trailing, sizeof(trailing));
+    EXPECT_TRUE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation>(msgT)));
+    EXPECT_EQ(3, OTFHTF::frameOperationCount);
+    EXPECT_EQ(0, OTFHTF::lastFd.extension);
+    ASSERT_EQ(msgT + msgT[-1] - sizeof(trailing), OTFHTF::lastFd.trailer);
+    EXPECT_EQ(0x40, OTFHTF::lastFd.trailer[0]);
+
+    // Other frame types, truncated frames and corrupted frames are not handled.
+    const uint8_t secureO[] = { 5, 'O' | 0x80, 1, 2, 3, 4 };
+    EXPECT_FALSE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation>(secureO + 1)));
+    OTFHTF::encode(buf, 13, 73, 100);
+    buf[0] = 20;
+    EXPECT_FALSE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation>(msg)));
+    OTFHTF::encode(buf, 13, 73, 100);
+    buf[20] ^= 0x30;
+    EXPECT_FALSE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation>(msg)));
+    EXPECT_EQ(3, OTFHTF::frameOperationCount);
+
+    // Goes in either sort of handler chain.
+    OTFHTF::encode(buf, 13, 73, 100);
+    OTRadioLink::decodeAndHandleRawRXedMessage<OTRadioLink::decodeAndHandleDummyFrame,
+        OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation> >(msg);
+    EXPECT_EQ(4, OTFHTF::frameOperationCount);
+    EXPECT_TRUE((OTRadioLink::decodeAndHandleRXedFrame<OTRadioLink::decodeAndHandleDummyFrameContext,
+        OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation> >(msg)));
+    EXPECT_EQ(5, OTFHTF::frameOperationCount);
+}
+
+// An FHT8V valve-position frame calls for heat at the boiler hub.
+TEST(FrameHandler, boilerFS20FrameOperation)
+{
+    OTFHTF::b2.reset();
+    // Trick boiler hub into believing 10 minutes have passed.
+    for(auto i = 0; i < 100; ++i) { OTFHTF::b2.processCallsForHeat(true, OTFHTF::inHubMode); }
+    EXPECT_FALSE(OTFHTF::b2.isBoilerOn());
+    uint8_t buf[64];
+    const uint8_t *const msg = OTFHTF::encode(buf, 13, 73, 100);
+    EXPECT_TRUE((OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t,
+        OTRadioLink::boilerFS20FrameOperation<OTFHTF::fs20util_t, decltype(OTFHTF::b2), OTFHTF::b2, OTFHTF::minuteCount> >(msg)));
+    OTFHTF::b2.processCallsForHeat(false, OTFHTF::inHubMode);
+    EXPECT_TRUE(OTFHTF::b2.isBoilerOn());
+    // Not a valve-position command.
+    OTRadioLink::OTFS20DecodeData_T fd = { 13, 73, 0x20, 0, NULL, NULL };
+    EXPECT_FALSE((OTRadioLink::boilerFS20FrameOperation<OTFHTF::fs20util_t, decltype(OTFHTF::b2), OTFHTF::b2, OTFHTF::minuteCount>(fd)));
+}
+
+namespace OTFHTR {
+    // Count the calls to each handler, which all accept the message.
+    int calls[3];
+    template<int n> bool countingHandler(volatile const uint8_t *) { ++calls[n]; return(true); }
+    void reset() { for(int &c : calls) { c = 0; } }
+    typedef OTRadioLink::frameTypeRoute<'O' | 0x80, 0xff, countingHandler<0> > secureORoute;
+    typedef OTRadioLink::frameTypeRoute<'O', 0x7f, countingHandler<1> > anyORoute;
+    typedef OTRadioLink::frameTypeRoute<OTRadioLink::FTp2_FS20_native, 0xff, countingHandler<2> > fs20Route;
+}
+// Messages go straight to the handler for their first byte.
+TEST(FrameHandler, decodeAndRouteRXedMessage)
+{
+    OTFHTR::reset();
+    const uint8_t secureO[] = { 2, 'O' | 0x80, 0 };
+    const uint8_t insecureO[] = { 2, 'O', 0 };
+    const uint8_t fs20[] = { 2, OTRadioLink::FTp2_FS20_native, 0 };
+    const uint8_t other[] = { 2, '{', 0 };
+    const uint8_t tooShort[] = { 1, 'O' | 0x80 };
+    // First listed route wins where they overlap.
+    EXPECT_TRUE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute, OTFHTR::anyORoute, OTFHTR::fs20Route>(secureO + 1)));
+    EXPECT_TRUE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute, OTFHTR::anyORoute, OTFHTR::fs20Route>(insecureO + 1)));
+    EXPECT_TRUE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute, OTFHTR::anyORoute, OTFHTR::fs20Route>(fs20 + 1)));
+    EXPECT_FALSE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute, OTFHTR::anyORoute, OTFHTR::fs20Route>(other + 1)));
+    EXPECT_FALSE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute, OTFHTR::anyORoute, OTFHTR::fs20Route>(tooShort + 1)));
+    EXPECT_EQ(1, OTFHTR::calls[0]);
+    EXPECT_EQ(1, OTFHTR::calls[1]);
+    EXPECT_EQ(1, OTFHTR::calls[2]);
+    // The mask takes in both variants.
+    EXPECT_TRUE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::anyORoute>(secureO + 1)));
+    EXPECT_EQ(2, OTFHTR::calls[1]);
+    // A router can itself be a handler, eg in OTMessageQueueHandler.
+    OTRadioLink::frameDecodeHandler_fn_t &h = OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::fs20Route>;
+    EXPECT_TRUE(h(fs20 + 1));
+    EXPECT_FALSE(h(secureO + 1));
+    EXPECT_EQ(2, OTFHTR::calls[2]);
+
+    // A real FS20 frame through the FS20 handler.
+    OTFHTF::frameOperationCount = 0;
+    uint8_t buf[64];
+    const uint8_t *const msg = OTFHTF::encode(buf, 13, 73, 100);
+    EXPECT_TRUE((OTRadioLink::decodeAndRouteRXedMessage<OTFHTR::secureORoute,
+        OTRadioLink::frameTypeRoute<OTRadioLink::FTp2_FS20_native, 0xff,
+            OTRadioLink::decodeAndHandleFS20Frame<OTFHTF::fs20util_t, OTFHTF::recordingFS20FrameOperation> > >(msg)));
+    EXPECT_EQ(1, OTFHTF::frameOperationCount);
+}
+
 TEST(FrameHandler, authAndDecodeSecurableFrameBasic)
 {
     // Secure Frame start
@@ -576,6 +723,63 @@ TEST(FrameHandler, OTMessageQueueHandlerBasic)
     EXPECT_FALSE(mh.handle(false, rl));
 }
 
+namespace OTFHTQ {
+    // Mock sub-cycle clock, advanced by the handler for each frame.
+    uint8_t sct;
+    uint8_t getSCT() { return(sct); }
+    uint8_t ticksPerFrame;
+    int framesHandled;
+    bool slowHandler(volatile const uint8_t *) { ++framesHandled; sct = uint8_t(sct + ticksPerFrame); return(true); }
+
+    // Radio with a number of identical frames queued.
+    class QueuedRadioLink final : public OTRadioLink::OTRadioLink
+    {
+    public:
+        uint8_t queued = 0;
+        const uint8_t frame[3] = { 2, 'O', 0 };
+        bool begin() override { return(true); }
+        void getCapacity(uint8_t &q, uint8_t &r, uint8_t &t) const override { q = 255; r = 2; t = 0; }
+        uint8_t getRXMsgsQueued() const override { return(queued); }
+        const volatile uint8_t *peekRXMsg() const override { return((0 == queued) ? NULL : frame + 1); }
+        void removeRXMsg() override { if(0 != queued) { --queued; } }
+        bool sendRaw(const uint8_t *, uint8_t, int8_t, TXpower, bool) override { return(false); }
+    private:
+        void _dolisten() override { }
+    };
+}
+// Queued frames are handled back to back until the queue empties or the deadline passes.
+TEST(FrameHandler, OTMessageQueueHandlerUntil)
+{
+    OTRadioLink::OTMessageQueueHandler<OTFHT::pollIO, 4800, OTFHTQ::slowHandler> mh;
+    OTFHTQ::QueuedRadioLink rl;
+    uint8_t left = 99;
+    OTFHTQ::ticksPerFrame = 10;
+    OTFHTQ::framesHandled = 0;
+    // All handled well within the deadline.
+    OTFHTQ::sct = 0;
+    rl.queued = 5;
+    EXPECT_EQ(5, mh.handleUntil(192, OTFHTQ::getSCT, false, rl, left));
+    EXPECT_EQ(0, left);
+    EXPECT_EQ(5, OTFHTQ::framesHandled);
+    // Nothing queued.
+    EXPECT_EQ(0, mh.handleUntil(192, OTFHTQ::getSCT, false, rl, left));
+    EXPECT_EQ(0, left);
+    // Stops at the deadline, reporting what is left.
+    OTFHTQ::sct = 150;
+    rl.queued = 10;
+    EXPECT_EQ(5, mh.handleUntil(192, OTFHTQ::getSCT, false, rl, left));
+    EXPECT_EQ(5, left);
+    // Nothing started past the deadline.
+    EXPECT_EQ(0, mh.handleUntil(192, OTFHTQ::getSCT, false, rl, left));
+    EXPECT_EQ(5, left);
+    EXPECT_EQ(10, OTFHTQ::framesHandled);
+    // Stops if the sub-cycle time wraps into the next cycle.
+    OTFHTQ::ticksPerFrame = 100;
+    OTFHTQ::sct = 100;
+    EXPECT_EQ(2, mh.handleUntil(255, OTFHTQ::getSCT, false, rl, left));
+    EXPECT_EQ(3, left);
+}
+
 //// Only enable these tests if the OTAESGCM library is marked as available.
 #if defined(EXT_AVAILABLE_ARDUINO_LIB_OTAESGCM)
 TEST(FrameHandlerTest, setFlagFrameOperation)
@@ -659,6 +863,157 @@ TEST(FrameHandlerTest, decodeAndHandleOTSecurableFrameDecryptSuccess)
     EXPECT_TRUE(OTFHT::frameOperationCalledFlag);
 }
 
+namespace OTFHTB {
+    // Count key fetches, decoded frames and non-secure frames.
+    int getKeyCount;
+    bool countingGetKey(uint8_t *key) { ++getKeyCount; return(OTFHT::getKeySuccess(key)); }
+    int frameOperationCount;
+    bool countingFrameOperation(const OTRadioLink::OTDecodeData_T &) { ++frameOperationCount; return(true); }
+    int otherFrameCount;
+    bool countingOtherHandler(volatile const uint8_t *) { ++otherFrameCount; return(true); }
+}
+// Drain several queued frames in one batch, fetching the key only once.
+TEST(FrameHandlerTest, decodeAndHandleOTSecureOFrameBatch)
+{
+    OTFHT::NULLSerialStream::verbose = false;
+    OTFHTB::getKeyCount = 0;
+    OTFHTB::frameOperationCount = 0;
+    OTFHTB::otherFrameCount = 0;
+
+    OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter &sfrx = OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter::getInstance();
+    sfrx.setMockIDValue(OTFHT::minimumSecureFrame::id);
+    sfrx.setMockCounterValue(OTFHT::minimumSecureFrame::oldCounter);
+
+    // Queue three copies of the secure frame around one non-secure frame.
+    OTRadioLink::ISRRXQueueVarLenMsg<64, 4> q;
+    const uint8_t nonSecure[] = { 'O', 1, 2, 3, 4 };
+    for(int i = 0; i < 4; ++i) {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        ASSERT_NE((volatile uint8_t *)NULL, b);
+        if(2 == i) {
+            for(size_t j = 0; j < sizeof(nonSecure); ++j) { b[j] = nonSecure[j]; }
+            q._loadedBuf(sizeof(nonSecure));
+        } else {
+            for(uint8_t j = 0; j < OTFHT::minimumSecureFrame::encodedLength - 1; ++j) { b[j] = OTFHT::minimumSecureFrame::buf[j + 1]; }
+            q._loadedBuf(OTFHT::minimumSecureFrame::encodedLength - 1);
+        }
+    }
+    EXPECT_EQ(4, q.getRXMsgsQueued());
+
+    constexpr size_t workspaceRequired =
+            OTRadioLink::SimpleSecureFrame32or0BodyRXBase::decode_total_scratch_usage_OTAESGCM_3p0
+            + OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec
+            + OTRadioLink::decodeAndHandleOTSecureOFrameBatch_scratch_usage;
+    uint8_t workspace[workspaceRequired];
+    OTV0P2BASE::ScratchSpaceL sW(workspace, sizeof(workspace));
+
+    // Too little scratch space handles nothing.
+    OTV0P2BASE::ScratchSpaceL sWSmall(workspace, OTRadioLink::decodeAndHandleOTSecureOFrameBatch_scratch_usage - 1);
+    EXPECT_EQ(0, (OTRadioLink::decodeAndHandleOTSecureOFrameBatch<
+            OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+            OTFHTB::countingGetKey,
+            OTFHTB::countingFrameOperation>(q, sWSmall)));
+    EXPECT_EQ(4, q.getRXMsgsQueued());
+
+    const uint8_t n = OTRadioLink::decodeAndHandleOTSecureOFrameBatch<
+            OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+            OTFHTB::countingGetKey,
+            OTFHTB::countingFrameOperation,
+            OTRadioLink::nullFrameOperation,
+            OTFHTB::countingOtherHandler>(q, sW);
+    EXPECT_EQ(4, n);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(1, OTFHTB::getKeyCount);
+    EXPECT_EQ(3, OTFHTB::frameOperationCount);
+    EXPECT_EQ(1, OTFHTB::otherFrameCount);
+
+    // Empty queue does nothing and does not fetch the key.
+    EXPECT_EQ(0, (OTRadioLink::decodeAndHandleOTSecureOFrameBatch<
+            OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter,
+            OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+            OTFHTB::countingGetKey,
+            OTFHTB::countingFrameOperation>(q, sW)));
+    EXPECT_EQ(1, OTFHTB::getKeyCount);
+}
+
+namespace OTFHTC {
+    // Order in which the operators were called, and the frame data each saw.
+    std::vector<int> opOrder;
+    std::vector<const OTRadioLink::OTDecodeData_T *> opFd;
+    template<int n> bool recordingFrameOperation(const OTRadioLink::OTDecodeData_T &fd)
+        { opOrder.push_back(n); opFd.push_back(&fd); return(true); }
+
+    // Handler that looks at the header and then lets the next handler have the frame.
+    OTRadioLink::OTRXFrameContext_T *inspected;
+    bool inspectingHandler(OTRadioLink::OTRXFrameContext_T &fc)
+    {
+        inspected = &fc;
+        EXPECT_NE(0, fc.decodeHeader());
+        return(false);
+    }
+
+    constexpr size_t workspaceRequired =
+            OTRadioLink::SimpleSecureFrame32or0BodyRXBase::decode_total_scratch_usage_OTAESGCM_3p0
+            + OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec
+            + OTRadioLink::authAndDecodeOTSecurableFrameWithWorkspace_scratch_usage; // + space to hold the key
+    bool secureHandler(OTRadioLink::OTRXFrameContext_T &fc)
+    {
+        uint8_t workspace[workspaceRequired];
+        OTV0P2BASE::ScratchSpaceL sW(workspace, sizeof(workspace));
+        return(OTRadioLink::decodeAndHandleOTSecureOFrame<
+                OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter,
+                OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+                OTFHTB::countingGetKey,
+                OTRadioLink::frameOperatorChain<recordingFrameOperation<1>, recordingFrameOperation<2>, recordingFrameOperation<3> >
+                >(fc, sW));
+    }
+}
+// One decoded-frame context is shared by the handlers in a chain and by all the operators.
+TEST(FrameHandlerTest, decodeAndHandleRXedFrameSharedContext)
+{
+    OTFHT::NULLSerialStream::verbose = false;
+    OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter &sfrx = OTRadioLink::SimpleSecureFrame32or0BodyRXFixedCounter::getInstance();
+    sfrx.setMockIDValue(OTFHT::minimumSecureFrame::id);
+    sfrx.setMockCounterValue(OTFHT::minimumSecureFrame::oldCounter);
+    const uint8_t * const msgStart = &OTFHT::minimumSecureFrame::buf[1];
+    OTFHTC::opOrder.clear();
+    OTFHTC::opFd.clear();
+    OTFHTC::inspected = NULL;
+    OTFHTB::getKeyCount = 0;
+
+    // Both handlers see the same context, and all the operators the same frame data.
+    EXPECT_TRUE((OTRadioLink::decodeAndHandleRXedFrame<OTFHTC::inspectingHandler, OTFHTC::secureHandler>(msgStart)));
+    EXPECT_NE((OTRadioLink::OTRXFrameContext_T *)NULL, OTFHTC::inspected);
+    ASSERT_EQ(3U, OTFHTC::opOrder.size());
+    EXPECT_EQ(1, OTFHTC::opOrder[0]);
+    EXPECT_EQ(2, OTFHTC::opOrder[1]);
+    EXPECT_EQ(3, OTFHTC::opOrder[2]);
+    EXPECT_EQ(OTFHTC::opFd[0], OTFHTC::opFd[1]);
+    EXPECT_EQ(OTFHTC::opFd[0], OTFHTC::opFd[2]);
+    EXPECT_EQ(1, OTFHTB::getKeyCount);
+
+    // A frame already decoded in the context is not authenticated again.
+    OTRadioLink::OTRXFrameContext_T fc(msgStart);
+    EXPECT_TRUE(OTFHTC::secureHandler(fc));
+    EXPECT_TRUE(fc.isBodyDecoded());
+    EXPECT_EQ(0, memcmp(OTFHT::minimumSecureFrame::body, fc.fd.ptext, sizeof(OTFHT::minimumSecureFrame::body)));
+    EXPECT_TRUE(OTFHTC::secureHandler(fc));
+    EXPECT_EQ(2, OTFHTB::getKeyCount);
+    EXPECT_EQ(9U, OTFHTC::opOrder.size());
+    EXPECT_EQ(&fc.fd, OTFHTC::opFd.back());
+
+    // Unhandled and too-short frames.
+    EXPECT_FALSE((OTRadioLink::decodeAndHandleRXedFrame<OTFHTC::inspectingHandler>(msgStart)));
+    const uint8_t shortMsg[] = { 1, 'O' };
+    EXPECT_FALSE((OTRadioLink::decodeAndHandleRXedFrame<OTFHTC::secureHandler>(shortMsg + 1)));
+    EXPECT_EQ(2, OTFHTB::getKeyCount);
+    // Context handlers can also go straight into the raw message decode chain.
+    OTRadioLink::decodeAndHandleRawRXedMessage<OTFHTC::inspectingHandler, OTFHTC::secureHandler>(msgStart);
+    EXPECT_EQ(3, OTFHTB::getKeyCount);
+}
+
 #if 0 // Deleted in sec frame api
 namespace FTBHT {
 constexpr uint8_t heatCallPin = 0;
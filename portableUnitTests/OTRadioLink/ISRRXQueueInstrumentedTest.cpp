@@ -0,0 +1,179 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the RX queue instrumentation wrapper.
+ */
+
+#include <stdint.h>
+#include <type_traits>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace ISRRXQI
+{
+    // Mock tick source, set by the tests.
+    uint8_t ticks;
+    uint8_t getTicks() { return(ticks); }
+
+    // Queue a frame of len bytes; false if the queue returned no buffer.
+    bool push(OTRadioLink::ISRRXQueue &q, const uint8_t len, const uint8_t fType = 'O')
+    {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        if(NULL == b) { return(false); }
+        b[0] = len - 1;
+        b[1] = fType;
+        q._loadedBuf(len);
+        return(true);
+    }
+}
+
+// Nothing is added when instrumentation is off.
+TEST(ISRRXQueueInstrumented, Selection)
+{
+    typedef OTRadioLink::ISRRXQueueVarLenMsg<64, 3> q_t;
+    EXPECT_TRUE((std::is_same<q_t, OTRadioLink::ISRRXQueueMaybeInstrumented<false, q_t, ISRRXQI::getTicks>::t>::value));
+    EXPECT_TRUE((std::is_same<OTRadioLink::ISRRXQueueInstrumented<q_t, ISRRXQI::getTicks>,
+        OTRadioLink::ISRRXQueueMaybeInstrumented<true, q_t, ISRRXQI::getTicks>::t>::value));
+}
+
+// High-water marks and drops, with the queue behaving as unwrapped.
+TEST(ISRRXQueueInstrumented, DepthAndDrops)
+{
+    OTRadioLink::ISRRXQueueInstrumented<OTRadioLink::ISRRXQueueVarLenMsg<64, 2>, ISRRXQI::getTicks> q;
+    uint8_t qMin, maxLen;
+    q.getRXCapacity(qMin, maxLen);
+    EXPECT_EQ(2, qMin);
+    EXPECT_EQ(64, maxLen);
+    EXPECT_EQ(0, q.getRXBytesQueuedNonVirtual());
+    int n = 0;
+    while(ISRRXQI::push(q, 64)) { ++n; }
+    EXPECT_LE(2, n);
+    EXPECT_EQ(n, q.getRXMsgsQueued());
+    EXPECT_TRUE(q.isFull());
+    EXPECT_EQ(n, q.getMaxQueued());
+    EXPECT_LE(65 * n, q.getMaxBytesQueued()); // Includes any space lost to wrapping.
+    EXPECT_EQ(1, q.getDroppedCount());
+    // A frame not being uploaded is not a drop.
+    while(!q.isEmpty()) { q.removeRXMsg(); }
+    q._getRXBufForInbound();
+    q._loadedBuf(0);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(1, q.getDroppedCount());
+    EXPECT_EQ(n, q.getMaxQueued());
+    q.resetStats();
+    EXPECT_EQ(0, q.getMaxQueued());
+    EXPECT_EQ(0, q.getMaxBytesQueued());
+    EXPECT_EQ(0, q.getDroppedCount());
+    // Stats are reported with their own keys.
+    EXPECT_STREQ("RXqD", q.droppedSubSensor.tag());
+    EXPECT_EQ(0, q.droppedSubSensor.get());
+}
+
+// Residency is measured from load to removal, per frame.
+TEST(ISRRXQueueInstrumented, Residency)
+{
+    OTRadioLink::ISRRXQueueInstrumented<OTRadioLink::ISRRXQueueVarLenMsg<64, 3>, ISRRXQI::getTicks> q;
+    ISRRXQI::ticks = 250;
+    ASSERT_TRUE(ISRRXQI::push(q, 10));
+    ISRRXQI::ticks = 253;
+    ASSERT_TRUE(ISRRXQI::push(q, 10));
+    // Removed at tick 254 and 3 (wrapped): residencies 4 and 6.
+    ISRRXQI::ticks = 254;
+    q.removeRXMsg();
+    ISRRXQI::ticks = 3;
+    q.removeRXMsg();
+    // Removing from an empty queue records nothing.
+    q.removeRXMsg();
+    ISRRXQI::ticks = 3;
+    ASSERT_TRUE(ISRRXQI::push(q, 10));
+    q.removeRXMsg();
+    EXPECT_EQ(1, q.getResidencyCount(0));
+    EXPECT_EQ(0, q.getResidencyCount(1));
+    EXPECT_EQ(2, q.getResidencyCount(3));
+    EXPECT_EQ(0, q.getResidencyCount(99));
+    EXPECT_EQ(6, q.getMaxResidency());
+    EXPECT_EQ(6, q.maxResidencySubSensor.get());
+}
+
+// The residency histogram is reported as percentile sub-sensors.
+TEST(ISRRXQueueInstrumented, ResidencyPercentiles)
+{
+    OTRadioLink::ISRRXQueueInstrumented<OTRadioLink::ISRRXQueueVarLenMsg<64, 3>, ISRRXQI::getTicks> q;
+    EXPECT_EQ(0, q.getResidencyPercentile(50));
+    EXPECT_EQ(0, q.residencyP90SubSensor.get());
+    // 8 frames of 1 tick and 2 of 20 ticks.
+    for(int i = 0; i < 10; ++i)
+        {
+        ISRRXQI::ticks = 100;
+        ASSERT_TRUE(ISRRXQI::push(q, 10));
+        ISRRXQI::ticks = uint8_t((i < 8) ? 101 : 120);
+        q.removeRXMsg();
+        }
+    EXPECT_EQ(8, q.getResidencyCount(1));
+    EXPECT_EQ(2, q.getResidencyCount(5));
+    EXPECT_EQ(1, q.getResidencyPercentile(50));
+    EXPECT_EQ(1, q.getResidencyPercentile(80));
+    EXPECT_EQ(31, q.getResidencyPercentile(90));
+    EXPECT_EQ(31, q.getResidencyPercentile(100));
+    EXPECT_STREQ("RXq50", q.residencyP50SubSensor.tag());
+    EXPECT_EQ(1, q.residencyP50SubSensor.get());
+    EXPECT_STREQ("RXq90", q.residencyP90SubSensor.tag());
+    EXPECT_EQ(31, q.residencyP90SubSensor.get());
+    q.resetStats();
+    EXPECT_EQ(0, q.residencyP90SubSensor.get());
+}
+
+// Frames beyond the timestamp depth are counted but only timed once the backlog clears.
+TEST(ISRRXQueueInstrumented, Untracked)
+{
+    OTRadioLink::ISRRXQueueInstrumented<OTRadioLink::ISRRXQueueVarLenMsg<2, 8>, ISRRXQI::getTicks, 2> q;
+    ISRRXQI::ticks = 0;
+    for(int i = 0; i < 4; ++i) { ASSERT_TRUE(ISRRXQI::push(q, 2)); }
+    ISRRXQI::ticks = 1;
+    for(int i = 0; i < 4; ++i) { q.removeRXMsg(); }
+    ASSERT_TRUE(ISRRXQI::push(q, 2));
+    ISRRXQI::ticks = 2;
+    q.removeRXMsg();
+    uint16_t timed = 0;
+    for(uint8_t i = 0; i < q.ResidencyBuckets; ++i) { timed += q.getResidencyCount(i); }
+    EXPECT_EQ(3, timed);
+    EXPECT_EQ(3, q.getResidencyCount(1));
+}
+
+// Frames evicted by the underlying queue count as dropped and are not timed.
+TEST(ISRRXQueueInstrumented, Evicted)
+{
+    OTRadioLink::ISRRXQueueInstrumented<
+        OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 256, OTRadioLink::RXQOverflow_DropOldest>,
+        ISRRXQI::getTicks> q;
+    ISRRXQI::ticks = 0;
+    int n = 0;
+    while(!q.isFull()) { ASSERT_TRUE(ISRRXQI::push(q, 64)); ++n; }
+    EXPECT_EQ(0, q.getDroppedCount());
+    ISRRXQI::ticks = 10;
+    ASSERT_TRUE(ISRRXQI::push(q, 64));
+    EXPECT_EQ(1, q.getDroppedCount());
+    EXPECT_EQ(n, q.getRXMsgsQueued());
+    // The oldest survivors were loaded at tick 0, the newest at 10.
+    ISRRXQI::ticks = 20;
+    while(!q.isEmpty()) { q.removeRXMsg(); }
+    EXPECT_EQ(n - 1, q.getResidencyCount(5));
+    EXPECT_EQ(1, q.getResidencyCount(4));
+}
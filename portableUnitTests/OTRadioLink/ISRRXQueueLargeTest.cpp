@@ -0,0 +1,144 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the large-capacity RX queue and its overflow policies.
+ */
+
+#include <stdint.h>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace ISRRXQL
+{
+    // Queue a frame of len bytes with frame type fType and tag in the last byte;
+    // false if the queue returned no buffer.
+    bool push(OTRadioLink::ISRRXQueue &q, const uint8_t len, const uint8_t fType, const uint8_t tag)
+    {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        if(NULL == b) { return(false); }
+        b[0] = len - 1;
+        b[1] = fType;
+        b[len - 1] = tag;
+        q._loadedBuf(len);
+        return(true);
+    }
+
+    // Tag of the oldest frame, which is removed; -1 if none.
+    int pop(OTRadioLink::ISRRXQueue &q)
+    {
+        const volatile uint8_t *const b = q.peekRXMsg();
+        if(NULL == b) { return(-1); }
+        const int tag = b[b[-1] - 1];
+        q.removeRXMsg();
+        return(tag);
+    }
+
+    // Non-secure and secure 'O' frame types.
+    const uint8_t insecure = 'O';
+    const uint8_t secure = 'O' | 0x80;
+}
+
+// Holds many more full-size frames than ISRRXQueueVarLenMsg,
+// in order, wrapping around the buffer many times.
+TEST(ISRRXQueueVarLenMsgLarge, Basics)
+{
+    static OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 2048> q;
+    uint8_t qMin, maxLen;
+    q.getRXCapacity(qMin, maxLen);
+    EXPECT_EQ(31, qMin);
+    EXPECT_EQ(64, maxLen);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(NULL, q.peekRXMsg());
+    int n = 0;
+    while(ISRRXQL::push(q, 64, ISRRXQL::insecure, uint8_t(n))) { ++n; }
+    EXPECT_LE(qMin, n);
+    EXPECT_EQ(n, q.getRXMsgsQueued());
+    EXPECT_TRUE(q.isFull());
+    EXPECT_EQ(1, q.getDroppedNewestCount());
+    for(int i = 0; i < 1000; ++i)
+        {
+        ASSERT_EQ(uint8_t(i), ISRRXQL::pop(q));
+        ASSERT_TRUE(ISRRXQL::push(q, uint8_t(2 + (i % 63)), ISRRXQL::insecure, uint8_t(n + i)));
+        }
+    EXPECT_EQ(n, q.getRXMsgsQueued());
+    EXPECT_EQ(0, q.getDroppedOldestCount());
+}
+
+// Never more than 255 frames queued.
+TEST(ISRRXQueueVarLenMsgLarge, CountLimit)
+{
+    static OTRadioLink::ISRRXQueueVarLenMsgLarge<2, 4096, OTRadioLink::RXQOverflow_DropOldest> q;
+    for(int i = 0; i < 300; ++i) { ISRRXQL::push(q, 2, ISRRXQL::insecure, uint8_t(i)); }
+    EXPECT_EQ(255, q.getRXMsgsQueued());
+    EXPECT_EQ(300 - 255, q.getDroppedOldestCount());
+    EXPECT_EQ(300 - 255, ISRRXQL::pop(q));
+}
+
+// Drop-oldest makes room by losing the oldest frames,
+// except one the consumer may be looking at.
+TEST(ISRRXQueueVarLenMsgLarge, DropOldest)
+{
+    OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 256, OTRadioLink::RXQOverflow_DropOldest> q;
+    int n = 0;
+    while(!q.isFull()) { ASSERT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::insecure, uint8_t(n++))); }
+    // Still accepted, dropping the oldest.
+    EXPECT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::insecure, uint8_t(n++)));
+    EXPECT_EQ(1, q.getDroppedOldestCount());
+    EXPECT_EQ(0, q.getDroppedNewestCount());
+    // Pin the oldest (1) by peeking: now the new frame is dropped instead.
+    const volatile uint8_t *const p = q.peekRXMsg();
+    ASSERT_NE((const volatile uint8_t *)NULL, p);
+    ISRRXQL::push(q, 64, ISRRXQL::insecure, 99);
+    EXPECT_EQ(1, q.getDroppedNewestCount());
+    EXPECT_EQ(1, p[63]);
+    q.removeRXMsg();
+    // Everything after that is as queued.
+    for(int i = 2; i < n; ++i) { EXPECT_EQ(i, ISRRXQL::pop(q)); }
+    EXPECT_EQ(-1, ISRRXQL::pop(q));
+    q.resetDropCounts();
+    EXPECT_EQ(0, q.getDroppedNewestCount());
+    EXPECT_EQ(0, q.getDroppedOldestCount());
+}
+
+// Prefer-secure drops old non-secure frames for new secure ones, and nothing else.
+TEST(ISRRXQueueVarLenMsgLarge, PreferSecure)
+{
+    OTRadioLink::ISRRXQueueVarLenMsgLarge<64, 256, OTRadioLink::RXQOverflow_PreferSecure> q;
+    // Fill with two non-secure then secure frames.
+    ASSERT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::insecure, 0));
+    ASSERT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::insecure, 1));
+    int n = 2;
+    while(!q.isFull()) { ASSERT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::secure, uint8_t(n++))); }
+    // A new non-secure frame is dropped.
+    ISRRXQL::push(q, 64, ISRRXQL::insecure, 100);
+    EXPECT_EQ(1, q.getDroppedNewestCount());
+    EXPECT_EQ(0, q.getDroppedOldestCount());
+    // New secure frames replace the non-secure ones...
+    EXPECT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::secure, 101));
+    EXPECT_TRUE(ISRRXQL::push(q, 64, ISRRXQL::secure, 102));
+    EXPECT_EQ(2, q.getDroppedOldestCount());
+    // ...but not the secure ones.
+    ISRRXQL::push(q, 64, ISRRXQL::secure, 103);
+    EXPECT_EQ(2, q.getDroppedNewestCount());
+    for(int i = 2; i < n; ++i) { EXPECT_EQ(i, ISRRXQL::pop(q)); }
+    EXPECT_EQ(101, ISRRXQL::pop(q));
+    EXPECT_EQ(102, ISRRXQL::pop(q));
+    EXPECT_EQ(-1, ISRRXQL::pop(q));
+}
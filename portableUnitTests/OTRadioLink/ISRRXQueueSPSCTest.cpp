@@ -0,0 +1,152 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the hosted lock-free SPSC RX queue.
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace ISRRXQSPSC
+{
+    // Length of frame n, in [1,maxLen].
+    uint8_t frameLen(const uint32_t n, const uint8_t maxLen) { return(uint8_t(1 + ((n * 37U) % maxLen))); }
+    // Byte i of frame n.
+    uint8_t frameByte(const uint32_t n, const uint8_t i) { return(uint8_t(n + (i * 13U))); }
+
+    // Queue frame n; false if full.
+    template<class q_t>
+    bool push(q_t &q, const uint32_t n, const uint8_t maxLen)
+    {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        if(NULL == b) { return(false); }
+        const uint8_t l = frameLen(n, maxLen);
+        for(uint8_t i = 0; i < l; ++i) { b[i] = frameByte(n, i); }
+        q._loadedBuf(l);
+        return(true);
+    }
+
+    // Check that the oldest frame is frame n and remove it; false if empty or wrong.
+    template<class q_t>
+    bool popCheck(q_t &q, const uint32_t n, const uint8_t maxLen)
+    {
+        const volatile uint8_t *const b = q.peekRXMsg();
+        if(NULL == b) { return(false); }
+        const uint8_t l = frameLen(n, maxLen);
+        bool ok = (l == b[-1]);
+        for(uint8_t i = 0; ok && (i < l); ++i) { ok = (frameByte(n, i) == b[i]); }
+        q.removeRXMsg();
+        return(ok);
+    }
+}
+
+// Single-threaded use behaves as for ISRRXQueueVarLenMsg,
+// including wrapping around the ring many times.
+TEST(ISRRXQueueSPSC, Basics)
+{
+    constexpr uint8_t maxLen = 64;
+    static OTRadioLink::ISRRXQueueSPSC<maxLen, 256> q;
+    uint8_t queueRXMsgsMin, maxRXMsgLen;
+    q.getRXCapacity(queueRXMsgsMin, maxRXMsgLen);
+    EXPECT_EQ(maxLen, maxRXMsgLen);
+    EXPECT_EQ(2, queueRXMsgsMin);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_FALSE(q.isFull());
+    EXPECT_EQ(NULL, q.peekRXMsg());
+    q.removeRXMsg(); // Harmless when empty.
+    EXPECT_TRUE(q.isEmpty());
+
+    // Abandoned upload.
+    ASSERT_NE((volatile uint8_t *)NULL, q._getRXBufForInbound());
+    q._loadedBuf(0);
+    EXPECT_TRUE(q.isEmpty());
+
+    // Fill with full-size frames.
+    uint8_t n = 0;
+    while(q.isFull() == false) {
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        ASSERT_NE((volatile uint8_t *)NULL, b);
+        for(uint8_t i = 0; i < maxLen; ++i) { b[i] = uint8_t(n + i); }
+        q._loadedBuf(maxLen);
+        ++n;
+    }
+    EXPECT_LE(queueRXMsgsMin, n);
+    EXPECT_EQ(n, q.getRXMsgsQueued());
+    EXPECT_EQ(NULL, q._getRXBufForInbound());
+    for(uint8_t j = 0; j < n; ++j) {
+        const volatile uint8_t *const b = q.peekRXMsg();
+        ASSERT_NE((const volatile uint8_t *)NULL, b);
+        EXPECT_EQ(maxLen, b[-1]);
+        EXPECT_EQ(uint8_t(j + maxLen - 1), b[maxLen - 1]);
+        q.removeRXMsg();
+    }
+    EXPECT_TRUE(q.isEmpty());
+
+    // Varied lengths, keeping a few frames queued, around the ring many times.
+    uint32_t in = 0, out = 0;
+    while(out < 2000) {
+        while((in - out < 3) && ISRRXQSPSC::push(q, in, maxLen)) { ++in; }
+        ASSERT_TRUE(ISRRXQSPSC::popCheck(q, out, maxLen));
+        ++out;
+        EXPECT_EQ(in - out, q.getRXMsgsQueued());
+    }
+}
+
+// Never more than 255 frames queued, however short.
+TEST(ISRRXQueueSPSC, CountLimit)
+{
+    static OTRadioLink::ISRRXQueueSPSC<2, 4096> q;
+    uint32_t n = 0;
+    while(ISRRXQSPSC::push(q, n, 1)) { ++n; }
+    EXPECT_EQ(255U, n);
+    EXPECT_EQ(255, q.getRXMsgsQueued());
+    EXPECT_TRUE(q.isFull());
+    ASSERT_TRUE(ISRRXQSPSC::popCheck(q, 0, 1));
+    EXPECT_FALSE(q.isFull());
+}
+
+// A producer and a consumer thread with no lock:
+// every frame arrives intact and in order.
+TEST(ISRRXQueueSPSC, TwoThreadStress)
+{
+    constexpr uint8_t maxLen = 63;
+    constexpr uint32_t frames = 500000;
+    static OTRadioLink::ISRRXQueueSPSC<maxLen, 512> q;
+    std::atomic<uint32_t> fullCount(0);
+    std::thread producer([&]{
+        for(uint32_t n = 0; n < frames; ) {
+            if(ISRRXQSPSC::push(q, n, maxLen)) { ++n; }
+            else { ++fullCount; std::this_thread::yield(); }
+        }
+    });
+    uint32_t bad = 0;
+    for(uint32_t n = 0; n < frames; ) {
+        if(NULL == q.peekRXMsg()) { std::this_thread::yield(); continue; }
+        if(!ISRRXQSPSC::popCheck(q, n, maxLen)) { ++bad; }
+        ++n;
+    }
+    producer.join();
+    EXPECT_EQ(0U, bad);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(NULL, q.peekRXMsg());
+}
@@ -0,0 +1,233 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * OTRN2483Link tests, against a scripted RN2483.
+ */
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "OTRN2483Link.h"
+
+namespace RN2483Mock
+{
+    // Mock clock, set by the tests.
+    uint_fast8_t seconds;
+    uint_fast8_t getSeconds() { return(seconds); }
+    void advance(const uint_fast8_t s) { seconds = uint_fast8_t((seconds + s) % 60); }
+
+    // Buffered serial answering each command line as the RN2483 would.
+    // The second reply line to "mac join" and "mac tx" is held until release().
+    class ScriptedRN2483 final : public Stream
+        {
+        private:
+            static std::string line;
+            static std::string toBeRead;
+            static std::string held;
+
+        public:
+            // Command lines received, without the CR LF.
+            static std::vector<std::string> commands;
+            // Commands received before the reply to the one before was read.
+            static int overlapped;
+            static int reads;
+            static int breaks;
+            // When true nothing is answered.
+            static bool silent;
+            // First reply to "mac tx".
+            static std::string txReply;
+
+            static void reset()
+                {
+                line.clear(); toBeRead.clear(); held.clear(); commands.clear();
+                overlapped = 0; reads = 0; breaks = 0; silent = false; txReply = "ok";
+                }
+            // Makes the held reply line, if any, available to read.
+            static void release() { toBeRead += held; held.clear(); }
+            static void addCharsToRead(const std::string &s) { toBeRead += s; }
+
+            void begin(unsigned long) { }
+            void sendBreak() { ++breaks; }
+
+            virtual size_t write(uint8_t uc) override
+                {
+                line += char(uc);
+                if((line.size() < 2) || (0 != line.compare(line.size() - 2, 2, "\r\n"))) { return(1); }
+                const std::string c = line.substr(0, line.size() - 2);
+                line.clear();
+                // Leading autobaud 'U'.
+                commands.push_back(('U' == c[0]) ? c.substr(1) : c);
+                if(!toBeRead.empty() || !held.empty()) { ++overlapped; }
+                if(silent) { return(1); }
+                if(0 == c.compare(0, 7, "mac tx ")) { toBeRead += txReply + "\r\n"; if("ok" == txReply) { held = "mac_tx_ok\r\n"; } }
+                else if("mac join abp" == c) { toBeRead += "ok\r\n"; held = "accepted\r\n"; }
+                else if("mac get status" == c) { toBeRead += "00000001\r\n"; }
+                else { toBeRead += "ok\r\n"; }
+                return(1);
+                }
+            virtual int read() override
+                {
+                ++reads;
+                if(toBeRead.empty()) { return(-1); }
+                const char c = toBeRead.front();
+                toBeRead.erase(0, 1);
+                return(c);
+                }
+            virtual int available() override { return(int(toBeRead.size())); }
+            virtual int peek() override { return(-1); }
+            virtual void flush() override { }
+        };
+    std::string ScriptedRN2483::line;
+    std::string ScriptedRN2483::toBeRead;
+    std::string ScriptedRN2483::held;
+    std::vector<std::string> ScriptedRN2483::commands;
+    int ScriptedRN2483::overlapped;
+    int ScriptedRN2483::reads;
+    int ScriptedRN2483::breaks;
+    bool ScriptedRN2483::silent;
+    std::string ScriptedRN2483::txReply;
+
+    typedef OTRN2483Link::OTRN2483Link<0, 0, 0, getSeconds, 57600, ScriptedRN2483> link_t;
+
+    void poll(link_t &l, const int n) { for(int i = 0; i < n; ++i) { l.poll(); } }
+
+    // Begins and runs the setup to the end.
+    void setUp(link_t &l)
+    {
+        seconds = 0;
+        ScriptedRN2483::reset();
+        l.begin();
+        poll(l, 20);
+        ScriptedRN2483::release();
+        poll(l, 5);
+    }
+}
+
+// Setup commands are sent one at a time, each once the last is answered.
+TEST(OTRN2483Link, Setup)
+{
+    typedef RN2483Mock::ScriptedRN2483 m;
+    RN2483Mock::seconds = 0;
+    m::reset();
+    RN2483Mock::link_t l;
+    EXPECT_TRUE(l.begin());
+    EXPECT_EQ(1, m::breaks);
+    EXPECT_TRUE(m::commands.empty());
+    EXPECT_FALSE(l.isAvailable());
+    RN2483Mock::poll(l, 20);
+    // Waiting for the join to be accepted.
+    ASSERT_EQ(8U, m::commands.size());
+    EXPECT_EQ("mac join abp", m::commands.back());
+    m::release();
+    RN2483Mock::poll(l, 20);
+    const std::vector<std::string> expected = {
+        "mac set devaddr 02011123",
+        "mac set appskey 2B7E151628AED2A6ABF7158809CF4F3C",
+        "mac set nwkskey 2B7E151628AED2A6ABF7158809CF4F3C",
+        "mac set ch drrange 0 1 5",
+        "mac set ch drrange 1 1 5",
+        "mac set ch drrange 2 1 5",
+        "mac set adr on",
+        "mac join abp",
+        "mac get status",
+        };
+    EXPECT_EQ(expected, m::commands);
+    EXPECT_EQ(0, m::overlapped);
+    EXPECT_TRUE(l.isAvailable());
+}
+
+// sendRaw() only queues; poll() sends it and waits for its result before the next.
+TEST(OTRN2483Link, SendIsQueued)
+{
+    typedef RN2483Mock::ScriptedRN2483 m;
+    RN2483Mock::link_t l;
+    RN2483Mock::setUp(l);
+    const size_t setupCommands = m::commands.size();
+    const int reads = m::reads;
+    uint8_t q, r, t;
+    l.getCapacity(q, r, t);
+    EXPECT_EQ(49, t);
+    const uint8_t big[50] = { };
+    EXPECT_FALSE(l.sendRaw(big, sizeof(big)));
+    const uint8_t f1[] = { 0x01, 0xab, 0x7f };
+    EXPECT_TRUE(l.sendRaw(f1, sizeof(f1)));
+    EXPECT_EQ(reads, m::reads);
+    EXPECT_EQ(setupCommands, m::commands.size());
+    EXPECT_EQ(1, l.getTXMsgsQueued());
+    l.poll();
+    ASSERT_EQ(setupCommands + 1, m::commands.size());
+    EXPECT_EQ("mac tx uncnf 1 01AB7F", m::commands.back());
+    EXPECT_EQ(0, l.getTXMsgsQueued());
+    // Another frame waits for the result of the first.
+    const uint8_t f2[] = { 0x42 };
+    EXPECT_TRUE(l.sendRaw(f2, sizeof(f2)));
+    RN2483Mock::poll(l, 10);
+    EXPECT_EQ(setupCommands + 1, m::commands.size());
+    m::release();
+    RN2483Mock::poll(l, 3);
+    ASSERT_EQ(setupCommands + 2, m::commands.size());
+    EXPECT_EQ("mac tx uncnf 1 42", m::commands.back());
+    m::release();
+    RN2483Mock::poll(l, 3);
+    EXPECT_EQ(0, l.getTXFailed());
+    EXPECT_EQ(0, m::overlapped);
+}
+
+// Refused and unanswered sends are given up on, without poll() blocking.
+TEST(OTRN2483Link, FailedSends)
+{
+    typedef RN2483Mock::ScriptedRN2483 m;
+    RN2483Mock::link_t l;
+    RN2483Mock::setUp(l);
+    const uint8_t f[] = { 1 };
+    // No second reply once refused.
+    m::txReply = "no_free_ch";
+    ASSERT_TRUE(l.sendRaw(f, sizeof(f)));
+    RN2483Mock::poll(l, 2);
+    EXPECT_EQ(1, l.getTXFailed());
+    m::txReply = "ok";
+    ASSERT_TRUE(l.sendRaw(f, sizeof(f)));
+    l.poll();
+    EXPECT_EQ("mac tx uncnf 1 01", m::commands.back());
+    // No result in time.
+    RN2483Mock::poll(l, 5);
+    RN2483Mock::advance(14);
+    RN2483Mock::poll(l, 5);
+    EXPECT_EQ(1, l.getTXFailed());
+    RN2483Mock::advance(2);
+    l.poll();
+    EXPECT_EQ(2, l.getTXFailed());
+    // Silent module.
+    m::silent = true;
+    ASSERT_TRUE(l.sendRaw(f, sizeof(f)));
+    RN2483Mock::poll(l, 5);
+    RN2483Mock::advance(2);
+    l.poll();
+    EXPECT_EQ(3, l.getTXFailed());
+    // A flood of chars is read a bounded amount at a time.
+    m::silent = false;
+    m::addCharsToRead(std::string(1000, 'x'));
+    ASSERT_TRUE(l.sendRaw(f, sizeof(f)));
+    l.poll();
+    const int before = m::reads;
+    l.poll();
+    EXPECT_EQ(unsigned(RN2483Mock::link_t::maxReadsPerPoll), unsigned(m::reads - before));
+}
@@ -24,6 +24,9 @@ Author(s) / Copyright (s): Damon Hart-Davis 2016
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
 
 #include "OTSIM900Link.h"
 
@@ -351,6 +354,7 @@ public:
             else if(commands.CIPSTATUS == command) { reply.append(replies.CIPSTATUS_CONNECTED); }
             else if(commands.CIPSTART == command) { reply.append(replies.CIPSTART_FALSE); }
             else if(commands.CIPSEND == command) { reply.append(replies.CIPSEND_TRUE); }
+            else if(0 == command.find("AT+CIPSEND=")) { reply.append(command + "\r\n\r\n>"); }  // Any other length.
             else if("123" == command) { reply = "123\r\nSEND OK\r\n"; }  // todo this must depend on the cipsend being asked.
             break;
         case UDP_CLOSING:
@@ -1305,3 +1309,312 @@ TEST(OTSIM900Link, PDPDeactResetTest)
         l0.end();
 }
 
+
+namespace B3 {
+// Never stops sending: a blocking read() always has a char ready.
+// Would hang any poll() that reads until the line goes quiet.
+class FloodSerial final : public Stream
+  {
+  public:
+    static unsigned long reads;
+    // Number of commands (lines) written.
+    static unsigned long commands;
+    void begin(unsigned long) { }
+    void end();
+    virtual size_t write(uint8_t c) override { if('\n' == c) { ++commands; } return(1); }
+    virtual int available() override { return(-1); }
+    virtual int read() override { ++reads; return('x'); }
+    virtual int peek() override { return(-1); }
+    virtual void flush() override { }
+  };
+unsigned long FloodSerial::reads = 0;
+unsigned long FloodSerial::commands = 0;
+}
+
+// poll() must return after a bounded number of reads and short time
+// even when the SIM900 never stops talking,
+// and the link must give up on the reply and reset rather than wait forever.
+TEST(OTSIM900Link, FloodedSerialPollIsBounded)
+{
+    const char SIM900_PIN[] = "1111";
+    const char SIM900_APN[] = "apn";
+    const char SIM900_UDP_ADDR[] = "0.0.0.0"; // ORS server
+    const char SIM900_UDP_PORT[] = "9999";
+    const OTSIM900Link::OTSIM900LinkConfig_t SIM900Config(false, SIM900_PIN, SIM900_APN, SIM900_UDP_ADDR, SIM900_UDP_PORT);
+    const OTRadioLink::OTRadioChannelConfig l0Config(&SIM900Config, true);
+    typedef OTSIM900Link::OTSIM900Link<0, 0, 0, SIM900Emu::getSecondsVT, B3::FloodSerial> link_t;
+    link_t l0;
+    EXPECT_TRUE(l0.configure(1, &l0Config));
+    EXPECT_TRUE(l0.begin());
+    const unsigned long commandsBefore = B3::FloodSerial::commands;
+    int resets = 0;
+    for(int i = 0; i < 100; ++i) {
+        SIM900Emu::vt.incrementVTOneCycle();
+        if(OTSIM900Link::RESET == l0._getState()) { ++resets; }
+        const unsigned long readsBefore = B3::FloodSerial::reads;
+        const auto start = std::chrono::steady_clock::now();
+        l0.poll();
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_GE(unsigned(link_t::maxReadsPerPoll), B3::FloodSerial::reads - readsBefore) << "poll " << i;
+        EXPECT_GT(10000, us) << "poll " << i;
+    }
+    // The reply to AT timed out (repeatedly), each time resetting and trying again.
+    EXPECT_LE(2, resets);
+    EXPECT_LE(3U, B3::FloodSerial::commands - commandsBefore);
+    l0.end();
+}
+
+namespace B4 {
+// Buffered serial (eg interrupt driven) in front of the SIM900 emulator:
+// read() never waits, available() says how much is ready,
+// and replies are released a few chars at a time by the test.
+class TrickleSerial final : public Stream
+  {
+  public:
+    static SIM900Emu::SIM900StateEmulator emu;
+    // Everything written.
+    static std::string written;
+    // Command being written.
+    static std::string command;
+    // Reply not yet released, and released but not yet read.
+    static std::string pending, ready;
+    static unsigned long reads;
+
+    static void reset() { written.clear(); command.clear(); pending.clear(); ready.clear(); emu.reset(); }
+    // Make up to n more chars of reply ready to read.
+    static void release(const size_t n)
+        {
+        const size_t m = std::min(n, pending.size());
+        ready += pending.substr(0, m);
+        pending.erase(0, m);
+        }
+
+    void begin(unsigned long) { }
+    void end();
+    virtual size_t write(uint8_t uc) override
+        {
+        const char c = (char)uc;
+        written += c;
+        command += c;
+        if('\n' == c) {
+            if(emu.parseCommand(command)) { emu.poll(command, pending); }
+            command.clear();
+        }
+        return(1);
+        }
+    virtual int available() override { return(int(ready.size())); }
+    virtual int read() override
+        {
+        ++reads;
+        if(ready.empty()) { return(-1); }
+        const char c = ready[0];
+        ready.erase(0, 1);
+        return(c);
+        }
+    virtual int peek() override { return(-1); }
+    virtual void flush() override { }
+  };
+SIM900Emu::SIM900StateEmulator TrickleSerial::emu;
+std::string TrickleSerial::written;
+std::string TrickleSerial::command;
+std::string TrickleSerial::pending;
+std::string TrickleSerial::ready;
+unsigned long TrickleSerial::reads = 0;
+}
+
+// With a buffered serial, replies are picked up over several polls
+// without waiting in any one, and a frame still gets sent.
+TEST(OTSIM900Link, BufferedSerialTrickle)
+{
+    B4::TrickleSerial::reset();
+    B4::TrickleSerial::emu.myState = SIM900Emu::SIM900StateEmulator::POWERING_UP; // Start from here to simplify startup process.
+    const char SIM900_PIN[] = "1111";
+    const char SIM900_APN[] = "apn";
+    const char SIM900_UDP_ADDR[] = "0.0.0.0"; // ORS server
+    const char SIM900_UDP_PORT[] = "9999";
+    const OTSIM900Link::OTSIM900LinkConfig_t SIM900Config(false, SIM900_PIN, SIM900_APN, SIM900_UDP_ADDR, SIM900_UDP_PORT);
+    const OTRadioLink::OTRadioChannelConfig l0Config(&SIM900Config, true);
+    typedef OTSIM900Link::OTSIM900Link<0, 0, 0, SIM900Emu::getSecondsVT, B4::TrickleSerial> link_t;
+    link_t l0;
+    EXPECT_TRUE(l0.configure(1, &l0Config));
+    EXPECT_TRUE(l0.begin());
+    // Poll once per cycle, releasing 4 chars of reply before each.
+    auto step = [&l0] {
+        SIM900Emu::vt.incrementVTOneCycle();
+        B4::TrickleSerial::release(4);
+        const unsigned long readsBefore = B4::TrickleSerial::reads;
+        l0.poll();
+        // Never more than what was ready plus the read that found nothing.
+        EXPECT_GE(5U, B4::TrickleSerial::reads - readsBefore);
+    };
+    // Get to IDLE.
+    for(int i = 0; (i < 500) && (OTSIM900Link::IDLE != l0._getState()); ++i) { step(); }
+    ASSERT_EQ(OTSIM900Link::IDLE, l0._getState());
+    EXPECT_EQ(SIM900Emu::SIM900StateEmulator::UDP_CONNECT_OK, B4::TrickleSerial::emu.myState);
+    // Send a frame, which must wait for the '>' prompt to trickle in.
+    const char message[] = "123";
+    B4::TrickleSerial::written.clear();
+    EXPECT_TRUE(l0.sendRaw((const uint8_t *)message, (uint8_t)sizeof(message)-1));
+    bool sent = false;
+    for(int i = 0; (i < 100) && !sent; ++i) {
+        step();
+        sent = (std::string::npos != B4::TrickleSerial::written.find("AT+CIPSEND=3\r\n123"));
+        if(!sent) { EXPECT_EQ(std::string::npos, B4::TrickleSerial::written.find("123")) << "frame sent before prompt"; }
+    }
+    EXPECT_TRUE(sent);
+    for(int i = 0; (i < 10) && (OTSIM900Link::IDLE != l0._getState()); ++i) { step(); }
+    EXPECT_EQ(OTSIM900Link::IDLE, l0._getState());
+    l0.end();
+}
+
+// Coalesced datagrams split back into their frames.
+TEST(OTSIM900Link, UDPCoalescedFrameReader)
+{
+    const uint8_t d[] = { 3, '1', '2', '3', 1, 'x', 2, 'a', 'b' };
+    OTSIM900Link::UDPCoalescedFrameReader r(d, sizeof(d));
+    const uint8_t *f;
+    uint8_t l;
+    ASSERT_TRUE(r.next(f, l));
+    EXPECT_EQ(3, l);
+    EXPECT_EQ(d + 1, f);
+    ASSERT_TRUE(r.next(f, l));
+    EXPECT_EQ(1, l);
+    EXPECT_EQ('x', f[0]);
+    ASSERT_TRUE(r.next(f, l));
+    EXPECT_EQ(2, l);
+    EXPECT_EQ('a', f[0]);
+    EXPECT_FALSE(r.next(f, l));
+    EXPECT_FALSE(r.isMalformed());
+    // Empty.
+    OTSIM900Link::UDPCoalescedFrameReader e(d, 0);
+    EXPECT_FALSE(e.next(f, l));
+    EXPECT_FALSE(e.isMalformed());
+    // Last frame runs off the end.
+    OTSIM900Link::UDPCoalescedFrameReader t(d, sizeof(d) - 1);
+    EXPECT_TRUE(t.next(f, l));
+    EXPECT_TRUE(t.next(f, l));
+    EXPECT_FALSE(t.next(f, l));
+    EXPECT_TRUE(t.isMalformed());
+    // Zero length.
+    const uint8_t z[] = { 1, 'x', 0 };
+    OTSIM900Link::UDPCoalescedFrameReader zr(z, sizeof(z));
+    EXPECT_TRUE(zr.next(f, l));
+    EXPECT_FALSE(zr.next(f, l));
+    EXPECT_TRUE(zr.isMalformed());
+}
+
+namespace B5 {
+// Everything written to the SIM900, which the emulator itself does not keep.
+std::string log;
+void logAndPoll()
+    {
+    log += SIM900Emu::serialConnection.written.back();
+    SIM900Emu::sim900.poll();
+    }
+// Frames in each coalesced datagram sent, in order.
+std::vector<std::vector<std::string>> datagrams()
+    {
+    std::vector<std::vector<std::string>> result;
+    const std::string cmd = "AT+CIPSEND=";
+    for(size_t p = log.find(cmd); std::string::npos != p; p = log.find(cmd, p + 1)) {
+        const size_t eol = log.find("\r\n", p);
+        const size_t len = size_t(atoi(log.c_str() + p + cmd.size()));
+        const std::string d = log.substr(eol + 2, len);
+        OTSIM900Link::UDPCoalescedFrameReader r((const uint8_t *)d.data(), uint16_t(d.size()));
+        const uint8_t *f;
+        uint8_t l;
+        result.emplace_back();
+        while(r.next(f, l)) { result.back().emplace_back((const char *)f, l); }
+        EXPECT_FALSE(r.isMalformed());
+    }
+    return(result);
+    }
+}
+
+// With coalescing on, all frames queued go in one datagram,
+// and frames queued while a send is in progress go in the next.
+TEST(OTSIM900Link, CoalescedSend)
+{
+    SIM900Emu::serialConnection.reset();
+    SIM900Emu::serialConnection.writeCallback = B5::logAndPoll;
+    SIM900Emu::sim900.reset();
+    SIM900Emu::sim900.emu.myState = SIM900Emu::SIM900StateEmulator::POWERING_UP; // Start from here to simplify startup process.
+    const char SIM900_PIN[] = "1111";
+    const char SIM900_APN[] = "apn";
+    const char SIM900_UDP_ADDR[] = "0.0.0.0"; // ORS server
+    const char SIM900_UDP_PORT[] = "9999";
+    const OTSIM900Link::OTSIM900LinkConfig_t SIM900Config(false, SIM900_PIN, SIM900_APN, SIM900_UDP_ADDR, SIM900_UDP_PORT);
+    const OTRadioLink::OTRadioChannelConfig l0Config(&SIM900Config, true);
+    OTSIM900Link::OTSIM900Link<0, 0, 0, SIM900Emu::getSecondsVT, SIM900Emu::SoftSerialSimulator, 16> l0;
+    EXPECT_TRUE(l0.configure(1, &l0Config));
+    EXPECT_TRUE(l0.begin());
+    uint8_t q, r, t;
+    l0.getCapacity(q, r, t);
+    EXPECT_EQ(15, t);
+    for(int i = 0; i < 100; ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); if(l0._getState() == OTSIM900Link::IDLE) break;}
+    ASSERT_EQ(OTSIM900Link::IDLE, l0._getState());
+    B5::log.clear();
+    // Queue 4 + 3 + 5 bytes with length prefixes, leaving 4 of 16 free.
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"123", 3));
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"45", 2));
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"6789", 4));
+    EXPECT_FALSE(l0.queueToSend((const uint8_t *)"abcd", 4));
+    EXPECT_EQ(3, l0.getTXMsgsQueued());
+    // Fill the queue once the send has started.
+    for(int i = 0; (i < 20) && (OTSIM900Link::WRITE_PACKET != l0._getState()); ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); }
+    ASSERT_EQ(OTSIM900Link::WRITE_PACKET, l0._getState());
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"abc", 3));
+    EXPECT_FALSE(l0.queueToSend((const uint8_t *)"d", 1));
+    EXPECT_EQ(4, l0.getTXMsgsQueued());
+    SIM900Emu::vt.incrementVTOneCycle();
+    l0.poll();
+    EXPECT_EQ(1, l0.getTXMsgsQueued());
+    for(int i = 0; (i < 20) && (0 != l0.getTXMsgsQueued()); ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); }
+    EXPECT_EQ(0, l0.getTXMsgsQueued());
+    const std::vector<std::vector<std::string>> d = B5::datagrams();
+    ASSERT_EQ(2U, d.size());
+    const std::vector<std::string> first = { "123", "45", "6789" };
+    EXPECT_EQ(first, d[0]);
+    EXPECT_EQ(std::vector<std::string>(1, "abc"), d[1]);
+    l0.end();
+}
+
+// Without coalescing, a frame queued while another is waiting for the '>' prompt
+// does not disturb the one being sent, and is sent next.
+TEST(OTSIM900Link, QueueDuringSend)
+{
+    SIM900Emu::serialConnection.reset();
+    SIM900Emu::serialConnection.writeCallback = B5::logAndPoll;
+    SIM900Emu::sim900.reset();
+    SIM900Emu::sim900.emu.myState = SIM900Emu::SIM900StateEmulator::POWERING_UP; // Start from here to simplify startup process.
+    const char SIM900_PIN[] = "1111";
+    const char SIM900_APN[] = "apn";
+    const char SIM900_UDP_ADDR[] = "0.0.0.0"; // ORS server
+    const char SIM900_UDP_PORT[] = "9999";
+    const OTSIM900Link::OTSIM900LinkConfig_t SIM900Config(false, SIM900_PIN, SIM900_APN, SIM900_UDP_ADDR, SIM900_UDP_PORT);
+    const OTRadioLink::OTRadioChannelConfig l0Config(&SIM900Config, true);
+    OTSIM900Link::OTSIM900Link<0, 0, 0, SIM900Emu::getSecondsVT, SIM900Emu::SoftSerialSimulator> l0;
+    EXPECT_TRUE(l0.configure(1, &l0Config));
+    EXPECT_TRUE(l0.begin());
+    for(int i = 0; i < 100; ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); if(l0._getState() == OTSIM900Link::IDLE) break;}
+    ASSERT_EQ(OTSIM900Link::IDLE, l0._getState());
+    B5::log.clear();
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"123", 3));
+    // AT+CIPSEND=3 has gone out; queue a longer frame before the prompt is acted on.
+    for(int i = 0; (i < 20) && (OTSIM900Link::WRITE_PACKET != l0._getState()); ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); }
+    ASSERT_EQ(OTSIM900Link::WRITE_PACKET, l0._getState());
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"abcdef", 6));
+    EXPECT_EQ(2, l0.getTXMsgsQueued());
+    // The freshest frame replaces any other not yet being sent.
+    EXPECT_TRUE(l0.queueToSend((const uint8_t *)"uvwxyz", 6));
+    EXPECT_EQ(2, l0.getTXMsgsQueued());
+    SIM900Emu::vt.incrementVTOneCycle();
+    l0.poll();
+    EXPECT_EQ(1, l0.getTXMsgsQueued());
+    for(int i = 0; (i < 20) && (0 != l0.getTXMsgsQueued()); ++i) { SIM900Emu::vt.incrementVTOneCycle(); l0.poll(); }
+    EXPECT_EQ(0, l0.getTXMsgsQueued());
+    EXPECT_NE(std::string::npos, B5::log.find("AT+CIPSEND=3\r\n123"));
+    EXPECT_NE(std::string::npos, B5::log.find("AT+CIPSEND=6\r\nuvwxyz"));
+    EXPECT_EQ(std::string::npos, B5::log.find("abcdef"));
+    l0.end();
+}
@@ -0,0 +1,282 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the hosted journal-backed RX message counter store.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace RXMCJ
+{
+    // Make a fresh journal path in the temp directory.
+    struct TempPath
+    {
+        char path[64];
+        TempPath()
+        {
+            snprintf(path, sizeof(path), "/tmp/OTRXMsgCtrJournalTest.%d.%d", int(getpid()), ++seq);
+            unlink(path);
+        }
+        ~TempPath() { unlink(path); }
+        static int seq;
+    };
+    int TempPath::seq = 0;
+
+    const uint8_t id1[8] = { 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88 };
+    const uint8_t id2[8] = { 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98 };
+    // Counter with lsbs set to v.
+    struct Ctr { uint8_t c[6]; Ctr(uint8_t r, uint16_t v) : c{ 0, 0, r, 0, uint8_t(v >> 8), uint8_t(v) } { } };
+
+    // Small config that syncs rarely, so that reservations are what keep replays out.
+    const OTRadioLink::RXMsgCtrJournal::Config smallConfig = { 4, 16, 1000, 60000, 16 };
+
+    OTV0P2BASE::NodeAssociationTableIndexed<4> nodes;
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXJournalled<decltype(nodes), nodes> sfrx_t;
+
+    // Table with more slots than an 8-bit index can address.
+    OTV0P2BASE::NodeAssociationTableIndexed<300> bigNodes;
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXJournalled<decltype(bigNodes), bigNodes> bigsfrx_t;
+}
+
+// Counters are held across a clean close and reopen.
+TEST(RXMsgCtrJournal, CleanReopen)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    uint8_t out[6];
+    EXPECT_FALSE(j.get(RXMCJ::id1, out));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    ASSERT_TRUE(j.open(tp.path));
+    EXPECT_FALSE(j.open(tp.path));
+    // Unknown node has a zero counter.
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(0, 0).c, 6));
+    EXPECT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 5).c));
+    EXPECT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 6).c));
+    EXPECT_TRUE(j.update(RXMCJ::id2, RXMCJ::Ctr(2, 100).c));
+    // Must be strictly increasing.
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 6).c));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 2).c));
+    EXPECT_EQ(2U, j.getNodeCount());
+    EXPECT_TRUE(j.close());
+
+    ASSERT_TRUE(j.open(tp.path));
+    EXPECT_TRUE(j.wasCleanOnOpen());
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(1, 6).c, 6));
+    ASSERT_TRUE(j.get(RXMCJ::id2, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(2, 100).c, 6));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 6).c));
+    EXPECT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 7).c));
+    EXPECT_TRUE(j.close());
+}
+
+// Updates are synced in batches, except when the reservation must move.
+TEST(RXMsgCtrJournal, BatchedSync)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    const OTRadioLink::RXMsgCtrJournal::Config c = { 4, 64, 8, 60000, 100 };
+    ASSERT_TRUE(j.open(tp.path, c));
+    // First update must sync its reservation.
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    const uint32_t s0 = j.getSyncCount();
+    EXPECT_EQ(1U, j.getUnsyncedCount());
+    // Within the reservation, only every batchSize updates sync.
+    for(uint16_t i = 2; i <= 8; ++i) { ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, i).c)); }
+    EXPECT_EQ(s0 + 1, j.getSyncCount());
+    EXPECT_EQ(0U, j.getUnsyncedCount());
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 9).c));
+    EXPECT_EQ(1U, j.getUnsyncedCount());
+    EXPECT_TRUE(j.poll());
+    EXPECT_EQ(1U, j.getUnsyncedCount()); // Latency not yet expired.
+    EXPECT_TRUE(j.sync());
+    EXPECT_EQ(0U, j.getUnsyncedCount());
+    EXPECT_TRUE(j.close());
+}
+
+// After a crash, no counter accepted before it can be accepted again.
+TEST(RXMsgCtrJournal, UncleanRecoveryPreventsReplay)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 10).c));
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 20).c));
+    j._abandon();
+
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    EXPECT_FALSE(j.wasCleanOnOpen());
+    // Recovered at the reservation (10 + 16), covering everything accepted.
+    uint8_t out[6];
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(1, 26).c, 6));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 20).c));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 26).c));
+    EXPECT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 27).c));
+    EXPECT_TRUE(j.close());
+}
+
+// A torn or corrupt record ends the journal.
+TEST(RXMsgCtrJournal, CorruptTailIgnored)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 2).c));
+    EXPECT_TRUE(j.close());
+    // Records: R(17), C(1), C(2); damage the last.
+    FILE *f = fopen(tp.path, "r+b");
+    ASSERT_NE((FILE *)NULL, f);
+    const long lastCtrLsb = long(OTRadioLink::RXMsgCtrJournal::headerBytes + 3 * OTRadioLink::RXMsgCtrJournal::recordBytes - 2);
+    fseek(f, lastCtrLsb, SEEK_SET);
+    fputc(0x55, f);
+    fclose(f);
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    uint8_t out[6];
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(1, 1).c, 6));
+    EXPECT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 2).c));
+    EXPECT_TRUE(j.close());
+}
+
+// The journal is compacted when full, keeping all values.
+TEST(RXMsgCtrJournal, Compaction)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    for(uint16_t i = 1; i <= 200; ++i)
+    {
+        ASSERT_TRUE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, i).c));
+        ASSERT_TRUE(j.update(RXMCJ::id2, RXMCJ::Ctr(2, uint16_t(2 * i)).c));
+    }
+    EXPECT_LT(0U, j.getCompactionCount());
+    // Too many nodes is rejected.
+    uint8_t id[8] = { 0xa0 };
+    for(uint8_t i = 0; i < 2; ++i) { id[1] = i; EXPECT_TRUE(j.update(id, RXMCJ::Ctr(3, 1).c)); }
+    id[1] = 99;
+    EXPECT_FALSE(j.update(id, RXMCJ::Ctr(3, 1).c));
+    EXPECT_TRUE(j.close());
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    uint8_t out[6];
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(1, 200).c, 6));
+    ASSERT_TRUE(j.get(RXMCJ::id2, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(2, 400).c, 6));
+    EXPECT_TRUE(j.close());
+}
+
+// If the compacted journal cannot be remapped the journal closes itself
+// rather than being left open with no mapping,
+// and keeps every accepted counter.
+TEST(RXMsgCtrJournal, CompactionRemapFailureCloses)
+{
+    RXMCJ::TempPath tp;
+    OTRadioLink::RXMsgCtrJournal j;
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    j._failNextMapFile();
+    // Fill the journal until the compaction (and so the remap) is needed.
+    uint16_t lastAccepted = 0;
+    for(uint16_t i = 1; i <= 100; ++i)
+    {
+        if(!j.update(RXMCJ::id1, RXMCJ::Ctr(1, i).c)) { break; }
+        lastAccepted = i;
+    }
+    ASSERT_NE(0, lastAccepted);
+    ASSERT_GT(100, lastAccepted);
+    EXPECT_EQ(0U, j.getCompactionCount());
+    EXPECT_FALSE(j.isOpen());
+    // Everything then fails cleanly.
+    uint8_t out[6];
+    EXPECT_FALSE(j.get(RXMCJ::id1, out));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, 1000).c));
+    EXPECT_FALSE(j.sync());
+    EXPECT_FALSE(j.poll());
+    EXPECT_TRUE(j.close());
+    // The compacted journal is intact and no accepted counter can be replayed.
+    ASSERT_TRUE(j.open(tp.path, RXMCJ::smallConfig));
+    EXPECT_FALSE(j.wasCleanOnOpen());
+    ASSERT_TRUE(j.get(RXMCJ::id1, out));
+    EXPECT_LE(0, OTRadioLink::SimpleSecureFrame32or0BodyRXBase::msgcountercmp(out, RXMCJ::Ctr(1, lastAccepted).c));
+    EXPECT_FALSE(j.update(RXMCJ::id1, RXMCJ::Ctr(1, lastAccepted).c));
+    EXPECT_TRUE(j.close());
+}
+
+// The RX implementation checks associations and uses the journal.
+TEST(RXMsgCtrJournal, SimpleSecureFrame32or0BodyRXJournalled)
+{
+    RXMCJ::TempPath tp;
+    RXMCJ::nodes._reset();
+    ASSERT_TRUE(RXMCJ::nodes.set(0, RXMCJ::id1));
+    RXMCJ::sfrx_t &rx = RXMCJ::sfrx_t::getInstance();
+    uint8_t out[6];
+    // Fails safely until opened.
+    EXPECT_FALSE(rx.getLastRXMsgCtr(RXMCJ::id1, out));
+    ASSERT_TRUE(rx.getJournal().open(tp.path, RXMCJ::smallConfig));
+    EXPECT_TRUE(rx.getLastRXMsgCtr(RXMCJ::id1, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::Ctr(0, 0).c, 6));
+    // Unassociated node fails.
+    EXPECT_FALSE(rx.getLastRXMsgCtr(RXMCJ::id2, out));
+    EXPECT_FALSE(rx.authAndUpdateRXMsgCtr(RXMCJ::id2, RXMCJ::Ctr(1, 1).c));
+    EXPECT_TRUE(rx.authAndUpdateRXMsgCtr(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    EXPECT_FALSE(rx.validateRXMsgCtr(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    EXPECT_TRUE(rx.validateRXMsgCtr(RXMCJ::id1, RXMCJ::Ctr(1, 2).c));
+    EXPECT_FALSE(rx.authAndUpdateRXMsgCtr(RXMCJ::id1, RXMCJ::Ctr(1, 1).c));
+    EXPECT_TRUE(rx.getJournal().close());
+}
+
+// Node lookup gives the right slot, and continues from it, past slot 127.
+TEST(RXMsgCtrJournal, NodeLookupPast127)
+{
+    RXMCJ::bigNodes._reset();
+    uint8_t id[8] = { 0x10, 0, 0, 0x44, 0x55, 0x66, 0x77, 0x88 };
+    for(uint16_t i = 0; i < RXMCJ::bigNodes.maxSets; ++i)
+    {
+        id[1] = uint8_t(i >> 8);
+        id[2] = uint8_t(i);
+        ASSERT_TRUE(RXMCJ::bigNodes.setEntry(i, id));
+    }
+    // Two nodes sharing a prefix, at slots either side of 255.
+    ASSERT_TRUE(RXMCJ::bigNodes.setEntry(200, RXMCJ::id1));
+    uint8_t id1b[8];
+    memcpy(id1b, RXMCJ::id1, 8);
+    id1b[7] ^= 1;
+    ASSERT_TRUE(RXMCJ::bigNodes.setEntry(290, id1b));
+    OTRadioLink::SecurableFrameHeader sfh;
+    sfh.seqIl = 4;
+    memcpy(sfh.id, RXMCJ::id1, 4);
+    const RXMCJ::bigsfrx_t &rx = RXMCJ::bigsfrx_t::getInstance();
+    uint8_t out[8];
+    EXPECT_EQ(200, rx._getNextMatchingNodeID(0, &sfh, out));
+    EXPECT_EQ(0, memcmp(out, RXMCJ::id1, 8));
+    EXPECT_EQ(200, rx._getNextMatchingNodeID(128, &sfh, out));
+    EXPECT_EQ(290, rx._getNextMatchingNodeID(201, &sfh, out));
+    EXPECT_EQ(0, memcmp(out, id1b, 8));
+    EXPECT_EQ(290, rx._getNextMatchingNodeID(290, &sfh, NULL));
+    EXPECT_EQ(-1, rx._getNextMatchingNodeID(291, &sfh, NULL));
+    EXPECT_EQ(-1, rx._getNextMatchingNodeID(RXMCJ::bigNodes.maxSets, &sfh, NULL));
+}
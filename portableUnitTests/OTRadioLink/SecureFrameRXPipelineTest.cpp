@@ -0,0 +1,331 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the hosted multi-threaded secure frame RX pipeline.
+ */
+
+// Only enable these tests if the OTAESGCM library is marked as available.
+#if defined(EXT_AVAILABLE_ARDUINO_LIB_OTAESGCM)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <OTAESGCM.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace SFRXP
+{
+    constexpr uint8_t nodeCount = 3;
+    OTV0P2BASE::NodeAssociationTableIndexed<nodeCount> nodes;
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXJournalled<decltype(nodes), nodes> sfrx_t;
+
+    void makeID(const uint8_t n, uint8_t *const id)
+    {
+        for(uint8_t i = 0; i < 8; ++i) { id[i] = uint8_t(0x80 | (n << 4) | i); }
+    }
+
+    bool getKey(uint8_t *const key) { memset(key, 0, 16); return(true); }
+
+    // Secure 'O' frame from node n with message counter c,
+    // with the length in the first byte.
+    struct Frame
+    {
+        uint8_t buf[OTRadioLink::SecurableFrameHeader::maxSmallFrameSize + 1];
+        Frame(const uint8_t n, const uint8_t c)
+        {
+            uint8_t id[8];
+            makeID(n, id);
+            uint8_t iv[12] = { };
+            memcpy(iv, id, 6);
+            iv[11] = c;
+            uint8_t body[32] = { 0x7f, 0x11, '{', '"', 'b', '"', ':', '1' };
+            OTRadioLink::OTEncodeData_T fd(body, sizeof(body), buf, sizeof(buf));
+            fd.ptextLen = 8;
+            fd.fType = OTRadioLink::FTS_BasicSensorOrValve;
+            uint8_t workspace[OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeRaw_total_scratch_usage_OTAESGCM_2p0];
+            OTV0P2BASE::ScratchSpaceL sW(workspace, sizeof(workspace));
+            const uint8_t key[16] = { };
+            const uint8_t l = OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeRaw(fd, id, 4, iv,
+                OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE, sW, key);
+            EXPECT_EQ(63, l);
+        }
+        const uint8_t *msg() const { return(buf + 1); }
+    };
+
+    // (Sender, message counter lsb) of each frame passed to the operator, in order.
+    std::vector<std::pair<uint8_t, uint8_t> > handled;
+    bool recordFrameOperation(const OTRadioLink::OTDecodeData_T &fd)
+    {
+        handled.push_back(std::make_pair(fd.id[0], fd.ctext[fd.sfh.getTrailerOffset() + 5]));
+        return(true);
+    }
+    int otherCount;
+    bool countingOtherHandler(volatile const uint8_t *) { ++otherCount; return(true); }
+
+    typedef OTRadioLink::SecureOFrameRXPipeline<sfrx_t,
+        OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE,
+        getKey, recordFrameOperation,
+        OTRadioLink::nullFrameOperation,
+        countingOtherHandler> pipeline_t;
+
+    // Associate the nodes and open a fresh counter journal.
+    struct Setup
+    {
+        char path[64];
+        Setup()
+        {
+            snprintf(path, sizeof(path), "/tmp/OTSecureFrameRXPipelineTest.%d", int(getpid()));
+            unlink(path);
+            nodes._reset();
+            uint8_t id[8];
+            for(uint8_t n = 0; n < nodeCount; ++n) { makeID(n, id); nodes.set(n, id); }
+            EXPECT_TRUE(sfrx_t::getInstance().getJournal().open(path));
+            handled.clear();
+            otherCount = 0;
+        }
+        ~Setup() { sfrx_t::getInstance().getJournal().close(); unlink(path); }
+    };
+}
+
+// Not running: frames are dropped.
+TEST(SecureOFrameRXPipeline, NotRunning)
+{
+    SFRXP::pipeline_t p;
+    const SFRXP::Frame f(0, 1);
+    EXPECT_FALSE(p.isRunning());
+    EXPECT_FALSE(p.submit(f.msg()));
+    EXPECT_EQ(1U, p.getDroppedCount());
+    // Insane arguments.
+    EXPECT_FALSE(p.start(0));
+    EXPECT_FALSE(p.start(1, 0));
+    EXPECT_FALSE(p.start(1, 1, 16));
+    EXPECT_TRUE(p.start(1, 1));
+    EXPECT_FALSE(p.start(1, 1));
+    p.stop();
+    EXPECT_FALSE(p.isRunning());
+}
+
+// Interleaved frames from several senders, with replays and stale frames,
+// are handled exactly once each and in counter order per sender,
+// as when decoding them one at a time.
+TEST(SecureOFrameRXPipeline, AntiReplayAndPerSenderOrder)
+{
+    SFRXP::Setup setup;
+    SFRXP::pipeline_t p;
+    ASSERT_TRUE(p.start(4));
+
+    constexpr uint8_t framesPerNode = 20;
+    uint32_t replays = 0;
+    const uint8_t nonSecure[] = { 5, 'O', 1, 2, 3, 4 };
+    for(uint8_t c = 1; c <= framesPerNode; ++c)
+    {
+        for(uint8_t n = 0; n < SFRXP::nodeCount; ++n)
+        {
+            const SFRXP::Frame f(n, c);
+            EXPECT_TRUE(p.submit(f.msg()));
+            // Exact repeat (eg heard via a second radio).
+            if(0 == (c % 3)) { EXPECT_TRUE(p.submit(f.msg())); ++replays; }
+            // Stale frame from earlier.
+            if((0 == (c % 5)) && (c > 2)) { EXPECT_TRUE(p.submit(SFRXP::Frame(n, c - 2).msg())); ++replays; }
+        }
+        if(0 == (c % 7)) { EXPECT_TRUE(p.submit(nonSecure + 1)); }
+    }
+    p.flush();
+    EXPECT_EQ(uint32_t(SFRXP::nodeCount * framesPerNode), p.getDecodedCount());
+    // Repeats are either dropped early as recent duplicates, or rejected.
+    EXPECT_EQ(replays, p.getRejectedCount() + p.getDuplicateCount());
+    EXPECT_EQ(2U, p.getOtherCount());
+    EXPECT_EQ(2, SFRXP::otherCount);
+    EXPECT_EQ(0U, p.getDroppedCount());
+    p.stop();
+
+    // Each sender's frames were handled once each, in order.
+    ASSERT_EQ(size_t(SFRXP::nodeCount * framesPerNode), SFRXP::handled.size());
+    uint8_t id[8];
+    for(uint8_t n = 0; n < SFRXP::nodeCount; ++n)
+    {
+        SFRXP::makeID(n, id);
+        uint8_t expected = 1;
+        for(const auto &h : SFRXP::handled) { if(h.first == id[0]) { EXPECT_EQ(expected++, h.second); } }
+        EXPECT_EQ(framesPerNode + 1, expected);
+        // Counters have been persisted.
+        uint8_t ctr[6];
+        EXPECT_TRUE(SFRXP::sfrx_t::getInstance().getLastRXMsgCtr(id, ctr));
+        EXPECT_EQ(framesPerNode, ctr[5]);
+    }
+}
+
+// Frames can be moved straight in from an RX queue,
+// and stop() finishes handling everything submitted.
+TEST(SecureOFrameRXPipeline, SubmitAllFromQueue)
+{
+    SFRXP::Setup setup;
+    SFRXP::pipeline_t p;
+    ASSERT_TRUE(p.start(2));
+    OTRadioLink::ISRRXQueueVarLenMsg<64, 3> q;
+    for(uint8_t c = 1; c <= 3; ++c)
+    {
+        const SFRXP::Frame f(1, c);
+        volatile uint8_t *const b = q._getRXBufForInbound();
+        ASSERT_NE((volatile uint8_t *)NULL, b);
+        for(uint8_t j = 0; j < f.buf[0]; ++j) { b[j] = f.buf[j + 1]; }
+        q._loadedBuf(f.buf[0]);
+    }
+    EXPECT_EQ(3, p.submitAll(q));
+    EXPECT_TRUE(q.isEmpty());
+    p.stop();
+    EXPECT_EQ(3U, p.getDecodedCount());
+    ASSERT_EQ(3U, SFRXP::handled.size());
+    EXPECT_EQ(3, SFRXP::handled[2].second);
+}
+
+// Frames from unassociated nodes are filtered out before any key fetch,
+// and the filter follows changes to the associations.
+TEST(SecureOFrameRXPipeline, FiltersForeignNodes)
+{
+    SFRXP::Setup setup;
+    SFRXP::pipeline_t p;
+    ASSERT_TRUE(p.start(2));
+    // Node nodeCount is not associated, so its frames are filtered.
+    EXPECT_TRUE(p.submit(SFRXP::Frame(SFRXP::nodeCount, 1).msg()));
+    EXPECT_TRUE(p.submit(SFRXP::Frame(0, 1).msg()));
+    p.flush();
+    EXPECT_EQ(1U, p.getFilteredCount());
+    EXPECT_EQ(1U, p.getDecodedCount());
+    EXPECT_EQ(0U, p.getRejectedCount());
+    // Replacing node 0's association filters it too.
+    uint8_t id[8];
+    SFRXP::makeID(SFRXP::nodeCount, id);
+    ASSERT_TRUE(SFRXP::nodes.set(0, id));
+    EXPECT_TRUE(p.submit(SFRXP::Frame(0, 2).msg()));
+    EXPECT_TRUE(p.submit(SFRXP::Frame(SFRXP::nodeCount, 2).msg()));
+    p.flush();
+    EXPECT_EQ(2U, p.getFilteredCount());
+    EXPECT_EQ(2U, p.getDecodedCount());
+    p.stop();
+}
+
+// Exact repeats of frames already handled are dropped before authentication.
+TEST(SecureOFrameRXPipeline, DropsRecentDuplicates)
+{
+    SFRXP::Setup setup;
+    SFRXP::pipeline_t p;
+    ASSERT_TRUE(p.start(2));
+    const SFRXP::Frame f(1, 1);
+    EXPECT_TRUE(p.submit(f.msg()));
+    p.flush();
+    SFRXP::sfrx_t::getInstance().resetRecentFrameCounts();
+    // Heard again via two more radios.
+    EXPECT_TRUE(p.submit(f.msg()));
+    EXPECT_TRUE(p.submit(f.msg()));
+    p.flush();
+    EXPECT_EQ(1U, p.getDecodedCount());
+    EXPECT_EQ(2U, p.getDuplicateCount());
+    EXPECT_EQ(0U, p.getRejectedCount());
+    EXPECT_EQ(2U, SFRXP::sfrx_t::getInstance().getRecentFrameCache().getHitCount());
+    EXPECT_EQ(0U, SFRXP::sfrx_t::getInstance().getRecentFrameCache().getMissCount());
+    // A new frame from the same sender is not a duplicate.
+    EXPECT_TRUE(p.submit(SFRXP::Frame(1, 2).msg()));
+    p.flush();
+    EXPECT_EQ(2U, p.getDecodedCount());
+    EXPECT_EQ(1U, SFRXP::sfrx_t::getInstance().getRecentFrameCache().getMissCount());
+    p.stop();
+}
+
+namespace SFRXP
+{
+    std::atomic<int> getKeyCalls;
+    bool countingGetKey(uint8_t *const key) { ++getKeyCalls; return(getKey(key)); }
+    // Decrypt that waits for the gate to open, to hold a worker in stage 2.
+    std::atomic<bool> gateOpen;
+    bool gatedDecrypt(uint8_t *workspace, size_t workspaceSize,
+                      const uint8_t *key, const uint8_t *iv,
+                      const uint8_t *authtext, uint8_t authtextSize,
+                      const uint8_t *ciphertext, const uint8_t *tag,
+                      uint8_t *plaintextOut)
+    {
+        while(!gateOpen) { std::this_thread::yield(); }
+        return(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE(workspace, workspaceSize,
+            key, iv, authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+    typedef OTRadioLink::SecureOFrameRXPipeline<sfrx_t,
+        gatedDecrypt, countingGetKey, recordFrameOperation> gatedPipeline_t;
+}
+
+// The key is fetched once for a batch of frames queued together,
+// and again for the first frame after the pipeline has caught up.
+TEST(SecureOFrameRXPipeline, KeyFetchedOncePerBatch)
+{
+    SFRXP::Setup setup;
+    SFRXP::gatedPipeline_t p;
+    SFRXP::getKeyCalls = 0;
+    SFRXP::gateOpen = false;
+    ASSERT_TRUE(p.start(1));
+    // The one worker takes the first frame and waits in stage 2
+    // while the rest queue up behind it.
+    EXPECT_TRUE(p.submit(SFRXP::Frame(0, 1).msg()));
+    while(1 != SFRXP::getKeyCalls) { std::this_thread::yield(); }
+    for(uint8_t c = 1; c <= 10; ++c) { EXPECT_TRUE(p.submit(SFRXP::Frame(c % SFRXP::nodeCount, uint8_t(c + 1)).msg())); }
+    SFRXP::gateOpen = true;
+    p.flush();
+    EXPECT_EQ(11U, p.getDecodedCount());
+    EXPECT_EQ(1, SFRXP::getKeyCalls);
+    // Idle, so the next frame fetches the key again.
+    EXPECT_TRUE(p.submit(SFRXP::Frame(0, 20).msg()));
+    p.flush();
+    EXPECT_EQ(12U, p.getDecodedCount());
+    EXPECT_EQ(2, SFRXP::getKeyCalls);
+    p.stop();
+}
+
+// The cache only matches the same ID prefix and message counter,
+// and does not remember frames until they are added.
+TEST(RecentSecureFrameCache, ExactRepeatsOnly)
+{
+    OTRadioLink::RecentSecureFrameCache<4> c;
+    uint8_t body[OTRadioLink::OTDecodeData_T::ptextLenMax];
+    const SFRXP::Frame f1(0, 1), f2(0, 2), g1(1, 1);
+    OTRadioLink::OTDecodeData_T d1(f1.buf, body), d2(f2.buf, body), e1(g1.buf, body);
+    ASSERT_NE(0, d1.sfh.decodeHeader(f1.buf, sizeof(f1.buf)));
+    ASSERT_NE(0, d2.sfh.decodeHeader(f2.buf, sizeof(f2.buf)));
+    ASSERT_NE(0, e1.sfh.decodeHeader(g1.buf, sizeof(g1.buf)));
+    EXPECT_FALSE(c.isDuplicate(d1));
+    c.add(d1);
+    EXPECT_TRUE(c.isDuplicate(d1));
+    EXPECT_FALSE(c.isDuplicate(d2));
+    EXPECT_FALSE(c.isDuplicate(e1));
+    EXPECT_EQ(1U, c.getHitCount());
+    EXPECT_EQ(3U, c.getMissCount());
+    // Header not decoded: never cached.
+    OTRadioLink::OTDecodeData_T bad(f1.buf, body);
+    c.add(bad);
+    EXPECT_FALSE(c.isDuplicate(bad));
+    c.clear();
+    EXPECT_FALSE(c.isDuplicate(d1));
+    c.resetCounts();
+    EXPECT_EQ(0U, c.getHitCount());
+    EXPECT_EQ(0U, c.getMissCount());
+}
+
+#endif // defined(EXT_AVAILABLE_ARDUINO_LIB_OTAESGCM)
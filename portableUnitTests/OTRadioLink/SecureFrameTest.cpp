@@ -28,6 +28,7 @@ Author(s) / Copyright (s): Damon Hart-Davis 2016
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
 
 #include <OTAESGCM.h>
 #include <OTRadioLink.h>
@@ -553,6 +554,64 @@ TEST(OTAESGCMSecureFrame, CryptoAccess)
     // AES-GCM 128-bit key enc/dec.
     runSimpleEncDec(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE,
                   OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE);
+    // AES-NI where available, else portable, AES-GCM 128-bit key enc/dec.
+    runSimpleEncDec(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE>,
+                  OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE>);
+}
+
+// Counts calls to the NULL keyed decrypt context setup.
+static int keyCacheSetupCount;
+static bool countingKeySetup(uint8_t *ctx, size_t ctxSize, const uint8_t *key)
+{
+    ++keyCacheSetupCount;
+    return(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_NULL_IMPL(ctx, ctxSize, key));
+}
+
+// Check that the key context cache only redoes key setup when the key changes
+// or after invalidation, and otherwise behaves as the stateless decrypt.
+TEST(OTAESGCMSecureFrame, DecKeyCache)
+{
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL_ctxSize,
+        countingKeySetup,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_NULL_IMPL> kc_t;
+    // Usable wherever the stateless decrypt is.
+    OTRadioLink::SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d = kc_t::decrypt;
+    kc_t::getInstance().invalidate();
+    keyCacheSetupCount = 0;
+    EXPECT_FALSE(kc_t::getInstance().isValid());
+    // Bad args fail.
+    EXPECT_FALSE(d(NULL, 0, NULL, NULL, NULL, 0, NULL, NULL, NULL));
+    static const uint8_t plaintext1[32] = { 'a', 'b', 'c', 'd', 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+    static const uint8_t nonce1[12] = { 'q', 'u', 'i', 'c', 'k', ' ', 6, 5, 4, 3, 2, 1 };
+    static const uint8_t authtext1[2] = { 'H', 'i' };
+    static const uint8_t key2[16] = { 1 };
+    uint8_t workspace[1];
+    uint8_t co1[32], to1[16];
+    EXPECT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_NULL_IMPL(workspace, sizeof(workspace), zeroBlock, nonce1, authtext1, sizeof(authtext1), plaintext1, co1, to1));
+    keyCacheSetupCount = 0;
+    // Repeated decrypts with the same key do the setup once.
+    for(int i = 0; i < 4; ++i) {
+        uint8_t plaintext1Decoded[32] = { };
+        EXPECT_TRUE(d(workspace, sizeof(workspace), zeroBlock, nonce1, authtext1, sizeof(authtext1), co1, to1, plaintext1Decoded));
+        EXPECT_EQ(0, memcmp(plaintext1, plaintext1Decoded, 32));
+    }
+    EXPECT_EQ(1, keyCacheSetupCount);
+    EXPECT_TRUE(kc_t::getInstance().isValid());
+    // A key change (eg via the CLI) forces a new setup.
+    uint8_t plaintext1Decoded[32];
+    EXPECT_TRUE(d(workspace, sizeof(workspace), key2, nonce1, authtext1, sizeof(authtext1), co1, to1, plaintext1Decoded));
+    EXPECT_TRUE(d(workspace, sizeof(workspace), key2, nonce1, authtext1, sizeof(authtext1), co1, to1, plaintext1Decoded));
+    EXPECT_EQ(2, keyCacheSetupCount);
+    // As does explicit invalidation.
+    kc_t::getInstance().invalidate();
+    EXPECT_FALSE(kc_t::getInstance().isValid());
+    EXPECT_TRUE(d(workspace, sizeof(workspace), key2, nonce1, authtext1, sizeof(authtext1), co1, to1, plaintext1Decoded));
+    EXPECT_EQ(3, keyCacheSetupCount);
+    // A bad tag still fails with a valid cached context.
+    to1[15] = 1;
+    EXPECT_FALSE(d(workspace, sizeof(workspace), key2, nonce1, authtext1, sizeof(authtext1), co1, to1, plaintext1Decoded));
+    EXPECT_EQ(3, keyCacheSetupCount);
 }
 
 // Check WITH_WORKSPACE methods using NIST GCMVS test vector.
@@ -691,6 +750,204 @@ TEST(Main,GCMVS1ViaFixed32BTextSizeWITHWORKSPACE)
             inputDecoded));
 }
 
+// Check the AES-NI enc/dec (with portable fallback) using the same NIST GCMVS test vector.
+TEST(OTAESGCMSecureFrame, GCMVS1ViaAESNI)
+{
+    static const uint8_t input[32] = { 0xcc, 0x38, 0xbc, 0xcd, 0x6b, 0xc5, 0x36, 0xad, 0x91, 0x9b, 0x13, 0x95, 0xf5, 0xd6, 0x38, 0x01, 0xf9, 0x9f, 0x80, 0x68, 0xd6, 0x5c, 0xa5, 0xac, 0x63, 0x87, 0x2d, 0xaf, 0x16, 0xb9, 0x39, 0x01 };
+    static const uint8_t key[AES_KEY_SIZE/8] = { 0x29, 0x8e, 0xfa, 0x1c, 0xcf, 0x29, 0xcf, 0x62, 0xae, 0x68, 0x24, 0xbf, 0xc1, 0x95, 0x57, 0xfc };
+    static const uint8_t nonce[GCM_NONCE_LENGTH] = { 0x6f, 0x58, 0xa9, 0x3f, 0xe1, 0xd2, 0x07, 0xfa, 0xe4, 0xed, 0x2f, 0x6d };
+    static const uint8_t aad[16] = { 0x02, 0x1f, 0xaf, 0xd2, 0x38, 0x46, 0x39, 0x73, 0xff, 0xe8, 0x02, 0x56, 0xe5, 0xb1, 0xc6, 0xb1 };
+    static const uint8_t expectedCT[32] = { 0xdf, 0xce, 0x4e, 0x9c, 0xd2, 0x91, 0x10, 0x3d, 0x7f, 0xe4, 0xe6, 0x33, 0x51, 0xd9, 0xe7, 0x9d, 0x3d, 0xfd, 0x39, 0x1e, 0x32, 0x67, 0x10, 0x46, 0x58, 0x21, 0x2d, 0xa9, 0x65, 0x21, 0xb7, 0xdb };
+    static const uint8_t expectedTag[GCM_TAG_LENGTH] = { 0x54, 0x24, 0x65, 0xef, 0x59, 0x93, 0x16, 0xf7, 0x3a, 0x7a, 0x56, 0x05, 0x09, 0xa2, 0xd9, 0xf2 };
+    OTRadioLink::SimpleSecureFrame32or0BodyTXBase::fixed32BTextSize12BNonce16BTagSimpleEnc_fn_t &e =
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE>;
+    OTRadioLink::SimpleSecureFrame32or0BodyRXBase::fixed32BTextSize12BNonce16BTagSimpleDec_fn_t &d =
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE>;
+    // Sized for the portable fallback.
+    constexpr size_t workspaceRequired = OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec;
+    static_assert(OTRadioLink::workspaceRequired_GCM32B16B_AESNI <= workspaceRequired, "fallback workspace must suffice");
+    uint8_t workspace[workspaceRequired] = { };
+    uint8_t tag[GCM_TAG_LENGTH];
+    uint8_t cipherText[32];
+    ASSERT_TRUE(e(workspace, sizeof(workspace), key, nonce, aad, sizeof(aad), input, cipherText, tag));
+    for(int i = workspaceRequired; --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    EXPECT_EQ(0, memcmp(expectedCT, cipherText, sizeof(expectedCT)));
+    EXPECT_EQ(0, memcmp(expectedTag, tag, sizeof(expectedTag)));
+    uint8_t inputDecoded[32];
+    EXPECT_TRUE(d(workspace, sizeof(workspace), key, nonce, aad, sizeof(aad), cipherText, tag, inputDecoded));
+    for(int i = workspaceRequired; --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    EXPECT_EQ(0, memcmp(input, inputDecoded, 32));
+    // A damaged tag fails.
+    tag[7] ^= 0x10;
+    EXPECT_FALSE(d(workspace, sizeof(workspace), key, nonce, aad, sizeof(aad), cipherText, tag, inputDecoded));
+    // Enc/auth with no (ie zero-length) plaintext, as for the portable implementation.
+    EXPECT_TRUE(e(workspace, sizeof(workspace), key, nonce, aad, sizeof(aad), NULL, cipherText, tag));
+    EXPECT_EQ(0x57, tag[1]);
+    EXPECT_EQ(0x25, tag[14]);
+    EXPECT_TRUE(d(workspace, sizeof(workspace), key, nonce, aad, sizeof(aad), NULL, tag, inputDecoded));
+    // The AES-NI functions directly, only usable where the CPU supports them.
+    uint8_t awsp[OTRadioLink::workspaceRequired_GCM32B16B_AESNI];
+    const bool aesni = OTRadioLink::isAvailableAESNI();
+    EXPECT_EQ(aesni, OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(awsp, sizeof(awsp), key, nonce, aad, sizeof(aad), input, cipherText, tag));
+    EXPECT_EQ(aesni, OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(awsp, sizeof(awsp), key, nonce, aad, sizeof(aad), cipherText, tag, inputDecoded));
+    if(aesni) { EXPECT_EQ(0, memcmp(expectedTag, tag, sizeof(expectedTag))); }
+    // Bad workspace is rejected.
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(NULL, sizeof(awsp), key, nonce, aad, sizeof(aad), input, cipherText, tag));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(awsp, sizeof(awsp)-1, key, nonce, aad, sizeof(aad), input, cipherText, tag));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(awsp, sizeof(awsp)-1, key, nonce, aad, sizeof(aad), cipherText, tag, inputDecoded));
+}
+
+// Check that the AES-NI enc/dec is interchangeable with the portable one
+// for all authtext lengths, with and without text.
+TEST(OTAESGCMSecureFrame, AESNIMatchesPortable)
+{
+    if(!OTRadioLink::isAvailableAESNI()) { return; } // Nothing to compare.
+    uint8_t workspace[OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec];
+    uint8_t key[16], iv[12], authtext[255], plaintext[32];
+    for(int authtextSize = 0; authtextSize <= 255; ++authtextSize)
+    {
+        for(uint8_t &b : key) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : iv) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : authtext) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : plaintext) { b = OTV0P2BASE::randRNG8(); }
+        const uint8_t as = uint8_t(authtextSize);
+        const bool withText = (0 != (authtextSize & 1));
+        const uint8_t *const pt = withText ? plaintext : NULL;
+        uint8_t ct1[32], tag1[16], ct2[32], tag2[16], out[32];
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI(workspace, sizeof(workspace), key, iv, authtext, as, pt, ct1, tag1));
+        ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE(workspace, sizeof(workspace), key, iv, authtext, as, pt, ct2, tag2));
+        ASSERT_EQ(0, memcmp(tag1, tag2, 16)) << authtextSize;
+        if(withText) { ASSERT_EQ(0, memcmp(ct1, ct2, 32)) << authtextSize; }
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(workspace, sizeof(workspace), key, iv, authtext, as, withText ? ct2 : NULL, tag2, out));
+        if(withText) { ASSERT_EQ(0, memcmp(plaintext, out, 32)) << authtextSize; }
+        // Any change to the authtext fails authentication.
+        if(0 != as)
+        {
+            authtext[as - 1] ^= 1;
+            ASSERT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(workspace, sizeof(workspace), key, iv, authtext, as, withText ? ct2 : NULL, tag2, out));
+        }
+    }
+}
+
+
+// Check that the keyed AES-NI decrypt, with its cached round keys and powers of H,
+// gives the same results as the stateless AES-NI and portable decrypts.
+TEST(OTAESGCMSecureFrame, AESNIKeyedMatchesStateless)
+{
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI> kc_t;
+    uint8_t ctx[OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize];
+    uint8_t workspace[OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec];
+    uint8_t key[16] = { }, iv[12] = { }, authtext[255], plaintext[32], ct[32], tag[16], out[32];
+    if(!OTRadioLink::isAvailableAESNI())
+    {
+        EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(ctx, sizeof(ctx), key));
+        return;
+    }
+    // Bad args fail.
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(NULL, sizeof(ctx), key));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(ctx, sizeof(ctx) - 1, key));
+    ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(ctx, sizeof(ctx), key));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(ctx, sizeof(ctx) - 1, workspace, sizeof(workspace), iv, NULL, 0, NULL, tag, NULL));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(ctx, sizeof(ctx), workspace, OTRadioLink::workspaceRequired_GCM32B16B_AESNI - 1, iv, NULL, 0, NULL, tag, NULL));
+    for(int authtextSize = 0; authtextSize <= 255; ++authtextSize)
+    {
+        // Change key every few rounds.
+        if(0 == (authtextSize & 3))
+        {
+            for(uint8_t &b : key) { b = OTV0P2BASE::randRNG8(); }
+            ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI(ctx, sizeof(ctx), key));
+        }
+        for(uint8_t &b : iv) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : authtext) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : plaintext) { b = OTV0P2BASE::randRNG8(); }
+        const uint8_t as = uint8_t(authtextSize);
+        const bool withText = (0 != (authtextSize & 1));
+        ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE(workspace, sizeof(workspace), key, iv, authtext, as, withText ? plaintext : NULL, ct, tag));
+        const uint8_t *const c = withText ? ct : NULL;
+        uint8_t outStateless[32];
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, outStateless));
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(ctx, sizeof(ctx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        ASSERT_TRUE(kc_t::decrypt(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out)) << authtextSize;
+        if(withText)
+        {
+            ASSERT_EQ(0, memcmp(plaintext, out, 32)) << authtextSize;
+            ASSERT_EQ(0, memcmp(outStateless, out, 32)) << authtextSize;
+        }
+        // Any change to the authtext, text or tag fails authentication, as for the stateless form.
+        const uint8_t i = OTV0P2BASE::randRNG8();
+        if(0 != as) { authtext[i % as] ^= 1; }
+        else if(withText) { ct[i & 31] ^= 1; }
+        else { tag[i & 15] ^= 1; }
+        ASSERT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out));
+        ASSERT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI(ctx, sizeof(ctx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        ASSERT_FALSE(kc_t::decrypt(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out)) << authtextSize;
+    }
+    // The key-changed callback wipes the cached context.
+    EXPECT_TRUE(kc_t::getInstance().isValid());
+    kc_t::keyChanged();
+    EXPECT_FALSE(kc_t::getInstance().isValid());
+}
+
+// The keyed fallback (raw key in the context, portable stateless decrypt)
+// behaves as the portable decrypt, and so does the keyed AES-NI-or-fallback form
+// whichever the CPU gets; the key cache works over either,
+// and is invalidated in this thread by keyChanged() from another.
+TEST(OTAESGCMSecureFrame, KeyedFallbackMatchesStateless)
+{
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE> > kcf_t;
+    typedef OTRadioLink::SimpleSecureFrame32or0BodyRXKeyCache<
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE> > kco_t;
+    auto &rawDec = OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE>;
+    auto &orDec = OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE>;
+    uint8_t rawCtx[OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_RAWKEY_ctxSize];
+    uint8_t orCtx[OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeyed_AESNI_ctxSize];
+    uint8_t workspace[OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequiredDec];
+    uint8_t key[16] = { }, iv[12] = { }, authtext[255], plaintext[32], ct[32], tag[16], out[32];
+    // Bad args fail.
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(NULL, sizeof(rawCtx), key));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(rawCtx, sizeof(rawCtx) - 1, key));
+    EXPECT_FALSE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR(orCtx, sizeof(orCtx) - 1, key));
+    EXPECT_FALSE(rawDec(rawCtx, sizeof(rawCtx) - 1, workspace, sizeof(workspace), iv, NULL, 0, NULL, tag, NULL));
+    EXPECT_FALSE(orDec(orCtx, sizeof(orCtx) - 1, workspace, sizeof(workspace), iv, NULL, 0, NULL, tag, NULL));
+    for(int authtextSize = 0; authtextSize <= 255; authtextSize += 5)
+    {
+        for(uint8_t &b : key) { b = OTV0P2BASE::randRNG8(); }
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_RAWKEY(rawCtx, sizeof(rawCtx), key));
+        ASSERT_TRUE(OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDecKeySetup_AESNI_OR(orCtx, sizeof(orCtx), key));
+        for(uint8_t &b : iv) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : authtext) { b = OTV0P2BASE::randRNG8(); }
+        for(uint8_t &b : plaintext) { b = OTV0P2BASE::randRNG8(); }
+        const uint8_t as = uint8_t(authtextSize);
+        const bool withText = (0 != (authtextSize & 1));
+        ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE(workspace, sizeof(workspace), key, iv, authtext, as, withText ? plaintext : NULL, ct, tag));
+        const uint8_t *const c = withText ? ct : NULL;
+        ASSERT_TRUE(rawDec(rawCtx, sizeof(rawCtx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        if(withText) { ASSERT_EQ(0, memcmp(plaintext, out, 32)) << authtextSize; }
+        ASSERT_TRUE(orDec(orCtx, sizeof(orCtx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        if(withText) { ASSERT_EQ(0, memcmp(plaintext, out, 32)) << authtextSize; }
+        ASSERT_TRUE(kcf_t::decrypt(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out)) << authtextSize;
+        ASSERT_TRUE(kco_t::decrypt(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out)) << authtextSize;
+        // Tampering is detected.
+        tag[OTV0P2BASE::randRNG8() & 15] ^= 1;
+        ASSERT_FALSE(rawDec(rawCtx, sizeof(rawCtx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        ASSERT_FALSE(orDec(orCtx, sizeof(orCtx), workspace, sizeof(workspace), iv, authtext, as, c, tag, out)) << authtextSize;
+        ASSERT_FALSE(kcf_t::decrypt(workspace, sizeof(workspace), key, iv, authtext, as, c, tag, out)) << authtextSize;
+    }
+    // A key change signalled from another thread invalidates this thread's cache.
+    EXPECT_TRUE(kcf_t::getInstance().isValid());
+    std::thread t(kcf_t::keyChanged);
+    t.join();
+    EXPECT_FALSE(kcf_t::getInstance().isValid());
+}
+
 
 // Test encoding/encryption then decoding/decryption of entire secure frame.
 //
@@ -795,6 +1052,25 @@ TEST(OTAESGCMSecureFrame, SecureSmallFrameEncoding)
     // Body content should be correctly decrypted and extracted.
     EXPECT_EQ(sizeof(body), fdRX.ptextLen);
     EXPECT_EQ(0, memcmp(body, decryptedBodyOut, sizeof(body)));
+    // The AES-NI (or fallback) enc/dec produce and accept exactly the same frame.
+    {
+    uint8_t _buf2[sizeof(_buf)];
+    OTRadioLink::OTEncodeData_T fdTX2(_bodyBuf, sizeof(_bodyBuf), _buf2, sizeof(_buf2));
+    fdTX2.ptextLen = sizeof(body);
+    fdTX2.fType = OTRadioLink::FTS_BasicSensorOrValve;
+    EXPECT_EQ(encodedLength, OTRadioLink::SimpleSecureFrame32or0BodyTXBase::encodeRaw(fdTX2, id4bytes.buf, id4bytes.bufsize, iv,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleEnc_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_LWORKSPACE>,
+        sWEnc, zeroBlock));
+    EXPECT_EQ(0, memcmp(buf.buf, _buf2, encodedLength));
+    uint8_t decryptedBodyOut2[OTRadioLink::ENC_BODY_SMALL_FIXED_PTEXT_MAX_SIZE];
+    OTRadioLink::OTDecodeData_T fdRX2(_buf2, decryptedBodyOut2);
+    EXPECT_TRUE(0 != fdRX2.sfh.decodeHeader(_buf2, encodedLength));
+    EXPECT_TRUE(0 != OTRadioLink::SimpleSecureFrame32or0BodyRXBase::decodeRaw(fdRX2,
+        OTRadioLink::fixed32BTextSize12BNonce16BTagSimpleDec_AESNI_OR<OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_LWORKSPACE>,
+        sWDec, zeroBlock, iv));
+    EXPECT_EQ(sizeof(body), fdRX2.ptextLen);
+    EXPECT_EQ(0, memcmp(body, decryptedBodyOut2, sizeof(body)));
+    }
 
     // Using ASSERT to avoid cryptic crash message (Floating point exception (core dumped)) when encodedLength is 0.
     ASSERT_NE(0, encodedLength);
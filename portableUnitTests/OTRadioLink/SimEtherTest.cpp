@@ -0,0 +1,172 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the simulated radio medium.
+ */
+
+#include <stdint.h>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace SimEtherTest
+{
+    // Two channels, contents ignored by the simulation.
+    const OTRadioLink::OTRadioChannelConfig configs[2] = { { NULL, true }, { NULL, true } };
+
+    typedef OTRadioLink::OTSimRadioLink<> radio_t;
+
+    // Configure r and start it listening on channel.
+    void up(radio_t &r, const int8_t channel = 0)
+    {
+        r.configure(2, configs);
+        r.begin();
+        r.listen(true, channel);
+    }
+
+    const uint8_t frame[] = { 'O', 1, 2, 3, 4, 5 };
+}
+
+// Frames reach all other listeners on the channel at the end of their airtime.
+TEST(SimEther, Delivery)
+{
+    OTRadioLink::SimEther ether;
+    SimEtherTest::radio_t a(ether), b(ether), c(ether), d(ether);
+    SimEtherTest::up(a);
+    SimEtherTest::up(b);
+    SimEtherTest::up(c, 1); // Other channel.
+    d.configure(2, SimEtherTest::configs); // Not listening.
+    EXPECT_EQ(4, ether.getNodeCount());
+    EXPECT_EQ(1, b.getNodeID());
+    // 16 bytes at 49260 bps is 2599us (rounded up).
+    EXPECT_EQ(2599U, ether.airtimeUs(6));
+    ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    // Can't send again until done.
+    EXPECT_FALSE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    ether.advance(2598);
+    EXPECT_EQ(0, b.getRXMsgsQueued());
+    EXPECT_TRUE(ether.isBusy());
+    ether.advance(1);
+    EXPECT_FALSE(ether.isBusy());
+    EXPECT_EQ(2599U, ether.getTime());
+    ASSERT_EQ(1, b.getRXMsgsQueued());
+    EXPECT_EQ(0, a.getRXMsgsQueued());
+    EXPECT_EQ(0, c.getRXMsgsQueued());
+    EXPECT_EQ(0, d.getRXMsgsQueued());
+    const volatile uint8_t *const m = b.peekRXMsg();
+    ASSERT_EQ(sizeof(SimEtherTest::frame), m[-1]);
+    for(uint8_t i = 0; i < sizeof(SimEtherTest::frame); ++i) { EXPECT_EQ(SimEtherTest::frame[i], m[i]); }
+    b.removeRXMsg();
+    EXPECT_EQ(1U, ether.getTXCount());
+    EXPECT_EQ(1U, ether.getDeliveredCount());
+    // Bad channel or empty frame.
+    EXPECT_FALSE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame), 2));
+    EXPECT_FALSE(a.sendRaw(SimEtherTest::frame, 0));
+}
+
+// Overlapping frames on the same channel are lost; on different channels they are not.
+TEST(SimEther, Collision)
+{
+    OTRadioLink::SimEther ether;
+    SimEtherTest::radio_t a(ether), b(ether), hub(ether);
+    SimEtherTest::up(a);
+    SimEtherTest::up(b);
+    SimEtherTest::up(hub);
+    ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    ether.advance(2598);
+    ASSERT_TRUE(b.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    ether.advance(10000);
+    EXPECT_EQ(0, hub.getRXMsgsQueued());
+    EXPECT_EQ(2U, ether.getCollidedCount());
+    // Back to back is fine.
+    ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    ether.advance(2599);
+    ASSERT_TRUE(b.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+    ether.advance(2599);
+    EXPECT_EQ(2, hub.getRXMsgsQueued());
+    // Simultaneous on different channels.
+    SimEtherTest::up(b, 1);
+    ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame), 0));
+    ASSERT_TRUE(b.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame), 1));
+    ether.advance(10000);
+    EXPECT_EQ(3, hub.getRXMsgsQueued());
+    EXPECT_EQ(2U, ether.getCollidedCount());
+}
+
+// A node does not hear frames that end while it is sending.
+TEST(SimEther, HalfDuplex)
+{
+    OTRadioLink::SimEther ether;
+    SimEtherTest::radio_t a(ether), b(ether);
+    SimEtherTest::up(a);
+    SimEtherTest::up(b);
+    ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame), 0));
+    ASSERT_TRUE(b.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame), 1));
+    ether.advance(10000);
+    EXPECT_EQ(0, a.getRXMsgsQueued());
+    EXPECT_EQ(0, b.getRXMsgsQueued());
+}
+
+// Link loss is per link, repeatable for a given seed, and roughly as configured.
+TEST(SimEther, Loss)
+{
+    OTRadioLink::SimEther ether(OTRadioLink::SimEther::DefaultBitRate, OTRadioLink::SimEther::DefaultOverheadBytes, 42);
+    SimEtherTest::radio_t a(ether), near(ether), far(ether);
+    SimEtherTest::up(a);
+    SimEtherTest::up(near);
+    SimEtherTest::up(far);
+    ether.setDefaultLoss(0.5);
+    ether.setLinkLoss(0, 1, 0);
+    EXPECT_EQ(0, ether.getLinkLoss(0, 1));
+    EXPECT_EQ(0.5, ether.getLinkLoss(0, 2));
+    int heard = 0;
+    for(int i = 0; i < 1000; ++i)
+        {
+        ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+        ether.advance(10000);
+        EXPECT_EQ(1, near.getRXMsgsQueued());
+        near.removeRXMsg();
+        heard += far.getRXMsgsQueued();
+        while(0 != far.getRXMsgsQueued()) { far.removeRXMsg(); }
+        }
+    EXPECT_NEAR(500, heard, 60);
+    EXPECT_EQ(1000U + heard, ether.getDeliveredCount());
+    EXPECT_EQ(1000U - heard, ether.getLostCount());
+}
+
+// Frames that do not fit the receiver's queue are dropped and counted there.
+TEST(SimEther, QueueFull)
+{
+    OTRadioLink::SimEther ether;
+    SimEtherTest::radio_t a(ether);
+    OTRadioLink::OTSimRadioLink<OTRadioLink::ISRRXQueue1Deep<8>> hub(ether);
+    SimEtherTest::up(a);
+    hub.configure(2, SimEtherTest::configs);
+    hub.listen(true);
+    for(int i = 0; i < 3; ++i)
+        {
+        ASSERT_TRUE(a.sendRaw(SimEtherTest::frame, sizeof(SimEtherTest::frame)));
+        ether.advance(10000);
+        }
+    const uint8_t big[9] = { };
+    ASSERT_TRUE(a.sendRaw(big, sizeof(big)));
+    ether.advance(10000);
+    EXPECT_EQ(1, hub.getRXMsgsQueued());
+    EXPECT_EQ(3, hub.getRXMsgsDroppedRecent());
+}
@@ -0,0 +1,220 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the hub-side stats ingest.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace SIT
+{
+    typedef OTRadioLink::StatsIngest si_t;
+
+    uint8_t ingestJSON(si_t &si, const uint32_t t, const char *const json)
+        { return(si.ingestJSON(t, json, strlen(json))); }
+}
+
+// JSON stats are kept per node and key, with the latest value to hand.
+TEST(StatsIngest, JSON)
+{
+    SIT::si_t si;
+    EXPECT_EQ(4, SIT::ingestJSON(si, 100, "{\"@\":\"cdfb\",\"T|C16\":299,\"H|%\":83,\"L\":255,\"B|cV\":256}"));
+    EXPECT_EQ(2, SIT::ingestJSON(si, 200, "{\"@\":\"cdfb\",\"+\":2,\"T|C16\":-12,\"v|%\":0}"));
+    EXPECT_EQ(1, SIT::ingestJSON(si, 200, "{\"@\":\"1234\",\"T|C16\":300}"));
+    EXPECT_EQ(2U, si.getNodeCount());
+    EXPECT_EQ(5U, si.getKeyCount());
+    EXPECT_EQ(7U, si.getSampleCount());
+    SIT::si_t::Sample s;
+    ASSERT_TRUE(si.getLatest(0xcdfb, "T|C16", s));
+    EXPECT_EQ(200U, s.time);
+    EXPECT_EQ(-12, s.value);
+    ASSERT_TRUE(si.getLatest(0xcdfb, "L", s));
+    EXPECT_EQ(100U, s.time);
+    EXPECT_EQ(255, s.value);
+    ASSERT_TRUE(si.getLatest(0x1234, "T|C16", s));
+    EXPECT_EQ(300, s.value);
+    EXPECT_FALSE(si.getLatest(0x1234, "L", s));
+    EXPECT_FALSE(si.getLatest(0x9999, "L", s));
+    EXPECT_FALSE(si.getLatest(0xcdfb, "+", s));
+    EXPECT_FALSE(si.getLatest(0xcdfb, "nope", s));
+    // Raw RXed JSON frame terminator, and the node given directly.
+    const char raw[] = { '{', '"', 'L', '"', ':', '7', char('}' | 0x80), 0x55 };
+    EXPECT_EQ(1, si.ingestJSON(0x1234, 300, raw, sizeof(raw)));
+    ASSERT_TRUE(si.getLatest(0x1234, "L", s));
+    EXPECT_EQ(7, s.value);
+    // No node ID, or not JSON.
+    EXPECT_EQ(0, SIT::ingestJSON(si, 400, "{\"L\":1}"));
+    EXPECT_EQ(0, SIT::ingestJSON(si, 400, "L:1"));
+    // Parsing stops at a malformed field, keeping those before.
+    EXPECT_EQ(1, SIT::ingestJSON(si, 400, "{\"@\":\"1234\",\"L\":8,\"H|%\":x}"));
+    ASSERT_TRUE(si.getLatest(0x1234, "L", s));
+    EXPECT_EQ(8, s.value);
+}
+
+// Each key keeps only its most recent samples, queryable by time range.
+TEST(StatsIngest, RingAndRange)
+{
+    SIT::si_t si(4, 8);
+    for(uint32_t t = 1; t <= 20; ++t) { EXPECT_TRUE(si.add(1, "T|C16", t * 10, int32_t(t))); }
+    SIT::si_t::Sample out[16];
+    // Only the last 8 are left, oldest first.
+    ASSERT_EQ(8U, si.getRange(1, "T|C16", 0, 1000, out, 16));
+    for(int i = 0; i < 8; ++i) { EXPECT_EQ(uint32_t(130 + 10 * i), out[i].time); EXPECT_EQ(13 + i, out[i].value); }
+    ASSERT_EQ(3U, si.getRange(1, "T|C16", 145, 170, out, 16));
+    EXPECT_EQ(150U, out[0].time);
+    EXPECT_EQ(170U, out[2].time);
+    EXPECT_EQ(2U, si.getRange(1, "T|C16", 140, 200, out, 2));
+    EXPECT_EQ(140U, out[0].time);
+    EXPECT_EQ(0U, si.getRange(1, "T|C16", 201, 300, out, 16));
+    EXPECT_EQ(0U, si.getRange(1, "T|C16", 170, 140, out, 16));
+    EXPECT_EQ(0U, si.getRange(2, "T|C16", 0, 1000, out, 16));
+    // Repeated times are kept; earlier ones are dropped.
+    EXPECT_TRUE(si.add(1, "T|C16", 200, 99));
+    EXPECT_FALSE(si.add(1, "T|C16", 199, 98));
+    EXPECT_EQ(1U, si.getDroppedCount());
+    SIT::si_t::Sample s;
+    ASSERT_TRUE(si.getLatest(1, "T|C16", s));
+    EXPECT_EQ(99, s.value);
+}
+
+// Memory is bounded by keys per node, and optionally by node count.
+TEST(StatsIngest, Bounds)
+{
+    SIT::si_t si(2, 4, 2);
+    EXPECT_TRUE(si.add(1, "a", 0, 1));
+    EXPECT_TRUE(si.add(1, "b", 0, 1));
+    EXPECT_FALSE(si.add(1, "c", 0, 1));
+    EXPECT_TRUE(si.add(2, "c", 0, 1));
+    EXPECT_FALSE(si.add(3, "a", 0, 1));
+    EXPECT_EQ(2U, si.getNodeCount());
+    EXPECT_EQ(2U, si.getDroppedCount());
+    // Keys dropped for a full node are not kept.
+    EXPECT_EQ(3U, si.getKeyCount());
+}
+
+// By default the number of nodes is capped, and samples from further
+// nodes are counted as rejected.
+TEST(StatsIngest, DefaultNodeCap)
+{
+    SIT::si_t si(1, 1);
+    const uint32_t cap = SIT::si_t::DefaultMaxNodes;
+    for(uint32_t n = 0; n < cap; ++n) { EXPECT_TRUE(si.add(n, "L", 0, 1)); }
+    EXPECT_FALSE(si.add(cap, "L", 0, 1));
+    EXPECT_FALSE(si.add(cap + 1, "L", 0, 1));
+    EXPECT_FALSE(si.add(0, "H|%", 0, 1));
+    EXPECT_EQ(size_t(cap), si.getNodeCount());
+    EXPECT_EQ(2U, si.getNodeRejectedCount());
+    EXPECT_EQ(3U, si.getDroppedCount());
+    // Known nodes still take samples.
+    EXPECT_TRUE(si.add(0, "L", 1, 2));
+}
+
+// A flood of made-up keys and nodes does not grow memory without bound.
+TEST(StatsIngest, KeyFlood)
+{
+    SIT::si_t si(4, 4, 8, 20);
+    char json[64];
+    for(uint32_t i = 0; i < 100000; ++i)
+        {
+        snprintf(json, sizeof(json), "{\"@\":\"%x\",\"k%u\":1,\"j%u\":2}", unsigned(i % 16), unsigned(i), unsigned(i));
+        SIT::ingestJSON(si, i, json);
+        }
+    EXPECT_GE(20U, si.getKeyCount());
+    EXPECT_GE(8U, si.getNodeCount());
+    EXPECT_EQ(200000U, si.getSampleCount() + si.getDroppedCount());
+    // Keys already known still go in while there is room.
+    SIT::si_t si2(16, 4, 0, 3);
+    EXPECT_TRUE(si2.add(1, "a", 0, 1));
+    EXPECT_TRUE(si2.add(1, "b", 0, 1));
+    EXPECT_TRUE(si2.add(1, "c", 0, 1));
+    EXPECT_FALSE(si2.add(1, "d", 0, 1));
+    EXPECT_TRUE(si2.add(2, "a", 0, 2));
+    EXPECT_EQ(3U, si2.getKeyCount());
+    SIT::si_t::Sample s;
+    EXPECT_FALSE(si2.getLatest(1, "d", s));
+    ASSERT_TRUE(si2.getLatest(2, "a", s));
+    EXPECT_EQ(2, s.value);
+}
+
+namespace SIT
+{
+    si_t hubStats;
+    uint32_t now;
+    uint32_t getTime() { return(now); }
+}
+// Decoded secure 'O' frames go straight in, eg from the frame handler chain.
+TEST(StatsIngest, DecodedFrame)
+{
+    const uint8_t msgBuf[] = { 5, 0, 1, 2, 3, 4 };
+    const uint8_t nodeID[OTV0P2BASE::OpenTRV_Node_ID_Bytes] = { 0xaa, 0xaa, 0xaa, 0xaa, 0x55, 0x55, 0x55, 0x55 };
+    // Valve 42% open with {"b":1,"L":99 (the closing '}' is not sent).
+    const char json[] = "{\"b\":1,\"L\":99";
+    uint8_t ptext[OTRadioLink::OTDecodeData_T::ptextLenMax];
+    OTRadioLink::OTDecodeData_T fd(&msgBuf[1], ptext);
+    memcpy(fd.id, nodeID, sizeof(nodeID));
+    ptext[0] = 42;
+    ptext[1] = 0x10;
+    memcpy(ptext + 2, json, sizeof(json) - 1);
+    fd.ptextLen = uint8_t(2 + sizeof(json) - 1);
+    SIT::now = 1000;
+    EXPECT_TRUE((OTRadioLink::statsIngestFrameOperation<SIT::hubStats, SIT::getTime>(fd)));
+    const SIT::si_t::nodeID_t node = SIT::si_t::nodeIDFromBytes(nodeID, sizeof(nodeID));
+    EXPECT_EQ(0xaaaaaaaa55555555ULL, node);
+    SIT::si_t::Sample s;
+    ASSERT_TRUE(SIT::hubStats.getLatest(node, "v|%", s));
+    EXPECT_EQ(42, s.value);
+    EXPECT_EQ(1000U, s.time);
+    ASSERT_TRUE(SIT::hubStats.getLatest(node, "L", s));
+    EXPECT_EQ(99, s.value);
+    ASSERT_TRUE(SIT::hubStats.getLatest(node, "b", s));
+    EXPECT_EQ(1, s.value);
+    // No valve and no JSON.
+    ptext[0] = 0x7f;
+    ptext[1] = 0;
+    SIT::now = 1010;
+    EXPECT_FALSE((OTRadioLink::statsIngestFrameOperation<SIT::hubStats, SIT::getTime>(fd)));
+    EXPECT_EQ(3U, SIT::hubStats.getSampleCount());
+}
+
+// The latest of one key across many nodes.
+TEST(StatsIngest, ManyNodes)
+{
+    SIT::si_t si(4, 16);
+    constexpr uint32_t nodes = 5000;
+    for(uint32_t t = 0; t < 4; ++t)
+        {
+        for(uint32_t n = 0; n < nodes; ++n) { si.add(n, "T|C16", t, int32_t(n + t)); }
+        }
+    EXPECT_EQ(size_t(nodes), si.getNodeCount());
+    std::vector<std::pair<SIT::si_t::nodeID_t, SIT::si_t::Sample>> latest;
+    ASSERT_EQ(size_t(nodes), si.getLatestAll("T|C16", latest));
+    for(const auto &l : latest)
+        {
+        EXPECT_EQ(3U, l.second.time);
+        EXPECT_EQ(int32_t(l.first + 3), l.second.value);
+        }
+    EXPECT_EQ(0U, si.getLatestAll("L", latest));
+}
@@ -0,0 +1,208 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Damon Hart-Davis 2018
+*/
+
+/*
+ * Unit tests for the duty-cycle-aware TX scheduler.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <gtest/gtest.h>
+#include <OTV0p2Base.h>
+#include <OTRadioLink.h>
+
+namespace TXST
+{
+    // Mock clock, set by the tests.
+    uint32_t nowMs;
+    uint32_t getTimeMs() { return(nowMs); }
+
+    // Radio that records what it is asked to send.
+    class RecordingRadio final : public OTRadioLink::OTRadioLink
+    {
+    public:
+        bool sendOK = true;
+        int sends = 0;
+        uint8_t lastLen = 0;
+        uint8_t lastFirst = 0;
+        int8_t lastChannel = -1;
+        uint32_t lastTime = 0;
+        int8_t configured = 0;
+        virtual bool begin() override { return(true); }
+        virtual void getCapacity(uint8_t &q, uint8_t &r, uint8_t &t) const override { q = 1; r = 64; t = 255; }
+        virtual uint8_t getRXMsgsQueued() const override { return(0); }
+        virtual const volatile uint8_t *peekRXMsg() const override { return(NULL); }
+        virtual void removeRXMsg() override { }
+        virtual bool sendRaw(const uint8_t *buf, uint8_t buflen, int8_t channel = 0, TXpower = TXnormal, bool = false) override
+            {
+            ++sends;
+            lastLen = buflen;
+            lastFirst = buf[0];
+            lastChannel = channel;
+            lastTime = nowMs;
+            return(sendOK);
+            }
+    private:
+        virtual bool _doconfig() override { configured = nChannels; return(true); }
+        virtual void _dolisten() override { }
+    };
+
+    const OTRadioLink::OTRadioChannelConfig configs[2] = { { NULL, true }, { NULL, true } };
+
+    // 10 byte frames take 4ms at the defaults, so 1% of a 16s window (160ms) is 40 frames.
+    typedef OTRadioLink::OTRadioLinkTXScheduled<getTimeMs, 4, 16, 2> sched_t;
+    constexpr uint32_t window = 16000;
+    constexpr uint8_t frameLen = 10;
+    const uint8_t frame[frameLen] = { 1 };
+
+    // Poll for up to ms, a millisecond at a time.
+    void run(sched_t &s, const uint32_t ms) { for(uint32_t i = 0; i < ms; ++i) { ++nowMs; s.poll(); } }
+}
+
+// Frames are queued at once and sent later in order; the wrapped radio is configured through the wrapper.
+TEST(TXScheduler, QueueAndSend)
+{
+    OTV0P2BASE::seedRNG8(1, 2, 3);
+    TXST::nowMs = 1000;
+    TXST::RecordingRadio r;
+    TXST::sched_t s(r, TXST::sched_t::DefaultBitRate, TXST::sched_t::DefaultOverheadBytes, TXST::window);
+    ASSERT_TRUE(s.configure(2, TXST::configs));
+    EXPECT_EQ(2, r.configured);
+    uint8_t q, rl, t;
+    s.getCapacity(q, rl, t);
+    EXPECT_EQ(16, t);
+    EXPECT_EQ(4U, s.airtimeMs(TXST::frameLen));
+    for(uint8_t i = 1; i <= 4; ++i)
+        {
+        uint8_t f[TXST::frameLen] = { i };
+        EXPECT_TRUE(s.queueToSend(f, sizeof(f), (4 == i) ? 1 : 0));
+        }
+    EXPECT_EQ(0, r.sends);
+    EXPECT_EQ(4, s.getTXMsgsQueued());
+    // Full, too long, or bad channel.
+    EXPECT_FALSE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    uint8_t big[17] = { };
+    EXPECT_FALSE(s.queueToSend(big, sizeof(big)));
+    EXPECT_FALSE(s.queueToSend(TXST::frame, sizeof(TXST::frame), 2));
+    // All sent, in order, within a few backoff slots.
+    uint8_t expected = 1;
+    uint32_t lastTime = 0;
+    for(int i = 0; (i < 1000) && (0 != s.getTXMsgsQueued()); ++i)
+        {
+        TXST::run(s, 1);
+        if(r.sends == expected)
+            {
+            EXPECT_EQ(expected, r.lastFirst);
+            EXPECT_EQ((4 == expected) ? 1 : 0, r.lastChannel);
+            EXPECT_LE(lastTime, r.lastTime);
+            lastTime = r.lastTime;
+            ++expected;
+            }
+        }
+    EXPECT_EQ(4, r.sends);
+    EXPECT_EQ(12U, s.getAirtimeUsedMs(0));
+    EXPECT_EQ(4U, s.getAirtimeUsedMs(1));
+}
+
+// Sends stop when the budget is used and resume as it expires.
+TEST(TXScheduler, DutyCycle)
+{
+    OTV0P2BASE::seedRNG8(4, 5, 6);
+    TXST::nowMs = 0;
+    TXST::RecordingRadio r;
+    TXST::sched_t s(r, TXST::sched_t::DefaultBitRate, TXST::sched_t::DefaultOverheadBytes, TXST::window);
+    s.configure(2, TXST::configs);
+    // Direct sends count against the budget and are refused beyond it.
+    int direct = 0;
+    while(s.sendRaw(TXST::frame, sizeof(TXST::frame))) { ++direct; }
+    EXPECT_EQ(40, direct);
+    EXPECT_EQ(160U, s.getAirtimeUsedMs(0));
+    // The other channel has its own budget.
+    EXPECT_TRUE(s.sendRaw(TXST::frame, sizeof(TXST::frame), 1));
+    // Queued frames wait for the airtime used to leave the window.
+    ASSERT_TRUE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    const int sent = r.sends;
+    TXST::run(s, TXST::window - 100);
+    EXPECT_EQ(sent, r.sends);
+    EXPECT_EQ(1, s.getTXMsgsQueued());
+    TXST::run(s, 200);
+    EXPECT_EQ(sent + 1, r.sends);
+    EXPECT_EQ(0, s.getTXMsgsQueued());
+    EXPECT_EQ(0, s.getTXMsgsDropped());
+    // A lower duty cycle can be set.
+    s.setDutyCyclePermille(1, 0);
+    EXPECT_FALSE(s.sendRaw(TXST::frame, sizeof(TXST::frame), 1));
+}
+
+// Frames the radio will not send are retried with backoff then dropped.
+TEST(TXScheduler, Retry)
+{
+    OTV0P2BASE::seedRNG8(7, 8, 9);
+    TXST::nowMs = 0;
+    TXST::RecordingRadio r;
+    r.sendOK = false;
+    TXST::sched_t s(r, TXST::sched_t::DefaultBitRate, TXST::sched_t::DefaultOverheadBytes, 3600000UL);
+    s.configure(1, TXST::configs);
+    ASSERT_TRUE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    ASSERT_TRUE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    TXST::run(s, 60000);
+    EXPECT_EQ(2 * TXST::sched_t::maxTXAttempts, r.sends);
+    EXPECT_EQ(0, s.getTXMsgsQueued());
+    EXPECT_EQ(2, s.getTXMsgsDropped());
+}
+
+// Frames that can never fit the budget are refused, or dropped, rather than block the queue.
+TEST(TXScheduler, OverBudget)
+{
+    OTV0P2BASE::seedRNG8(10, 11, 12);
+    TXST::nowMs = 0;
+    TXST::RecordingRadio r;
+    // 1 per mille of a 16s window is 16ms; 16 byte frames take 5ms, 10 byte 4ms.
+    TXST::sched_t s(r, TXST::sched_t::DefaultBitRate, TXST::sched_t::DefaultOverheadBytes, TXST::window);
+    s.configure(2, TXST::configs);
+    s.setDutyCyclePermille(0, 1);
+    const uint8_t big[16] = { 2 };
+    EXPECT_TRUE(s.queueToSend(big, sizeof(big)));
+    // A 100 byte overhead makes even a 1 byte frame too long for the budget.
+    TXST::sched_t s2(r, TXST::sched_t::DefaultBitRate, 100, TXST::window);
+    s2.setDutyCyclePermille(0, 1);
+    EXPECT_FALSE(s2.queueToSend(TXST::frame, 1));
+    EXPECT_EQ(0, s2.getTXMsgsQueued());
+    // No budget at all.
+    s.setDutyCyclePermille(1, 0);
+    EXPECT_FALSE(s.queueToSend(TXST::frame, sizeof(TXST::frame), 1));
+    // Budget cut to nothing after queueing: the head is dropped and the next sent.
+    ASSERT_TRUE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    ASSERT_TRUE(s.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    s.setDutyCyclePermille(0, 0);
+    TXST::run(s, 1000);
+    EXPECT_EQ(0, r.sends);
+    EXPECT_EQ(0, s.getTXMsgsQueued());
+    EXPECT_EQ(3, s.getTXMsgsDropped());
+    // Budget cut below one big frame: dropped, while a smaller one behind it is sent.
+    // 1 per mille of a 4.5s window is 4ms.
+    TXST::sched_t s3(r, TXST::sched_t::DefaultBitRate, TXST::sched_t::DefaultOverheadBytes, 4500);
+    ASSERT_TRUE(s3.queueToSend(big, sizeof(big)));
+    ASSERT_TRUE(s3.queueToSend(TXST::frame, sizeof(TXST::frame)));
+    s3.setDutyCyclePermille(0, 1);
+    for(int i = 0; i < 1000; ++i) { ++TXST::nowMs; s3.poll(); }
+    EXPECT_EQ(1, r.sends);
+    EXPECT_EQ(TXST::frameLen, r.lastLen);
+    EXPECT_EQ(0, s3.getTXMsgsQueued());
+    EXPECT_EQ(1, s3.getTXMsgsDropped());
+}
@@ -21,6 +21,8 @@ Author(s) / Copyright (s): Damon Hart-Davis 2016
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <string>
 #include <gtest/gtest.h>
 #include <OTV0p2Base.h>
 #include <OTRadValve.h>
@@ -174,6 +176,131 @@ TEST(JSONStats,JSONForTX)
 //  AssertIsTrue(quickValidateRawSimpleJSONMessage(buf));
   }
 
+namespace JSONRXT
+  {
+  // Make the TX form of a JSON message in buf, ie with '}'|0x80 and the CRC.
+  // Returns the length including the CRC.
+  uint8_t makeTX(char *const buf, const char *const json)
+    {
+    strcpy(buf, json);
+    const uint8_t crc = OTV0P2BASE::adjustJSONMsgForTXAndComputeCRC(buf);
+    const uint8_t l = uint8_t(strlen(buf));
+    buf[l] = char((0 == crc) ? 0x80 : crc);
+    return(uint8_t(l + 1));
+    }
+  }
+
+// Test tokenizing received JSON messages in place.
+TEST(JSONStats,JSONStatsRXTokenizer)
+  {
+  char buf[OTV0P2BASE::MSG_JSON_ABS_MAX_LENGTH + 2];
+  const uint8_t l = JSONRXT::makeTX(buf, "{\"@\":\"cdfb\",\"T|C16\":299,\"H|%\":83,\"L\":-255,\"B|cV\":256}");
+  const uint8_t *const b = reinterpret_cast<const uint8_t *>(buf);
+  OTV0P2BASE::JSONStatsRXTokenizer t(b, l);
+  ASSERT_TRUE(t.next());
+  EXPECT_EQ(OTV0P2BASE::JSONStatsRXTokenizer::JSON_STRING, t.type);
+  EXPECT_EQ(std::string("@"), std::string(t.key, t.keyLen));
+  EXPECT_EQ(std::string("cdfb"), std::string(t.str, t.strLen));
+  EXPECT_FALSE(t.isValid());
+  const char *const keys[] = { "T|C16", "H|%", "L", "B|cV" };
+  const int16_t values[] = { 299, 83, -255, 256 };
+  for(int i = 0; i < 4; ++i)
+    {
+    ASSERT_TRUE(t.next());
+    EXPECT_EQ(OTV0P2BASE::JSONStatsRXTokenizer::JSON_INT, t.type);
+    EXPECT_EQ(std::string(keys[i]), std::string(t.key, t.keyLen));
+    EXPECT_EQ(values[i], t.value);
+    // Points into the message.
+    EXPECT_LT(buf, t.key);
+    EXPECT_GT(buf + l, t.key);
+    }
+  // Valid as soon as the last pair is yielded.
+  EXPECT_TRUE(t.isValid());
+  EXPECT_FALSE(t.next());
+  EXPECT_TRUE(t.isValid());
+  EXPECT_EQ(OTV0P2BASE::checkJSONMsgRXCRC(b, l), t.getLength());
+
+  // Every corruption of the message is caught by one or the other check.
+  for(uint8_t i = 0; i < l; ++i)
+    {
+    for(uint8_t bit = 1; 0 != bit; bit = uint8_t(bit << 1))
+      {
+      buf[i] = char(buf[i] ^ bit);
+      OTV0P2BASE::JSONStatsRXTokenizer tc(b, l);
+      while(tc.next()) { }
+      EXPECT_FALSE(tc.isValid()) << int(i) << " " << int(bit);
+      EXPECT_EQ(0, tc.getLength());
+      buf[i] = char(buf[i] ^ bit);
+      }
+    }
+  // Truncated.
+  OTV0P2BASE::JSONStatsRXTokenizer tt(b, uint8_t(l - 1));
+  while(tt.next()) { }
+  EXPECT_FALSE(tt.isValid());
+
+  // Empty object, and the raw (untransmitted) form.
+  const uint8_t le = JSONRXT::makeTX(buf, "{}");
+  OTV0P2BASE::JSONStatsRXTokenizer te(b, le);
+  EXPECT_FALSE(te.next());
+  EXPECT_TRUE(te.isValid());
+  EXPECT_EQ(2, te.getLength());
+  const char raw[] = "{\"L\":42}";
+  OTV0P2BASE::JSONStatsRXTokenizer tr(reinterpret_cast<const uint8_t *>(raw), sizeof(raw));
+  ASSERT_TRUE(tr.next());
+  EXPECT_EQ(42, tr.value);
+  EXPECT_TRUE(tr.isValid());
+
+  // int16_t limits, and forms that are not supported.
+  const char *const good[] = { "{\"a\":-32768}", "{\"a\":32767}", "{\"a\":0,\"b\":\"\"}" };
+  for(const char *const j : good)
+    {
+    OTV0P2BASE::JSONStatsRXTokenizer tg(b, JSONRXT::makeTX(buf, j));
+    while(tg.next()) { }
+    EXPECT_TRUE(tg.isValid()) << j;
+    }
+  const char *const bad[] = { "{\"a\":32768}", "{\"a\":-32769}", "{\"a\":1,}", "{\"a\": 1}", "{\"a\":true}",
+                               "{\"a\":-}", "{\"a\"}", "{\"a\\\"\":1}", "{,}" };
+  for(const char *const j : bad)
+    {
+    OTV0P2BASE::JSONStatsRXTokenizer tb(b, JSONRXT::makeTX(buf, j));
+    while(tb.next()) { }
+    EXPECT_FALSE(tb.isValid()) << j;
+    }
+  }
+
+// Lenient tokenizing of JSON needing no CRC, eg from a secure frame body.
+TEST(JSONStats,JSONStatsRXTokenizerLenient)
+  {
+  // Closing '}' not sent, as in a full 'O' frame.
+  const char body[] = "{\"b\":1,\"L\":99";
+  OTV0P2BASE::JSONStatsRXTokenizer t(reinterpret_cast<const uint8_t *>(body), uint8_t(sizeof(body) - 1), true);
+  ASSERT_TRUE(t.next());
+  EXPECT_EQ(1, t.value);
+  ASSERT_TRUE(t.next());
+  EXPECT_EQ(std::string("L"), std::string(t.key, t.keyLen));
+  EXPECT_EQ(99, t.value);
+  EXPECT_TRUE(t.isValid());
+  EXPECT_FALSE(t.next());
+  // Not valid unless lenient.
+  OTV0P2BASE::JSONStatsRXTokenizer ts(reinterpret_cast<const uint8_t *>(body), uint8_t(sizeof(body) - 1));
+  while(ts.next()) { }
+  EXPECT_FALSE(ts.isValid());
+  // No terminating '\0' or CRC needed after the closing '}'.
+  const char raw[] = { '{', '"', 'L', '"', ':', '7', char('}' | 0x80), 0x55 };
+  OTV0P2BASE::JSONStatsRXTokenizer tr(reinterpret_cast<const uint8_t *>(raw), uint8_t(sizeof(raw)), true);
+  ASSERT_TRUE(tr.next());
+  EXPECT_EQ(7, tr.value);
+  EXPECT_TRUE(tr.isValid());
+  // Still rejects a string or key cut short by the end of the buffer.
+  const char *const bad[] = { "{\"@\":\"cd", "{\"L", "{\"L\":", "{\"L\":-", "{" };
+  for(const char *const j : bad)
+    {
+    OTV0P2BASE::JSONStatsRXTokenizer tb(reinterpret_cast<const uint8_t *>(j), uint8_t(strlen(j)), true);
+    while(tb.next()) { }
+    EXPECT_FALSE(tb.isValid()) << j;
+    }
+  }
+
 
 // Testing stats object sizing with placeholders.
 TEST(JSONStats,VariadicJSON0)
@@ -500,3 +500,130 @@ TEST(getNextMatchingNodeID, ReturnCorrectIDWithPartialPrefix)
     EXPECT_EQ(7, i7);
     EXPECT_THAT(outbuf, ::testing::ElementsAreArray(id7));
 }
+
+
+// Test that NodeAssociationTableIndexed matches getNextMatchingNodeIDGeneric
+// over the mock for random tables (including gaps) and queries.
+TEST(NodeAssociationTableIndexed, MatchesGenericScan)
+{
+    static OTV0P2BASE::NodeAssociationTableIndexed<OTV0P2BASE::NodeAssociationTableMock::maxSets> indexed;
+    srandom(42);
+    for (int round = 0; round < 200; ++round) {
+        GNMNID::nodes._reset();
+        indexed._reset();
+        // Small alphabet so that prefixes collide; occasionally 0xff to make gaps.
+        const int nSets = 1 + (random() % 16);
+        for (int s = 0; s < nSets; ++s) {
+            const uint8_t index = uint8_t(random() % GNMNID::nodes.maxSets);
+            uint8_t id[GNMNID::nodes.idLength];
+            for (auto& x: id) { x = uint8_t(random() % 3); }
+            if (0 == (random() % 5)) { id[0] = 0xff; }
+            ASSERT_TRUE(GNMNID::nodes.set(index, id));
+            ASSERT_TRUE(indexed.set(index, id));
+        }
+        for (int q = 0; q < 50; ++q) {
+            const uint8_t index = uint8_t(random() % (GNMNID::nodes.maxSets + 1));
+            const uint8_t prefixLen = uint8_t(random() % (GNMNID::nodes.idLength + 1));
+            uint8_t prefix[GNMNID::nodes.idLength];
+            for (auto& x: prefix) { x = uint8_t(random() % 3); }
+            uint8_t expected[GNMNID::nodes.idLength] = {};
+            uint8_t actual[GNMNID::nodes.idLength] = {};
+            const int8_t e = GNMNID::getNextMatchingNodeID(index, prefix, prefixLen, expected);
+            const int16_t a = indexed.getNextMatchingNodeID(index, prefix, prefixLen, actual);
+            ASSERT_EQ(e, a);
+            if (e >= 0) { EXPECT_EQ(0, memcmp(expected, actual, sizeof(expected))); }
+        }
+    }
+}
+
+// Test NodeAssociationTableIndexed with many more entries than fit in EEPROM.
+TEST(NodeAssociationTableIndexed, LargeTable)
+{
+    constexpr uint16_t n = 20000;
+    static OTV0P2BASE::NodeAssociationTableIndexed<n> nodes;
+    nodes._reset();
+    uint8_t id[nodes.idLength] = { 0x80, 0, 0, 0, 0x81, 0x82, 0x83, 0x84 };
+    for (uint16_t i = 0; i < n; ++i) {
+        // Spread IDs so that the sorted order differs from the slot order.
+        const uint16_t v = uint16_t(i * 7919U);
+        id[1] = uint8_t(v >> 8);
+        id[2] = uint8_t(v);
+        id[3] = uint8_t(i & 0x3f);
+        ASSERT_TRUE(nodes.setEntry(i, id));
+    }
+    EXPECT_EQ(n, nodes.countEntries());
+    // Out of range fails.
+    EXPECT_FALSE(nodes.setEntry(n, id));
+    EXPECT_EQ(-1, nodes.getNextMatchingNodeID(n, id, 4, nullptr));
+
+    uint8_t out[nodes.idLength];
+    for (uint16_t i = 0; i < n; i += 997) {
+        const uint16_t v = uint16_t(i * 7919U);
+        const uint8_t prefix[] = { 0x80, uint8_t(v >> 8), uint8_t(v), uint8_t(i & 0x3f) };
+        EXPECT_EQ(int16_t(i), nodes.getNextMatchingNodeID(0, prefix, sizeof(prefix), out));
+        EXPECT_EQ(0, memcmp(prefix, out, sizeof(prefix)));
+        // Not found when starting after it.
+        EXPECT_EQ(-1, nodes.getNextMatchingNodeID(uint16_t(i + 1), prefix, sizeof(prefix), nullptr));
+    }
+
+    // Clearing a slot stops a scan there, as for the EEPROM table.
+    const uint8_t empty[nodes.idLength] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    ASSERT_TRUE(nodes.setEntry(100, empty));
+    EXPECT_EQ(n - 1, nodes.countEntries());
+    const uint8_t anyPrefix[] = { 0x80 };
+    EXPECT_EQ(99, nodes.getNextMatchingNodeID(99, anyPrefix, sizeof(anyPrefix), nullptr));
+    EXPECT_EQ(-1, nodes.getNextMatchingNodeID(100, anyPrefix, sizeof(anyPrefix), nullptr));
+    EXPECT_EQ(101, nodes.getNextMatchingNodeID(101, anyPrefix, sizeof(anyPrefix), nullptr));
+    const uint16_t v200 = uint16_t(200 * 7919U);
+    const uint8_t prefix200[] = { 0x80, uint8_t(v200 >> 8), uint8_t(v200), uint8_t(200 & 0x3f) };
+    EXPECT_EQ(-1, nodes.getNextMatchingNodeID(0, prefix200, sizeof(prefix200), nullptr));
+    EXPECT_EQ(200, nodes.getNextMatchingNodeID(101, prefix200, sizeof(prefix200), nullptr));
+}
+
+// Test that NodeIDPrefixFilter never rejects an association,
+// rejects most other prefixes, and is rebuilt from a table.
+TEST(NodeIDPrefixFilter, NoFalseNegatives)
+{
+    constexpr uint16_t n = 500;
+    static OTV0P2BASE::NodeAssociationTableIndexed<n> nodes;
+    OTV0P2BASE::NodeIDPrefixFilter<8192> filter;
+    nodes._reset();
+    // Empty filter passes only prefixes too short to check.
+    uint8_t id[nodes.idLength] = { 0x80, 0, 0, 0, 0x81, 0x82, 0x83, 0x84 };
+    EXPECT_FALSE(filter.mayContain(id, 4));
+    EXPECT_TRUE(filter.mayContain(id, 3));
+    EXPECT_TRUE(filter.mayContain(nullptr, 0));
+
+    srandom(42);
+    const uint32_t g0 = nodes.getGeneration();
+    for (uint16_t i = 0; i < n; ++i) {
+        for (auto& x: id) { x = uint8_t(random()); }
+        id[0] &= 0x7f;
+        ASSERT_TRUE(nodes.setEntry(i, id));
+    }
+    EXPECT_NE(g0, nodes.getGeneration());
+    filter.rebuild(nodes);
+    for (uint16_t i = 0; i < n; ++i) {
+        ASSERT_EQ(int16_t(i), nodes.getNextMatchingNodeID(i, nullptr, 0, id));
+        EXPECT_TRUE(filter.check(id, 4));
+        EXPECT_TRUE(filter.check(id, 8));
+    }
+    EXPECT_EQ(2U * n, filter.getPassedCount());
+    EXPECT_EQ(0U, filter.getFilteredCount());
+
+    // Foreign IDs (top bit set so never associated) are mostly filtered.
+    filter.resetCounts();
+    constexpr uint32_t foreign = 10000;
+    for (uint32_t i = 0; i < foreign; ++i) {
+        for (auto& x: id) { x = uint8_t(random()); }
+        id[0] |= 0x80;
+        filter.check(id, 4);
+    }
+    EXPECT_EQ(foreign, filter.getPassedCount() + filter.getFilteredCount());
+    EXPECT_LT(filter.getPassedCount(), foreign / 20);
+
+    // Rebuilding from an emptied table filters everything checkable.
+    nodes._reset();
+    filter.rebuild(nodes);
+    EXPECT_FALSE(filter.mayContain(id, 4));
+}